@@ -29,16 +29,55 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/un.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include "audispd-pconfig.h"
 #include "audispd-builtins.h"
 
+/*
+ * The af_unix builtin serves any number of local subscribers up to
+ * AF_UNIX_MAX_CLIENTS. Every client has its own bounded queue of
+ * references to the shared events, which are written straight out of
+ * the shared buffers with non-blocking writev. A client that falls
+ * behind loses events once its queue is full, and is disconnected when
+ * it drops more than a queue's worth without reading anything. Clients
+ * are accepted and drained by a thread of their own.
+ */
+#define AF_UNIX_MAX_CLIENTS	32
+#define AF_UNIX_CLIENT_DEPTH	4096
+#define AF_UNIX_IOV		64	/* Events per writev */
+
+struct af_unix_entry
+{
+	shared_event_t *se;
+	int binary;
+};
+
+struct af_unix_client
+{
+	int fd;
+	struct af_unix_entry *ring;
+	unsigned int head, len;
+	size_t offset;		/* Bytes of ring[head] already written */
+	unsigned int lost;	/* Drops since the client last read */
+	unsigned long long sent, dropped;
+};
+
 // Local data
-static volatile int sock = -1, conn = -1;
+static volatile int sock = -1;
 static int syslog_started = 0, priority;
 static char *path = NULL;
+static pthread_mutex_t af_unix_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct af_unix_client clients[AF_UNIX_MAX_CLIENTS];
+static unsigned int client_cnt = 0;
+static unsigned long long evicted = 0;
+static int wake_pipe[2] = { -1, -1 };
+static pthread_t af_unix_thread;
+static int af_unix_running = 0, af_unix_stop = 0;
 
 // Local prototypes
 static void init_af_unix(const plugin_conf_t *conf);
@@ -67,19 +106,266 @@ void stop_builtin(plugin_conf_t *conf)
 		syslog(LOG_ERR, "Unknown builtin %s", conf->path);
 }
 
-static void af_unix_accept(int fd)
+static void set_fd_flags(int fd)
 {
 	int cmd;
 
-	do {
-		conn = accept(fd, NULL, NULL);
-	} while (conn < 0 && errno == EINTR);
+	cmd = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, cmd|O_NONBLOCK);
+	cmd = fcntl(fd, F_GETFD);
+	fcntl(fd, F_SETFD, cmd|FD_CLOEXEC);
+}
+
+/* Called with af_unix_lock held */
+static void remove_client(unsigned int i)
+{
+	struct af_unix_client *c = &clients[i];
+
+	close(c->fd);
+	while (c->len) {
+		shared_event_put(c->ring[c->head].se);
+		c->head = (c->head + 1) % AF_UNIX_CLIENT_DEPTH;
+		c->len--;
+	}
+	free(c->ring);
+	client_cnt--;
+	if (i != client_cnt)
+		clients[i] = clients[client_cnt];
+}
+
+static struct af_unix_client *find_client(int fd, unsigned int *idx)
+{
+	unsigned int i;
+
+	for (i = 0; i < client_cnt; i++) {
+		if (clients[i].fd == fd) {
+			*idx = i;
+			return &clients[i];
+		}
+	}
+	return NULL;
+}
+
+static void af_unix_accept(int fd)
+{
+	int conn;
+
+	for (;;) {
+		struct af_unix_client *c;
+
+		do {
+			conn = accept(fd, NULL, NULL);
+		} while (conn < 0 && errno == EINTR);
+		if (conn < 0)
+			return;
+
+		if (client_cnt == AF_UNIX_MAX_CLIENTS) {
+			syslog(LOG_ERR,
+			    "af_unix plugin has too many clients, rejecting");
+			close(conn);
+			continue;
+		}
+		set_fd_flags(conn);
+		c = &clients[client_cnt];
+		memset(c, 0, sizeof(*c));
+		c->ring = malloc(AF_UNIX_CLIENT_DEPTH *
+					sizeof(struct af_unix_entry));
+		if (c->ring == NULL) {
+			close(conn);
+			continue;
+		}
+		c->fd = conn;
+		client_cnt++;
+	}
+}
+
+static size_t entry_len(const struct af_unix_entry *ent)
+{
+	if (ent->binary)
+		return sizeof(struct audit_dispatcher_header) +
+			ent->se->e->hdr.size;
+	return ent->se->len;
+}
+
+/* Points iov at what is left of an event after skipping skip bytes.
+ * Returns the number of iovecs used. */
+static int entry_iov(const struct af_unix_entry *ent, size_t skip,
+		struct iovec *iov)
+{
+	shared_event_t *se = ent->se;
+	int n = 0;
+
+	if (ent->binary) {
+		size_t hlen = sizeof(struct audit_dispatcher_header);
+
+		if (skip < hlen) {
+			iov[n].iov_base = (char *)&se->e->hdr + skip;
+			iov[n].iov_len = hlen - skip;
+			n++;
+			skip = 0;
+		} else
+			skip -= hlen;
+		iov[n].iov_base = se->e->data + skip;
+		iov[n].iov_len = se->e->hdr.size - skip;
+		n++;
+	} else {
+		iov[n].iov_base = se->str + skip;
+		iov[n].iov_len = se->len - skip;
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Writes as much of the client's queue as the socket takes without
+ * blocking. Called with af_unix_lock held. Returns -1 if the client
+ * has to go, 0 otherwise.
+ */
+static int flush_client(struct af_unix_client *c)
+{
+	while (c->len) {
+		struct iovec iov[AF_UNIX_IOV * 2];
+		unsigned int i;
+		ssize_t rc;
+		int n = 0;
+
+		for (i = 0; i < c->len && i < AF_UNIX_IOV; i++)
+			n += entry_iov(&c->ring[(c->head + i) %
+					AF_UNIX_CLIENT_DEPTH],
+					i ? 0 : c->offset, &iov[n]);
+		do {
+			rc = writev(c->fd, iov, n);
+		} while (rc < 0 && errno == EINTR);
+		if (rc < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ?
+				0 : -1;
+
+		/* Retire everything that went out completely */
+		c->lost = 0;
+		while (rc > 0) {
+			struct af_unix_entry *ent = &c->ring[c->head];
+			size_t left = entry_len(ent) - c->offset;
+
+			if ((size_t)rc < left) {
+				c->offset += rc;
+				break;
+			}
+			rc -= left;
+			shared_event_put(ent->se);
+			ent->se = NULL;
+			c->head = (c->head + 1) % AF_UNIX_CLIENT_DEPTH;
+			c->len--;
+			c->offset = 0;
+			c->sent++;
+		}
+	}
+	return 0;
+}
+
+static void nudge_af_unix(void)
+{
+	char c = 0;
+	int rc;
+
+	rc = write(wake_pipe[1], &c, 1);
+	(void)rc; /* A full pipe means it's awake already */
+}
+
+/* Accepts new clients and finishes writes that would have blocked */
+static void *af_unix_thread_main(void *arg)
+{
+	struct pollfd pfd[AF_UNIX_MAX_CLIENTS + 2];
+
+	for (;;) {
+		unsigned int i, n;
+		int rc;
+
+		pthread_mutex_lock(&af_unix_lock);
+		if (af_unix_stop) {
+			pthread_mutex_unlock(&af_unix_lock);
+			break;
+		}
+		pfd[0].fd = wake_pipe[0];
+		pfd[0].events = POLLIN;
+		pfd[1].fd = sock;
+		pfd[1].events = POLLIN;
+		for (i = 0; i < client_cnt; i++) {
+			pfd[i+2].fd = clients[i].fd;
+			pfd[i+2].events = POLLIN;
+			if (clients[i].len)
+				pfd[i+2].events |= POLLOUT;
+		}
+		n = client_cnt + 2;
+		pthread_mutex_unlock(&af_unix_lock);
+
+		do {
+			rc = poll(pfd, n, -1);
+		} while (rc < 0 && errno == EINTR);
+		if (rc <= 0)
+			continue;
+
+		if (pfd[0].revents & POLLIN) {
+			char buf[64];
+
+			while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		pthread_mutex_lock(&af_unix_lock);
+		/* Clients can be evicted while we poll, so go by fd */
+		for (i = 2; i < n; i++) {
+			struct af_unix_client *c;
+			unsigned int idx;
+
+			if (pfd[i].revents == 0)
+				continue;
+			c = find_client(pfd[i].fd, &idx);
+			if (c == NULL)
+				continue;
+			if (pfd[i].revents & POLLIN) {
+				char buf[256];
+
+				/* Subscribers don't talk back */
+				do {
+					rc = read(c->fd, buf, sizeof(buf));
+				} while (rc > 0 || (rc < 0 && errno == EINTR));
+				if (rc == 0) {
+					remove_client(idx);
+					continue;
+				}
+			}
+			if (pfd[i].revents & (POLLHUP|POLLERR|POLLNVAL)) {
+				remove_client(idx);
+				continue;
+			}
+			if ((pfd[i].revents & POLLOUT) && flush_client(c) < 0)
+				remove_client(idx);
+		}
+		if (pfd[1].revents & POLLIN)
+			af_unix_accept(sock);
+		pthread_mutex_unlock(&af_unix_lock);
+	}
+	return NULL;
+}
 
-	// De-register since this is intended to be one listener
-	if (conn >= 0)
-		remove_event(fd);
-	cmd = fcntl(conn, F_GETFD);
-	fcntl(conn, F_SETFD, cmd|FD_CLOEXEC);
+static void start_af_unix_thread(void)
+{
+	if (pipe(wake_pipe)) {
+		syslog(LOG_ERR, "Couldn't create af_unix wakeup pipe (%s)",
+			strerror(errno));
+		destroy_af_unix();
+		return;
+	}
+	set_fd_flags(wake_pipe[0]);
+	set_fd_flags(wake_pipe[1]);
+	af_unix_stop = 0;
+	if (pthread_create(&af_unix_thread, NULL, af_unix_thread_main,
+				NULL)) {
+		syslog(LOG_ERR, "Couldn't start af_unix thread");
+		destroy_af_unix();
+		return;
+	}
+	af_unix_running = 1;
 }
 
 static int create_af_unix_socket(const char *path, int mode)
@@ -125,9 +411,6 @@ static int create_af_unix_socket(const char *path, int mode)
 
 	// Make socket listening...won't block
 	(void)listen(sock, 5);
-
-	// Register socket with poll
-	add_event(sock, af_unix_accept);
 	return 0;
 }
 
@@ -201,61 +484,99 @@ static void init_af_unix(const plugin_conf_t *conf)
 		}
 		i++;
 	}
-	syslog(LOG_INFO, "af_unix plugin initialized");
+	if (sock < 0)
+		return;
+	start_af_unix_thread();
+	if (af_unix_running)
+		syslog(LOG_INFO, "af_unix plugin initialized");
 }
 
-void send_af_unix_string(const char *s, unsigned int len)
+/* Hands the event to every subscriber. Never blocks. */
+void send_af_unix(shared_event_t *se, format_t format)
 {
-	if (sock < 0) 
-		return;
+	unsigned int i = 0;
+	int nudge = 0;
 
-	if (conn >= 0) {
-		int rc;
-		do {
-			rc = write(conn, s, len);
-		} while (rc < 0 && errno == EINTR);
-		if (rc < 0 && errno == EPIPE) {
-			close(conn);
-			conn = -1;
-			add_event(sock, af_unix_accept);
+	pthread_mutex_lock(&af_unix_lock);
+	while (i < client_cnt) {
+		struct af_unix_client *c = &clients[i];
+		struct af_unix_entry *ent;
+
+		if (c->len == AF_UNIX_CLIENT_DEPTH) {
+			c->dropped++;
+			if (++c->lost > AF_UNIX_CLIENT_DEPTH) {
+				syslog(LOG_WARNING,
+		    "af_unix client is not reading, disconnecting it (%llu sent, %llu dropped)",
+					c->sent, c->dropped);
+				remove_client(i);
+				evicted++;
+				continue;
+			}
+			i++;
+			continue;
 		}
-	} 
+
+		shared_event_get(se);
+		ent = &c->ring[(c->head + c->len) % AF_UNIX_CLIENT_DEPTH];
+		ent->se = se;
+		ent->binary = format == F_BINARY;
+		c->len++;
+
+		/* Idle clients get it right away, the thread takes over
+		 * if the socket is full */
+		if (c->len == 1) {
+			if (flush_client(c) < 0) {
+				remove_client(i);
+				continue;
+			}
+			if (c->len)
+				nudge = 1;
+		}
+		i++;
+	}
+	pthread_mutex_unlock(&af_unix_lock);
+	if (nudge)
+		nudge_af_unix();
 }
 
-void send_af_unix_binary(event_t *e)
+void report_af_unix(void)
 {
-	if (sock < 0) 
-		return;
+	unsigned int i;
 
-	if (conn >= 0) {
-		int rc;
-		struct iovec vec[2];
-
-		vec[0].iov_base = &e->hdr;
-		vec[0].iov_len = sizeof(struct audit_dispatcher_header);
-		vec[1].iov_base = e->data;
-		vec[1].iov_len = MAX_AUDIT_MESSAGE_LENGTH;
-		do {
-			rc = writev(conn, vec, 2);
-		} while (rc < 0 && errno == EINTR);
-		if (rc < 0 && errno == EPIPE) {
-			close(conn);
-			conn = -1;
-			add_event(sock, af_unix_accept);
-		}
-	} 
+	pthread_mutex_lock(&af_unix_lock);
+	syslog(LOG_INFO, "af_unix plugin: clients=%u evicted=%llu",
+		client_cnt, evicted);
+	for (i = 0; i < client_cnt; i++)
+		syslog(LOG_INFO,
+			"af_unix client %d: sent=%llu dropped=%llu depth=%u/%u",
+			clients[i].fd, clients[i].sent, clients[i].dropped,
+			clients[i].len, AF_UNIX_CLIENT_DEPTH);
+	pthread_mutex_unlock(&af_unix_lock);
 }
 
 void destroy_af_unix(void)
 {
-	if (conn >= 0) {
-		close(conn);
-		conn = -1;
+	if (af_unix_running) {
+		pthread_mutex_lock(&af_unix_lock);
+		af_unix_stop = 1;
+		pthread_mutex_unlock(&af_unix_lock);
+		nudge_af_unix();
+		pthread_join(af_unix_thread, NULL);
+		af_unix_running = 0;
 	}
+	pthread_mutex_lock(&af_unix_lock);
+	while (client_cnt)
+		remove_client(client_cnt - 1);
 	if (sock >= 0) {
 		close(sock);
 		sock = -1;
 	}
+	pthread_mutex_unlock(&af_unix_lock);
+	if (wake_pipe[0] >= 0) {
+		close(wake_pipe[0]);
+		close(wake_pipe[1]);
+		wake_pipe[0] = wake_pipe[1] = -1;
+	}
 	if (path) {
 		unlink(path);
 		free(path);
@@ -25,11 +25,12 @@
 #define AUDISPD_BUILTINS_HEADER
 
 #include "queue.h"
+#include "audispd-fanout.h"
 
 void start_builtin(plugin_conf_t *conf);
 void stop_builtin(plugin_conf_t *conf);
-void send_af_unix_string(const char *s, unsigned int len);
-void send_af_unix_binary(event_t *e);
+void send_af_unix(shared_event_t *se, format_t format);
+void report_af_unix(void);
 void destroy_af_unix(void);
 void send_syslog(const char *s);
 void destroy_syslog(void);
@@ -0,0 +1,451 @@
+/*
+* audispd-fanout.c - per plugin event queues
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * Every active plugin gets its own bounded queue and a writer thread
+ * that feeds it. The dispatcher only formats an event once and appends a
+ * reference to it to each queue, so a plugin that stops reading only
+ * fills up its own queue and triggers its own overflow_action.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "audispd-fanout.h"
+#include "audispd-builtins.h"
+
+typedef enum { W_RUNNING, W_PAUSED, W_FAILED } writer_state_t;
+
+struct plugin_queue
+{
+	plugin_conf_t *conf;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;	/* Something to write or state change */
+	pthread_cond_t idle;	/* Writer is not inside a write */
+	shared_event_t **ring;
+	unsigned int depth, head, len;
+	overflow_action_t overflow_action;
+	writer_state_t state;
+	int busy;		/* Writer is delivering ring[head] */
+	int suspended;		/* overflow_action was suspend */
+	int stop;
+	/* Statistics */
+	unsigned long long queued, sent, dropped, errors;
+	unsigned int max_len;
+};
+
+/* Enough released events to cover a full burst without going back to
+ * malloc. Anything beyond that is freed. */
+#define POOL_MAX 256
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_event_t *pool;
+static unsigned int pool_cnt;
+
+shared_event_t *shared_event_alloc(event_t *e, unsigned int size)
+{
+	shared_event_t *se;
+
+	pthread_mutex_lock(&pool_lock);
+	se = pool;
+	if (se) {
+		pool = se->next;
+		pool_cnt--;
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	if (se == NULL) {
+		se = calloc(1, sizeof(shared_event_t));
+		if (se == NULL)
+			return NULL;
+	}
+	if (se->size < size) {
+		char *tmp = realloc(se->str, size);
+		if (tmp == NULL) {
+			free(se->str);
+			free(se);
+			return NULL;
+		}
+		se->str = tmp;
+		se->size = size;
+	}
+	se->e = e;
+	se->len = 0;
+	se->refcnt = 1;
+	se->next = NULL;
+	return se;
+}
+
+void shared_event_get(shared_event_t *se)
+{
+	__sync_add_and_fetch(&se->refcnt, 1);
+}
+
+void shared_event_put(shared_event_t *se)
+{
+	if (__sync_sub_and_fetch(&se->refcnt, 1) == 0) {
+		free(se->e);
+		se->e = NULL;
+		pthread_mutex_lock(&pool_lock);
+		if (pool_cnt < POOL_MAX) {
+			se->next = pool;
+			pool = se;
+			pool_cnt++;
+			se = NULL;
+		}
+		pthread_mutex_unlock(&pool_lock);
+		if (se) {
+			free(se->str);
+			free(se);
+		}
+	}
+}
+
+void shared_event_pool_destroy(void)
+{
+	pthread_mutex_lock(&pool_lock);
+	while (pool) {
+		shared_event_t *se = pool;
+
+		pool = se->next;
+		free(se->str);
+		free(se);
+	}
+	pool_cnt = 0;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static int write_to_plugin(shared_event_t *se, plugin_conf_t *conf)
+{
+	int rc;
+
+	if (conf->format == F_STRING) {
+		do {
+			rc = write(conf->plug_pipe[1], se->str, se->len);
+		} while (rc < 0 && errno == EINTR);
+	} else {
+		struct iovec vec[2];
+
+		vec[0].iov_base = &se->e->hdr;
+		vec[0].iov_len = sizeof(struct audit_dispatcher_header);
+
+		vec[1].iov_base = se->e->data;
+		vec[1].iov_len = se->e->hdr.size;
+		do {
+			rc = writev(conf->plug_pipe[1], vec, 2);
+		} while (rc < 0 && errno == EINTR);
+	}
+	return rc;
+}
+
+static int deliver(shared_event_t *se, plugin_conf_t *conf)
+{
+	switch (conf->type)
+	{
+		case S_SYSLOG:
+			send_syslog(se->str);
+			return 0;
+		case S_AF_UNIX:
+			send_af_unix(se, conf->format);
+			return 0;
+		case S_ALWAYS:
+			return write_to_plugin(se, conf);
+		default:
+			return 0;
+	}
+}
+
+static void *writer_thread_main(void *arg)
+{
+	struct plugin_queue *pq = arg;
+
+	pthread_mutex_lock(&pq->lock);
+	while (pq->stop == 0) {
+		shared_event_t *se;
+		int rc;
+
+		if (pq->len == 0 || pq->state != W_RUNNING) {
+			pthread_cond_wait(&pq->wake, &pq->lock);
+			continue;
+		}
+
+		se = pq->ring[pq->head];
+		pq->busy = 1;
+		pthread_mutex_unlock(&pq->lock);
+
+		rc = deliver(se, pq->conf);
+
+		pthread_mutex_lock(&pq->lock);
+		pq->busy = 0;
+		pthread_cond_broadcast(&pq->idle);
+		if (rc < 0) {
+			pq->errors++;
+			/* Child disappeared? Keep the event so that it can be
+			 * resent once the dispatcher restarted the plugin. */
+			if (errno == EPIPE) {
+				if (pq->state == W_RUNNING)
+					pq->state = W_FAILED;
+				continue;
+			}
+		} else
+			pq->sent++;
+		pq->ring[pq->head] = NULL;
+		pq->head = (pq->head + 1) % pq->depth;
+		pq->len--;
+		shared_event_put(se);
+	}
+	pthread_mutex_unlock(&pq->lock);
+	return NULL;
+}
+
+int plugin_queue_create(plugin_conf_t *conf, unsigned int depth,
+		overflow_action_t action)
+{
+	struct plugin_queue *pq;
+
+	if (depth == 0)
+		depth = 1;
+	pq = calloc(1, sizeof(struct plugin_queue));
+	if (pq == NULL)
+		return -1;
+	pq->ring = calloc(depth, sizeof(shared_event_t *));
+	if (pq->ring == NULL) {
+		free(pq);
+		return -1;
+	}
+	pq->conf = conf;
+	pq->depth = depth;
+	pq->overflow_action = action;
+	pq->state = W_RUNNING;
+	pthread_mutex_init(&pq->lock, NULL);
+	pthread_cond_init(&pq->wake, NULL);
+	pthread_cond_init(&pq->idle, NULL);
+	if (pthread_create(&pq->thread, NULL, writer_thread_main, pq)) {
+		pthread_cond_destroy(&pq->idle);
+		pthread_cond_destroy(&pq->wake);
+		pthread_mutex_destroy(&pq->lock);
+		free(pq->ring);
+		free(pq);
+		return -1;
+	}
+	conf->queue = pq;
+	return 0;
+}
+
+/* Queues only grow, just like the main queue */
+void plugin_queue_reconfigure(plugin_conf_t *conf, unsigned int depth,
+		overflow_action_t action)
+{
+	struct plugin_queue *pq = conf->queue;
+
+	if (pq == NULL)
+		return;
+
+	pthread_mutex_lock(&pq->lock);
+	pq->overflow_action = action;
+	pq->suspended = 0;
+	if (depth > pq->depth) {
+		shared_event_t **tmp = calloc(depth, sizeof(shared_event_t *));
+		if (tmp) {
+			unsigned int i;
+
+			for (i = 0; i < pq->len; i++)
+				tmp[i] = pq->ring[(pq->head + i) % pq->depth];
+			free(pq->ring);
+			pq->ring = tmp;
+			pq->head = 0;
+			pq->depth = depth;
+		}
+	}
+	pthread_mutex_unlock(&pq->lock);
+}
+
+void plugin_queue_destroy(plugin_conf_t *conf)
+{
+	struct plugin_queue *pq = conf->queue;
+
+	if (pq == NULL)
+		return;
+
+	pthread_mutex_lock(&pq->lock);
+	pq->stop = 1;
+	/* Unblock a writer stuck on a plugin that doesn't read */
+	if (pq->busy && conf->type == S_ALWAYS && conf->plug_pipe[1] >= 0)
+		shutdown(conf->plug_pipe[1], SHUT_RDWR);
+	pthread_cond_signal(&pq->wake);
+	pthread_mutex_unlock(&pq->lock);
+	pthread_join(pq->thread, NULL);
+
+	while (pq->len) {
+		shared_event_put(pq->ring[pq->head]);
+		pq->head = (pq->head + 1) % pq->depth;
+		pq->len--;
+	}
+	pthread_cond_destroy(&pq->idle);
+	pthread_cond_destroy(&pq->wake);
+	pthread_mutex_destroy(&pq->lock);
+	free(pq->ring);
+	free(pq);
+	conf->queue = NULL;
+}
+
+static void do_overflow_action(struct plugin_queue *pq,
+		overflow_action_t action)
+{
+	const char *path = pq->conf->path;
+
+	switch (action)
+	{
+		case O_IGNORE:
+			break;
+		case O_SYSLOG:
+			syslog(LOG_ERR,
+				"queue for plugin %s is full - dropping event",
+				path);
+			break;
+		case O_SUSPEND:
+			syslog(LOG_ALERT,
+    "Audispd is suspending event processing for %s due to overflowing its queue.",
+				path);
+			break;
+		case O_SINGLE:
+			syslog(LOG_ALERT,
+    "Audisp is now changing the system to single user mode due to overflowing the queue for %s",
+				path);
+			change_runlevel(SINGLE);
+			break;
+		case O_HALT:
+			syslog(LOG_ALERT,
+    "Audispd is now halting the system due to overflowing the queue for %s",
+				path);
+			change_runlevel(HALT);
+			break;
+		default:
+			syslog(LOG_ALERT, "Unknown overflow action requested");
+			break;
+	}
+}
+
+void plugin_queue_push(plugin_conf_t *conf, shared_event_t *se)
+{
+	struct plugin_queue *pq = conf->queue;
+	overflow_action_t action;
+
+	if (pq == NULL)
+		return;
+
+	pthread_mutex_lock(&pq->lock);
+	if (pq->suspended) {
+		pq->dropped++;
+		pthread_mutex_unlock(&pq->lock);
+		return;
+	}
+	if (pq->len == pq->depth) {
+		pq->dropped++;
+		action = pq->overflow_action;
+		if (action == O_SUSPEND)
+			pq->suspended = 1;
+		pthread_mutex_unlock(&pq->lock);
+		do_overflow_action(pq, action);
+		return;
+	}
+	shared_event_get(se);
+	pq->ring[(pq->head + pq->len) % pq->depth] = se;
+	pq->len++;
+	pq->queued++;
+	if (pq->len > pq->max_len)
+		pq->max_len = pq->len;
+	pthread_cond_signal(&pq->wake);
+	pthread_mutex_unlock(&pq->lock);
+}
+
+/* Returns 1 if the writer found the plugin's pipe closed */
+int plugin_queue_failed(plugin_conf_t *conf)
+{
+	struct plugin_queue *pq = conf->queue;
+	int rc;
+
+	if (pq == NULL)
+		return 0;
+
+	pthread_mutex_lock(&pq->lock);
+	rc = pq->state == W_FAILED;
+	pthread_mutex_unlock(&pq->lock);
+	return rc;
+}
+
+/* Stop writing and wait until the writer no longer uses the plugin's
+ * descriptor so that it can be closed. Queued events are kept. */
+void plugin_queue_pause(plugin_conf_t *conf)
+{
+	struct plugin_queue *pq = conf->queue;
+
+	if (pq == NULL)
+		return;
+
+	pthread_mutex_lock(&pq->lock);
+	pq->state = W_PAUSED;
+	if (pq->busy && conf->type == S_ALWAYS && conf->plug_pipe[1] >= 0)
+		shutdown(conf->plug_pipe[1], SHUT_RDWR);
+	while (pq->busy)
+		pthread_cond_wait(&pq->idle, &pq->lock);
+	pthread_mutex_unlock(&pq->lock);
+}
+
+void plugin_queue_resume(plugin_conf_t *conf)
+{
+	struct plugin_queue *pq = conf->queue;
+
+	if (pq == NULL)
+		return;
+
+	pthread_mutex_lock(&pq->lock);
+	pq->state = W_RUNNING;
+	pthread_cond_signal(&pq->wake);
+	pthread_mutex_unlock(&pq->lock);
+}
+
+void plugin_queue_report(plugin_conf_t *conf)
+{
+	struct plugin_queue *pq = conf->queue;
+
+	if (pq == NULL)
+		return;
+
+	pthread_mutex_lock(&pq->lock);
+	syslog(LOG_INFO,
+	"plugin %s: queued=%llu sent=%llu dropped=%llu errors=%llu "
+	"depth=%u/%u max_depth=%u%s",
+		conf->path, pq->queued, pq->sent, pq->dropped, pq->errors,
+		pq->len, pq->depth, pq->max_len,
+		pq->suspended ? " suspended" : "");
+	pthread_mutex_unlock(&pq->lock);
+}
+
@@ -0,0 +1,63 @@
+/*
+* audispd-fanout.h - per plugin event queues
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUDISPD_FANOUT_HEADER
+#define AUDISPD_FANOUT_HEADER
+
+#include "audispd-config.h"
+#include "audispd-pconfig.h"
+#include "queue.h"
+
+/* An event in both of its forms. It is formatted once by the dispatcher
+ * and then shared by every plugin queue holding it. Released events go
+ * back to a free list together with their string buffer. */
+typedef struct shared_event
+{
+	event_t *e;		/* As received from auditd */
+	char *str;		/* String form, newline terminated */
+	unsigned int len;	/* Length of str */
+	unsigned int size;	/* Allocated size of str */
+	unsigned int refcnt;	/* Updated atomically */
+	struct shared_event *next;	/* Free list link */
+} shared_event_t;
+
+/* Takes ownership of e, the reference count starts at 1 and str has
+ * room for at least size bytes. */
+shared_event_t *shared_event_alloc(event_t *e, unsigned int size);
+void shared_event_get(shared_event_t *se);
+void shared_event_put(shared_event_t *se);
+void shared_event_pool_destroy(void);
+
+int  plugin_queue_create(plugin_conf_t *conf, unsigned int depth,
+		overflow_action_t action);
+void plugin_queue_reconfigure(plugin_conf_t *conf, unsigned int depth,
+		overflow_action_t action);
+void plugin_queue_destroy(plugin_conf_t *conf);
+void plugin_queue_push(plugin_conf_t *conf, shared_event_t *se);
+int  plugin_queue_failed(plugin_conf_t *conf);
+void plugin_queue_pause(plugin_conf_t *conf);
+void plugin_queue_resume(plugin_conf_t *conf);
+void plugin_queue_report(plugin_conf_t *conf);
+
+#endif
+
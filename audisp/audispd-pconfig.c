@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <libgen.h>
 #include "audispd-pconfig.h"
 #include "private.h"
@@ -69,6 +70,10 @@ static int args_parser(struct nv_pair *nv, int line,
 		plugin_conf_t *config);
 static int format_parser(struct nv_pair *nv, int line, 
 		plugin_conf_t *config);
+static int q_depth_parser(struct nv_pair *nv, int line, 
+		plugin_conf_t *config);
+static int overflow_action_parser(struct nv_pair *nv, int line, 
+		plugin_conf_t *config);
 static int sanity_check(plugin_conf_t *config, const char *file);
 
 static const struct kw_pair keywords[] = 
@@ -79,6 +84,8 @@ static const struct kw_pair keywords[] =
   {"type",                     service_type_parser,		0 },
   {"args",                     args_parser,			2 },
   {"format",                   format_parser,			0 },
+  {"q_depth",                  q_depth_parser,			0 },
+  {"overflow_action",          overflow_action_parser,		0 },
   { NULL,                      NULL }
 };
 
@@ -110,6 +117,16 @@ static const struct nv_list formats[] =
   { NULL,  0 }
 };
 
+static const struct nv_list overflow_actions[] =
+{
+  {"ignore",  O_IGNORE },
+  {"syslog",  O_SYSLOG },
+  {"suspend", O_SUSPEND },
+  {"single",  O_SINGLE },
+  {"halt",    O_HALT },
+  { NULL,     0 }
+};
+
 /*
  * Set everything to its default value
 */
@@ -131,6 +148,9 @@ void clear_pconfig(plugin_conf_t *config)
 	config->checked = 0;
 	config->name = NULL;
 	config->restart_cnt = 0;
+	config->q_depth = 0;
+	config->overflow_action = -1;
+	config->queue = NULL;
 }
 
 int load_pconfig(plugin_conf_t *config, char *file)
@@ -463,6 +483,54 @@ static int format_parser(struct nv_pair *nv, int line,
 	return 1;
 }
 
+static int q_depth_parser(struct nv_pair *nv, int line, 
+		plugin_conf_t *config)
+{
+	const char *ptr = nv->value;
+	unsigned long i;
+
+	/* check that all chars are numbers */
+	for (i=0; ptr[i]; i++) {
+		if (!isdigit(ptr[i])) {
+			audit_msg(LOG_ERR,
+				"Value %s should only be numbers - line %d",
+				nv->value, line);
+			return 1;
+		}
+	}
+
+	/* convert to unsigned long */
+	errno = 0;
+	i = strtoul(nv->value, NULL, 10);
+	if (errno) {
+		audit_msg(LOG_ERR,
+			"Error converting string to a number (%s) - line %d",
+			strerror(errno), line);
+		return 1;
+	}
+	if (i > 99999) {
+		audit_msg(LOG_ERR, "q_depth must be 99999 or less");
+		return 1;
+	}
+	config->q_depth = i;
+	return 0;
+}
+
+static int overflow_action_parser(struct nv_pair *nv, int line, 
+		plugin_conf_t *config)
+{
+	int i;
+
+	for (i=0; overflow_actions[i].name != NULL; i++) {
+		if (strcasecmp(nv->value, overflow_actions[i].name) == 0) {
+			config->overflow_action = overflow_actions[i].option;
+			return 0;
+		}
+	}
+	audit_msg(LOG_ERR, "Option %s not found - line %d", nv->value, line);
+	return 1;
+}
+
 /*
  * This function is where we do the integrated check of the audispd config
  * options. At this point, all fields have been read. Returns 0 if no
@@ -26,6 +26,7 @@
 
 #include <sys/types.h>
 #include "libaudit.h"
+#include "audispd-config.h"
 #define MAX_PLUGIN_ARGS 2
 
 typedef enum { A_NO, A_YES } active_t;
@@ -47,6 +48,9 @@ typedef struct plugin_conf
 	int checked;		/* Used for internal housekeeping on HUP */
 	char *name;		/* Used to distinguish plugins for HUP */
 	unsigned restart_cnt;	/* Number of times its crashed */
+	unsigned int q_depth;	/* Plugin queue size, 0 means audispd's */
+	int overflow_action;	/* overflow_action_t, -1 means audispd's */
+	struct plugin_queue *queue; /* Events waiting to be written */
 } plugin_conf_t;
 
 void clear_pconfig(plugin_conf_t *config);
@@ -34,22 +34,29 @@
 #include <sys/poll.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "audispd-config.h"
 #include "audispd-pconfig.h"
 #include "audispd-llist.h"
 #include "audispd-builtins.h"
+#include "audispd-fanout.h"
 #include "queue.h"
 #include "libaudit.h"
+#include "disp-ring.h"
 
 /* Global Data */
 volatile int stop = 0;
 volatile int hup = 0;
+static volatile int dump_stats = 0;
 
 /* Local data */
 static daemon_conf_t daemon_config;
 static conf_llist plugin_conf;
 static int audit_fd;
+static struct disp_ring *ring = NULL;	/* Set when started with --ring */
+static size_t ring_map_size;
 static pthread_t inbound_thread;
 static const char *config_file = "/etc/audisp/audispd.conf";
 static const char *plugin_dir =  "/etc/audisp/plugins.d/";
@@ -60,6 +67,9 @@ static int event_loop(void);
 static int safe_exec(plugin_conf_t *conf);
 static void *inbound_thread_main(void *arg);
 static void process_inbound_event(int fd);
+static int init_ring(void);
+static void process_ring_events(int fd);
+static void report_plugins(void);
 
 /*
  * SIGTERM handler
@@ -101,6 +111,14 @@ static void hup_handler( int sig )
 	hup = 1;
 }
 
+/*
+ * SIGUSR1 handler: log plugin queue statistics
+ */
+static void usr1_handler( int sig )
+{
+	dump_stats = 1;
+}
+
 /*
  * SIGALRM handler - help force exit when terminating daemon
  */
@@ -161,6 +179,26 @@ static void load_plugin_conf(conf_llist *plugin)
 	}
 }
 
+/* Plugin queues only hold references, so they default to something that
+ * can absorb a burst the dispatcher hands out faster than a writer thread
+ * gets scheduled. The plugin's own settings win over audispd's. */
+#define MIN_PLUGIN_Q_DEPTH 1024
+static unsigned int plugin_q_depth(const plugin_conf_t *p)
+{
+	if (p->q_depth)
+		return p->q_depth;
+	if (daemon_config.q_depth > MIN_PLUGIN_Q_DEPTH)
+		return daemon_config.q_depth;
+	return MIN_PLUGIN_Q_DEPTH;
+}
+
+static overflow_action_t plugin_overflow_action(const plugin_conf_t *p)
+{
+	if (p->overflow_action < 0)
+		return daemon_config.overflow_action;
+	return p->overflow_action;
+}
+
 static int start_one_plugin(lnode *conf)
 {
 	if (conf->p->restart_cnt > daemon_config.max_restarts)
@@ -174,6 +212,7 @@ static int start_one_plugin(lnode *conf)
 				"Error running %s (%s) continuing without it",
 				conf->p->path, strerror(errno));
 			conf->p->active = A_NO;
+			plugin_queue_destroy(conf->p);
 			return 0;
 		}
 
@@ -183,9 +222,44 @@ static int start_one_plugin(lnode *conf)
 		/* Avoid leaking descriptor */
 		fcntl(conf->p->plug_pipe[1], F_SETFD, FD_CLOEXEC);
 	}
+
+	/* A restarted plugin keeps its queue */
+	if (conf->p->queue == NULL && plugin_queue_create(conf->p,
+			plugin_q_depth(conf->p),
+			plugin_overflow_action(conf->p))) {
+		syslog(LOG_ERR, "Cannot create queue for %s, skipping it",
+			conf->p->path);
+		conf->p->active = A_NO;
+		return 0;
+	}
 	return 1;
 }
 
+/* Called when the writer thread found the plugin's pipe closed */
+static void restart_plugin(lnode *conf)
+{
+	/* Child disappeared ? */
+	syslog(LOG_ERR, "plugin %s terminated unexpectedly", conf->p->path);
+	plugin_queue_pause(conf->p);
+	conf->p->pid = 0;
+	conf->p->restart_cnt++;
+	close(conf->p->plug_pipe[1]);
+	conf->p->plug_pipe[1] = -1;
+	conf->p->active = A_NO;
+	if (conf->p->restart_cnt > daemon_config.max_restarts) {
+		syslog(LOG_ERR, "plugin %s has exceeded max_restarts",
+			conf->p->path);
+		plugin_queue_destroy(conf->p);
+		return;
+	}
+	if (!stop && start_one_plugin(conf)) {
+		/* The event that failed is still queued and resent */
+		plugin_queue_resume(conf->p);
+		syslog(LOG_NOTICE, "plugin %s was restarted", conf->p->path);
+		conf->p->active = A_YES;
+	}
+}
+
 static int start_plugins(conf_llist *plugin)
 {
 	/* spawn children */
@@ -262,6 +336,12 @@ static int reconfigure(void)
 			}
 		} else {
 			if (opconf->p->active == tpconf->p->active) {
+				opconf->p->q_depth = tpconf->p->q_depth;
+				opconf->p->overflow_action =
+					tpconf->p->overflow_action;
+				plugin_queue_reconfigure(opconf->p,
+					plugin_q_depth(opconf->p),
+					plugin_overflow_action(opconf->p));
 				/* If active and no state change, sighup it */
 				if (opconf->p->type == S_ALWAYS && 
 						opconf->p->active == A_YES) {
@@ -274,10 +354,12 @@ static int reconfigure(void)
 							opconf->p->path);
 						kill(opconf->p->pid, SIGTERM);
 						usleep(50000); // 50 msecs
+						plugin_queue_pause(opconf->p);
 						close(opconf->p->plug_pipe[1]);
 						opconf->p->plug_pipe[1] = -1;
 						opconf->p->pid = 0;
 						start_one_plugin(opconf);
+						plugin_queue_resume(opconf->p);
 						opconf->p->inode =
 							tpconf->p->inode;
 					}
@@ -287,6 +369,7 @@ static int reconfigure(void)
 				/* A change in state */
 				if (tpconf->p->active == A_YES) {
 					/* starting - copy config and exec */
+					plugin_queue_destroy(opconf->p);
 					free_pconfig(opconf->p);
 					free(opconf->p);
 					opconf->p = tpconf->p;
@@ -308,9 +391,12 @@ static int reconfigure(void)
 				tpconf->p->path);
 		if (tpconf->p->type == S_ALWAYS) {
 			kill(tpconf->p->pid, SIGTERM);
+			plugin_queue_destroy(tpconf->p);
 			close(tpconf->p->plug_pipe[1]);
-		} else
+		} else {
 			stop_builtin(tpconf->p);
+			plugin_queue_destroy(tpconf->p);
+		}
 		tpconf->p->plug_pipe[1] = -1;
 		tpconf->p->pid = 0;
 		tpconf->p->checked = 1;
@@ -331,7 +417,7 @@ int main(int argc, char *argv[])
 {
 	lnode *conf;
 	struct sigaction sa;
-	int i;
+	int i, use_ring = 0;
 
 #ifndef DEBUG
 	/* Make sure we are root */
@@ -360,6 +446,8 @@ int main(int argc, char *argv[])
 	sigaction(SIGHUP, &sa, NULL);
 	sa.sa_handler = alarm_handler;
 	sigaction(SIGALRM, &sa, NULL);
+	sa.sa_handler = usr1_handler;
+	sigaction(SIGUSR1, &sa, NULL);
 	sa.sa_handler = child_handler;
 	sigaction(SIGCHLD, &sa, NULL);
 
@@ -373,6 +461,17 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	/* Events come from shared memory, stdin only tells us that
+	 * auditd went away */
+	if (argc == 2 && strcmp(argv[1], "--ring") == 0) {
+		if (init_ring()) {
+			syslog(LOG_ERR,
+				"Failed setting up dispatcher ring, exiting");
+			return 1;
+		}
+		use_ring = 1;
+	}
+
 	/* Make all descriptors point to dev null */
 	i = open("/dev/null", O_RDWR);
 	if (i >= 0) {
@@ -432,6 +531,14 @@ int main(int argc, char *argv[])
 		syslog(LOG_ERR, "Cannot add event, exiting");
 		return 1;
 	}
+	if (use_ring) {
+		if (add_event(DISP_RING_DATA_FD, process_ring_events) < 0) {
+			syslog(LOG_ERR, "Cannot add event, exiting");
+			return 1;
+		}
+		/* Pick up whatever auditd queued before we got here */
+		process_ring_events(DISP_RING_DATA_FD);
+	}
 
 	/* Create inbound thread */
 	pthread_create(&inbound_thread, NULL, inbound_thread_main, NULL); 
@@ -461,6 +568,8 @@ int main(int argc, char *argv[])
 	plist_first(&plugin_conf);
 	conf = plist_get_cur(&plugin_conf);
 	while (conf) {
+		if (conf->p)
+			plugin_queue_destroy(conf->p);
 		free_pconfig(conf->p);
 		conf = plist_next(&plugin_conf);
 	}
@@ -468,6 +577,9 @@ int main(int argc, char *argv[])
 
 	/* Cleanup the queue */
 	destroy_queue();
+	shared_event_pool_destroy();
+	if (ring)
+		munmap(ring, ring_map_size);
 	free_config(&daemon_config);
 	
 	return 0;
@@ -521,34 +633,110 @@ static void signal_plugins(int sig)
 	}
 }
 
-static int write_to_plugin(event_t *e, const char *string, size_t string_len,
-			   lnode *conf)
+static void report_plugins(void)
 {
-	int rc;
+	lnode *conf;
 
-	if (conf->p->format == F_STRING) {
-		do {
-			rc = write(conf->p->plug_pipe[1], string, string_len);
-		} while (rc < 0 && errno == EINTR);
-	} else {
-		struct iovec vec[2];
+	if (ring)
+		syslog(LOG_INFO,
+	"dispatcher ring: used=%u/%u high_water=%llu waits=%llu lost=%llu",
+			(unsigned int)(ring->head - ring->tail), ring->size,
+			(unsigned long long)ring->high_water,
+			(unsigned long long)ring->waits,
+			(unsigned long long)ring->lost);
 
-		vec[0].iov_base = &e->hdr;
-		vec[0].iov_len = sizeof(struct audit_dispatcher_header);
+	plist_first(&plugin_conf);
+	conf = plist_get_cur(&plugin_conf);
+	while (conf) {
+		if (conf->p && conf->p->active == A_YES) {
+			plugin_queue_report(conf->p);
+			if (conf->p->type == S_AF_UNIX)
+				report_af_unix();
+		}
+		conf = plist_next(&plugin_conf);
+	}
+}
 
-		vec[1].iov_base = e->data;
-		vec[1].iov_len = MAX_AUDIT_MESSAGE_LENGTH;
-		do {
-			rc = writev(conf->p->plug_pipe[1], vec, 2);
-		} while (rc < 0 && errno == EINTR);
+/* Type names never change, so each one is only looked up once */
+static struct {
+	const char *name;
+	unsigned int len;
+} type_cache[AUDIT_LAST_USER_MSG2 + 1];
+
+static const char *lookup_type(unsigned int type, unsigned int *len,
+		char *unknown, size_t size)
+{
+	const char *name;
+
+	if (type <= AUDIT_LAST_USER_MSG2 && type_cache[type].name) {
+		*len = type_cache[type].len;
+		return type_cache[type].name;
 	}
-	return rc;
+
+	name = audit_msg_type_to_name(type);
+	if (name == NULL) {
+		*len = snprintf(unknown, size, "UNKNOWN[%u]", type);
+		return unknown;
+	}
+	*len = strlen(name);
+	if (type <= AUDIT_LAST_USER_MSG2) {
+		type_cache[type].name = name;
+		type_cache[type].len = *len;
+	}
+	return name;
+}
+
+/*
+ * Formats "<prefix><type> msg=<data>\n" into a pooled shared event.
+ * Newlines inside the record are turned into spaces while copying so
+ * that every event goes out as a single line.
+ */
+static shared_event_t *format_event(event_t *e, const char *prefix,
+		unsigned int prefix_len)
+{
+	shared_event_t *se;
+	const char *type, *data, *end, *nl;
+	char unknown[32], *ptr;
+	unsigned int type_len, data_len;
+
+	type = lookup_type(e->hdr.type, &type_len, unknown, sizeof(unknown));
+	data_len = strnlen(e->data, e->hdr.size);
+
+	/* prefix, type, " msg=", data, newline and terminator */
+	se = shared_event_alloc(e, prefix_len + type_len + 5 + data_len + 2);
+	if (se == NULL)
+		return NULL;
+
+	ptr = se->str;
+	memcpy(ptr, prefix, prefix_len);
+	ptr += prefix_len;
+	memcpy(ptr, type, type_len);
+	ptr += type_len;
+	memcpy(ptr, " msg=", 5);
+	ptr += 5;
+
+	data = e->data;
+	end = data + data_len;
+	while ((nl = memchr(data, 0x0A, end - data)) != NULL) {
+		memcpy(ptr, data, nl - data);
+		ptr += nl - data;
+		*ptr++ = ' ';
+		data = nl + 1;
+	}
+	memcpy(ptr, data, end - data);
+	ptr += end - data;
+	*ptr++ = 0x0A;
+	*ptr = 0;
+	se->len = ptr - se->str;
+	return se;
 }
 
 /* Returns 0 on stop, and 1 on HUP */
 static int event_loop(void)
 {
 	char *name = NULL, tmp_name[255];
+	const char *prefix;
+	unsigned int prefix_len;
 
 	/* Get the host name representation */
 	switch (daemon_config.node_name_format)
@@ -627,14 +815,29 @@ static int event_loop(void)
 			break;
 	}
 
+	/* Everything in front of the type name is the same for each event */
+	if (name) {
+		char *tmp;
+
+		if (asprintf(&tmp, "node=%s type=", name) < 0)
+			tmp = NULL;
+		free(name);
+		name = tmp;
+	}
+	prefix = name ? name : "type=";
+	prefix_len = strlen(prefix);
+
 	/* Figure out the format for the af_unix socket */
 	while (stop == 0) {
 		event_t *e;
-		const char *type;
-		char *v, *ptr, unknown[32];
-		unsigned int len;
+		shared_event_t *se;
 		lnode *conf;
 
+		if (dump_stats) {
+			dump_stats = 0;
+			report_plugins();
+		}
+
 		/* This is where we block until we have an event */
 		e = dequeue();
 		if (e == NULL) {
@@ -645,86 +848,28 @@ static int event_loop(void)
 			continue;
 		}
 
-		/* Get the event formatted */
-		type = audit_msg_type_to_name(e->hdr.type);
-		if (type == NULL) {
-			snprintf(unknown, sizeof(unknown),
-				"UNKNOWN[%d]", e->hdr.type);
-			type = unknown;
-		}
-
-		if (daemon_config.node_name_format != N_NONE) {
-			len = asprintf(&v, "node=%s type=%s msg=%.*s\n", 
-				name, type, e->hdr.size, e->data);
-		} else
-			len = asprintf(&v, "type=%s msg=%.*s\n", 
-				type, e->hdr.size, e->data);
-		if (len <= 0) {
-			v = NULL;
-			free(e); /* Either corrupted event or no memory */
+		/* Everybody shares the same copy */
+		se = format_event(e, prefix, prefix_len);
+		if (se == NULL) {
+			free(e); /* No memory */
 			continue;
 		}
 
-		/* Strip newlines from event record */
-		ptr = v;
-		while ((ptr = strchr(ptr, 0x0A)) != NULL) {
-			if (ptr != &v[len-1])
-				*ptr = ' ';
-			else
-				break; /* Done - exit loop */
-		}
-
-		/* Distribute event to the plugins */
+		/* Hand the event to the plugin queues */
 		plist_first(&plugin_conf);
 		conf = plist_get_cur(&plugin_conf);
-		do {
-			if (conf == NULL || conf->p == NULL)
-				continue;
-			if (conf->p->active == A_NO || stop)
-				continue;
-
-			/* Now send the event to the right child */
-			if (conf->p->type == S_SYSLOG) 
-				send_syslog(v);
-			else if (conf->p->type == S_AF_UNIX) {
-				if (conf->p->format == F_STRING)
-					send_af_unix_string(v, len);
-				else
-					send_af_unix_binary(e);
-			} else if (conf->p->type == S_ALWAYS && !stop) {
-				int rc;
-				rc = write_to_plugin(e, v, len, conf);
-				if (rc < 0 && errno == EPIPE) {
-					/* Child disappeared ? */
-					syslog(LOG_ERR,
-					"plugin %s terminated unexpectedly", 
-								conf->p->path);
-					conf->p->pid = 0;
-					conf->p->restart_cnt++;
-					if (conf->p->restart_cnt >
-						daemon_config.max_restarts) {
-						syslog(LOG_ERR,
-					"plugin %s has exceeded max_restarts",
-								conf->p->path);
-					}
-					close(conf->p->plug_pipe[1]);
-					conf->p->plug_pipe[1] = -1;
-					conf->p->active = A_NO;
-					if (!stop && start_one_plugin(conf)) {
-						rc = write_to_plugin(e, v, len,
-								     conf);
-						syslog(LOG_NOTICE,
-						"plugin %s was restarted",
-							conf->p->path);
-						conf->p->active = A_YES;
-					} 
-				}
+		while (conf && !stop) {
+			if (conf->p && conf->p->active == A_YES) {
+				if (plugin_queue_failed(conf->p))
+					restart_plugin(conf);
+				if (conf->p->active == A_YES)
+					plugin_queue_push(conf->p, se);
 			}
-		} while (!stop && (conf = plist_next(&plugin_conf)));
+			conf = plist_next(&plugin_conf);
+		}
 
-		/* Done with the memory...release it */
-		free(v);
-		free(e);
+		/* Done with our reference...release it */
+		shared_event_put(se);
 		if (hup)
 			break;
 	}
@@ -777,7 +922,7 @@ static void *inbound_thread_main(void *arg)
 {
 	while (stop == 0) {
 		int rc;
-		if (hup)
+		if (hup || dump_stats)
 			nudge_queue();
 		do {
 			rc = poll(pfd, pfd_cnt, 20000); /* 20 sec */
@@ -805,14 +950,12 @@ static void process_inbound_event(int fd)
 {
 	int rc;
 	struct iovec vec;
-	event_t *e = malloc(sizeof(event_t));
-	if (e == NULL) 
-		return;
-	memset(e, 0, sizeof(event_t));
+	struct audit_dispatcher_header hdr;
+	event_t *e;
 
 	/* Get header first. It is fixed size */
-	vec.iov_base = &e->hdr;
-	vec.iov_len = sizeof(struct audit_dispatcher_header);
+	vec.iov_base = &hdr;
+	vec.iov_len = sizeof(hdr);
 	do {
 		rc = readv(fd, &vec, 1);
 	} while (rc < 0 && errno == EINTR);
@@ -820,35 +963,139 @@ static void process_inbound_event(int fd)
 	if (rc <= 0) {
 		if (rc == 0)
 			stop = 1; // End of File
-		free(e);
 		return;
 	}
 
-	if (rc > 0) {
-		/* Sanity check */
-		if (e->hdr.ver != AUDISP_PROTOCOL_VER ||
-				e->hdr.hlen != sizeof(e->hdr) ||
-				e->hdr.size > MAX_AUDIT_MESSAGE_LENGTH) {
-			free(e);
-			syslog(LOG_ERR,
-				"Dispatcher protocol mismatch, exiting");
-			exit(1);
-		}
+	/* Sanity check */
+	if (rc != sizeof(hdr) || hdr.ver != AUDISP_PROTOCOL_VER ||
+			hdr.hlen != sizeof(hdr) ||
+			hdr.size > MAX_AUDIT_MESSAGE_LENGTH) {
+		syslog(LOG_ERR, "Dispatcher protocol mismatch, exiting");
+		exit(1);
+	}
 
-		/* Next payload */
-		vec.iov_base = e->data;
-		vec.iov_len = e->hdr.size;
-		do {
-			rc = readv(fd, &vec, 1);
-		} while (rc < 0 && errno == EINTR);
-
-		if (rc > 0)
-			enqueue(e, &daemon_config);
-		else {
-			if (rc == 0)
-				stop = 1; // End of File
-			free(e);
-		}
+	/* Only hdr.size bytes of data are ever looked at */
+	e = malloc(EVENT_SIZE(hdr.size));
+	if (e == NULL)
+		return;
+	e->hdr = hdr;
+
+	/* Next payload */
+	vec.iov_base = e->data;
+	vec.iov_len = hdr.size;
+	do {
+		rc = readv(fd, &vec, 1);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc > 0)
+		enqueue(e, &daemon_config);
+	else {
+		if (rc == 0)
+			stop = 1; // End of File
+		free(e);
 	}
 }
 
+/* Maps the ring auditd passed in. Returns 0 on success. */
+static int init_ring(void)
+{
+	struct stat st;
+	struct disp_ring *r;
+
+	if (fstat(DISP_RING_FD, &st) ||
+			st.st_size < (off_t)sizeof(struct disp_ring))
+		return -1;
+	r = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED,
+			DISP_RING_FD, 0);
+	if (r == MAP_FAILED)
+		return -1;
+	if (r->magic != DISP_RING_MAGIC || r->version != DISP_RING_VERSION ||
+			r->size == 0 || (r->size & (r->size - 1)) ||
+			disp_ring_map_size(r->size) != (size_t)st.st_size ||
+			r->data_offset != st.st_size - r->size) {
+		munmap(r, st.st_size);
+		return -1;
+	}
+	close(DISP_RING_FD);
+
+	/* Plugins don't need these */
+	if (fcntl(DISP_RING_DATA_FD, F_SETFD, FD_CLOEXEC) < 0 ||
+		fcntl(DISP_RING_SPACE_FD, F_SETFD, FD_CLOEXEC) < 0) {
+		munmap(r, st.st_size);
+		return -1;
+	}
+	ring = r;
+	ring_map_size = st.st_size;
+	return 0;
+}
+
+/* Takes everything auditd put in the ring since we last looked */
+static void process_ring_events(int fd)
+{
+	char *data = disp_ring_data(ring);
+	uint32_t size = ring->size;
+	uint64_t cnt, head, tail = ring->tail;
+	int rc;
+
+	/* Clear the wakeup, it's non-blocking */
+	rc = read(fd, &cnt, sizeof(cnt));
+
+	do {
+		ring->consumer_sleeping = 0;
+		head = ring->head;
+		/* Don't look at records before seeing the head */
+		__sync_synchronize();
+		while (tail != head) {
+			uint32_t pos = tail & (size - 1), contig = size - pos;
+			struct audit_dispatcher_header hdr;
+			event_t *e;
+
+			/* Producer skipped to the start */
+			if (contig < sizeof(hdr)) {
+				tail += contig;
+				continue;
+			}
+			memcpy(&hdr, data + pos, sizeof(hdr));
+			if (hdr.type == DISP_RING_PAD) {
+				tail += contig;
+				continue;
+			}
+			if (hdr.ver != AUDISP_PROTOCOL_VER ||
+				hdr.hlen != sizeof(hdr) ||
+				hdr.size > MAX_AUDIT_MESSAGE_LENGTH ||
+				DISP_RING_REC_LEN(hdr.size) > contig) {
+				syslog(LOG_ERR,
+					"Dispatcher ring is corrupted, exiting");
+				exit(1);
+			}
+
+			e = malloc(EVENT_SIZE(hdr.size));
+			if (e) {
+				memcpy(&e->hdr, data + pos, sizeof(hdr));
+				memcpy(e->data, data + pos + sizeof(hdr),
+					hdr.size);
+				enqueue(e, &daemon_config);
+			}
+			tail += DISP_RING_REC_LEN(hdr.size);
+
+			/* Hand the space back as we go */
+			__sync_synchronize();
+			ring->tail = tail;
+			__sync_synchronize();
+			if (ring->producer_waiting &&
+				__sync_bool_compare_and_swap(
+					&ring->producer_waiting, 1, 0)) {
+				cnt = 1;
+				rc = write(DISP_RING_SPACE_FD, &cnt,
+					sizeof(cnt));
+			}
+		}
+
+		/* Ask auditd to wake us up, then make sure we didn't
+		 * miss anything in the meantime */
+		ring->consumer_sleeping = 1;
+		__sync_synchronize();
+	} while (ring->head != tail && stop == 0);
+	(void)rc;
+}
+
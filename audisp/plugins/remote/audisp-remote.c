@@ -57,8 +57,9 @@
 #define CONFIG_FILE "/etc/audisp/audisp-remote.conf"
 #define BUF_SIZE 32
 
-/* MAX_AUDIT_MESSAGE_LENGTH, aligned to 4 KB so that an average q_append() only
-   writes to two disk disk blocks (1 aligned data block, 1 header block). */
+/* Must be at least MAX_AUDIT_MESSAGE_LENGTH.  It is only a limit, queue
+   records use as much disk space as the event needs.  Changing it makes
+   existing queue files unusable. */
 #define QUEUE_ENTRY_SIZE (3*4096)
 
 /* Error types */
@@ -32,21 +32,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include "queue.h"
 
 struct queue
 {
 	int flags;		/* Q_* */
-	int fd;			/* -1 if !Q_IN_FILE */
+	int fd;			/* Checkpoint file, -1 if !Q_IN_FILE */
+	char *path;		/* Base name of the segment files */
+	int head_fd;		/* Segment holding the head entry */
+	int tail_fd;		/* Segment receiving new entries */
+	uint32_t generation;	/* Seeds the record checksums, see below */
+	uint32_t head_segment;
+	uint32_t head_offset;
+	uint32_t head_segment_end; /* Only valid if head_segment != tail_segment */
+	uint32_t tail_segment;
+	uint32_t tail_offset;
+	unsigned dirty;		/* Operations since the last checkpoint */
 	/* NULL if !Q_IN_MEMORY.  [i] contains a memory copy of the queue entry
 	   "i", if known - it may be NULL even if entry exists. */
 	unsigned char **memory;
+	size_t memory_slots;	/* Size of the memory ring */
 	size_t num_entries;
 	size_t entry_size;
-	size_t queue_head;
+	size_t queue_head;	/* Index of the head entry in memory */
 	size_t queue_length;
-	unsigned char buffer[];	/* Used only locally within q_peek() */
+	/* Used only locally within q_peek() and q_append(), holds a record
+	   header followed by up to entry_size bytes. */
+	unsigned char buffer[];
 };
 
 /* Infrastructure */
@@ -107,12 +121,52 @@ static int full_pwrite(int fd, const void *buf, size_t size, off_t offset)
 	return 0;
 }
 
+/* Standard CRC-32 (IEEE 802.3) */
+static uint32_t crc_table[256];
+
+static void crc_init(void)
+{
+	uint32_t i, j, c;
+
+	if (crc_table[1] != 0)
+		return;
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t crc_update(uint32_t crc, const void *buf, size_t size)
+{
+	const unsigned char *p = buf;
+
+	crc = ~crc;
+	while (size--)
+		crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
 /* File format and utilities */
 
+/* A segment is closed once it grows past this size, the next entry goes into
+   a new segment file.  Segments are deleted once the head moves past them. */
+#define SEGMENT_SIZE (4 * 1024 * 1024)
+
+/* The header is rewritten after this many operations.  Entries appended
+   after the last header write are found again by scanning the tail
+   segment, entries dropped after it will be sent again. */
+#define CHECKPOINT_INTERVAL 64
+
 /* The mutable part of struct file_header */
 struct fh_state {
-	uint32_t queue_head;	/* 0-based index of the first non-empty entry */
-	uint32_t queue_length;	/* [0, num_entries] */
+	uint32_t head_segment;	/* Segment number of the first entry */
+	uint32_t head_offset;	/* Offset of the first entry in head_segment */
+	uint32_t tail_segment;	/* Segment number receiving new entries */
+	uint32_t tail_offset;	/* End of the last entry in tail_segment */
+	uint32_t queue_length;	/* Entries between head and tail */
+	uint32_t checksum;	/* crc32 of the header up to this field */
 };
 
 /* All integer values are in network byte order (big endian) */
@@ -121,58 +175,359 @@ struct file_header
 	uint8_t magic[14];	/* See fh_magic below */
 	uint8_t version;	/* File format version, see FH_VERSION* below */
 	uint8_t reserved;	/* Must be 0 */
-	/* Total file size is (num_entries + 1) * entry_size.  This must fit
-	   into SIZE_MAX because the "len" parameter of posix_fallocate has
-	   a size_t type. */
-	uint32_t num_entries;	/* Total number of entries allocated */
+	uint32_t num_entries;	/* Maximum number of entries */
 	uint32_t entry_size;
+	uint32_t generation;	/* Chosen when the file is created */
 	struct fh_state s;
 };
 
+/* The header of the obsolete slot based format.  It was followed by
+   num_entries slots of entry_size bytes each, the first one starting at
+   offset entry_size. */
+struct file_header_v0
+{
+	uint8_t magic[14];
+	uint8_t version;
+	uint8_t reserved;
+	uint32_t num_entries;
+	uint32_t entry_size;
+	uint32_t queue_head;
+	uint32_t queue_length;
+};
+
+/* Every entry is stored in a segment file as a record header followed by
+   the string without its trailing NUL.  Records are packed back to back.
+   The checksum covers the length field and the data and is seeded with the
+   generation number of the queue, so that stale segment files left behind
+   by an unrelated queue are not mistaken for valid data. */
+struct record_header
+{
+	uint32_t length;
+	uint32_t checksum;
+};
+
 /* Contains a '\0' byte to unambiguously mark the file as a binary file. */
 static const uint8_t fh_magic[14] = "\0audisp-remote";
 #define FH_VERSION_0 0x00
+#define FH_VERSION_1 0x01
 
-/* Return file position for ENTRY in Q */
-static size_t entry_offset (const struct queue *q, size_t entry)
+/* Return the number of bytes used on disk by an entry of LENGTH bytes,
+   excluding the trailing NUL. */
+static size_t record_size(size_t length)
 {
-	return (entry + 1) * q->entry_size;
+	return sizeof(struct record_header) + length;
+}
+
+static uint32_t record_checksum(const struct queue *q,
+				const struct record_header *rh,
+				const void *data, size_t length)
+{
+	uint32_t crc;
+
+	crc = crc_update(q->generation, &rh->length, sizeof(rh->length));
+	return crc_update(crc, data, length);
 }
 
-/* Synchronize Q if required and return 0.
+/* Open segment SEGMENT of Q using OPEN_FLAGS and return its descriptor.
    On error, return -1 and set errno. */
-static int q_sync(struct queue *q)
+static int open_segment(const struct queue *q, uint32_t segment,
+			int open_flags)
 {
-	if ((q->flags & Q_SYNC) == 0)
+	size_t len = strlen(q->path) + 10;
+	char name[len];
+	int fd, fd_flags;
+
+	snprintf(name, len, "%s.%08x", q->path, (unsigned)segment);
+	fd = open(name, open_flags, S_IRUSR | S_IWUSR);
+	if (fd == -1)
+		return -1;
+	fd_flags = fcntl(fd, F_GETFD);
+	if (fd_flags < 0 || fcntl(fd, F_SETFD, fd_flags | FD_CLOEXEC) == -1) {
+		int saved_errno = errno;
+
+		close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return fd;
+}
+
+static int unlink_segment(const struct queue *q, uint32_t segment)
+{
+	size_t len = strlen(q->path) + 10;
+	char name[len];
+
+	snprintf(name, len, "%s.%08x", q->path, (unsigned)segment);
+	if (unlink(name) != 0 && errno != ENOENT)
+		return -1;
+	return 0;
+}
+
+/* Read the record at OFFSET in FD into Q->buffer, verify it and store the
+   length of its data into *LENGTH.  Return 1 if a valid record was read,
+   0 if there is no valid record at OFFSET.  On error, return -1 and set
+   errno. */
+static int read_record(struct queue *q, int fd, off_t offset, size_t *length)
+{
+	struct record_header rh;
+	size_t got = 0, len;
+
+	while (got < sizeof(rh)) {
+		ssize_t res;
+
+		res = pread(fd, (unsigned char *)&rh + got, sizeof(rh) - got,
+			    offset + got);
+		if (res < 0)
+			return -1;
+		if (res == 0)
+			return 0;
+		got += res;
+	}
+	len = ntohl(rh.length);
+	if (len >= q->entry_size)
+		return 0;
+	if (full_pread(fd, q->buffer, len, offset + sizeof(rh)) != 0)
+		return errno == ENXIO ? 0 : -1;
+	if (ntohl(rh.checksum) != record_checksum(q, &rh, q->buffer, len))
 		return 0;
-	return fdatasync(q->fd);
+	*length = len;
+	return 1;
 }
 
-/* Sync file's fh_state with Q, q_sync (Q), and return 0.
+/* Synchronize FD of Q if required and return 0.
    On error, return -1 and set errno. */
-static int sync_fh_state (struct queue *q)
+static int q_sync(struct queue *q, int fd)
 {
-	struct fh_state s;
+	if ((q->flags & Q_SYNC) == 0)
+		return 0;
+	return fdatasync(fd);
+}
+
+/* Write the head and tail position of Q to the file header, q_sync() it, and
+   return 0.  On error, return -1 and set errno. */
+static int write_checkpoint(struct queue *q)
+{
+	struct file_header fh;
 
 	if (q->fd == -1)
 		return 0;
 
-	s.queue_head = htonl(q->queue_head);
-	s.queue_length = htonl(q->queue_length);
-	if (full_pwrite(q->fd, &s, sizeof(s), offsetof(struct file_header, s))
-	    != 0)
+	verify(sizeof(fh.magic) == sizeof(fh_magic));
+	memcpy(fh.magic, fh_magic, sizeof(fh.magic));
+	fh.version = FH_VERSION_1;
+	fh.reserved = 0;
+	fh.num_entries = htonl(q->num_entries);
+	fh.entry_size = htonl(q->entry_size);
+	fh.generation = htonl(q->generation);
+	fh.s.head_segment = htonl(q->head_segment);
+	fh.s.head_offset = htonl(q->head_offset);
+	fh.s.tail_segment = htonl(q->tail_segment);
+	fh.s.tail_offset = htonl(q->tail_offset);
+	fh.s.queue_length = htonl(q->queue_length);
+	fh.s.checksum = htonl(crc_update(0, &fh,
+					 offsetof(struct file_header,
+						  s.checksum)));
+	if (full_pwrite(q->fd, &fh, sizeof(fh), 0) != 0)
 		return -1;
-	return q_sync(q);
+	q->dirty = 0;
+	return q_sync(q, q->fd);
+}
+
+/* Note that an operation has been done on Q and write the file header if
+   enough operations have accumulated.  Return 0 on success, on error return
+   -1 and set errno. */
+static int checkpoint_maybe(struct queue *q)
+{
+	if (q->fd == -1)
+		return 0;
+	if (++q->dirty < CHECKPOINT_INTERVAL)
+		return 0;
+	return write_checkpoint(q);
+}
+
+/* Start a new tail segment in Q and return 0.
+   On error, return -1 and set errno. */
+static int roll_tail_segment(struct queue *q)
+{
+	int fd;
+
+	fd = open_segment(q, q->tail_segment + 1, O_RDWR | O_CREAT | O_TRUNC);
+	if (fd == -1)
+		return -1;
+	if (q->head_segment == q->tail_segment)
+		q->head_segment_end = q->tail_offset;
+	close(q->tail_fd);
+	q->tail_fd = fd;
+	q->tail_segment++;
+	q->tail_offset = 0;
+	return write_checkpoint(q);
+}
+
+/* Move the head of Q past any fully consumed segments, deleting them, and
+   return 0.  On error, return -1 and set errno. */
+static int advance_head_segment(struct queue *q)
+{
+	while (q->head_segment != q->tail_segment
+	       && q->head_offset >= q->head_segment_end) {
+		uint32_t old = q->head_segment;
+		struct stat st;
+		int fd;
+
+		fd = open_segment(q, old + 1, O_RDONLY);
+		if (fd == -1)
+			return -1;
+		if (fstat(fd, &st) != 0) {
+			int saved_errno = errno;
+
+			close(fd);
+			errno = saved_errno;
+			return -1;
+		}
+		close(q->head_fd);
+		q->head_fd = fd;
+		q->head_segment = old + 1;
+		q->head_offset = 0;
+		q->head_segment_end = st.st_size;
+		/* The header must not refer to a segment once it is gone */
+		if (write_checkpoint(q) != 0)
+			return -1;
+		if (unlink_segment(q, old) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* Internal use only: add DATA of LENGTH bytes (excluding the trailing NUL)
+   to the segment files of Q, without writing the file header. */
+static int append_record(struct queue *q, const char *data, size_t length)
+{
+	struct record_header *rh = (struct record_header *)q->buffer;
+	size_t size = record_size(length);
+
+	if (q->tail_offset != 0 && q->tail_offset + size > SEGMENT_SIZE
+	    && roll_tail_segment(q) != 0)
+		return -1;
+
+	rh->length = htonl(length);
+	memcpy(q->buffer + sizeof(*rh), data, length);
+	rh->checksum = htonl(record_checksum(q, rh, data, length));
+	if (full_pwrite(q->tail_fd, q->buffer, size, q->tail_offset) != 0)
+		return -1;
+	if (q_sync(q, q->tail_fd) != 0)
+		return -1;
+	q->tail_offset += size;
+	return 0;
 }
 
 /* Queue implementation */
 
+/* Convert the slot based queue described by FH in Q->fd to the current
+   format, appending its entries to the segment files, and return 0.
+   On error, return -1 and set errno. */
+static int import_v0(struct queue *q, const struct file_header_v0 *fh,
+		     off_t file_size)
+{
+	uint32_t file_entries, head, length, i;
+	int fd;
+
+	file_entries = ntohl(fh->num_entries);
+	head = ntohl(fh->queue_head);
+	length = ntohl(fh->queue_length);
+	if (fh->entry_size != htonl(q->entry_size)
+	    || file_entries > SIZE_MAX / q->entry_size - 1
+	    || ((uintmax_t)file_size != (file_entries + 1) * q->entry_size)
+	    || head >= file_entries || length > file_entries) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* Keep the old header intact until all entries are copied, a crash
+	   in between restarts the conversion from scratch.  A crash after
+	   the new header is written but before the file is cut down leaves
+	   the old slots behind it, open_file() removes them. */
+	fd = q->fd;
+	q->fd = -1;
+	for (i = 0; i < length; i++) {
+		off_t offset = ((head + i) % file_entries + 1) * q->entry_size;
+		unsigned char *end;
+		size_t len;
+
+		/* Read into the data part of the buffer so that
+		   append_record() can fill in the header in place. */
+		if (full_pread(fd, q->buffer + sizeof(struct record_header),
+			       q->entry_size, offset) != 0)
+			goto err;
+		end = memchr(q->buffer + sizeof(struct record_header), '\0',
+			     q->entry_size);
+		if (end == NULL) {
+			errno = EBADMSG;
+			goto err;
+		}
+		len = end - (q->buffer + sizeof(struct record_header));
+		if (append_record(q, (char *)q->buffer +
+				  sizeof(struct record_header), len) != 0)
+			goto err;
+	}
+	q->fd = fd;
+	q->num_entries = file_entries;
+	q->queue_length = length;
+	if (write_checkpoint(q) != 0)
+		return -1;
+	if (ftruncate(q->fd, sizeof(struct file_header)) != 0)
+		return -1;
+	return q_sync(q, q->fd);
+
+err:
+	q->fd = fd;
+	return -1;
+}
+
+/* Find entries that were appended to Q after the last checkpoint, discard
+   any partially written record at the end, and return 0.
+   On error, return -1 and set errno. */
+static int recover_tail(struct queue *q)
+{
+	size_t found = 0;
+
+	for (;;) {
+		size_t len;
+		int r, fd;
+
+		r = read_record(q, q->tail_fd, q->tail_offset, &len);
+		if (r < 0)
+			return -1;
+		if (r > 0) {
+			q->tail_offset += record_size(len);
+			found++;
+			continue;
+		}
+		if (ftruncate(q->tail_fd, q->tail_offset) != 0)
+			return -1;
+		fd = open_segment(q, q->tail_segment + 1, O_RDWR);
+		if (fd == -1) {
+			if (errno != ENOENT)
+				return -1;
+			break;
+		}
+		if (q->head_segment == q->tail_segment)
+			q->head_segment_end = q->tail_offset;
+		close(q->tail_fd);
+		q->tail_fd = fd;
+		q->tail_segment++;
+		q->tail_offset = 0;
+	}
+	q->queue_length += found;
+	if (found != 0)
+		return write_checkpoint(q);
+	return 0;
+}
+
 /* Open PATH for Q, update Q from it, and return 0.
    On error, return -1 and set errno; Q->fd may be set even on error. */
 static int q_open_file(struct queue *q, const char *path)
 {
 	int open_flags, fd_flags;
 	struct stat st;
+	struct file_header_v0 fh0;
 	struct file_header fh;
 
 	open_flags = O_RDWR;
@@ -200,52 +555,87 @@ static int q_open_file(struct queue *q, const char *path)
 		return -1;
 	}
 
+	q->path = strdup(path);
+	if (q->path == NULL)
+		return -1;
+
 	if (fstat(q->fd, &st) != 0)
 		return -1;
-	if (st.st_size == 0) {
-		verify(sizeof(fh.magic) == sizeof(fh_magic));
-		memcpy(fh.magic, fh_magic, sizeof(fh.magic));
-		fh.version = FH_VERSION_0;
-		fh.reserved = 0;
-		fh.num_entries = htonl(q->num_entries);
-		fh.entry_size = htonl(q->entry_size);
-		fh.s.queue_head = htonl(0);
-		fh.s.queue_length = htonl(0);
-		if (full_pwrite(q->fd, &fh, sizeof(fh), 0) != 0)
-			return -1;
-		if (q_sync(q) != 0)
-			return -1;
-		if (posix_fallocate(q->fd, 0,
-				    (q->num_entries + 1) * q->entry_size) != 0)
-			return -1;
-	} else {
-		uint32_t file_entries;
-		if (full_pread(q->fd, &fh, sizeof(fh), 0) != 0)
+	if (st.st_size != 0) {
+		/* Both versions start the same way */
+		if (full_pread(q->fd, &fh0, sizeof(fh0), 0) != 0)
 			return -1;
-		if (memcmp(fh.magic, fh_magic, sizeof(fh.magic)) != 0
-		    || fh.version != FH_VERSION_0 || fh.reserved != 0
-		    || fh.entry_size != htonl(q->entry_size)) {
+		if (memcmp(fh0.magic, fh_magic, sizeof(fh0.magic)) != 0
+		    || fh0.reserved != 0
+		    || fh0.entry_size != htonl(q->entry_size)
+		    || (fh0.version != FH_VERSION_0
+			&& fh0.version != FH_VERSION_1)) {
 			errno = EINVAL;
 			return -1;
 		}
-		file_entries = ntohl(fh.num_entries);
-		if (file_entries > SIZE_MAX / q->entry_size - 1
-		    || ((uintmax_t)st.st_size
-			!= (file_entries + 1) * q->entry_size)) {
-			errno = EINVAL;
+	}
+
+	if (st.st_size == 0 || fh0.version == FH_VERSION_0) {
+		/* Start a new generation, so that leftover segment files
+		   can't be confused with ours. */
+		q->generation = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16)
+			^ (uint32_t)st.st_ino;
+		q->tail_fd = open_segment(q, 0, O_RDWR | O_CREAT | O_TRUNC);
+		if (q->tail_fd == -1)
+			return -1;
+		q->head_fd = open_segment(q, 0, O_RDONLY);
+		if (q->head_fd == -1)
+			return -1;
+		if (st.st_size == 0)
+			return write_checkpoint(q);
+		return import_v0(q, &fh0, st.st_size);
+	}
+
+	if (st.st_size < (off_t)sizeof(fh)
+	    || full_pread(q->fd, &fh, sizeof(fh), 0) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (ntohl(fh.s.checksum) != crc_update(0, &fh,
+				offsetof(struct file_header, s.checksum))) {
+		errno = EBADMSG;
+		return -1;
+	}
+	/* The slots of a converted v0 file that were not cut off yet */
+	if (st.st_size != sizeof(fh)) {
+		if (ftruncate(q->fd, sizeof(fh)) != 0
+		    || q_sync(q, q->fd) != 0)
 			return -1;
-		}
 	}
 	/* Note that this may change q->num_entries! */
 	q->num_entries = ntohl(fh.num_entries);
-	q->queue_head = ntohl(fh.s.queue_head);
+	q->generation = ntohl(fh.generation);
+	q->head_segment = ntohl(fh.s.head_segment);
+	q->head_offset = ntohl(fh.s.head_offset);
+	q->tail_segment = ntohl(fh.s.tail_segment);
+	q->tail_offset = ntohl(fh.s.tail_offset);
 	q->queue_length = ntohl(fh.s.queue_length);
-	if (q->queue_head >= q->num_entries
-	    || q->queue_length > q->num_entries) {
+	if (q->num_entries == 0 || q->head_segment > q->tail_segment
+	    || (q->head_segment == q->tail_segment
+		&& q->head_offset > q->tail_offset)) {
 		errno = EINVAL;
 		return -1;
 	}
-	return 0;
+
+	q->tail_fd = open_segment(q, q->tail_segment, O_RDWR | O_CREAT);
+	if (q->tail_fd == -1)
+		return -1;
+	q->head_fd = open_segment(q, q->head_segment, O_RDONLY);
+	if (q->head_fd == -1)
+		return -1;
+	if (q->head_segment != q->tail_segment) {
+		if (fstat(q->head_fd, &st) != 0)
+			return -1;
+		q->head_segment_end = st.st_size;
+	}
+	if (recover_tail(q) != 0)
+		return -1;
+	return advance_head_segment(q);
 }
 
 /* Like q_open(), but does not handle Q_RESIZE, and NUM_ENTRIES is only used
@@ -262,48 +652,66 @@ static struct queue *q_open_no_resize(int q_flags, const char *path,
 	}
 	if (num_entries == 0 || num_entries > UINT32_MAX
 	    || entry_size < 1 /* for trailing NUL */
-	    || entry_size < sizeof(struct file_header) /* for Q_IN_FILE */
 	    /* to allocate "struct queue" including its buffer*/
-	    || entry_size > UINT32_MAX - sizeof(struct queue)) {
-		errno = EINVAL;
-		return NULL;
-	}
-	if (entry_size > SIZE_MAX
-	    || num_entries > SIZE_MAX / entry_size - 1 /* for Q_IN_FILE */
-	    || num_entries > SIZE_MAX / sizeof(*q->memory)) {
+	    || entry_size > UINT32_MAX - sizeof(struct queue)
+				- sizeof(struct record_header)
+	    /* a record must fit into a segment */
+	    || record_size(entry_size) > SEGMENT_SIZE) {
 		errno = EINVAL;
 		return NULL;
 	}
 
-	q = malloc(sizeof(*q) + entry_size);
+	q = malloc(sizeof(*q) + sizeof(struct record_header) + entry_size);
 	if (q == NULL)
 		return NULL;
 	q->flags = q_flags;
 	q->fd = -1;
+	q->path = NULL;
+	q->head_fd = -1;
+	q->tail_fd = -1;
+	q->generation = 0;
+	q->head_segment = 0;
+	q->head_offset = 0;
+	q->head_segment_end = 0;
+	q->tail_segment = 0;
+	q->tail_offset = 0;
+	q->dirty = 0;
 	q->memory = NULL;
+	q->memory_slots = 0;
 	q->num_entries = num_entries;
 	q->entry_size = entry_size;
 	q->queue_head = 0;
 	q->queue_length = 0;
 
-	if ((q_flags & Q_IN_MEMORY) != 0) {
-		size_t sz = num_entries * sizeof(*q->memory);
+	crc_init();
+	if ((q_flags & Q_IN_FILE) != 0 && q_open_file(q, path) != 0)
+		goto err;
 
-		q->memory = malloc(sz);
+	if ((q_flags & Q_IN_MEMORY) != 0) {
+		/* Entries recovered from the file may exceed num_entries */
+		q->memory_slots = q->num_entries;
+		if (q->queue_length > q->memory_slots)
+			q->memory_slots = q->queue_length;
+		if (q->memory_slots > SIZE_MAX / sizeof(*q->memory)) {
+			errno = EINVAL;
+			goto err;
+		}
+		q->memory = calloc(q->memory_slots, sizeof(*q->memory));
 		if (q->memory == NULL)
 			goto err;
-		memset(q->memory, 0, sz);
 	}
 
-	if ((q_flags & Q_IN_FILE) != 0 && q_open_file(q, path) != 0)
-		goto err;
-
 	return q;
 
 err:
 	saved_errno = errno;
+	if (q->head_fd != -1)
+		close(q->head_fd);
+	if (q->tail_fd != -1)
+		close(q->tail_fd);
 	if (q->fd != -1)
 		close(q->fd);
+	free(q->path);
 	free(q->memory);
 	free(q);
 	errno = saved_errno;
@@ -312,25 +720,32 @@ err:
 
 void q_close(struct queue *q)
 {
-	if (q->fd != -1)
+	if (q->fd != -1) {
+		if (q->dirty != 0)
+			write_checkpoint(q); /* Errors are harmless here */
 		close(q->fd); /* Also releases the file lock */
+	}
+	if (q->head_fd != -1)
+		close(q->head_fd);
+	if (q->tail_fd != -1)
+		close(q->tail_fd);
+	free(q->path);
 	if (q->memory != NULL) {
 		size_t i;
 
-		for (i = 0; i < q->num_entries; i++)
+		for (i = 0; i < q->memory_slots; i++)
 			free(q->memory[i]);
 		free(q->memory);
 	}
 	free(q);
 }
 
-/* Internal use only: add DATA to Q, but don't update fh_state. */
-static int q_append_no_sync_fh_state(struct queue *q, const char *data)
+int q_append(struct queue *q, const char *data)
 {
-	size_t data_size, entry_index;
+	size_t data_size, entry_index = 0;
 	unsigned char *copy;
 
-	if (q->queue_length == q->num_entries) {
+	if (q->queue_length >= q->num_entries) {
 		errno = ENOSPC;
 		return -1;
 	}
@@ -341,8 +756,9 @@ static int q_append_no_sync_fh_state(struct queue *q, const char *data)
 		return -1;
 	}
 
-	entry_index = (q->queue_head + q->queue_length) % q->num_entries;
 	if (q->memory != NULL) {
+		entry_index = (q->queue_head + q->queue_length)
+			% q->memory_slots;
 		if (q->memory[entry_index] != NULL) {
 			errno = EIO; /* This is _really_ unexpected. */
 			return -1;
@@ -354,19 +770,13 @@ static int q_append_no_sync_fh_state(struct queue *q, const char *data)
 	} else
 		copy = NULL;
 
-	if (q->fd != -1) {
-		size_t offset;
-
-		offset = entry_offset(q, entry_index);
-		if (full_pwrite(q->fd, data, data_size, offset) != 0) {
-			int saved_errno;
+	if (q->fd != -1 && append_record(q, data, data_size - 1) != 0) {
+		int saved_errno;
 
-			saved_errno = errno;
-			if (copy != NULL)
-				free(copy);
-			errno = saved_errno;
-			return -1;
-		}
+		saved_errno = errno;
+		free(copy);
+		errno = saved_errno;
+		return -1;
 	}
 
 	if (copy != NULL)
@@ -374,18 +784,7 @@ static int q_append_no_sync_fh_state(struct queue *q, const char *data)
 
 	q->queue_length++;
 
-	return 0;
-}
-
-int q_append(struct queue *q, const char *data)
-{
-	int r;
-
-	r = q_append_no_sync_fh_state(q, data);
-	if (r != 0)
-		return r;
-
-	return sync_fh_state(q); /* Calls q_sync() */
+	return checkpoint_maybe(q);
 }
 
 int q_peek(struct queue *q, char *buf, size_t size)
@@ -400,19 +799,20 @@ int q_peek(struct queue *q, char *buf, size_t size)
 		data = q->memory[q->queue_head];
 		data_size = strlen((char *)data) + 1;
 	} else if (q->fd != -1) {
-		const unsigned char *end;
+		size_t len;
+		int r;
 
-		if (full_pread(q->fd, q->buffer, q->entry_size,
-			       entry_offset(q, q->queue_head)) != 0)
+		r = read_record(q, q->head_fd, q->head_offset, &len);
+		if (r < 0)
 			return -1;
-		data = q->buffer;
-		end = memchr(q->buffer, '\0', q->entry_size);
-		if (end == NULL) {
+		if (r == 0) {
 			/* FIXME: silently drop this entry? */
 			errno = EBADMSG;
 			return -1;
 		}
-		data_size = (end - data) + 1;
+		q->buffer[len] = '\0';
+		data = q->buffer;
+		data_size = len + 1;
 
 		if (q->memory != NULL) {
 			unsigned char *copy;
@@ -436,35 +836,44 @@ int q_peek(struct queue *q, char *buf, size_t size)
 	return data_size;
 }
 
-/* Internal use only: drop head of Q, but don't write this into the file */
-static int q_drop_head_memory_only(struct queue *q)
+int q_drop_head(struct queue *q)
 {
 	if (q->queue_length == 0) {
 		errno = EINVAL;
 		return -1;
 	}
 
+	if (q->fd != -1) {
+		size_t len;
+
+		if (q->memory != NULL && q->memory[q->queue_head] != NULL)
+			len = strlen((char *)q->memory[q->queue_head]);
+		else {
+			int r;
+
+			r = read_record(q, q->head_fd, q->head_offset, &len);
+			if (r < 0)
+				return -1;
+			if (r == 0) {
+				errno = EBADMSG;
+				return -1;
+			}
+		}
+		q->head_offset += record_size(len);
+	}
+
 	if (q->memory != NULL) {
 		free(q->memory[q->queue_head]);
 		q->memory[q->queue_head] = NULL;
+		q->queue_head++;
+		if (q->queue_head == q->memory_slots)
+			q->queue_head = 0;
 	}
-
-	q->queue_head++;
-	if (q->queue_head == q->num_entries)
-		q->queue_head = 0;
 	q->queue_length--;
-	return 0;
-}
 
-int q_drop_head(struct queue *q)
-{
-	int r;
-
-	r = q_drop_head_memory_only(q);
-	if (r != 0)
-		return r;
-
-	return sync_fh_state(q); /* Calls q_sync() */
+	if (q->fd != -1 && advance_head_segment(q) != 0)
+		return -1;
+	return checkpoint_maybe(q);
 }
 
 size_t q_queue_length(const struct queue *q)
@@ -475,97 +884,44 @@ size_t q_queue_length(const struct queue *q)
 struct queue *q_open(int q_flags, const char *path, size_t num_entries,
 		     size_t entry_size)
 {
-	struct queue *q, *q2;
-	char *tmp_path, *buf;
-	size_t path_len;
-	int saved_errno, fd;
+	struct queue *q;
+	int saved_errno;
 
 	q = q_open_no_resize(q_flags, path, num_entries, entry_size);
 	if (q == NULL || q->num_entries == num_entries)
 		return q;
 
+	/* Entries are not preallocated, so resizing only changes the limit */
 	if ((q->flags & Q_RESIZE) == 0) {
 		saved_errno = EINVAL;
-		goto err_errno_q;
+		goto err;
 	}
-
 	if (q->queue_length > num_entries) {
 		saved_errno = ENOSPC;
-		goto err_errno_q;
-	}
-
-	buf = malloc(entry_size);
-	if (buf == NULL) {
-		saved_errno = errno;
-		goto err_errno_q;
+		goto err;
 	}
+	q->num_entries = num_entries;
+	if (q->memory != NULL && q->memory_slots < num_entries) {
+		unsigned char **memory;
 
-	path_len = strlen(path);
-	tmp_path = malloc(path_len + 7);
-	if (tmp_path == NULL) {
-		saved_errno = errno;
-		goto err_errno_buf;
-	}
-	memcpy(tmp_path, path, path_len);
-	memcpy(tmp_path + path_len, "XXXXXX", 7);
-	/* We really want tmpnam() here (safe due to the Q_EXCL below), but gcc
-	   warns on any use of tmpnam(). */
-	fd = mkstemp(tmp_path);
-	if (fd == -1) {
-		saved_errno = errno;
-		goto err_errno_tmp_path;
-	}
-	if (close(fd) != 0 || unlink(tmp_path) != 0) {
-		saved_errno = errno;
-		goto err_errno_tmp_file;
+		/* Nothing is cached in memory right after opening */
+		memory = calloc(num_entries, sizeof(*memory));
+		if (memory == NULL) {
+			saved_errno = errno;
+			goto err;
+		}
+		free(q->memory);
+		q->memory = memory;
+		q->memory_slots = num_entries;
+		q->queue_head = 0;
 	}
-
-	q2 = q_open_no_resize(q_flags | Q_CREAT | Q_EXCL, tmp_path, num_entries,
-			      entry_size);
-	if (q2 == NULL) {
+	if (write_checkpoint(q) != 0) {
 		saved_errno = errno;
-		goto err_errno_tmp_file;
-	}
-	if (q2->num_entries != num_entries) {
-		errno = EIO;	/* This is _really_ unexpected. */
-		goto err_q2;
-	}
-
-	for (;;) {
-		int r;
-
-		r = q_peek(q, buf, entry_size);
-		if (r == 0)
-			break;
-		if (r < 0)
-			goto err_q2;
-
-		if (q_append_no_sync_fh_state(q2, buf) != 0)
-			goto err_q2;
-		if (q_drop_head_memory_only(q) != 0)
-			goto err_q2;
+		goto err;
 	}
-	if (sync_fh_state(q2) != 0)
-		goto err_q2;
-
-	if (rename(tmp_path, path) != 0)
-		goto err_q2;
-
-	q_close(q);
-	free(buf);
-	free(tmp_path);
-	return q2;
+	return q;
 
-err_q2:
-	saved_errno = errno;
-	q_close(q2);
-err_errno_tmp_file:
-	unlink(tmp_path);
-err_errno_tmp_path:
-	free(tmp_path);
-err_errno_buf:
-	free(buf);
-err_errno_q:
+err:
 	q_close(q);
 	errno = saved_errno;
 	return NULL;
@@ -27,6 +27,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include "queue.h"
@@ -101,6 +105,22 @@ free_sample_entries(void)
 		free(sample_entries[i]);
 }
 
+/* Remove the queue file and its segment files */
+static void
+remove_queue(void)
+{
+	char name[sizeof(filename) + 9];
+	unsigned i;
+
+	if (unlink(filename) != 0)
+		err("unlink");
+	for (i = 0; i < 16; i++) {
+		snprintf(name, sizeof(name), "%s.%08x", filename, i);
+		if (unlink(name) != 0 && errno != ENOENT)
+			err("unlink");
+	}
+}
+
 static void
 test_q_open(void)
 {
@@ -221,13 +241,11 @@ append_sample_entries(size_t count)
 }
 
 static void
-verify_sample_entries(size_t count)
+verify_sample_entries_prefix(size_t count)
 {
 	char buf[ENTRY_SIZE + 1];
 	size_t i;
 
-	if (q_queue_length(q) != count)
-		die("Unexpected q_queue_length");
 	for (i = 0; i < count; i++) {
 		if (q_peek(q, buf, sizeof(buf)) < 1)
 			err("q_peek %zu", i);
@@ -236,6 +254,16 @@ verify_sample_entries(size_t count)
 		if (q_drop_head(q) != 0)
 			err("q_drop_head");
 	}
+}
+
+static void
+verify_sample_entries(size_t count)
+{
+	char buf[ENTRY_SIZE + 1];
+
+	if (q_queue_length(q) != count)
+		die("Unexpected q_queue_length");
+	verify_sample_entries_prefix(count);
 	if (q_peek(q, buf, sizeof(buf)) != 0)
 		die("q_peek reports non-empty");
 }
@@ -276,8 +304,8 @@ test_run(int flags)
 		verify_sample_entries(0);
 	q_close(q);
 
-	if ((flags & Q_IN_FILE) != 0 && unlink(filename) != 0)
-		err("unlink");
+	if ((flags & Q_IN_FILE) != 0)
+		remove_queue();
 }
 
 static void
@@ -327,8 +355,180 @@ test_resizing(void)
 	verify_sample_entries(NUM_ENTRIES);
 	q_close(q);
 
-	if (unlink(filename) != 0)
-		err("unlink");
+	remove_queue();
+}
+
+/* Enough entries to need more than one segment file */
+#define MANY_ENTRIES 1500
+
+static void
+test_segments(void)
+{
+	char name[sizeof(filename) + 9];
+	struct stat st;
+
+	q = q_open(Q_IN_FILE | Q_CREAT | Q_EXCL, filename, MANY_ENTRIES,
+		   ENTRY_SIZE);
+	if (q == NULL)
+		err("q_open");
+	append_sample_entries(MANY_ENTRIES);
+	q_close(q);
+
+	snprintf(name, sizeof(name), "%s.%08x", filename, 1);
+	if (stat(name, &st) != 0)
+		err("stat %s", name);
+
+	q = q_open(Q_IN_FILE | Q_IN_MEMORY, filename, MANY_ENTRIES,
+		   ENTRY_SIZE);
+	if (q == NULL)
+		err("q_open");
+	verify_sample_entries(MANY_ENTRIES);
+
+	/* Fully consumed segments are removed */
+	snprintf(name, sizeof(name), "%s.%08x", filename, 0);
+	if (stat(name, &st) == 0 || errno != ENOENT)
+		die("segment 0 was not removed");
+	q_close(q);
+
+	remove_queue();
+}
+
+static void
+test_recovery(void)
+{
+	char buf[ENTRY_SIZE + 1], name[sizeof(filename) + 9];
+	int fd;
+
+	/* Append without closing the queue, so that the last entries are
+	   not covered by a checkpoint. */
+	fflush(NULL);
+	switch (fork()) {
+	case -1:
+		err("fork");
+	case 0:
+		q = q_open(Q_IN_FILE | Q_CREAT | Q_EXCL, filename, 100,
+			   ENTRY_SIZE);
+		if (q == NULL)
+			err("q_open");
+		append_sample_entries(NUM_SAMPLE_ENTRIES);
+		_exit(0);
+	default: {
+		int status;
+
+		if (wait(&status) == (pid_t)-1)
+			err("wait");
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			die("wait status %d", status);
+	}
+	}
+
+	/* Simulate a record torn by a crash */
+	snprintf(name, sizeof(name), "%s.%08x", filename, 0);
+	fd = open(name, O_WRONLY | O_APPEND);
+	if (fd == -1)
+		err("open");
+	if (write(fd, "\0\0\0\x10garbage", 11) != 11)
+		err("write");
+	close(fd);
+
+	q = q_open(Q_IN_FILE, filename, 100, ENTRY_SIZE);
+	if (q == NULL)
+		err("q_open");
+	if (q_queue_length(q) != NUM_SAMPLE_ENTRIES)
+		die("Unexpected q_queue_length");
+	/* The torn record must be overwritten, not skipped */
+	if (q_append(q, " ") != 0)
+		err("q_append");
+	q_close(q);
+
+	q = q_open(Q_IN_FILE, filename, 100, ENTRY_SIZE);
+	if (q == NULL)
+		err("q_open");
+	if (q_queue_length(q) != NUM_SAMPLE_ENTRIES + 1)
+		die("Unexpected q_queue_length");
+	verify_sample_entries_prefix(NUM_SAMPLE_ENTRIES);
+	if (q_peek(q, buf, sizeof(buf)) < 1)
+		err("q_peek");
+	if (strcmp(buf, " ") != 0)
+		die("invalid data returned");
+	q_close(q);
+
+	remove_queue();
+}
+
+/* Create a queue file in the old slot based format holding 2 entries,
+   starting at slot NUM_ENTRIES - 1. */
+static void
+create_v0_queue(void)
+{
+	static const uint8_t magic[14] = "\0audisp-remote";
+	uint32_t v;
+	char *slot;
+	int fd;
+
+	fd = open(filename, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd == -1)
+		err("open");
+	slot = calloc(1, ENTRY_SIZE);
+	if (slot == NULL)
+		err("calloc");
+	memcpy(slot, magic, sizeof(magic));
+	slot[14] = 0; /* version */
+	slot[15] = 0;
+	v = htonl(NUM_ENTRIES);
+	memcpy(slot + 16, &v, 4);
+	v = htonl(ENTRY_SIZE);
+	memcpy(slot + 20, &v, 4);
+	v = htonl(NUM_ENTRIES - 1);
+	memcpy(slot + 24, &v, 4);
+	v = htonl(2);
+	memcpy(slot + 28, &v, 4);
+	if (pwrite(fd, slot, ENTRY_SIZE, 0) != ENTRY_SIZE)
+		err("pwrite");
+	memset(slot, 0, ENTRY_SIZE);
+	strcpy(slot, sample_entries[1]);
+	if (pwrite(fd, slot, ENTRY_SIZE, ENTRY_SIZE) != ENTRY_SIZE)
+		err("pwrite");
+	strcpy(slot, sample_entries[0]);
+	if (pwrite(fd, slot, ENTRY_SIZE, NUM_ENTRIES * ENTRY_SIZE)
+	    != ENTRY_SIZE)
+		err("pwrite");
+	free(slot);
+	close(fd);
+}
+
+static void
+test_v0_import(void)
+{
+	struct stat st;
+
+	create_v0_queue();
+	q = q_open(Q_IN_FILE, filename, NUM_ENTRIES, ENTRY_SIZE);
+	if (q == NULL)
+		err("q_open");
+	q_close(q);
+
+	if (stat(filename, &st) != 0)
+		err("stat");
+	if (st.st_size >= ENTRY_SIZE)
+		die("queue file was not converted");
+
+	/* A crash after the new header was written but before the old
+	   slots were cut off */
+	if (truncate(filename, (NUM_ENTRIES + 1) * ENTRY_SIZE) != 0)
+		err("truncate");
+
+	q = q_open(Q_IN_FILE, filename, NUM_ENTRIES, ENTRY_SIZE);
+	if (q == NULL)
+		err("q_open with leftover slots");
+	if (stat(filename, &st) != 0)
+		err("stat");
+	if (st.st_size >= ENTRY_SIZE)
+		die("leftover slots were not removed");
+	verify_sample_entries(2);
+	q_close(q);
+
+	remove_queue();
 }
 
 int
@@ -360,6 +560,9 @@ main(void)
 		test_run(flags[i]);
 
 	test_resizing();
+	test_segments();
+	test_recovery();
+	test_v0_import();
 
 	free_sample_entries();
 
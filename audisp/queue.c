@@ -31,8 +31,6 @@ static volatile event_t **q;
 static pthread_mutex_t queue_lock;
 static pthread_cond_t queue_nonempty;
 static unsigned int q_next, q_last, q_depth, processing_suspended;
-static const char *SINGLE = "1";
-static const char *HALT = "0";
 extern volatile int hup;
 
 void reset_suspended(void)
@@ -62,7 +60,7 @@ int init_queue(unsigned int size)
 	return 0;
 }
 
-static void change_runlevel(const char *level)
+void change_runlevel(const char *level)
 {
 	char *argv[3];
 	int pid;
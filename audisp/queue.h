@@ -23,15 +23,19 @@
 #ifndef QUEUE_HEADER
 #define QUEUE_HEADER
 
+#include <stddef.h>
 #include "libaudit.h"
 #include "audispd-config.h"
 
 typedef struct event
 {
 	struct audit_dispatcher_header hdr;
-	char data[MAX_AUDIT_MESSAGE_LENGTH];
+	char data[];	// hdr.size bytes, at most MAX_AUDIT_MESSAGE_LENGTH
 } event_t;
 
+/* Bytes to allocate for an event with len bytes of data */
+#define EVENT_SIZE(len) (offsetof(event_t, data) + (len))
+
 
 void reset_suspended(void);
 int init_queue(unsigned int size);
@@ -40,6 +44,11 @@ event_t *dequeue(void);
 void nudge_queue(void);
 void increase_queue_depth(unsigned int size);
 void destroy_queue(void);
+void change_runlevel(const char *level);
+
+/* Runlevels for change_runlevel */
+#define SINGLE "1"
+#define HALT "0"
 
 #endif
 
@@ -35,7 +35,8 @@ extern "C" {
 /* This tells the library where the data source is located */
 typedef enum { AUSOURCE_LOGS, AUSOURCE_FILE, AUSOURCE_FILE_ARRAY, 
 	AUSOURCE_BUFFER, AUSOURCE_BUFFER_ARRAY,
-	AUSOURCE_DESCRIPTOR, AUSOURCE_FILE_POINTER, AUSOURCE_FEED } ausource_t;
+	AUSOURCE_DESCRIPTOR, AUSOURCE_FILE_POINTER, AUSOURCE_FEED,
+	AUSOURCE_COLUMNAR } ausource_t;
 
 /* This used to define the types of searches that can be done.  It is not used
    any more. */
@@ -70,6 +71,14 @@ typedef struct
 /* This indicates why the user supplied callback was invoked */
 typedef enum {AUPARSE_CB_EVENT_READY} auparse_cb_event_t;
 
+/* Columns of the columnar export format */
+typedef enum { AUCOL_TIME, AUCOL_SERIAL, AUCOL_NODE, AUCOL_TYPE, AUCOL_UID,
+	AUCOL_AUID, AUCOL_SYSCALL, AUCOL_EXE, AUCOL_KEY, AUCOL_SUCCESS,
+	AUCOL_RAW } aucol_t;
+#define AUCOL_COUNT	(AUCOL_RAW + 1)
+#define AUCOL_MASK(col)	(1U << (col))
+#define AUCOL_ALL	((1U << AUCOL_COUNT) - 1)
+
 /* This determines the type of field at current cursor location
  * ONLY APPEND - DO NOT DELETE or it will break ABI */
 typedef enum {  AUPARSE_TYPE_UNCLASSIFIED,  AUPARSE_TYPE_UID, AUPARSE_TYPE_GID,
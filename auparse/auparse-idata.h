@@ -25,6 +25,7 @@
 #define IDATA_HEADER
 
 #include "config.h"
+#include <stddef.h>
 #include "dso.h"
 
 typedef struct _idata {
@@ -38,9 +39,11 @@ typedef struct _idata {
 
 int auparse_interp_adjust_type(int rtype, const char *name, const char *val);
 const char *auparse_do_interpretation(int type, const idata *id);
+int auparse_interp_buf(int type, const idata *id, char *buf, size_t size);
 
 hidden_proto(auparse_interp_adjust_type)
 hidden_proto(auparse_do_interpretation)
+hidden_proto(auparse_interp_buf)
 
 #endif
 
@@ -121,6 +121,8 @@ auparse_state_t *auparse_init(ausource_t source, const void *b)
 
 	au->in = NULL;
 	au->source_list = NULL;
+	au->col = NULL;
+	au->col_row = au->col_rows = 0;
 	databuf_init(&au->databuf, 0, 0);
 	au->callback = NULL;
 	au->callback_user_data = NULL;
@@ -135,6 +137,7 @@ auparse_state_t *auparse_init(ausource_t source, const void *b)
 			setup_log_file_array(au);
 			break;
 		case AUSOURCE_FILE:
+		case AUSOURCE_COLUMNAR:
 			if (access(b, R_OK))
 				goto bad_exit;
 			tmp = malloc(2*sizeof(char *));
@@ -315,6 +318,12 @@ int auparse_reset(auparse_state_t *au)
 			au->off = 0;
 			databuf_reset(&au->databuf);
 			break;
+		case AUSOURCE_COLUMNAR:
+			auparse_columnar_free(au->col);
+			au->col = NULL;
+			au->col_row = au->col_rows = 0;
+			au->line_number = 0;
+			break;
 		default:
 			return -1;
 	}
@@ -555,6 +564,7 @@ void auparse_destroy(auparse_state_t *au)
 		fclose(au->in);
 		au->in = NULL;
 	}
+	auparse_columnar_free(au->col);
 	free(au);
 }
 
@@ -614,6 +624,42 @@ static int readline_file(auparse_state_t *au)
 	return 1;
 }
 
+/* Copies the next record of a columnar file into cur_buf. Only the raw
+ * column is read. Returns the same as readline_file. */
+static int readline_columnar(auparse_state_t *au)
+{
+	const char *text;
+
+	if (au->cur_buf != NULL) {
+		free(au->cur_buf);
+		au->cur_buf = NULL;
+	}
+	if (au->col == NULL) {
+		au->col = auparse_columnar_open(au->source_list[0],
+						AUCOL_MASK(AUCOL_RAW));
+		if (au->col == NULL)
+			return -1;
+	}
+	while (au->col_row >= au->col_rows) {
+		int rc = auparse_columnar_next_chunk(au->col);
+
+		if (rc < 0)
+			return -1;
+		if (rc == 0) {
+			errno = 0;
+			return -2;
+		}
+		au->col_rows = rc;
+		au->col_row = 0;
+	}
+	text = auparse_columnar_get_str(au->col, AUCOL_RAW, au->col_row++);
+	au->cur_buf = strdup(text ? text : "");
+	if (au->cur_buf == NULL)
+		return -1;
+	errno = 0;
+	return 1;
+}
+
 
 /* malloc & copy a line into cur_buf from the internal buffer,
  * next_buf.  cur_buf will contain a null terminated line without a
@@ -857,6 +903,11 @@ static int retrieve_next_line(auparse_state_t *au)
 			if (rc > 0)
 				au->line_number++;
 			return rc;
+		case AUSOURCE_COLUMNAR:
+			rc = readline_columnar(au);
+			if (rc > 0)
+				au->line_number++;
+			return rc;
 		case AUSOURCE_FEED:
 			rc = readline_buf(au);
 			// No such thing as EOF for feed, translate EOF
@@ -1209,6 +1260,7 @@ const char *auparse_get_filename(auparse_state_t *au)
 	{
 		case AUSOURCE_FILE:
 		case AUSOURCE_FILE_ARRAY:
+		case AUSOURCE_COLUMNAR:
 			break;
 		default:
 			return NULL;
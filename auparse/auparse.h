@@ -102,6 +102,22 @@ int auparse_get_field_type(auparse_state_t *au);
 int auparse_get_field_int(auparse_state_t *au);
 const char *auparse_interpret_field(auparse_state_t *au);
 
+/* Columnar export, read back with AUSOURCE_COLUMNAR */
+typedef struct aucol_writer aucol_writer_t;
+typedef struct aucol_reader aucol_reader_t;
+
+aucol_writer_t *auparse_columnar_create(const char *path);
+int auparse_columnar_write(aucol_writer_t *w, const char *record);
+int auparse_columnar_close(aucol_writer_t *w);
+aucol_reader_t *auparse_columnar_open(const char *path, unsigned int columns);
+int auparse_columnar_next_chunk(aucol_reader_t *r);
+int auparse_columnar_get_event(aucol_reader_t *r, unsigned int row,
+			au_event_t *e);
+int auparse_columnar_get_type(aucol_reader_t *r, unsigned int row);
+const char *auparse_columnar_get_str(aucol_reader_t *r, aucol_t col,
+			unsigned int row);
+void auparse_columnar_free(aucol_reader_t *r);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,880 @@
+/* columnar.c --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *      Steve Grubb <sgrubb@redhat.com>
+ */
+
+/*
+ * The columnar format stores records in chunks of up to CHUNK_ROWS rows.
+ * Each chunk starts with a directory giving the length of every column,
+ * so a reader can seek past the columns it has no use for. All numbers
+ * are little endian.
+ *
+ *   file:   "AUCL" version
+ *   chunk:  "AUCK" rows ncols { column len } * ncols, column data
+ *
+ * Time and serial columns hold zigzag varint deltas from the previous
+ * row, the type column holds varints. The node and field columns are
+ * dictionary encoded: a varint count, that many NUL terminated strings,
+ * then a varint per row that is 0 when the record has no such field or
+ * else the string's index plus one. The raw column holds each record's
+ * text NUL terminated, so the records can always be read back exactly.
+ * As log lines repeat a lot, it is stored as a varint of its length and
+ * then an LZ77 stream of sequences: a varint literal count, the literals,
+ * and a varint that is 0 at the end of the stream or else the match
+ * length minus MIN_MATCH - 1 followed by a varint offset back to copy
+ * from. Dictionaries and matches do not reach across chunks.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include "libaudit.h"
+#include "auparse.h"
+
+#define FILE_MAGIC	0x4c435541	/* "AUCL" */
+#define CHUNK_MAGIC	0x4b435541	/* "AUCK" */
+#define COL_VERSION	1
+#define CHUNK_ROWS	8192
+#define CHUNK_BYTES	(4*1024*1024)	/* Raw text before a chunk is cut */
+#define MAX_ROWS	(1 << 20)
+#define MAX_COLS	64
+#define MAX_TEXT	(64*1024*1024)	/* Raw text a reader will expand */
+#define MIN_MATCH	4
+#define LZ_HASH_BITS	14
+
+/* The record fields that get their own column */
+static const struct {
+	aucol_t col;
+	const char *name;
+	size_t len;
+} field_cols[] = {
+	{ AUCOL_UID, "uid", 3 },
+	{ AUCOL_AUID, "auid", 4 },
+	{ AUCOL_SYSCALL, "syscall", 7 },
+	{ AUCOL_EXE, "exe", 3 },
+	{ AUCOL_KEY, "key", 3 },
+	{ AUCOL_SUCCESS, "success", 7 }
+};
+#define FIELD_COLS (sizeof(field_cols)/sizeof(field_cols[0]))
+
+static int is_dict_col(aucol_t col)
+{
+	return col != AUCOL_TIME && col != AUCOL_SERIAL &&
+		col != AUCOL_TYPE && col != AUCOL_RAW;
+}
+
+struct obuf {
+	unsigned char *p;
+	size_t len;
+	size_t size;
+};
+
+static int obuf_put(struct obuf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		size_t size = b->size ? b->size : 4096;
+		unsigned char *tmp;
+
+		while (size < b->len + len)
+			size *= 2;
+		tmp = realloc(b->p, size);
+		if (tmp == NULL)
+			return -1;
+		b->p = tmp;
+		b->size = size;
+	}
+	memcpy(b->p + b->len, data, len);
+	b->len += len;
+	return 0;
+}
+
+static int obuf_varint(struct obuf *b, uint64_t v)
+{
+	unsigned char tmp[10];
+	size_t n = 0;
+
+	do {
+		tmp[n] = v & 0x7F;
+		v >>= 7;
+		if (v)
+			tmp[n] |= 0x80;
+		n++;
+	} while (v);
+	return obuf_put(b, tmp, n);
+}
+
+static int obuf_delta(struct obuf *b, int64_t cur, int64_t *prev)
+{
+	int64_t d = cur - *prev;
+
+	*prev = cur;
+	return obuf_varint(b, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+}
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static unsigned int lz_hash(const unsigned char *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static int lz_sequence(struct obuf *out, const unsigned char *lit,
+		size_t lit_len, size_t match_len, size_t offset)
+{
+	int rc = obuf_varint(out, lit_len);
+
+	if (lit_len)
+		rc |= obuf_put(out, lit, lit_len);
+	if (match_len) {
+		rc |= obuf_varint(out, match_len - MIN_MATCH + 1);
+		rc |= obuf_varint(out, offset);
+	} else
+		rc |= obuf_varint(out, 0);
+	return rc;
+}
+
+/* Appends the compressed form of src to out */
+static int lz_compress(const unsigned char *src, size_t n, struct obuf *out)
+{
+	uint32_t *table;
+	size_t i = 0, anchor = 0;
+	int rc = 0;
+
+	table = calloc(1 << LZ_HASH_BITS, sizeof(uint32_t));
+	if (table == NULL)
+		return -1;
+	while (i + MIN_MATCH <= n && rc == 0) {
+		unsigned int h = lz_hash(src + i);
+		size_t cand = table[h];
+
+		table[h] = i + 1;
+		if (cand-- && memcmp(src + cand, src + i, MIN_MATCH) == 0) {
+			size_t len = MIN_MATCH;
+
+			while (i + len < n && src[cand + len] == src[i + len])
+				len++;
+			rc = lz_sequence(out, src + anchor, i - anchor, len,
+					i - cand);
+			// Remember a few spots inside the match too
+			if (len > 8)
+				table[lz_hash(src + i + len/2)] = i + len/2 + 1;
+			i += len;
+			anchor = i;
+		} else
+			i++;
+	}
+	if (rc == 0)
+		rc = lz_sequence(out, src + anchor, n - anchor, 0, 0);
+	free(table);
+	return rc;
+}
+
+/* FNV-1a */
+static unsigned int hash_str(const char *s)
+{
+	unsigned int h = 2166136261U;
+
+	while (*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/* The strings of a dictionary column, with a table to find them */
+struct dict {
+	struct obuf strs;	// NUL terminated, in index order
+	unsigned int cnt;
+	unsigned int size;	// Slots in the table, a power of 2
+	unsigned int *off;	// Offset into strs + 1, 0 for empty
+	unsigned int *idx;
+};
+
+static int dict_grow(struct dict *d)
+{
+	unsigned int size = d->size ? d->size * 2 : 256, i;
+	unsigned int *off = calloc(size, sizeof(unsigned int));
+	unsigned int *idx = malloc(size * sizeof(unsigned int));
+
+	if (off == NULL || idx == NULL) {
+		free(off);
+		free(idx);
+		return -1;
+	}
+	for (i = 0; i < d->size; i++) {
+		unsigned int j;
+
+		if (d->off[i] == 0)
+			continue;
+		j = hash_str((char *)d->strs.p + d->off[i] - 1) & (size - 1);
+		while (off[j])
+			j = (j + 1) & (size - 1);
+		off[j] = d->off[i];
+		idx[j] = d->idx[i];
+	}
+	free(d->off);
+	free(d->idx);
+	d->off = off;
+	d->idx = idx;
+	d->size = size;
+	return 0;
+}
+
+/* Returns the index of str plus one, adding it if needed, or 0 on error */
+static unsigned int dict_lookup(struct dict *d, const char *str)
+{
+	unsigned int i;
+
+	if (d->cnt >= d->size / 2 && dict_grow(d))
+		return 0;
+	i = hash_str(str) & (d->size - 1);
+	while (d->off[i]) {
+		if (strcmp((char *)d->strs.p + d->off[i] - 1, str) == 0)
+			return d->idx[i] + 1;
+		i = (i + 1) & (d->size - 1);
+	}
+	d->off[i] = d->strs.len + 1;
+	if (obuf_put(&d->strs, str, strlen(str) + 1)) {
+		d->off[i] = 0;
+		return 0;
+	}
+	d->idx[i] = d->cnt++;
+	return d->idx[i] + 1;
+}
+
+static void dict_reset(struct dict *d)
+{
+	d->strs.len = 0;
+	d->cnt = 0;
+	if (d->off)
+		memset(d->off, 0, d->size * sizeof(unsigned int));
+}
+
+static void dict_free(struct dict *d)
+{
+	free(d->strs.p);
+	free(d->off);
+	free(d->idx);
+}
+
+struct aucol_writer {
+	FILE *f;
+	unsigned int rows;
+	int64_t prev_sec;
+	int64_t prev_serial;
+	struct obuf data[AUCOL_COUNT];
+	struct dict dict[AUCOL_COUNT];
+	int error;
+};
+
+aucol_writer_t *auparse_columnar_create(const char *path)
+{
+	aucol_writer_t *w;
+	unsigned char hdr[8];
+
+	w = calloc(1, sizeof(aucol_writer_t));
+	if (w == NULL)
+		return NULL;
+	w->f = fopen(path, "w");
+	if (w->f == NULL) {
+		free(w);
+		return NULL;
+	}
+	__fsetlocking(w->f, FSETLOCKING_BYCALLER);
+	put_u32(hdr, FILE_MAGIC);
+	put_u32(hdr + 4, COL_VERSION);
+	if (fwrite(hdr, sizeof(hdr), 1, w->f) != 1) {
+		fclose(w->f);
+		free(w);
+		return NULL;
+	}
+	return w;
+}
+
+static int flush_chunk(aucol_writer_t *w)
+{
+	unsigned char hdr[12 + AUCOL_COUNT * 8];
+	struct obuf cnt[AUCOL_COUNT], raw;
+	unsigned int i;
+	int rc = 0;
+
+	if (w->rows == 0)
+		return 0;
+	memset(cnt, 0, sizeof(cnt));
+	memset(&raw, 0, sizeof(raw));
+	if (obuf_varint(&raw, w->data[AUCOL_RAW].len) ||
+			lz_compress(w->data[AUCOL_RAW].p,
+				w->data[AUCOL_RAW].len, &raw))
+		rc = -1;
+	put_u32(hdr, CHUNK_MAGIC);
+	put_u32(hdr + 4, w->rows);
+	put_u32(hdr + 8, AUCOL_COUNT);
+	for (i = 0; i < AUCOL_COUNT; i++) {
+		size_t len = i == AUCOL_RAW ? raw.len : w->data[i].len;
+
+		if (is_dict_col(i)) {
+			if (obuf_varint(&cnt[i], w->dict[i].cnt))
+				rc = -1;
+			len += cnt[i].len + w->dict[i].strs.len;
+		}
+		put_u32(hdr + 12 + i * 8, i);
+		put_u32(hdr + 16 + i * 8, len);
+	}
+	if (rc == 0 && fwrite(hdr, sizeof(hdr), 1, w->f) != 1)
+		rc = -1;
+	for (i = 0; i < AUCOL_COUNT && rc == 0; i++) {
+		if (is_dict_col(i)) {
+			fwrite(cnt[i].p, cnt[i].len, 1, w->f);
+			if (w->dict[i].strs.len)
+				fwrite(w->dict[i].strs.p,
+					w->dict[i].strs.len, 1, w->f);
+			dict_reset(&w->dict[i]);
+		}
+		if (i == AUCOL_RAW)
+			fwrite(raw.p, raw.len, 1, w->f);
+		else if (w->data[i].len)
+			fwrite(w->data[i].p, w->data[i].len, 1, w->f);
+		w->data[i].len = 0;
+		if (ferror_unlocked(w->f))
+			rc = -1;
+	}
+	for (i = 0; i < AUCOL_COUNT; i++)
+		free(cnt[i].p);
+	free(raw.p);
+	w->rows = 0;
+	w->prev_sec = 0;
+	w->prev_serial = 0;
+	return rc;
+}
+
+static int put_str(aucol_writer_t *w, aucol_t col, const char *str)
+{
+	unsigned int idx = 0;
+
+	if (str) {
+		idx = dict_lookup(&w->dict[col], str);
+		if (idx == 0)
+			return -1;
+	}
+	return obuf_varint(&w->data[col], idx);
+}
+
+/*
+ * Picks the first value of each field that has a column out of the text
+ * of a record. vals gets pointers into buf, which is a copy of text.
+ */
+static void split_fields(char *buf, const char *vals[])
+{
+	char *ptr = buf, *saved = NULL;
+	int in_msg = 0;
+
+	while ((ptr = strtok_r(ptr, " ", &saved))) {
+		char *eq;
+		size_t i, len;
+
+		// User space messages nest their fields in msg='...'
+		if (strncmp(ptr, "msg='", 5) == 0) {
+			ptr += 5;
+			in_msg = 1;
+		}
+		eq = strchr(ptr, '=');
+		if (eq) {
+			len = eq - ptr;
+			for (i = 0; i < FIELD_COLS; i++) {
+				if (vals[field_cols[i].col] == NULL &&
+						len == field_cols[i].len &&
+						memcmp(ptr, field_cols[i].name,
+							len) == 0) {
+					char *end = eq + strlen(eq);
+
+					if (in_msg && end > eq + 1 &&
+							end[-1] == '\'')
+						end[-1] = 0;
+					vals[field_cols[i].col] = eq + 1;
+					break;
+				}
+			}
+		}
+		ptr = NULL;
+	}
+}
+
+/* Returns the record type from the text after type= */
+static int record_type(const char *ptr)
+{
+	char name[64];
+	size_t len = strcspn(ptr, " ");
+
+	if (len >= sizeof(name))
+		return 0;
+	memcpy(name, ptr, len);
+	name[len] = 0;
+	if (strncmp(name, "UNKNOWN[", 8) == 0)
+		return strtoul(name + 8, NULL, 10);
+	len = audit_name_to_msg_type(name);
+	return (int)len < 0 ? 0 : (int)len;
+}
+
+/* Adds one record, given as the text of a log line */
+int auparse_columnar_write(aucol_writer_t *w, const char *record)
+{
+	const char *vals[AUCOL_COUNT];
+	const char *ptr = record;
+	char *buf, *fields, *node = NULL;
+	unsigned long long sec = 0, serial = 0;
+	unsigned int milli = 0, i;
+	size_t len;
+	int type = 0, rc = 0;
+
+	if (w == NULL || record == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (w->error)
+		return -1;
+	len = strlen(record);
+	if (len && record[len-1] == '\n')
+		len--;
+	buf = malloc(len + 1);
+	if (buf == NULL)
+		return -1;
+	memcpy(buf, record, len);
+	buf[len] = 0;
+
+	memset(vals, 0, sizeof(vals));
+	if (strncmp(ptr, "node=", 5) == 0) {
+		size_t n = strcspn(ptr + 5, " ");
+
+		node = strndup(ptr + 5, n);
+		ptr += 5 + n;
+		while (*ptr == ' ')
+			ptr++;
+	}
+	if (strncmp(ptr, "type=", 5) == 0)
+		type = record_type(ptr + 5);
+	ptr = strstr(ptr, "audit(");
+	if (ptr)
+		sscanf(ptr + 6, "%llu.%u:%llu", &sec, &milli, &serial);
+	// The values point into fields, which is kept until they're added
+	ptr = strstr(buf, "): ");
+	fields = ptr ? strdup(ptr + 3) : NULL;
+	if (fields)
+		split_fields(fields, vals);
+	vals[AUCOL_NODE] = node;
+
+	rc |= obuf_delta(&w->data[AUCOL_TIME], sec, &w->prev_sec);
+	rc |= obuf_varint(&w->data[AUCOL_TIME], milli);
+	rc |= obuf_delta(&w->data[AUCOL_SERIAL], serial, &w->prev_serial);
+	rc |= obuf_varint(&w->data[AUCOL_TYPE], type);
+	for (i = 0; i < AUCOL_COUNT; i++)
+		if (is_dict_col(i))
+			rc |= put_str(w, i, vals[i]);
+	free(fields);
+	rc |= obuf_put(&w->data[AUCOL_RAW], buf, len + 1);
+	free(node);
+	free(buf);
+	w->rows++;
+	if (rc == 0 && (w->rows >= CHUNK_ROWS ||
+			w->data[AUCOL_RAW].len >= CHUNK_BYTES))
+		rc = flush_chunk(w);
+	if (rc)
+		w->error = 1;
+	return rc ? -1 : 0;
+}
+
+/* Writes out what is left and frees the writer */
+int auparse_columnar_close(aucol_writer_t *w)
+{
+	unsigned int i;
+	int rc;
+
+	if (w == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	rc = w->error ? -1 : flush_chunk(w);
+	if (fclose(w->f))
+		rc = -1;
+	for (i = 0; i < AUCOL_COUNT; i++) {
+		free(w->data[i].p);
+		dict_free(&w->dict[i]);
+	}
+	free(w);
+	return rc;
+}
+
+/* A column of the current chunk */
+struct rcol {
+	unsigned char *buf;	// Column data as read
+	size_t size;
+	int loaded;
+	int64_t *num;		// Time, serial, or type per row
+	unsigned int *milli;	// Time column only
+	const char **str;	// Strings per row, point into buf or text
+	const char **dict;	// Dictionary entries, point into buf
+	unsigned int dict_size;
+	unsigned char *text;	// Raw column after expanding
+	size_t text_size;
+};
+
+struct aucol_reader {
+	FILE *f;
+	unsigned int want;	// Columns to load
+	unsigned int rows;	// Rows in the current chunk
+	unsigned int size;	// Rows the row arrays can hold
+	struct rcol col[AUCOL_COUNT];
+};
+
+aucol_reader_t *auparse_columnar_open(const char *path, unsigned int columns)
+{
+	aucol_reader_t *r;
+	unsigned char hdr[8];
+
+	r = calloc(1, sizeof(aucol_reader_t));
+	if (r == NULL)
+		return NULL;
+	r->f = fopen(path, "rm");
+	if (r->f == NULL) {
+		free(r);
+		return NULL;
+	}
+	__fsetlocking(r->f, FSETLOCKING_BYCALLER);
+	if (fread(hdr, sizeof(hdr), 1, r->f) != 1 ||
+			get_u32(hdr) != FILE_MAGIC ||
+			get_u32(hdr + 4) != COL_VERSION) {
+		fclose(r->f);
+		free(r);
+		errno = EINVAL;
+		return NULL;
+	}
+	r->want = columns & AUCOL_ALL;
+	return r;
+}
+
+static int get_varint(const unsigned char **p, const unsigned char *end,
+		uint64_t *v)
+{
+	unsigned int shift = 0;
+
+	*v = 0;
+	while (*p < end && shift < 64) {
+		unsigned char c = *(*p)++;
+
+		*v |= (uint64_t)(c & 0x7F) << shift;
+		if ((c & 0x80) == 0)
+			return 0;
+		shift += 7;
+	}
+	return -1;
+}
+
+/* Expands an LZ77 stream into the n bytes at dst */
+static int lz_decompress(const unsigned char *p, const unsigned char *end,
+		unsigned char *dst, size_t n)
+{
+	size_t pos = 0;
+	uint64_t v;
+
+	for (;;) {
+		if (get_varint(&p, end, &v) || v > (uint64_t)(end - p) ||
+				v > n - pos)
+			return -1;
+		memcpy(dst + pos, p, v);
+		p += v;
+		pos += v;
+		if (get_varint(&p, end, &v))
+			return -1;
+		if (v == 0)
+			return pos == n ? 0 : -1;
+		{
+			uint64_t len = v + MIN_MATCH - 1, off;
+
+			if (get_varint(&p, end, &off) || off == 0 ||
+					off > pos || len > n - pos)
+				return -1;
+			// May overlap, so copy a byte at a time
+			while (len--) {
+				dst[pos] = dst[pos - off];
+				pos++;
+			}
+		}
+	}
+}
+
+static int grow_rows(aucol_reader_t *r, unsigned int rows)
+{
+	unsigned int i;
+
+	if (rows <= r->size)
+		return 0;
+	for (i = 0; i < AUCOL_COUNT; i++) {
+		struct rcol *c = &r->col[i];
+		void *tmp;
+
+		if (i == AUCOL_TIME || i == AUCOL_SERIAL ||
+				i == AUCOL_TYPE) {
+			tmp = realloc(c->num, rows * sizeof(int64_t));
+			if (tmp == NULL)
+				return -1;
+			c->num = tmp;
+		} else {
+			tmp = realloc(c->str, rows * sizeof(char *));
+			if (tmp == NULL)
+				return -1;
+			c->str = tmp;
+		}
+		if (i == AUCOL_TIME) {
+			tmp = realloc(c->milli, rows * sizeof(unsigned int));
+			if (tmp == NULL)
+				return -1;
+			c->milli = tmp;
+		}
+	}
+	r->size = rows;
+	return 0;
+}
+
+/* Turns the bytes of a column into per row values */
+static int decode_col(aucol_reader_t *r, aucol_t col, size_t len)
+{
+	struct rcol *c = &r->col[col];
+	const unsigned char *p = c->buf, *end = c->buf + len;
+	int64_t prev = 0;
+	unsigned int i;
+	uint64_t v;
+
+	if (col == AUCOL_TIME || col == AUCOL_SERIAL) {
+		for (i = 0; i < r->rows; i++) {
+			if (get_varint(&p, end, &v))
+				return -1;
+			prev += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			c->num[i] = prev;
+			if (col == AUCOL_TIME) {
+				if (get_varint(&p, end, &v))
+					return -1;
+				c->milli[i] = v;
+			}
+		}
+	} else if (col == AUCOL_TYPE) {
+		for (i = 0; i < r->rows; i++) {
+			if (get_varint(&p, end, &v))
+				return -1;
+			c->num[i] = v;
+		}
+	} else if (col == AUCOL_RAW) {
+		if (get_varint(&p, end, &v) || v > MAX_TEXT)
+			return -1;
+		if (v > c->text_size) {
+			unsigned char *tmp = realloc(c->text, v);
+
+			if (tmp == NULL)
+				return -1;
+			c->text = tmp;
+			c->text_size = v;
+		}
+		if (lz_decompress(p, end, c->text, v))
+			return -1;
+		p = c->text;
+		end = c->text + v;
+		for (i = 0; i < r->rows; i++) {
+			const unsigned char *nul = memchr(p, 0, end - p);
+
+			if (nul == NULL)
+				return -1;
+			c->str[i] = (const char *)p;
+			p = nul + 1;
+		}
+	} else {
+		if (get_varint(&p, end, &v) || v > len)
+			return -1;
+		if (v > c->dict_size) {
+			const char **tmp = realloc(c->dict,
+						v * sizeof(char *));
+			if (tmp == NULL)
+				return -1;
+			c->dict = tmp;
+			c->dict_size = v;
+		}
+		for (i = 0; i < v; i++) {
+			const unsigned char *nul = memchr(p, 0, end - p);
+
+			if (nul == NULL)
+				return -1;
+			c->dict[i] = (const char *)p;
+			p = nul + 1;
+		}
+		len = v;
+		for (i = 0; i < r->rows; i++) {
+			if (get_varint(&p, end, &v) || v > len)
+				return -1;
+			c->str[i] = v ? c->dict[v - 1] : NULL;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Reads the next chunk, loading only the columns asked for when opening.
+ * Returns the number of rows, 0 at the end of the file, or -1 on error.
+ */
+int auparse_columnar_next_chunk(aucol_reader_t *r)
+{
+	unsigned char hdr[12], dir[MAX_COLS * 8];
+	unsigned int ncols, i;
+	size_t n;
+
+	if (r == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < AUCOL_COUNT; i++)
+		r->col[i].loaded = 0;
+	r->rows = 0;
+	n = fread(hdr, 1, sizeof(hdr), r->f);
+	if (n == 0 && feof_unlocked(r->f))
+		return 0;
+	if (n != sizeof(hdr) || get_u32(hdr) != CHUNK_MAGIC)
+		goto bad;
+	ncols = get_u32(hdr + 8);
+	if (ncols > MAX_COLS || get_u32(hdr + 4) > MAX_ROWS)
+		goto bad;
+	if (ncols && fread(dir, ncols * 8, 1, r->f) != 1)
+		goto bad;
+	if (grow_rows(r, get_u32(hdr + 4)))
+		return -1;
+	r->rows = get_u32(hdr + 4);
+	for (i = 0; i < ncols; i++) {
+		uint32_t id = get_u32(dir + i * 8);
+		uint32_t len = get_u32(dir + i * 8 + 4);
+		struct rcol *c;
+
+		if (id >= AUCOL_COUNT || !(r->want & AUCOL_MASK(id)) ||
+				r->col[id].loaded) {
+			if (fseeko(r->f, len, SEEK_CUR))
+				goto bad;
+			continue;
+		}
+		c = &r->col[id];
+		if (len > c->size) {
+			unsigned char *tmp = realloc(c->buf, len);
+
+			if (tmp == NULL)
+				return -1;
+			c->buf = tmp;
+			c->size = len;
+		}
+		if (len && fread(c->buf, len, 1, r->f) != 1)
+			goto bad;
+		if (decode_col(r, id, len))
+			goto bad;
+		c->loaded = 1;
+	}
+	return r->rows;
+bad:
+	for (i = 0; i < AUCOL_COUNT; i++)
+		r->col[i].loaded = 0;
+	r->rows = 0;
+	errno = EIO;
+	return -1;
+}
+
+/*
+ * Fills in the time stamp, serial number, and node of a row from the
+ * columns that were loaded. Returns 0 on success and -1 if the row does
+ * not exist.
+ */
+int auparse_columnar_get_event(aucol_reader_t *r, unsigned int row,
+		au_event_t *e)
+{
+	if (r == NULL || e == NULL || row >= r->rows) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(e, 0, sizeof(*e));
+	if (r->col[AUCOL_TIME].loaded) {
+		e->sec = r->col[AUCOL_TIME].num[row];
+		e->milli = r->col[AUCOL_TIME].milli[row];
+	}
+	if (r->col[AUCOL_SERIAL].loaded)
+		e->serial = r->col[AUCOL_SERIAL].num[row];
+	if (r->col[AUCOL_NODE].loaded)
+		e->host = r->col[AUCOL_NODE].str[row];
+	return 0;
+}
+
+/* Returns the record type of a row, or 0 if not known */
+int auparse_columnar_get_type(aucol_reader_t *r, unsigned int row)
+{
+	if (r == NULL || row >= r->rows || !r->col[AUCOL_TYPE].loaded)
+		return 0;
+	return r->col[AUCOL_TYPE].num[row];
+}
+
+/*
+ * Returns the value of a string column for a row. This is NULL if the
+ * record does not have the field or the column was not loaded. The string
+ * is good until the next chunk is read.
+ */
+const char *auparse_columnar_get_str(aucol_reader_t *r, aucol_t col,
+		unsigned int row)
+{
+	if (r == NULL || (unsigned int)col >= AUCOL_COUNT || row >= r->rows ||
+			!r->col[col].loaded || col == AUCOL_TIME ||
+			col == AUCOL_SERIAL || col == AUCOL_TYPE)
+		return NULL;
+	return r->col[col].str[row];
+}
+
+void auparse_columnar_free(aucol_reader_t *r)
+{
+	unsigned int i;
+
+	if (r == NULL)
+		return;
+	for (i = 0; i < AUCOL_COUNT; i++) {
+		free(r->col[i].buf);
+		free(r->col[i].num);
+		free(r->col[i].milli);
+		free(r->col[i].str);
+		free(r->col[i].dict);
+		free(r->col[i].text);
+	}
+	fclose(r->f);
+	free(r);
+}
+
@@ -63,6 +63,9 @@ struct opaque
 	austop_t search_where;		// Where to put the cursors on a match
 	auparser_state_t parse_state;	// parsing state
 	DataBuf databuf;		// input data
+	aucol_reader_t *col;		// If source is columnar, the reader
+	unsigned int col_row;		// Next row of the reader's chunk
+	unsigned int col_rows;		// Rows in the reader's chunk
 
 	// function to call to notify user of parsing changes
 	void (*callback)(struct opaque *au, auparse_cb_event_t cb_event_type, void *user_data);
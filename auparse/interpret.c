@@ -223,16 +223,15 @@ static const char *aulookup_uid(uid_t uid, char *buf, size_t size)
 	if (rc) {
 		name = uid_nvl.cur->name;
 	} else {
-		// Add it to cache
+		// Add it to cache, unknown ids too so they aren't looked
+		// up again for every record
 		struct passwd *pw;
+		nvpnode nv;
 		pw = getpwuid(uid);
-		if (pw) {
-			nvpnode nv;
-			nv.name = strdup(pw->pw_name);
-			nv.val = uid;
-			nvpair_append(&uid_nvl, &nv);
-			name = uid_nvl.cur->name;
-		}
+		nv.name = pw ? strdup(pw->pw_name) : NULL;
+		nv.val = uid;
+		nvpair_append(&uid_nvl, &nv);
+		name = uid_nvl.cur->name;
 	}
 	if (name != NULL)
 		snprintf(buf, size, "%s", name);
@@ -272,16 +271,15 @@ static const char *aulookup_gid(gid_t gid, char *buf, size_t size)
 	if (rc) {
 		name = gid_nvl.cur->name;
 	} else {
-		// Add it to cache
+		// Add it to cache, unknown ids too so they aren't looked
+		// up again for every record
 		struct group *gr;
+		nvpnode nv;
 		gr = getgrgid(gid);
-		if (gr) {
-			nvpnode nv;
-			nv.name = strdup(gr->gr_name);
-			nv.val = gid;
-			nvpair_append(&gid_nvl, &nv);
-			name = gid_nvl.cur->name;
-		}
+		nv.name = gr ? strdup(gr->gr_name) : NULL;
+		nv.val = gid;
+		nvpair_append(&gid_nvl, &nv);
+		name = gid_nvl.cur->name;
 	}
 	if (name != NULL)
 		snprintf(buf, size, "%s", name);
@@ -2445,3 +2443,204 @@ const char *auparse_do_interpretation(int type, const idata *id)
 }
 hidden_def(auparse_do_interpretation)
 
+
+/* Copies s into buf like snprintf() would */
+static int copy_out(char *buf, size_t size, const char *s, size_t len)
+{
+	if (size) {
+		size_t n = len < size ? len : size - 1;
+		memcpy(buf, s, n);
+		buf[n] = 0;
+	}
+	return len;
+}
+
+static int hex_val(unsigned char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return 0;
+}
+
+/*
+ * Same as au_unescape() followed by a copy, but decodes straight into
+ * buf. Returns -1 where au_unescape() would have returned NULL.
+ */
+static int unescape_out(const char *val, char *buf, size_t size)
+{
+	const char *end = val;
+	size_t len, i, n = 0;
+
+	if (*val == '(') {
+		end = strchr(val, ')');
+		if (end == NULL)
+			return -1;
+		return copy_out(buf, size, val, end + 1 - val);
+	}
+	while (isxdigit(*end))
+		end++;
+	len = end - val;
+	if (len < 2)
+		return -1;
+	// The string ends at the first decoded nul
+	for (i = 0; i < len; i += 2) {
+		unsigned char c = hex_val(val[i]) << 4;
+
+		if (i + 1 < len)
+			c |= hex_val(val[i + 1]);
+		if (c == 0)
+			break;
+		if (n + 1 < size)
+			buf[n] = c;
+		n++;
+	}
+	if (size)
+		buf[n < size ? n : size - 1] = 0;
+	return n;
+}
+
+/*
+ * Writes the interpretation of a field into buf instead of returning an
+ * allocated string. The common types are formatted in place, the rest
+ * go through auparse_do_interpretation(). Like snprintf(), it returns the
+ * length the result needs, which is more than size - 1 when it was cut.
+ */
+int auparse_interp_buf(int type, const idata *id, char *buf, size_t size)
+{
+	const char *val = id->val, *ptr;
+	char name[64];
+	int len;
+
+	errno = 0;
+	switch (type) {
+	case AUPARSE_TYPE_UID:
+	case AUPARSE_TYPE_GID: {
+		int ival = strtoul(val, NULL, 10);
+
+		if (errno)
+			return snprintf(buf, size, "conversion error(%s)", val);
+		if (type == AUPARSE_TYPE_UID)
+			ptr = aulookup_uid(ival, name, sizeof(name));
+		else
+			ptr = aulookup_gid(ival, name, sizeof(name));
+		return copy_out(buf, size, ptr, strlen(ptr));
+		}
+	case AUPARSE_TYPE_SYSCALL: {
+		const char *func = NULL;
+		int machine = id->machine;
+
+		if (machine < 0)
+			machine = audit_detect_machine();
+		if (machine < 0)
+			return copy_out(buf, size, val, strlen(val));
+		ptr = audit_syscall_to_name(id->syscall, machine);
+		if (ptr == NULL)
+			return snprintf(buf, size, "unknown syscall(%d)",
+					id->syscall);
+		if (strcmp(ptr, "socketcall") == 0) {
+			if ((int)id->a0 == id->a0)
+				func = sock_i2s(id->a0);
+		} else if (strcmp(ptr, "ipc") == 0)
+			if ((int)id->a0 == id->a0)
+				func = ipc_i2s(id->a0);
+		if (func)
+			return snprintf(buf, size, "%s(%s)", ptr, func);
+		return copy_out(buf, size, ptr, strlen(ptr));
+		}
+	case AUPARSE_TYPE_ARCH: {
+		unsigned int machine = id->machine;
+
+		if (machine > MACH_AARCH64) {
+			unsigned int ival = strtoul(val, NULL, 16);
+
+			if (errno)
+				return snprintf(buf, size,
+					"conversion error(%s) ", val);
+			machine = audit_elf_to_machine(ival);
+		}
+		if ((int)machine < 0)
+			return snprintf(buf, size, "unknown elf type(%s)", val);
+		ptr = audit_machine_to_name(machine);
+		if (ptr == NULL)
+			return snprintf(buf, size, "unknown machine type(%d)",
+					machine);
+		return copy_out(buf, size, ptr, strlen(ptr));
+		}
+	case AUPARSE_TYPE_EXIT: {
+		long long ival = strtoll(val, NULL, 10);
+
+		if (errno)
+			return snprintf(buf, size, "conversion error(%s)", val);
+		if (ival < 0)
+			return snprintf(buf, size, "%lld(%s)", ival,
+					strerror(-ival));
+		return copy_out(buf, size, val, strlen(val));
+		}
+	case AUPARSE_TYPE_ESCAPED:
+		if (*val == '"') {
+			ptr = strchr(val + 1, '"');
+			if (ptr == NULL)
+				return copy_out(buf, size, " ", 1);
+			return copy_out(buf, size, val + 1, ptr - val - 1);
+		}
+		if (val[0] == '0' && val[1] == '0')
+			len = unescape_out(val + 2, buf, size); // Abstract name
+		else
+			len = unescape_out(val, buf, size);
+		if (len >= 0)
+			return len;
+		return copy_out(buf, size, val, strlen(val));
+	case AUPARSE_TYPE_MODE: {
+		unsigned int ival = strtoul(val, NULL, 8);
+
+		if (errno)
+			return snprintf(buf, size, "conversion error(%s)", val);
+		ptr = audit_ftype_to_name(ival & S_IFMT);
+		if (ptr == NULL) {
+			// The lowest-valued "1" bit in S_IFMT
+			unsigned first_ifmt_bit = S_IFMT & ~(S_IFMT - 1);
+
+			snprintf(name, sizeof(name), "%03o",
+				(ival & S_IFMT) / first_ifmt_bit);
+			ptr = name;
+		}
+		return snprintf(buf, size, "%s%s%s%s,%03o", ptr,
+			S_ISUID & ival ? ",suid" : "",
+			S_ISGID & ival ? ",sgid" : "",
+			S_ISVTX & ival ? ",sticky" : "",
+			(S_IRWXU|S_IRWXG|S_IRWXO) & ival);
+		}
+	case AUPARSE_TYPE_SUCCESS:
+		if (isdigit(*val)) {
+			int res = strtoul(val, NULL, 10);
+
+			if (errno)
+				return snprintf(buf, size,
+					"conversion error(%s)", val);
+			ptr = aulookup_success(res);
+			return copy_out(buf, size, ptr, strlen(ptr));
+		}
+		return copy_out(buf, size, val, strlen(val));
+	case AUPARSE_TYPE_SESSION:
+		if (strcmp(val, "4294967295") == 0)
+			return copy_out(buf, size, "unset", 5);
+		return copy_out(buf, size, val, strlen(val));
+	case AUPARSE_TYPE_MAC_LABEL:
+	case AUPARSE_TYPE_UNCLASSIFIED:
+		return copy_out(buf, size, val, strlen(val));
+	default: {
+		char *out = (char *)auparse_do_interpretation(type, id);
+
+		if (out == NULL)
+			return copy_out(buf, size, "", 0);
+		len = copy_out(buf, size, out, strlen(out));
+		free(out);
+		return len;
+		}
+	}
+}
+hidden_def(auparse_interp_buf)
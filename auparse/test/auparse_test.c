@@ -462,6 +462,72 @@ int main(void)
 	}
         printf("Test 10 Done\n\n");
 
+	/* Note: the walk should match Test 4 except for the file name */
+	printf("Starting Test 11, columnar file...\n");
+	{
+		aucol_writer_t *w;
+		aucol_reader_t *r;
+		char line[MAX_AUDIT_MESSAGE_LENGTH];
+		FILE *fp;
+		int rows, i;
+
+		w = auparse_columnar_create("./test.col");
+		if (w == NULL) {
+			printf("Error - %s\n", strerror(errno));
+			return 1;
+		}
+		if ((fp = fopen("./test.log", "r")) == NULL) {
+			printf("could not open ./test.log, %s\n",
+						strerror(errno));
+			return 1;
+		}
+		while (fgets(line, sizeof(line), fp))
+			auparse_columnar_write(w, line);
+		fclose(fp);
+		if (auparse_columnar_close(w)) {
+			printf("Error writing ./test.col\n");
+			return 1;
+		}
+
+		au = auparse_init(AUSOURCE_COLUMNAR, "./test.col");
+		if (au == NULL) {
+			printf("Error - %s\n", strerror(errno));
+			return 1;
+		}
+		walk_test(au);
+		auparse_destroy(au);
+
+		r = auparse_columnar_open("./test.col",
+				AUCOL_MASK(AUCOL_TIME)|AUCOL_MASK(AUCOL_TYPE)|
+				AUCOL_MASK(AUCOL_AUID)|AUCOL_MASK(AUCOL_EXE));
+		if (r == NULL) {
+			printf("Error - %s\n", strerror(errno));
+			return 1;
+		}
+		while ((rows = auparse_columnar_next_chunk(r)) > 0) {
+			for (i = 0; i < rows; i++) {
+				au_event_t e;
+				const char *auid, *exe;
+
+				auparse_columnar_get_event(r, i, &e);
+				auid = auparse_columnar_get_str(r,
+							AUCOL_AUID, i);
+				exe = auparse_columnar_get_str(r,
+							AUCOL_EXE, i);
+				printf("row %d: %u.%u:%lu type=%d auid=%s "
+					"exe=%s\n", i, (unsigned)e.sec,
+					e.milli, e.serial,
+					auparse_columnar_get_type(r, i),
+					auid ? auid : "-", exe ? exe : "-");
+			}
+		}
+		if (rows < 0)
+			printf("Error reading ./test.col\n");
+		auparse_columnar_free(r);
+		unlink("./test.col");
+	}
+	printf("Test 11 Done\n\n");
+
 	puts("Finished non-admin tests\n");
 
 	return 0;
@@ -298,11 +298,12 @@ AuParser_init(AuParser *self, PyObject *args, PyObject *kwds)
             return -1;
         }
     } break;
-    case AUSOURCE_FILE: {
+    case AUSOURCE_FILE:
+    case AUSOURCE_COLUMNAR: {
         char *filename = NULL;
 
         if (!PyString_Check(source)) {
-            PyErr_SetString(PyExc_ValueError, "source must be a string when source_type is AUSOURCE_FILE");
+            PyErr_SetString(PyExc_ValueError, "source must be a string when source_type is AUSOURCE_FILE or AUSOURCE_COLUMNAR");
             return -1;
         }
         if ((filename = PyString_AsString(source)) == NULL) return -1;
@@ -1476,6 +1477,7 @@ AUSOURCE_BUFFER_ARRAY: list or tuple of strings each containing audit data to pa
 AUSOURCE_DESCRIPTOR:   integer file descriptor (e.g. fileno)\n\
 AUSOURCE_FILE_POINTER: file object (e.g. types.FileType)\n\
 AUSOURCE_FEED:         None (data supplied via feed()\n\
+AUSOURCE_COLUMNAR:     string containing path of a columnar file\n\
 ");
 
 static PyTypeObject AuParserType = {
@@ -1571,6 +1573,7 @@ initauparse(void)
     PyModule_AddIntConstant(m, "AUSOURCE_DESCRIPTOR",    AUSOURCE_DESCRIPTOR);
     PyModule_AddIntConstant(m, "AUSOURCE_FILE_POINTER",  AUSOURCE_FILE_POINTER);
     PyModule_AddIntConstant(m, "AUSOURCE_FEED",          AUSOURCE_FEED);
+    PyModule_AddIntConstant(m, "AUSOURCE_COLUMNAR",      AUSOURCE_COLUMNAR);
 
     /* ausearch_op_t */
     PyModule_AddIntConstant(m, "AUSEARCH_UNSET",         AUSEARCH_UNSET);
@@ -26,6 +26,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
 #include <errno.h>
 #include <netinet/in.h> // inet6 addrlen
 #include <netdb.h>	// gethostbyname
@@ -37,6 +39,7 @@
 #include "private.h"
 
 #define TTY_PATH	32
+#define COMM_LEN	32
 #define MAX_USER	(UT_NAMESIZE * 2) + 8
 
 // NOTE: The kernel fills in pid, uid, and loginuid of sender. Therefore,
@@ -222,6 +225,105 @@ static const char *_get_tty(char *tname, int size)
 	return tname;
 }
 
+/*
+ * This function makes the text of a user message. commname is NULL for
+ * messages without a comm field. It returns 0, or -EINVAL with errno set
+ * if the text doesn't fit, which would be too long to send anyway.
+ */
+static int _format_user(char *buf, size_t size, const char *message,
+	const char *commname, const char *exename, const char *hostname,
+	const char *addr, const char *tty, int result)
+{
+	const char *success;
+	int n;
+
+	if (result)
+		success = "success";
+	else
+		success = "failed";
+
+	if (commname)
+		n = snprintf(buf, size,
+		"%s comm=%s exe=%s hostname=%s addr=%s terminal=%s res=%s",
+			message, commname, exename,
+			hostname ? hostname : "?",
+			addr,
+			tty ? tty : "?",
+			success
+			);
+	else
+		n = snprintf(buf, size,
+			"%s exe=%s hostname=%s addr=%s terminal=%s res=%s",
+			message, exename,
+			hostname ? hostname : "?",
+			addr,
+			tty ? tty : "?",
+			success
+			);
+	if (n < 0 || (size_t)n >= size) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * This function makes the text of an account message. The account is
+ * given by name, or by id if name is NULL or id is not -1. It returns
+ * what _format_user does.
+ */
+static int _format_acct(char *buf, size_t size, const char *op,
+	const char *name, unsigned int id, const char *exename,
+	const char *host, const char *addr, const char *tty, int result)
+{
+	const char *success;
+	int n;
+
+	if (result)
+		success = "success";
+	else
+		success = "failed";
+
+	if (name && id == -1) {
+		char user[MAX_USER];
+		const char *format;
+		size_t len;
+
+		user[0] = 0;
+		strncat(user, name, MAX_USER-1);
+		len = strnlen(user, UT_NAMESIZE);
+		user[len] = 0;
+		if (audit_value_needs_encoding(name, len)) {
+			audit_encode_value(user, name, len);
+			format = 
+	     "op=%s acct=%s exe=%s hostname=%s addr=%s terminal=%s res=%s";
+		} else
+			format = 
+	 "op=%s acct=\"%s\" exe=%s hostname=%s addr=%s terminal=%s res=%s";
+
+		n = snprintf(buf, size, format,
+			op, user, exename,
+			host ? host : "?",
+			addr,
+			tty ? tty : "?",
+			success
+			);
+	} else
+		n = snprintf(buf, size,
+		"op=%s id=%u exe=%s hostname=%s addr=%s terminal=%s res=%s",
+			op, id, exename,
+			host ? host : "?",
+			addr,
+			tty ? tty : "?",
+			success
+			);
+	if (n < 0 || (size_t)n >= size) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	return 0;
+}
+
 /*
  * This function will log a message to the audit system using a predefined
  * message format. This function should be used by all console apps that do
@@ -244,17 +346,11 @@ int audit_log_user_message(int audit_fd, int type, const char *message,
 	char addrbuf[INET6_ADDRSTRLEN];
 	static char exename[PATH_MAX*2]="";
 	char ttyname[TTY_PATH];
-	const char *success;
 	int ret;
 
 	if (audit_fd < 0)
 		return 0;
 
-	if (result)
-		success = "success";
-	else
-		success = "failed";
-
 	/* If hostname is empty string, make it NULL ptr */
 	if (hostname && *hostname == 0)
 		hostname = NULL;
@@ -271,14 +367,9 @@ int audit_log_user_message(int audit_fd, int type, const char *message,
 	else if (*tty == 0)
 		tty = NULL;
 
-	snprintf(buf, sizeof(buf),
-		"%s exe=%s hostname=%s addr=%s terminal=%s res=%s",
-		message, exename,
-		hostname ? hostname : "?",
-		addrbuf,
-		tty ? tty : "?",
-		success
-		);
+	if ((ret = _format_user(buf, sizeof(buf), message, NULL, exename,
+			hostname, addrbuf, tty, result)))
+		return ret;
 
 	errno = 0;
 	ret = audit_send_user_message( audit_fd, type, HIDE_IT, buf );
@@ -313,17 +404,11 @@ int audit_log_user_comm_message(int audit_fd, int type, const char *message,
 	static char exename[PATH_MAX*2]="";
 	char commname[PATH_MAX*2];
 	char ttyname[TTY_PATH];
-	const char *success;
 	int ret;
 
 	if (audit_fd < 0)
 		return 0;
 
-	if (result)
-		success = "success";
-	else
-		success = "failed";
-
 	/* If hostname is empty string, make it NULL ptr */
 	if (hostname && *hostname == 0)
 		hostname = NULL;
@@ -341,14 +426,9 @@ int audit_log_user_comm_message(int audit_fd, int type, const char *message,
 
 	_get_commname(comm, commname, sizeof(commname));
 
-	snprintf(buf, sizeof(buf),
-		"%s comm=%s exe=%s hostname=%s addr=%s terminal=%s res=%s",
-		message, commname, exename,
-		hostname ? hostname : "?",
-		addrbuf,
-		tty ? tty : "?",
-		success
-		);
+	if ((ret = _format_user(buf, sizeof(buf), message, commname,
+			exename, hostname, addrbuf, tty, result)))
+		return ret;
 
 	errno = 0;
 	ret = audit_send_user_message( audit_fd, type, HIDE_IT, buf );
@@ -382,7 +462,6 @@ int audit_log_acct_message(int audit_fd, int type, const char *pgname,
 	const char *op, const char *name, unsigned int id, 
 	const char *host, const char *addr, const char *tty, int result)
 {
-	const char *success;
 	char buf[MAX_AUDIT_MESSAGE_LENGTH];
 	char addrbuf[INET6_ADDRSTRLEN];
 	static char exename[PATH_MAX*2] = "";
@@ -392,11 +471,6 @@ int audit_log_acct_message(int audit_fd, int type, const char *pgname,
 	if (audit_fd < 0)
 		return 0;
 
-	if (result)
-		success = "success";
-	else
-		success = "failed";
-
 	/* If hostname is empty string, make it NULL ptr */
 	if (host && *host == 0)
 		host = NULL;
@@ -419,39 +493,9 @@ int audit_log_acct_message(int audit_fd, int type, const char *pgname,
 	else if (*tty == 0)
 		tty = NULL;
 
-	if (name && id == -1) {
-		char user[MAX_USER];
-		const char *format;
-		size_t len;
-
-		user[0] = 0;
-		strncat(user, name, MAX_USER-1);
-		len = strnlen(user, UT_NAMESIZE);
-		user[len] = 0;
-		if (audit_value_needs_encoding(name, len)) {
-			audit_encode_value(user, name, len);
-			format = 
-	     "op=%s acct=%s exe=%s hostname=%s addr=%s terminal=%s res=%s";
-		} else
-			format = 
-	 "op=%s acct=\"%s\" exe=%s hostname=%s addr=%s terminal=%s res=%s";
-
-		snprintf(buf, sizeof(buf), format,
-			op, user, exename,
-			host ? host : "?",
-			addrbuf,
-			tty ? tty : "?",
-			success
-			);
-	} else
-		snprintf(buf, sizeof(buf),
-		"op=%s id=%u exe=%s hostname=%s addr=%s terminal=%s res=%s",
-			op, id, exename,
-			host ? host : "?",
-			addrbuf,
-			tty ? tty : "?",
-			success
-			);
+	if ((ret = _format_acct(buf, sizeof(buf), op, name, id, exename,
+			host, addrbuf, tty, result)))
+		return ret;
 
 	errno = 0;
 	ret = audit_send_user_message(audit_fd, type, REAL_ERR, buf);
@@ -744,3 +788,536 @@ int audit_log_user_command(int audit_fd, int type, const char *command,
 	return ret;
 }
 
+
+/*
+ * The logging context lets a busy program send the messages above
+ * without waiting on the kernel for each one. The exe, comm, and tty
+ * are looked up once per process, hostnames go through a small cache
+ * or are not resolved at all, and messages are queued and sent several
+ * at a time in one datagram. Acks are read as they come in and each
+ * message's outcome is handed to the callback.
+ */
+
+#define CTX_BATCH	8		// Messages sent in one datagram
+#define CTX_WINDOW	(CTX_BATCH*2)	// Messages queued or waiting for acks
+#define CTX_BUF		16384		// Room for a batch of messages
+#define CTX_HOSTS	16		// Hostnames kept
+#define CTX_HOST_TTL	60		// Seconds before looking one up again
+
+/* Where a message is */
+#define ENTRY_DONE	0
+#define ENTRY_QUEUED	1
+#define ENTRY_SENT	2
+
+struct log_entry {
+	int state;
+	int id;		// Sequence number given to the caller
+	int seq;	// Sequence number of the request in flight
+	int type;
+	hide_t hide;
+	int retried;
+	char *message;
+};
+
+struct host_entry {
+	char *host;
+	char addr[INET6_ADDRSTRLEN];
+	time_t when;
+};
+
+struct audit_log_ctx {
+	int fd;
+	pid_t pid;
+	int flags;
+	audit_log_callback_t callback;
+	void *data;
+
+	char exename[PATH_MAX*2];
+	char commname[PATH_MAX*2];
+	char ttyname[TTY_PATH];
+	const char *tty;
+	struct host_entry hosts[CTX_HOSTS];
+
+	struct log_entry entries[CTX_WINDOW];
+	int head;	// Oldest entry
+	int count;	// Entries from head, some may be done
+	int queued;	// Entries in buf
+	int in_flight;	// Entries waiting for an ack
+	union {
+		struct nlmsghdr nlh;
+		char data[CTX_BUF];
+	} buf;
+	unsigned int len;
+};
+
+/* Looks up the exe, comm, and tty of the process */
+static void ctx_identity(audit_log_ctx *ctx)
+{
+	char comm[COMM_LEN];
+	ssize_t len = -1;
+	int fd;
+
+	ctx->pid = getpid();
+	_get_exename(ctx->exename, sizeof(ctx->exename));
+	ctx->tty = _get_tty(ctx->ttyname, TTY_PATH);
+
+	fd = open("/proc/self/comm", O_RDONLY|O_CLOEXEC);
+	if (fd >= 0) {
+		len = read(fd, comm, sizeof(comm) - 1);
+		close(fd);
+	}
+	if (len > 0) {
+		comm[len] = 0;
+		if (comm[len-1] == '\n')
+			comm[len-1] = 0;
+		_get_commname(comm, ctx->commname, sizeof(ctx->commname));
+	} else
+		_get_commname(NULL, ctx->commname, sizeof(ctx->commname));
+}
+
+audit_log_ctx *audit_log_ctx_new(int flags, audit_log_callback_t callback,
+	void *data)
+{
+	audit_log_ctx *ctx;
+
+	ctx = calloc(1, sizeof(audit_log_ctx));
+	if (ctx == NULL)
+		return NULL;
+	ctx->fd = audit_open();
+	if (ctx->fd < 0) {
+		int saved_errno = errno;
+		free(ctx);
+		errno = saved_errno;
+		return NULL;
+	}
+	ctx->flags = flags;
+	ctx->callback = callback;
+	ctx->data = data;
+	ctx_identity(ctx);
+	return ctx;
+}
+
+int audit_log_ctx_fd(const audit_log_ctx *ctx)
+{
+	if (ctx == NULL)
+		return -1;
+	return ctx->fd;
+}
+
+/* Drops the entries and hostnames without telling the callback */
+static void ctx_clear(audit_log_ctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < CTX_WINDOW; i++) {
+		free(ctx->entries[i].message);
+		ctx->entries[i].message = NULL;
+		ctx->entries[i].state = ENTRY_DONE;
+	}
+	for (i = 0; i < CTX_HOSTS; i++) {
+		free(ctx->hosts[i].host);
+		ctx->hosts[i].host = NULL;
+	}
+	ctx->head = ctx->count = ctx->queued = ctx->in_flight = 0;
+	ctx->len = 0;
+}
+
+/*
+ * A forked child shares the parent's socket, so acks could go to either.
+ * The child gets its own socket and identity and leaves the messages
+ * to the parent. Returns 0 on success and -errno on error.
+ */
+static int ctx_check_pid(audit_log_ctx *ctx)
+{
+	if (ctx->pid == getpid() && ctx->fd >= 0)
+		return 0;
+	ctx_clear(ctx);
+	audit_close(ctx->fd);
+	ctx->fd = audit_open();
+	ctx_identity(ctx);
+	if (ctx->fd < 0)
+		return -errno;
+	return 0;
+}
+
+/*
+ * Gives the address of host, looking it up if it isn't cached or is old.
+ * Failed lookups are cached as well since they tend to be the slow ones.
+ */
+static const char *ctx_resolve(audit_log_ctx *ctx, const char *host)
+{
+	struct host_entry *h, *same = NULL, *oldest = NULL;
+	time_t now = time(NULL);
+	int i;
+
+	if (host == NULL || (ctx->flags & AUDIT_LOG_NORESOLVE))
+		return "?";
+
+	for (i = 0; i < CTX_HOSTS; i++) {
+		h = &ctx->hosts[i];
+		if (h->host == NULL) {
+			if (oldest == NULL || oldest->host)
+				oldest = h;
+			continue;
+		}
+		if (strcmp(h->host, host) == 0) {
+			if (now >= h->when && now - h->when < CTX_HOST_TTL)
+				return h->addr;
+			same = h;
+		}
+		if (oldest == NULL || (oldest->host && h->when < oldest->when))
+			oldest = h;
+	}
+
+	/* Look it up again in place, or take over an entry */
+	h = same ? same : oldest;
+	if (h != same) {
+		free(h->host);
+		h->host = strdup(host);
+	}
+	_resolve_addr(h->addr, host);
+	h->when = now;
+	return h->addr;
+}
+
+/* The kernel's answer mapped the way audit_send_user_message does */
+static int delivery_error(const struct log_entry *e, int error)
+{
+	/* No one is listening, or we are a common user that can't write
+	 * to the socket. Act as though auditing is not enabled. */
+	if (error == -ECONNREFUSED)
+		return 0;
+	if (error == -EPERM && getuid() != 0 && e->hide == HIDE_IT)
+		return 0;
+	return error;
+}
+
+/* Tells the callback what happened to a message and retires it */
+static void ctx_complete(audit_log_ctx *ctx, struct log_entry *e, int error)
+{
+	if (e->state == ENTRY_SENT)
+		ctx->in_flight--;
+	e->state = ENTRY_DONE;
+	if (ctx->callback)
+		ctx->callback(e->id, e->type, e->message,
+			delivery_error(e, error), ctx->data);
+	free(e->message);
+	e->message = NULL;
+
+	while (ctx->count && ctx->entries[ctx->head].state == ENTRY_DONE) {
+		ctx->head = (ctx->head + 1) % CTX_WINDOW;
+		ctx->count--;
+	}
+}
+
+/* Fails every message in the given state, oldest first */
+static void ctx_fail(audit_log_ctx *ctx, int state, int error)
+{
+	int i, start = ctx->head, count = ctx->count;
+
+	for (i = 0; i < count; i++) {
+		struct log_entry *e = &ctx->entries[(start + i) % CTX_WINDOW];
+
+		if (e->state == state)
+			ctx_complete(ctx, e, error);
+	}
+}
+
+/* Sends the queued messages. Returns 0 on success and -errno on error. */
+static int ctx_send(audit_log_ctx *ctx)
+{
+	int i, rc;
+
+	if (ctx->queued == 0)
+		return 0;
+	rc = audit_send_queued(ctx->fd, &ctx->buf, ctx->len);
+	ctx->len = 0;
+	if (rc < 0) {
+		ctx_fail(ctx, ENTRY_QUEUED, rc);
+		ctx->queued = 0;
+		return rc;
+	}
+	for (i = 0; i < CTX_WINDOW; i++) {
+		if (ctx->entries[i].state == ENTRY_QUEUED) {
+			ctx->entries[i].state = ENTRY_SENT;
+			ctx->in_flight++;
+		}
+	}
+	ctx->queued = 0;
+	return 0;
+}
+
+/* Handles the ack for a message */
+static void ctx_ack(audit_log_ctx *ctx, int seq, int error)
+{
+	struct log_entry *e = NULL;
+	int i, rc;
+
+	for (i = 0; i < ctx->count; i++) {
+		struct log_entry *t =
+			&ctx->entries[(ctx->head + i) % CTX_WINDOW];
+
+		if (t->state == ENTRY_SENT && t->seq == seq) {
+			e = t;
+			break;
+		}
+	}
+	if (e == NULL)
+		return;
+
+	/* An old kernel doesn't know the message type, use the old one */
+	if (error == -EINVAL && e->type >= AUDIT_FIRST_USER_MSG &&
+			e->type <= AUDIT_LAST_USER_MSG && !e->retried) {
+		e->retried = 1;
+		rc = audit_send_nowait(ctx->fd, AUDIT_USER, e->message,
+			strlen(e->message)+1);
+		if (rc > 0) {
+			e->seq = rc;
+			return;
+		}
+		error = rc ? rc : -EIO;
+	}
+	ctx_complete(ctx, e, error);
+}
+
+/*
+ * Reads acks until no more than want messages are waiting for one. Acks
+ * that have already come in are read as well.
+ */
+static void ctx_read_acks(audit_log_ctx *ctx, int want)
+{
+	int rc, seq, error;
+	reply_t block;
+
+	while (ctx->in_flight) {
+		block = ctx->in_flight > want ? GET_REPLY_BLOCKING :
+						GET_REPLY_NONBLOCKING;
+		rc = audit_get_ack(ctx->fd, &seq, &error, block);
+		if (rc == -EAGAIN && block == GET_REPLY_NONBLOCKING)
+			break;
+		if (rc < 0) {
+			/* The acks are lost, nothing more is coming */
+			ctx_fail(ctx, ENTRY_SENT, rc);
+			break;
+		}
+		ctx_ack(ctx, seq, error);
+	}
+}
+
+/*
+ * Queues a message, sending the batch once it is full. Returns the
+ * sequence number given to the message, or -errno on error.
+ */
+static int ctx_queue(audit_log_ctx *ctx, int type, hide_t hide,
+	const char *message)
+{
+	struct log_entry *e;
+	unsigned int size = strlen(message) + 1;
+	int seq;
+
+	if (NLMSG_SPACE(size) > MAX_AUDIT_MESSAGE_LENGTH) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	if (ctx->len + NLMSG_SPACE(size) > CTX_BUF)
+		ctx_send(ctx);
+	while (ctx->count == CTX_WINDOW && ctx->in_flight)
+		ctx_read_acks(ctx, ctx->in_flight - 1);
+
+	e = &ctx->entries[(ctx->head + ctx->count) % CTX_WINDOW];
+	e->message = strdup(message);
+	if (e->message == NULL) {
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+	seq = audit_queue_request(&ctx->buf, &ctx->len, CTX_BUF, type,
+		message, size);
+	if (seq <= 0) {
+		free(e->message);
+		e->message = NULL;
+		errno = -seq;
+		return seq;
+	}
+	e->state = ENTRY_QUEUED;
+	e->id = e->seq = seq;
+	e->type = type;
+	e->hide = hide;
+	e->retried = 0;
+	ctx->count++;
+	ctx->queued++;
+
+	if (ctx->queued == CTX_BATCH)
+		ctx_send(ctx);
+	ctx_read_acks(ctx, CTX_WINDOW);
+	return seq;
+}
+
+/* Fills in the address and tty the way the functions above do */
+static const char *ctx_addr(audit_log_ctx *ctx, const char *host,
+	const char *addr, char addrbuf[])
+{
+	addrbuf[0] = 0;
+	if (addr == NULL || strlen(addr) == 0)
+		return ctx_resolve(ctx, host);
+	strncat(addrbuf, addr, INET6_ADDRSTRLEN-1);
+	return addrbuf;
+}
+
+static const char *ctx_tty(audit_log_ctx *ctx, const char *tty)
+{
+	if (tty == NULL)
+		return ctx->tty;
+	if (*tty == 0)
+		return NULL;
+	return tty;
+}
+
+/*
+ * This function queues a message in the format of audit_log_user_message.
+ * It returns the sequence number which is > 0 on success or <= 0 on error.
+ * The outcome of sending it is given to the context's callback.
+ */
+int audit_log_ctx_user_message(audit_log_ctx *ctx, int type,
+	const char *message, const char *hostname, const char *addr,
+	const char *tty, int result)
+{
+	char buf[MAX_AUDIT_MESSAGE_LENGTH];
+	char addrbuf[INET6_ADDRSTRLEN];
+	const char *address;
+	int rc;
+
+	if (ctx == NULL)
+		return 0;
+	if ((rc = ctx_check_pid(ctx)))
+		return rc;
+
+	/* If hostname is empty string, make it NULL ptr */
+	if (hostname && *hostname == 0)
+		hostname = NULL;
+	address = ctx_addr(ctx, hostname, addr, addrbuf);
+	if ((rc = _format_user(buf, sizeof(buf), message, NULL,
+			ctx->exename, hostname, address, ctx_tty(ctx, tty),
+			result)))
+		return rc;
+
+	return ctx_queue(ctx, type, HIDE_IT, buf);
+}
+
+/*
+ * This function queues a message in the format of
+ * audit_log_user_comm_message. If comm is NULL, the process's comm is
+ * used. It returns the sequence number which is > 0 on success or <= 0
+ * on error.
+ */
+int audit_log_ctx_user_comm_message(audit_log_ctx *ctx, int type,
+	const char *message, const char *comm, const char *hostname,
+	const char *addr, const char *tty, int result)
+{
+	char buf[MAX_AUDIT_MESSAGE_LENGTH];
+	char addrbuf[INET6_ADDRSTRLEN];
+	char commname[PATH_MAX*2];
+	const char *address;
+	int rc;
+
+	if (ctx == NULL)
+		return 0;
+	if ((rc = ctx_check_pid(ctx)))
+		return rc;
+
+	/* If hostname is empty string, make it NULL ptr */
+	if (hostname && *hostname == 0)
+		hostname = NULL;
+	address = ctx_addr(ctx, hostname, addr, addrbuf);
+	if (comm)
+		_get_commname(comm, commname, sizeof(commname));
+	if ((rc = _format_user(buf, sizeof(buf), message,
+			comm ? commname : ctx->commname, ctx->exename,
+			hostname, address, ctx_tty(ctx, tty), result)))
+		return rc;
+
+	return ctx_queue(ctx, type, HIDE_IT, buf);
+}
+
+/*
+ * This function queues a message in the format of audit_log_acct_message.
+ * It returns the sequence number which is > 0 on success or <= 0 on error.
+ */
+int audit_log_ctx_acct_message(audit_log_ctx *ctx, int type,
+	const char *pgname, const char *op, const char *name, unsigned int id,
+	const char *host, const char *addr, const char *tty, int result)
+{
+	char buf[MAX_AUDIT_MESSAGE_LENGTH];
+	char addrbuf[INET6_ADDRSTRLEN];
+	char exename[PATH_MAX*2];
+	const char *address, *exe = exename;
+	int rc;
+
+	if (ctx == NULL)
+		return 0;
+	if ((rc = ctx_check_pid(ctx)))
+		return rc;
+
+	/* If hostname is empty string, make it NULL ptr */
+	if (host && *host == 0)
+		host = NULL;
+	address = ctx_addr(ctx, host, addr, addrbuf);
+	if (pgname == NULL)
+		exe = ctx->exename;
+	else if (pgname[0] != '"')
+		snprintf(exename, sizeof(exename), "\"%s\"", pgname);
+	else
+		snprintf(exename, sizeof(exename), "%s", pgname);
+	if ((rc = _format_acct(buf, sizeof(buf), op, name, id, exe, host,
+			address, ctx_tty(ctx, tty), result)))
+		return rc;
+
+	return ctx_queue(ctx, type, REAL_ERR, buf);
+}
+
+/*
+ * This function sends the queued messages and handles the acks that
+ * have come in without waiting for the rest. It returns how many
+ * messages are still waiting for an ack, or -errno on error.
+ */
+int audit_log_ctx_process(audit_log_ctx *ctx)
+{
+	int rc;
+
+	if (ctx == NULL)
+		return 0;
+	if ((rc = ctx_check_pid(ctx)))
+		return rc;
+	rc = ctx_send(ctx);
+	ctx_read_acks(ctx, CTX_WINDOW);
+	if (rc < 0)
+		return rc;
+	return ctx->in_flight;
+}
+
+/*
+ * This function sends the queued messages and waits for all acks. It
+ * returns 0 on success or -errno if any could not be sent.
+ */
+int audit_log_ctx_flush(audit_log_ctx *ctx)
+{
+	int rc;
+
+	if (ctx == NULL)
+		return 0;
+	if ((rc = ctx_check_pid(ctx)))
+		return rc;
+	rc = ctx_send(ctx);
+	ctx_read_acks(ctx, 0);
+	return rc;
+}
+
+void audit_log_ctx_free(audit_log_ctx *ctx)
+{
+	if (ctx == NULL)
+		return;
+	if (ctx->pid == getpid())
+		audit_log_ctx_flush(ctx);
+	ctx_clear(ctx);
+	audit_close(ctx->fd);
+	free(ctx);
+}
@@ -0,0 +1,88 @@
+/* disp-ring.h -- shared memory transport between auditd and its dispatcher
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *	Steve Grubb <sgrubb@redhat.com>
+ */
+#ifndef _DISP_RING_H_
+#define _DISP_RING_H_
+
+#include <stdint.h>
+#include "libaudit.h"
+
+/*
+ * When disp_ring_size is set, auditd copies each event straight into a
+ * single producer/single consumer ring in shared memory instead of
+ * writing it to the dispatcher's stdin. The dispatcher is started with
+ * the --ring option and finds the ring and its wakeup descriptors at
+ * fixed descriptor numbers. Its stdin is still connected to auditd so
+ * that either side notices when the other goes away.
+ *
+ * Each record is a struct audit_dispatcher_header followed by hdr.size
+ * bytes of payload, padded to DISP_RING_ALIGN. Records never wrap. If a
+ * record doesn't fit in front of the end of the data area, the producer
+ * skips to the start, leaving a DISP_RING_PAD header behind when there
+ * is room for one.
+ */
+#define DISP_RING_FD		3	/* memfd holding the ring */
+#define DISP_RING_DATA_FD	4	/* eventfd, auditd -> dispatcher */
+#define DISP_RING_SPACE_FD	5	/* eventfd, dispatcher -> auditd */
+
+#define DISP_RING_MAGIC		0x41554452	/* "AUDR" */
+#define DISP_RING_VERSION	1
+#define DISP_RING_ALIGN		8
+#define DISP_RING_PAD		0xFFFFFFFF	/* hdr.type of a skip marker */
+#define DISP_RING_MIN_KB	64
+#define DISP_RING_MAX_KB	65536
+
+#define DISP_RING_REC_LEN(size) \
+	((sizeof(struct audit_dispatcher_header) + (size) + \
+	 DISP_RING_ALIGN - 1) & ~(DISP_RING_ALIGN - 1))
+
+struct disp_ring
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		/* Bytes in the data area, a power of 2 */
+	uint32_t data_offset;	/* Start of the data area in the mapping */
+
+	/* Only written by auditd */
+	volatile uint64_t head __attribute__ ((aligned (64)));
+	uint64_t high_water;	/* Most bytes ever in use */
+	uint64_t waits;		/* Times auditd found the ring full */
+	uint64_t lost;		/* Events auditd had to give up on */
+	volatile uint32_t producer_waiting;
+
+	/* Only written by the dispatcher, except for clearing the flag */
+	volatile uint64_t tail __attribute__ ((aligned (64)));
+	volatile uint32_t consumer_sleeping;
+};
+
+static inline char *disp_ring_data(struct disp_ring *r)
+{
+	return (char *)r + r->data_offset;
+}
+
+/* Total bytes to map for a data area of size bytes */
+static inline size_t disp_ring_map_size(uint32_t size)
+{
+	return ((sizeof(struct disp_ring) + 4095) & ~4095UL) + size;
+}
+
+#endif
+
@@ -64,6 +64,11 @@
    no more memory and is faster. */
 #define DIRECT_THRESHOLD 2
 
+/* The ratio of hash table slots to strings for --s2i-hash, rounded up to a
+   power of 2.  With the table at most half full a lookup seldom compares
+   more than one string. */
+#define HASH_RATIO 2
+
 /* Allow more than one string defined for a single integer value */
 static bool allow_duplicate_ints; /* = false; */
 
@@ -160,14 +165,48 @@ output_strings(const char *prefix)
 	fputs("\";\n", stdout);
 }
 
+/* Output a hash table indexing the s2i tables, return its size.
+   values must be sorted by strings. */
+static size_t
+output_s2i_hash(const char *prefix)
+{
+	unsigned *slots;
+	size_t i, size;
+
+	size = 1;
+	while (size < NUM_VALUES * HASH_RATIO)
+		size *= 2;
+	slots = calloc(size, sizeof(*slots));
+	assert(slots != NULL);
+	for (i = 0; i < NUM_VALUES; i++) {
+		size_t slot;
+
+		slot = gt_hash__(values[i].s) & (size - 1);
+		while (slots[slot] != 0)
+			slot = (slot + 1) & (size - 1);
+		slots[slot] = i + 1;
+	}
+	printf("static const unsigned %s_s2i_h[] = {", prefix);
+	for (i = 0; i < size; i++) {
+		if (i % 10 == 0)
+			fputs("\n\t", stdout);
+		printf("%u,", slots[i]);
+	}
+	fputs("\n"
+	      "};\n", stdout);
+	free(slots);
+	return size;
+}
+
 /* Output the string to integer mapping code.
    Assume strings are all uppsercase or all lowercase if specified by
    parameters; in that case, make the search case-insensitive.
+   If hash, look the strings up in a hash table instead of a binary search.
    values must be sorted by strings. */
 static void
-output_s2i(const char *prefix, bool uppercase, bool lowercase)
+output_s2i(const char *prefix, bool uppercase, bool lowercase, bool hash)
 {
-	size_t i;
+	size_t i, hash_size;
 
 	for (i = 0; i < NUM_VALUES - 1; i++) {
 		assert(strcmp(values[i].s, values[i + 1].s) <= 0);
@@ -194,6 +233,7 @@ output_s2i(const char *prefix, bool uppercase, bool lowercase)
 	}
 	fputs("\n"
 	      "};\n", stdout);
+	hash_size = hash ? output_s2i_hash(prefix) : 0;
 	assert(!(uppercase && lowercase));
 	if (uppercase) {
 		for (i = 0; i < NUM_VALUES; i++) {
@@ -225,13 +265,26 @@ output_s2i(const char *prefix, bool uppercase, bool lowercase)
 		else
 			fputs("\t\tcopy[i] = GT_ISUPPER(c) ? c - 'A' + 'a' "
 							  ": c;\n", stdout);
-		printf("\t}\n"
-		       "\tcopy[i] = 0;\n"
-		       "\treturn s2i__(%s_strings, %s_s2i_s, %s_s2i_i, %zu, "
-				      "copy, value);\n"
-		       "\t}\n"
-		       "}\n", prefix, prefix, prefix, NUM_VALUES);
-	} else
+		fputs("\t}\n"
+		      "\tcopy[i] = 0;\n", stdout);
+		if (hash)
+			printf("\treturn s2i_hash__(%s_strings, %s_s2i_s, "
+					"%s_s2i_i, %s_s2i_h, %zu, copy, "
+					"gt_hash__(copy), value);\n",
+			       prefix, prefix, prefix, prefix, hash_size);
+		else
+			printf("\treturn s2i__(%s_strings, %s_s2i_s, "
+					"%s_s2i_i, %zu, copy, value);\n",
+			       prefix, prefix, prefix, NUM_VALUES);
+		fputs("\t}\n"
+		      "}\n", stdout);
+	} else if (hash)
+		printf("static int %s_s2i(const char *s, int *value) {\n"
+		       "\treturn s2i_hash__(%s_strings, %s_s2i_s, %s_s2i_i, "
+				      "%s_s2i_h, %zu, s, gt_hash__(s), value);\n"
+		       "}\n", prefix, prefix, prefix, prefix, prefix,
+		       hash_size);
+	else
 		printf("static int %s_s2i(const char *s, int *value) {\n"
 		       "\treturn s2i__(%s_strings, %s_s2i_s, %s_s2i_i, %zu, s, "
 				      "value);\n"
@@ -353,7 +406,8 @@ output_i2s_transtab(const char *prefix)
 int
 main(int argc, char **argv)
 {
-	bool gen_i2s, gen_i2s_transtab, gen_s2i, uppercase, lowercase;
+	bool gen_i2s, gen_i2s_transtab, gen_s2i, gen_s2i_hash, uppercase;
+	bool lowercase;
 	char *prefix;
 	size_t i;
 
@@ -365,6 +419,7 @@ main(int argc, char **argv)
 	gen_i2s = false;
 	gen_i2s_transtab = false;
 	gen_s2i = false;
+	gen_s2i_hash = false;
 	uppercase = false;
 	lowercase = false;
 	prefix = NULL;
@@ -376,6 +431,8 @@ main(int argc, char **argv)
 			gen_i2s_transtab = true;
 		else if (strcmp(argv[i], "--s2i") == 0)
 			gen_s2i = true;
+		else if (strcmp(argv[i], "--s2i-hash") == 0)
+			gen_s2i = gen_s2i_hash = true;
 		else if (strcmp(argv[i], "--uppercase") == 0)
 			uppercase = true;
 		else if (strcmp(argv[i], "--lowercase") == 0)
@@ -403,7 +460,7 @@ main(int argc, char **argv)
 	   in the original order to use the cache better. */
 	output_strings(prefix);
 	if (gen_s2i)
-		output_s2i(prefix, uppercase, lowercase);
+		output_s2i(prefix, uppercase, lowercase, gen_s2i_hash);
 	if (gen_i2s) {
 		qsort(values, NUM_VALUES, sizeof(*values), cmp_value_vals);
 		output_i2s(prefix);
@@ -55,6 +55,37 @@ inline static int s2i__(const char *strings, const unsigned *s_table,
 	return 0;
 }
 
+/* Hash of a table string, used by the s2i hash tables. */
+inline static unsigned gt_hash__(const char *s)
+{
+	unsigned h = 2166136261U;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619U;
+	return h;
+}
+
+/* h_table holds h_size (a power of 2) slots of indexes into s_table and
+   i_table, plus one; 0 marks an empty slot.  h is gt_hash__(s). */
+inline static int s2i_hash__(const char *strings, const unsigned *s_table,
+			     const int *i_table, const unsigned *h_table,
+			     size_t h_size, const char *s, unsigned h,
+			     int *value)
+{
+	size_t slot;
+	unsigned idx;
+
+	slot = h & (h_size - 1);
+	while ((idx = h_table[slot]) != 0) {
+		if (strcmp(s, strings + s_table[idx - 1]) == 0) {
+			*value = i_table[idx - 1];
+			return 1;
+		}
+		slot = (slot + 1) & (h_size - 1);
+	}
+	return 0;
+}
+
 inline static const char *i2s_direct__(const char *strings,
 				       const unsigned *table, int min, int max,
 				       int v)
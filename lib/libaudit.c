@@ -350,6 +350,15 @@ int audit_set_enabled(int fd, uint32_t enabled)
 	return rc;
 }
 
+/* Keeps the enabled flag of the status reply */
+static int status_reply(struct audit_reply *rep, void *data)
+{
+	if (rep->type != AUDIT_GET)
+		return 0;
+	*(int *)data = rep->status->enabled;
+	return 1;
+}
+
 /* 
  * This function will return 0 if auditing is NOT enabled and
  * 1 if enabled, and -1 on error.
@@ -362,34 +371,11 @@ int audit_is_enabled(int fd)
 		return 0;
 
 	if ((rc = audit_request_status(fd)) > 0) {
-		struct audit_reply rep;
-		int i;
-		int timeout = 40; /* tenths of seconds */
-		struct pollfd pfd[1];
-
-		pfd[0].fd = fd;
-		pfd[0].events = POLLIN;
-
-	        for (i = 0; i < timeout; i++) {
-			do {
-				rc = poll(pfd, 1, 100);
-			} while (rc < 0 && errno == EINTR);
-
-			rc = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING,0);
-			if (rc > 0) {
-                	        /* If we get done or error, break out */
-                        	if (rep.type == NLMSG_DONE || 
-					rep.type == NLMSG_ERROR)
-	                                break;
-
-        	                /* If its not status, keep looping */
-	                        if (rep.type != AUDIT_GET)
-        	                        continue;
-
-				/* Found it... */
-				return rep.status->enabled;
-			}
-		}
+		int enabled = -1;
+
+		rc = audit_wait_replies(fd, rc, status_reply, &enabled, 4000);
+		if (rc == 0 && enabled >= 0)
+			return enabled;
 	}
 	if (rc == -ECONNREFUSED) {
 		/* This is here to let people that build their own kernel
@@ -673,6 +659,97 @@ int audit_add_rule_data(int fd, struct audit_rule_data *rule,
 	return rc;
 }
 
+/*
+ * Acks for the rules in flight queue up in the socket's receive buffer,
+ * and errors carry a copy of the rule. This many fit in the default
+ * buffer with room to spare.
+ */
+#define BATCH_WINDOW 64
+
+/*
+ * This function sends an add or delete request for many rules without
+ * waiting for the ack of each one before sending the next. The flags and
+ * action of each rule have to be set. errors[i] gets 0 if the request
+ * for rules[i] worked and -errno if not. The return value is how many
+ * failed, or -errno if the acks couldn't be read, in which case the
+ * rules without an ack get that error too.
+ */
+static int send_rules_batch(int fd, int type, struct audit_rule_data **rules,
+			int count, int *errors)
+{
+	int i, rc = 0, seq, error, sent = 0, oldest = 0, in_flight = 0;
+	int failed = 0;
+	int *seqs;
+
+	if (count <= 0)
+		return 0;
+	seqs = malloc(count * sizeof(int));
+	if (seqs == NULL) {
+		for (i = 0; i < count; i++)
+			errors[i] = -ENOMEM;
+		return -ENOMEM;
+	}
+	while (sent < count || in_flight) {
+		while (sent < count && in_flight < BATCH_WINDOW) {
+			struct audit_rule_data *rule = rules[sent];
+
+			seqs[sent] = 0;
+			if (rule->flags == AUDIT_FILTER_ENTRY) {
+				audit_msg(LOG_WARNING,
+					"Use of entry filter is deprecated");
+				errors[sent++] = -EINVAL;
+				continue;
+			}
+			rc = audit_send_nowait(fd, type, rule,
+				sizeof(struct audit_rule_data) + rule->buflen);
+			if (rc <= 0) {
+				errors[sent++] = rc ? rc : -EIO;
+				continue;
+			}
+			seqs[sent] = rc;
+			errors[sent++] = 1;	// Waiting for the ack
+			in_flight++;
+		}
+		if (in_flight == 0)
+			break;
+
+		rc = audit_get_ack(fd, &seq, &error, GET_REPLY_BLOCKING);
+		if (rc < 0) {
+			for (i = oldest; i < count; i++) {
+				if (i >= sent || errors[i] == 1)
+					errors[i] = rc;
+			}
+			break;
+		}
+		// Acks come in the order the rules were sent
+		for (i = oldest; i < sent; i++) {
+			if (errors[i] == 1 && seqs[i] == seq) {
+				errors[i] = error;
+				in_flight--;
+				break;
+			}
+		}
+		while (oldest < sent && errors[oldest] != 1)
+			oldest++;
+	}
+	free(seqs);
+	for (i = 0; i < count; i++) {
+		if (errors[i])
+			failed++;
+	}
+	if (rc < 0 && in_flight) {
+		errno = -rc;
+		return rc;
+	}
+	return failed;
+}
+
+int audit_add_rules_batch(int fd, struct audit_rule_data **rules, int count,
+			int *errors)
+{
+	return send_rules_batch(fd, AUDIT_ADD_RULE, rules, count, errors);
+}
+
 int audit_delete_rule_data(int fd, struct audit_rule_data *rule,
                            int flags, int action)
 {
@@ -698,6 +775,12 @@ int audit_delete_rule_data(int fd, struct audit_rule_data *rule,
 	return rc;
 }
 
+int audit_delete_rules_batch(int fd, struct audit_rule_data **rules,
+			int count, int *errors)
+{
+	return send_rules_batch(fd, AUDIT_DEL_RULE, rules, count, errors);
+}
+
 /*
  * This function is part of the directory auditing code
  */
@@ -1548,11 +1631,18 @@ static int audit_name_to_gid(const char *name, gid_t *gid)
 
 int audit_detect_machine(void)
 {
+	// The machine doesn't change, so only ask the kernel once
+	static int machine = -2;
 	struct utsname uts;
+
+	if (machine != -2)
+		return machine;
 	if (uname(&uts) == 0)
 //		strcpy(uts.machine, "x86_64");
-		return audit_name_to_machine(uts.machine);
-	return -1;
+		machine = audit_name_to_machine(uts.machine);
+	else
+		return -1;
+	return machine;
 }
 hidden_def(audit_detect_machine)
 
@@ -1566,15 +1656,15 @@ void audit_number_to_errmsg(int errnumber, const char *opt)
 			switch (err_msgtab[i].position)
 			{
 				case 0:
-					fprintf(stderr, "%s\n",
+					fprintf(audit_msg_stream(), "%s\n",
 						err_msgtab[i].cvalue);
 					break;
 				case 1:
-					fprintf(stderr, "%s %s\n", opt,
-						err_msgtab[i].cvalue);
+					fprintf(audit_msg_stream(), "%s %s\n",
+						opt, err_msgtab[i].cvalue);
 					break;
 				case 2:
-					fprintf(stderr, "%s %s\n",
+					fprintf(audit_msg_stream(), "%s %s\n",
 						err_msgtab[i].cvalue, opt);
 					break;
 				default:
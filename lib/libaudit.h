@@ -34,6 +34,7 @@ extern "C" {
 #include <linux/netlink.h>
 #include <linux/audit.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <syslog.h>
 
 
@@ -440,6 +441,7 @@ typedef enum {
 	MACH_ARM,
 	MACH_AARCH64
 } machine_t;
+#define AUDIT_MACHINES	(MACH_AARCH64 + 1)
 
 /* These are the valid audit failure tunable enum values */
 typedef enum {
@@ -452,6 +454,7 @@ typedef enum {
 typedef enum { MSG_STDERR, MSG_SYSLOG, MSG_QUIET } message_t;
 typedef enum { DBG_NO, DBG_YES } debug_message_t;
 void set_aumessage_mode(message_t mode, debug_message_t debug);
+void set_aumessage_stream(FILE *stream);
 
 /* General */
 typedef enum { GET_REPLY_BLOCKING=0, GET_REPLY_NONBLOCKING } reply_t;
@@ -459,6 +462,18 @@ extern int  audit_open(void);
 extern void audit_close(int fd);
 extern int  audit_get_reply(int fd, struct audit_reply *rep, reply_t block, 
 		int peek);
+/* Receives all queued replies at once and walks every message in them */
+typedef struct audit_reply_iter audit_reply_iter;
+extern audit_reply_iter *audit_reply_iter_new(void);
+extern int  audit_reply_iter_recv(int fd, audit_reply_iter *it,
+		reply_t block);
+extern int  audit_reply_iter_next(audit_reply_iter *it,
+		struct audit_reply *rep);
+extern void audit_reply_iter_free(audit_reply_iter *it);
+/* Waits for the replies to a request and gives each to the handler */
+typedef int (*audit_reply_handler_t)(struct audit_reply *rep, void *data);
+extern int  audit_wait_replies(int fd, int seq,
+		audit_reply_handler_t handler, void *data, int timeout);
 extern uid_t audit_getloginuid(void);
 extern int  audit_setloginuid(uid_t uid);
 extern int  audit_detect_machine(void);
@@ -469,6 +484,13 @@ extern int        audit_name_to_field(const char *field);
 extern const char *audit_field_to_name(int field);
 extern int        audit_name_to_syscall(const char *sc, int machine);
 extern const char *audit_syscall_to_name(int sc, int machine);
+/* Syscall lookups on every machine at once, and of whole lists */
+extern int        audit_name_to_syscall_all(const char *sc,
+			int nums[AUDIT_MACHINES]);
+extern int        audit_names_to_syscalls(const char *const *names,
+			int count, int machine, int *nums);
+extern int        audit_syscalls_to_names(const int *nums, int count,
+			int machine, const char **names);
 extern int        audit_name_to_flag(const char *flag);
 extern const char *audit_flag_to_name(int flag);
 extern int        audit_name_to_action(const char *action);
@@ -521,10 +543,14 @@ extern int audit_make_equivalent(int fd, const char *mount_point,
 /* AUDIT_ADD_RULE */
 extern int  audit_add_rule_data(int fd, struct audit_rule_data *rule,
                                 int flags, int action);
+extern int  audit_add_rules_batch(int fd, struct audit_rule_data **rules,
+				int count, int *errors);
 
 /* AUDIT_DEL_RULE */
 extern int  audit_delete_rule_data(int fd, struct audit_rule_data *rule,
                                    int flags, int action);
+extern int  audit_delete_rules_batch(int fd, struct audit_rule_data **rules,
+				int count, int *errors);
 
 /* The following are for standard formatting of messages */
 extern int audit_value_needs_encoding(const char *str, unsigned int len);
@@ -551,6 +577,31 @@ extern int audit_log_semanage_message(int audit_fd, int type,
 extern int audit_log_user_command(int audit_fd, int type, const char *command,
         const char *tty, int result);
 
+/* The following queue messages in the formats above and send them in
+ * batches without waiting for an ack for each one */
+typedef struct audit_log_ctx audit_log_ctx;
+/* Given the sequence number, type, and text of a message, and 0 if it
+ * was delivered or -errno if not */
+typedef void (*audit_log_callback_t)(int seq, int type, const char *message,
+	int error, void *data);
+#define AUDIT_LOG_NORESOLVE	0x0001	/* Don't look up hostnames */
+extern audit_log_ctx *audit_log_ctx_new(int flags,
+	audit_log_callback_t callback, void *data);
+extern int audit_log_ctx_fd(const audit_log_ctx *ctx);
+extern int audit_log_ctx_user_message(audit_log_ctx *ctx, int type,
+	const char *message, const char *hostname, const char *addr,
+	const char *tty, int result);
+extern int audit_log_ctx_user_comm_message(audit_log_ctx *ctx, int type,
+	const char *message, const char *comm, const char *hostname,
+	const char *addr, const char *tty, int result);
+extern int audit_log_ctx_acct_message(audit_log_ctx *ctx, int type,
+	const char *pgname, const char *op, const char *name,
+	unsigned int id, const char *host, const char *addr,
+	const char *tty, int result);
+extern int audit_log_ctx_process(audit_log_ctx *ctx);
+extern int audit_log_ctx_flush(audit_log_ctx *ctx);
+extern void audit_log_ctx_free(audit_log_ctx *ctx);
+
 /* Rule-building helper functions */
 extern int  audit_rule_syscall_data(struct audit_rule_data *rule, int scall);
 extern int  audit_rule_syscallbyname_data(struct audit_rule_data *rule,
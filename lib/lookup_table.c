@@ -85,6 +85,44 @@ static const struct int_transtab elftab[] = {
 };
 #define AUDIT_ELF_NAMES (sizeof(elftab)/sizeof(elftab[0]))
 
+#ifndef NO_TABLES
+/* The syscall tables of each machine, to look a name up on all of them */
+struct syscall_tab {
+	int machine;
+	const char *strings;
+	const unsigned *s_table;
+	const int *i_table;
+	const unsigned *h_table;
+	size_t h_size;
+};
+#define SYSCALL_TAB(M, P) { (M), P##_syscall_strings, P##_syscall_s2i_s, \
+	P##_syscall_s2i_i, P##_syscall_s2i_h, \
+	sizeof(P##_syscall_s2i_h)/sizeof(P##_syscall_s2i_h[0]) }
+
+static const struct syscall_tab syscall_tabs[] = {
+	SYSCALL_TAB(MACH_X86, i386),
+	SYSCALL_TAB(MACH_86_64, x86_64),
+	SYSCALL_TAB(MACH_IA64, ia64),
+	SYSCALL_TAB(MACH_PPC64, ppc),
+	SYSCALL_TAB(MACH_PPC, ppc),
+	SYSCALL_TAB(MACH_S390X, s390x),
+	SYSCALL_TAB(MACH_S390, s390),
+#ifdef WITH_ALPHA
+	SYSCALL_TAB(MACH_ALPHA, alpha),
+#endif
+#ifdef WITH_ARM
+	SYSCALL_TAB(MACH_ARM, arm),
+#endif
+#ifdef WITH_AARCH64
+	SYSCALL_TAB(MACH_AARCH64, aarch64),
+#endif
+};
+#define SYSCALL_TABS (sizeof(syscall_tabs)/sizeof(syscall_tabs[0]))
+
+/* Longer than any syscall name */
+#define SYSCALL_NAME_MAX 64
+#endif
+
 int audit_name_to_field(const char *field)
 {
 #ifndef NO_TABLES
@@ -192,6 +230,122 @@ const char *audit_syscall_to_name(int sc, int machine)
 	return NULL;
 }
 
+#ifndef NO_TABLES
+/*
+ * This function lower cases a syscall name into buf the way the tables
+ * have them. Returns the hash of it, or 0 with buf empty if it is too long
+ * to be a syscall.
+ */
+static unsigned syscall_fold(const char *sc, char *buf)
+{
+	size_t i;
+
+	for (i = 0; sc[i]; i++) {
+		if (i == SYSCALL_NAME_MAX - 1) {
+			buf[0] = 0;
+			return 0;
+		}
+		buf[i] = GT_ISUPPER(sc[i]) ? sc[i] - 'A' + 'a' : sc[i];
+	}
+	buf[i] = 0;
+	return gt_hash__(buf);
+}
+
+static const struct syscall_tab *syscall_tab(int machine)
+{
+	unsigned int i;
+
+	for (i = 0; i < SYSCALL_TABS; i++) {
+		if (syscall_tabs[i].machine == machine)
+			return &syscall_tabs[i];
+	}
+	return NULL;
+}
+
+static int syscall_tab_s2i(const struct syscall_tab *t, const char *name,
+	unsigned h)
+{
+	int res;
+
+	if (name[0] && s2i_hash__(t->strings, t->s_table, t->i_table,
+			t->h_table, t->h_size, name, h, &res))
+		return res;
+	return -1;
+}
+#endif
+
+/*
+ * This function looks a syscall up on every machine, hashing the name
+ * once. nums gets the number on each machine, or -1 where it is unknown.
+ * Returns how many machines have it.
+ */
+int audit_name_to_syscall_all(const char *sc, int nums[AUDIT_MACHINES])
+{
+	int i, found = 0;
+#ifndef NO_TABLES
+	char name[SYSCALL_NAME_MAX];
+	unsigned int t, h;
+#endif
+
+	for (i = 0; i < AUDIT_MACHINES; i++)
+		nums[i] = -1;
+#ifndef NO_TABLES
+	h = syscall_fold(sc, name);
+	for (t = 0; t < SYSCALL_TABS; t++) {
+		i = syscall_tabs[t].machine;
+		nums[i] = syscall_tab_s2i(&syscall_tabs[t], name, h);
+		if (nums[i] >= 0)
+			found++;
+	}
+#endif
+	return found;
+}
+
+/*
+ * This function looks a list of syscalls up on one machine. nums gets
+ * the number of each one or -1 if it is unknown. Returns how many names
+ * are unknown.
+ */
+int audit_names_to_syscalls(const char *const *names, int count,
+	int machine, int *nums)
+{
+	int i, missing = 0;
+#ifndef NO_TABLES
+	const struct syscall_tab *t = syscall_tab(machine);
+	char name[SYSCALL_NAME_MAX];
+#endif
+
+	for (i = 0; i < count; i++) {
+		nums[i] = -1;
+#ifndef NO_TABLES
+		if (t) {
+			unsigned h = syscall_fold(names[i], name);
+			nums[i] = syscall_tab_s2i(t, name, h);
+		}
+#endif
+		if (nums[i] < 0)
+			missing++;
+	}
+	return missing;
+}
+
+/*
+ * This function names a list of syscall numbers of one machine. names
+ * gets NULL for the unknown ones. Returns how many are unknown.
+ */
+int audit_syscalls_to_names(const int *nums, int count, int machine,
+	const char **names)
+{
+	int i, missing = 0;
+
+	for (i = 0; i < count; i++) {
+		names[i] = audit_syscall_to_name(nums[i], machine);
+		if (names[i] == NULL)
+			missing++;
+	}
+	return missing;
+}
+
 int audit_name_to_flag(const char *flag)
 {
 	int res;
@@ -30,6 +30,8 @@
    0 - stderr, 1 - syslog, 2 - quiet. The default is quiet. */
 static message_t message_mode = MSG_QUIET;
 static debug_message_t debug_message = DBG_NO;
+/* Where MSG_STDERR messages go, NULL for stderr */
+static FILE *message_stream = NULL;
 
 void set_aumessage_mode(message_t mode, debug_message_t debug)
 {
@@ -37,6 +39,17 @@ void set_aumessage_mode(message_t mode, debug_message_t debug)
 	debug_message = debug;
 }
 
+void set_aumessage_stream(FILE *stream)
+{
+	message_stream = stream;
+}
+
+FILE *audit_msg_stream(void)
+{
+	return message_stream ? message_stream : stderr;
+}
+hidden_def(audit_msg_stream)
+
 void audit_msg(int priority, const char *fmt, ...)
 {
         va_list   ap;
@@ -51,8 +64,10 @@ void audit_msg(int priority, const char *fmt, ...)
         if (message_mode == MSG_SYSLOG)
                 vsyslog(priority, fmt, ap);
         else {
-                vfprintf(stderr, fmt, ap);
-		fputc('\n', stderr);
+		FILE *f = audit_msg_stream();
+
+                vfprintf(f, fmt, ap);
+		fputc('\n', f);
 	}
         va_end( ap );
 }
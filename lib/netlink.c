@@ -27,7 +27,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <time.h>
+#include <stdlib.h>
 #include <sys/poll.h>
+#include <sys/socket.h>
 #include "libaudit.h"
 #include "private.h"
 
@@ -36,8 +38,12 @@
 #endif
 
 static int adjust_reply(struct audit_reply *rep, int len);
+static int fill_reply(struct audit_reply *rep, struct nlmsghdr *nlh, int len);
 static int check_ack(int fd, int seq);
 
+/* How long to wait for an answer to a request */
+#define ACK_TIMEOUT	40000	// milliseconds
+
 /*
  * This function opens a connection to the kernel's audit
  * subsystem. You must be root for the call to succeed. On error,
@@ -132,15 +138,292 @@ retry:
 }
 hidden_def(audit_get_reply)
 
+/*
+ * The kernel sends each message of a rule list in its own datagram, and
+ * a datagram can hold several messages. A reply iterator receives all
+ * the datagrams that are queued with one system call and walks every
+ * message in them.
+ */
+#define ITER_SLOTS	16	// Datagrams received at once
+
+struct audit_reply_iter {
+	struct audit_message *bufs;
+	struct mmsghdr msgs[ITER_SLOTS];
+	struct iovec iov[ITER_SLOTS];
+	struct sockaddr_nl addr[ITER_SLOTS];
+	int count;		// Datagrams received
+	int cur;		// The one being walked
+	struct nlmsghdr *nlh;	// Its next message, NULL if not started
+	int left;		// Bytes from nlh to its end
+};
+
+audit_reply_iter *audit_reply_iter_new(void)
+{
+	audit_reply_iter *it;
+
+	it = calloc(1, sizeof(audit_reply_iter));
+	if (it == NULL)
+		return NULL;
+	it->bufs = malloc(ITER_SLOTS * sizeof(struct audit_message));
+	if (it->bufs == NULL) {
+		free(it);
+		return NULL;
+	}
+	return it;
+}
+
+void audit_reply_iter_free(audit_reply_iter *it)
+{
+	if (it == NULL)
+		return;
+	free(it->bufs);
+	free(it);
+}
+
+/*
+ * This function receives the datagrams queued on the socket, dropping
+ * any messages of the last ones that were not walked. If block is
+ * GET_REPLY_BLOCKING, it waits for the first one. It returns the number
+ * of datagrams received, or -errno on error.
+ */
+int audit_reply_iter_recv(int fd, audit_reply_iter *it, reply_t block)
+{
+	int i, rc, flags;
+
+	if (fd < 0)
+		return -EBADF;
+
+	it->count = it->cur = 0;
+	it->nlh = NULL;
+	for (i = 0; i < ITER_SLOTS; i++) {
+		it->iov[i].iov_base = &it->bufs[i];
+		it->iov[i].iov_len = sizeof(struct audit_message);
+		memset(&it->msgs[i], 0, sizeof(struct mmsghdr));
+		it->msgs[i].msg_hdr.msg_name = &it->addr[i];
+		it->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+		it->msgs[i].msg_hdr.msg_iov = &it->iov[i];
+		it->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	flags = block == GET_REPLY_NONBLOCKING ? MSG_DONTWAIT : MSG_WAITFORONE;
+
+	do {
+		rc = recvmmsg(fd, it->msgs, ITER_SLOTS, flags, NULL);
+	} while (rc < 0 && errno == EINTR);
+	if (rc < 0 && errno == ENOSYS) {
+		/* An old kernel, take them one at a time */
+		do {
+			rc = recvmsg(fd, &it->msgs[0].msg_hdr,
+				block == GET_REPLY_NONBLOCKING ?
+					MSG_DONTWAIT : 0);
+		} while (rc < 0 && errno == EINTR);
+		if (rc >= 0) {
+			it->msgs[0].msg_len = rc;
+			rc = 1;
+		}
+	}
+	if (rc < 0) {
+		if (errno != EAGAIN) {
+			int saved_errno = errno;
+			audit_msg(LOG_ERR, 
+				"Error receiving audit netlink packet (%s)", 
+				strerror(errno));
+			errno = saved_errno;
+		}
+		return -errno;
+	}
+	it->count = rc;
+	return rc;
+}
+
+/*
+ * This function checks the datagram about to be walked. It returns 1 if
+ * its messages can be used and 0 if it has to be skipped.
+ */
+static int iter_check(audit_reply_iter *it)
+{
+	struct msghdr *m = &it->msgs[it->cur].msg_hdr;
+
+	if (m->msg_namelen != sizeof(struct sockaddr_nl)) {
+		audit_msg(LOG_ERR, 
+			"Bad address size reading audit netlink socket");
+		return 0;
+	}
+	if (it->addr[it->cur].nl_pid) {
+		audit_msg(LOG_ERR, 
+			"Spoofed packet received on audit netlink socket");
+		return 0;
+	}
+	if (m->msg_flags & MSG_TRUNC) {
+		audit_msg(LOG_ERR, "Netlink event from kernel is too big");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * This function fills in rep with the next message received. The reply
+ * points into the iterator and stays valid until the next receive.
+ * Datagrams that can't be trusted are skipped. It returns 1 if there
+ * was a message and 0 when all have been walked.
+ */
+int audit_reply_iter_next(audit_reply_iter *it, struct audit_reply *rep)
+{
+	while (it->cur < it->count) {
+		if (it->nlh == NULL) {
+			if (!iter_check(it)) {
+				it->cur++;
+				continue;
+			}
+			it->nlh = &it->bufs[it->cur].nlh;
+			it->left = it->msgs[it->cur].msg_len;
+		}
+		if (NLMSG_OK(it->nlh, (unsigned int)it->left)) {
+			fill_reply(rep, it->nlh, it->left);
+			it->nlh = NLMSG_NEXT(it->nlh, it->left);
+			return 1;
+		}
+		if (it->left > 0)
+			audit_msg(LOG_ERR, 
+				"Netlink message from kernel was not OK");
+		it->cur++;
+		it->nlh = NULL;
+	}
+	return 0;
+}
+
+
+
+/* Sets deadline to timeout milliseconds from now */
+static void set_deadline(struct timespec *deadline, int timeout)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += timeout / 1000;
+	deadline->tv_nsec += (timeout % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/*
+ * This function waits until fd can be read or the deadline passes. A
+ * NULL deadline waits for as long as it takes. Returns 0 if it can be
+ * read, -ETIMEDOUT if the deadline passed, and -errno on error.
+ */
+static int wait_readable(int fd, const struct timespec *deadline)
+{
+	struct pollfd pfd[1];
+	struct timespec now;
+	long timeout = -1;
+	int rc;
+
+	pfd[0].fd = fd;
+	pfd[0].events = POLLIN;
+	do {
+		if (deadline) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			timeout = (deadline->tv_sec - now.tv_sec) * 1000L +
+				(deadline->tv_nsec - now.tv_nsec) / 1000000L;
+			if (timeout < 0)
+				timeout = 0;
+		}
+		rc = poll(pfd, 1, (int)timeout);
+	} while (rc < 0 && errno == EINTR);
+	if (rc < 0)
+		return -errno;
+	if (rc == 0)
+		return -ETIMEDOUT;
+	return 0;
+}
+
+/*
+ * This function reads the replies to the request with sequence number
+ * seq, or to any request if seq is 0, and gives each one to handler. It
+ * sleeps until the kernel sends something, and gives up after timeout
+ * milliseconds without a reply, or never if timeout is -1.
+ *
+ * The handler returns 0 to wait for more replies, 1 when the request is
+ * done, or a negative errno to stop. Without a handler, the request is
+ * done when it is acked. A request is also done at NLMSG_DONE, and an
+ * ack with an error ends it with that error.
+ *
+ * It returns 0 when the request is done, or -errno. It is -ETIMEDOUT if
+ * the kernel stopped answering.
+ */
+int audit_wait_replies(int fd, int seq, audit_reply_handler_t handler,
+	void *data, int timeout)
+{
+	struct timespec deadline;
+	struct audit_reply rep;
+	audit_reply_iter *it;
+	int rc;
+
+	if (fd < 0)
+		return -EBADF;
+	it = audit_reply_iter_new();
+	if (it == NULL)
+		return -ENOMEM;
+	if (timeout >= 0)
+		set_deadline(&deadline, timeout);
+
+	while (1) {
+		rc = audit_reply_iter_recv(fd, it, GET_REPLY_NONBLOCKING);
+		if (rc == -EAGAIN) {
+			rc = wait_readable(fd, timeout >= 0 ? &deadline : NULL);
+			if (rc < 0)
+				break;
+			continue;
+		} else if (rc < 0)
+			break;
+
+		rc = 0;
+		while (rc == 0 && audit_reply_iter_next(it, &rep)) {
+			/* Don't make decisions based on wrong packet */
+			if (seq && rep.nlh->nlmsg_seq != (uint32_t)seq)
+				continue;
+
+			/* The kernel is answering, give it more time */
+			if (timeout >= 0)
+				set_deadline(&deadline, timeout);
+
+			if (handler)
+				rc = handler(&rep, data);
+			if (rc)
+				break;
+			if (rep.type == NLMSG_DONE)
+				rc = 1;
+			else if (rep.type == NLMSG_ERROR &&
+					(rep.error->error || handler == NULL))
+				rc = rep.error->error ? rep.error->error : 1;
+		}
+		if (rc)
+			break;
+	}
+	audit_reply_iter_free(it);
+	if (rc > 0)
+		return 0;
+	errno = -rc;
+	return rc;
+}
+hidden_def(audit_wait_replies)
 
 /* 
  * This function returns 0 on error and len on success.
  */
 static int adjust_reply(struct audit_reply *rep, int len)
 {
-	rep->type     = rep->msg.nlh.nlmsg_type;
-	rep->len      = rep->msg.nlh.nlmsg_len;
-	rep->nlh      = &rep->msg.nlh;
+	return fill_reply(rep, &rep->msg.nlh, len);
+}
+
+/*
+ * This function points rep at the message at nlh, which has len bytes
+ * after it. It returns 0 on error and len on success.
+ */
+static int fill_reply(struct audit_reply *rep, struct nlmsghdr *nlh, int len)
+{
+	rep->type     = nlh->nlmsg_type;
+	rep->len      = nlh->nlmsg_len;
+	rep->nlh      = nlh;
 	rep->status   = NULL;
 	rep->ruledata = NULL;
 	rep->login    = NULL;
@@ -184,22 +467,75 @@ static int adjust_reply(struct audit_reply *rep, int len)
 		case AUDIT_SIGNAL_INFO:
 			rep->signal_info = NLMSG_DATA(rep->nlh);
 			break;
+#if HAVE_DECL_AUDIT_FEATURE_VERSION
+		case AUDIT_GET_FEATURE:
+			rep->features = NLMSG_DATA(rep->nlh);
+			break;
+#endif
 	}
 	return len;
 }
 
 
+static int sequence = 0;
+
+/*
+ * This function fills in a request that the kernel will ack at nlh,
+ * which has to have room for NLMSG_SPACE(size) bytes. It returns the
+ * sequence number given to the request.
+ */
+static int fill_request(struct nlmsghdr *nlh, int type, const void *data,
+	unsigned int size)
+{
+	if (++sequence < 0) 
+		sequence = 1;
+
+	memset(nlh, 0, NLMSG_SPACE(size));
+	nlh->nlmsg_len = NLMSG_SPACE(size);
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = NLM_F_REQUEST|NLM_F_ACK;
+	nlh->nlmsg_seq = sequence;
+	if (size && data)
+		memcpy(NLMSG_DATA(nlh), data, size);
+	return sequence;
+}
+
+/*
+ * This function sends len bytes of requests to the kernel in one
+ * datagram. Returns 0 on success, -errno on error, and 1 if it was
+ * short.
+ */
+static int send_buffer(int fd, const void *buf, unsigned int len)
+{
+	struct sockaddr_nl addr;
+	int retval;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_pid = 0;
+	addr.nl_groups = 0;
+
+	do {
+		retval = sendto(fd, buf, len, 0,
+			(struct sockaddr*)&addr, sizeof(addr));
+	} while (retval < 0 && errno == EINTR);
+	if (retval == (int)len)
+		return 0;
+	if (retval < 0) 
+		return -errno;
+	return 1;
+}
+
 /*
+ * This function sends a request that the kernel will ack.
  *  Return values:   success: positive non-zero sequence number
  *                   error:   -errno
  *                   short:   0
  */
-int audit_send(int fd, int type, const void *data, unsigned int size)
+static int send_request(int fd, int type, const void *data, unsigned int size)
 {
-	static int sequence = 0;
 	struct audit_message req;
-	int retval;
-	struct sockaddr_nl addr;
+	int retval, seq;
 
 	/* Due to user space library callbacks, there's a chance that
 	   a -1 for the fd could be passed. Just check for and handle it. */
@@ -213,37 +549,124 @@ int audit_send(int fd, int type, const void *data, unsigned int size)
 		return -errno;
 	}
 
-	if (++sequence < 0) 
-		sequence = 1;
+	seq = fill_request(&req.nlh, type, data, size);
+	retval = send_buffer(fd, &req, req.nlh.nlmsg_len);
+	if (retval == 0)
+		return seq;
+	if (retval > 0)
+		return 0;
+	return retval;
+}
 
-	memset(&req, 0, sizeof(req));
-	req.nlh.nlmsg_len = NLMSG_SPACE(size);
-	req.nlh.nlmsg_type = type;
-	req.nlh.nlmsg_flags = NLM_F_REQUEST|NLM_F_ACK;
-	req.nlh.nlmsg_seq = sequence;
-	if (size && data)
-		memcpy(NLMSG_DATA(&req.nlh), data, size);
-	memset(&addr, 0, sizeof(addr));
-	addr.nl_family = AF_NETLINK;
-	addr.nl_pid = 0;
-	addr.nl_groups = 0;
+/*
+ *  Return values:   success: positive non-zero sequence number
+ *                   error:   -errno
+ *                   short:   0
+ */
+int audit_send(int fd, int type, const void *data, unsigned int size)
+{
+	int retval, seq;
 
-	do {
-		retval = sendto(fd, &req, req.nlh.nlmsg_len, 0,
-			(struct sockaddr*)&addr, sizeof(addr));
-	} while (retval < 0 && errno == EINTR);
-	if (retval == (int)req.nlh.nlmsg_len) {
-		if ((retval = check_ack(fd, sequence)) == 0)
-			return sequence;
-		else
-			return retval; 
-	}
-	if (retval < 0) 
+	seq = send_request(fd, type, data, size);
+	if (seq <= 0)
+		return seq;
+	if ((retval = check_ack(fd, seq)) == 0)
+		return seq;
+	else
+		return retval; 
+}
+hidden_def(audit_send)
+
+/*
+ * Same as audit_send, but the ack is left for audit_get_ack so that
+ * several requests can be in flight at once.
+ */
+int audit_send_nowait(int fd, int type, const void *data, unsigned int size)
+{
+	return send_request(fd, type, data, size);
+}
+hidden_def(audit_send_nowait)
+
+/*
+ * This function adds a request that the kernel will ack to the end of
+ * the len bytes of requests in buf, which holds room bytes. The requests
+ * are sent with audit_send_queued. Returns the sequence number given to
+ * the request, -EINVAL if it is too big for any buffer, or -ENOSPC if it
+ * doesn't fit in this one.
+ */
+int audit_queue_request(void *buf, unsigned int *len, unsigned int room,
+	int type, const void *data, unsigned int size)
+{
+	if (NLMSG_SPACE(size) > MAX_AUDIT_MESSAGE_LENGTH)
+		return -EINVAL;
+	if (*len + NLMSG_SPACE(size) > room)
+		return -ENOSPC;
+	*len += NLMSG_SPACE(size);
+	return fill_request((struct nlmsghdr *)((char *)buf + *len -
+				NLMSG_SPACE(size)), type, data, size);
+}
+hidden_def(audit_queue_request)
+
+/*
+ * This function sends the requests put in buf by audit_queue_request.
+ * The kernel handles them in order and acks each one. Returns 0 on
+ * success and -errno on error, in which case none of them were sent.
+ */
+int audit_send_queued(int fd, const void *buf, unsigned int len)
+{
+	int retval;
+
+	if (fd < 0) {
+		errno = EBADF;
 		return -errno;
+	}
+	retval = send_buffer(fd, buf, len);
+	if (retval > 0) {
+		errno = EIO;
+		return -EIO;
+	}
+	return retval;
+}
+hidden_def(audit_send_queued)
 
-	return 0;
+/*
+ * This function waits for the next ack, giving up after the same 40
+ * seconds check_ack waits. The sequence number of the request goes in
+ * seq and the error the kernel gave for it, 0 on success, in error.
+ * Returns 0 when an ack was read and -errno if none could be. With
+ * GET_REPLY_NONBLOCKING it returns -EAGAIN instead of waiting.
+ */
+int audit_get_ack(int fd, int *seq, int *error, reply_t block)
+{
+	int rc;
+	struct audit_reply rep;
+	struct timespec deadline;
+
+	set_deadline(&deadline, ACK_TIMEOUT);
+	while (1) {
+		rc = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
+		if (rc == -EAGAIN) {
+			if (block == GET_REPLY_NONBLOCKING)
+				return rc;
+			rc = wait_readable(fd, &deadline);
+			if (rc == -ETIMEDOUT)
+				return -EAGAIN;
+			if (rc < 0)
+				return rc;
+			continue;
+		} else if (rc < 0)
+			return rc;
+		else if (rc == 0)
+			return -EINVAL; /* This can't happen anymore */
+		if (rep.type == NLMSG_ERROR) {
+			*seq = rep.nlh->nlmsg_seq;
+			*error = rep.error->error;
+			return 0;
+		}
+		// Anything else is not an answer to a request
+	}
 }
-hidden_def(audit_send)
+hidden_def(audit_get_ack)
 
 /*
  * This function will take a peek into the next packet and see if there's
@@ -252,40 +675,46 @@ hidden_def(audit_send)
  */
 static int check_ack(int fd, int seq)
 {
-	int rc, retries = 80;
+	int rc;
 	struct audit_reply rep;
-	struct pollfd pfd[1];
+	struct timespec deadline;
 
-retry:
-	pfd[0].fd = fd;
-	pfd[0].events = POLLIN;
-	do {
-		rc = poll(pfd, 1, 500); /* .5 second */
-	} while (rc < 0 && errno == EINTR);
+	set_deadline(&deadline, ACK_TIMEOUT);
+	while (1) {
+		/* NOTE: whatever is returned is treated as the errno */
+		rc = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, MSG_PEEK);
+		if (rc == -EAGAIN) {
+			/* Sleep until the kernel answers */
+			rc = wait_readable(fd, &deadline);
+			if (rc == -ETIMEDOUT)
+				return -EAGAIN;
+			if (rc < 0)
+				return rc;
+			continue;
+		} else if (rc < 0)
+			return rc;
+		else if (rc == 0)
+			return -EINVAL; /* This can't happen anymore */
+		else if (rep.type == NLMSG_ERROR) {
+			int error = rep.error->error;
+			int ours = rep.nlh->nlmsg_seq == (uint32_t)seq;
+
+			/* Eat the message */
+			(void)audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
 
-	/* We don't look at rc from above as it doesn't matter. We are 
-	 * going to try to read nonblocking just in case packet shows up. */
-	
-	/* NOTE: whatever is returned is treated as the errno */
-	rc = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, MSG_PEEK);
-	if (rc == -EAGAIN && retries) {
-		retries--;
-		goto retry;
-	} else if (rc < 0)
-		return rc;
-	else if (rc == 0)
-		return -EINVAL; /* This can't happen anymore */
-	else if (rc > 0 && rep.type == NLMSG_ERROR) {
-		int error = rep.error->error;
-		/* Eat the message */
-		(void)audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
-
-		/* NLMSG_ERROR can indicate success, only report nonzero */ 
-		if (error) {
-			errno = -error;
-			return error;
+			/* An ack left over from an earlier request */
+			if (!ours)
+				continue;
+
+			/* NLMSG_ERROR can indicate success, only report
+			 * nonzero */ 
+			if (error) {
+				errno = -error;
+				return error;
+			}
 		}
+		/* Any other reply is left for the caller to read */
+		return 0;
 	}
-	return 0;
 }
 
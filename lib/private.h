@@ -22,6 +22,7 @@
 #ifndef _PRIVATE_H_
 #define _PRIVATE_H_
 
+#include <stdio.h>
 #include "dso.h"
 
 #ifdef __cplusplus
@@ -37,6 +38,8 @@ void audit_msg(int priority, const char *fmt, ...)
 #else
 	;
 #endif
+/* Where messages that aren't going to syslog are written */
+FILE *audit_msg_stream(void);
 
 /* This structure is for protocol reference only.  All fields are
    packed and in network order (LSB first).  */
@@ -121,6 +124,12 @@ struct auditd_remote_message_wrapper {
 
 /* General */
 extern int audit_send(int fd, int type, const void *data, unsigned int size);
+extern int audit_send_nowait(int fd, int type, const void *data,
+	unsigned int size);
+extern int audit_queue_request(void *buf, unsigned int *len,
+	unsigned int room, int type, const void *data, unsigned int size);
+extern int audit_send_queued(int fd, const void *buf, unsigned int len);
+extern int audit_get_ack(int fd, int *seq, int *error, reply_t block);
 
 // This is the main messaging function used internally
 // Don't hide it, it used to be a part of the public API!
@@ -156,10 +165,16 @@ hidden_proto(audit_name_to_ftype);
 
 // netlink.c
 hidden_proto(audit_get_reply);
+hidden_proto(audit_wait_replies);
 hidden_proto(audit_send)
+hidden_proto(audit_send_nowait)
+hidden_proto(audit_queue_request)
+hidden_proto(audit_send_queued)
+hidden_proto(audit_get_ack)
 
 // message.c
 hidden_proto(audit_msg)
+hidden_proto(audit_msg_stream)
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,343 @@
+/* batch_test.c -- A test of sending rules without waiting for each ack.
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The library talks to a fake kernel here. Requests are taken out of
+ * sendto as they are sent and their acks are held back until the library
+ * finds nothing left to read, so the test knows how many requests were
+ * in flight at any time. The acks go to the library over a socket
+ * the way the kernel's do, in the order and with the errors each test
+ * picks, along with acks and messages the library has to pass over.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+
+#include "../libaudit.h"
+
+/* These are private to the library */
+extern int audit_send_nowait(int fd, int type, const void *data,
+	unsigned int size);
+extern int audit_get_ack(int fd, int *seq, int *error, reply_t block);
+
+#define WINDOW 64	// BATCH_WINDOW in libaudit.c
+#define RULES 300
+
+struct request {
+	int seq;
+	int type;
+	int id;		// Which rule it was
+	int flags;
+	int read;	// The library read its ack
+};
+
+static struct request reqs[RULES];
+static int nreq, held;		// Requests taken, and the first not acked
+static int in_flight, max_in_flight, empty;
+static int lib_fd = -1, kern_fd = -1;
+
+/* How the fake kernel acks what it holds when the library runs out */
+static int reverse;		// Last request first
+static int with_errors;		// Some rules fail
+static int noise;		// Stale acks and other messages come first
+static int hold;		// Only acks when the test says to
+static int fail_read;		// The read that finds this many empty fails
+static int stale_seq;		// A request of an earlier test
+
+static int error_for(int id)
+{
+	if (with_errors && id % 7 == 3)
+		return -EEXIST;
+	return 0;
+}
+
+static void send_msg(int type, int seq, int error)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct nlmsgerr err;
+	} msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.nlh.nlmsg_len = sizeof(msg);
+	msg.nlh.nlmsg_type = type;
+	msg.nlh.nlmsg_seq = seq;
+	msg.err.error = error;
+	if (send(kern_fd, &msg, sizeof(msg), 0) != sizeof(msg))
+		printf("Can't send a reply (%s)\n", strerror(errno));
+}
+
+static void release(void)
+{
+	int i;
+
+	if (noise) {
+		send_msg(NLMSG_ERROR, stale_seq, -EPERM);
+		if (held < nreq)
+			send_msg(AUDIT_GET, reqs[held].seq, 0);
+	}
+	for (i = held; i < nreq; i++) {
+		const struct request *r = &reqs[reverse ? nreq - 1 - i + held :
+									i];
+
+		send_msg(NLMSG_ERROR, r->seq, error_for(r->id));
+		// The same ack again while older requests still wait
+		if (noise && i == held)
+			send_msg(NLMSG_ERROR, r->seq, -ENOENT);
+	}
+	held = nreq;
+}
+
+/* The library calls these instead of the ones in libc */
+ssize_t sendto(int fd, const void *buf, size_t len, int flags,
+	const struct sockaddr *addr, socklen_t alen)
+{
+	const struct nlmsghdr *nlh = buf;
+	const struct audit_rule_data *rule = NLMSG_DATA(nlh);
+
+	if (fd != lib_fd || addr == NULL || addr->sa_family != AF_NETLINK)
+		return syscall(SYS_sendto, fd, buf, len, flags, addr, alen);
+	if (nreq == RULES) {
+		errno = ENOBUFS;
+		return -1;
+	}
+	reqs[nreq].seq = nlh->nlmsg_seq;
+	reqs[nreq].type = nlh->nlmsg_type;
+	reqs[nreq].id = rule->values[0];
+	reqs[nreq].flags = rule->flags;
+	reqs[nreq].read = 0;
+	nreq++;
+	if (++in_flight > max_in_flight)
+		max_in_flight = in_flight;
+	return len;
+}
+
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags,
+	struct sockaddr *addr, socklen_t *alen)
+{
+	const struct nlmsghdr *nlh = buf;
+	ssize_t rc;
+	int i;
+
+	if (fd != lib_fd || (flags & MSG_PEEK))
+		return syscall(SYS_recvfrom, fd, buf, len, flags, addr, alen);
+	rc = syscall(SYS_recvfrom, fd, buf, len, flags | MSG_DONTWAIT, addr,
+		alen);
+	if (rc < 0 && errno == EAGAIN && !hold) {
+		if (++empty == fail_read) {
+			errno = EIO;
+			return -1;
+		}
+		release();
+		rc = syscall(SYS_recvfrom, fd, buf, len, flags, addr, alen);
+	}
+	if (rc < (ssize_t)sizeof(*nlh) || nlh->nlmsg_type != NLMSG_ERROR)
+		return rc;
+	for (i = 0; i < nreq; i++) {
+		if (reqs[i].seq == (int)nlh->nlmsg_seq && !reqs[i].read) {
+			reqs[i].read = 1;
+			in_flight--;
+		}
+	}
+	return rc;
+}
+
+/*
+ * The library checks that replies come from an address the size of a
+ * netlink one with a port id of 0. An abstract unix socket name of 10
+ * bytes looks like that, with its bytes 2 to 5 where the port id goes.
+ */
+static int open_kernel(void)
+{
+	struct sockaddr_un addr;
+	int sv[2];
+	pid_t pid = getpid();
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+		return 1;
+	lib_fd = sv[0];
+	kern_fd = sv[1];
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(&addr.sun_path[6], &pid, sizeof(pid));
+	return bind(kern_fd, (struct sockaddr *)&addr,
+		offsetof(struct sockaddr_un, sun_path) + 10);
+}
+
+static void reset(void)
+{
+	if (nreq)
+		stale_seq = reqs[nreq - 1].seq;
+	nreq = held = in_flight = max_in_flight = empty = 0;
+	reverse = with_errors = noise = hold = fail_read = 0;
+}
+
+static struct audit_rule_data rule_data[RULES];
+static struct audit_rule_data *rules[RULES];
+static int errors[RULES];
+
+/* Every 11th rule is on the entry list when entry is set */
+static void make_rules(int entry)
+{
+	int i;
+
+	for (i = 0; i < RULES; i++) {
+		memset(&rule_data[i], 0, sizeof(rule_data[i]));
+		rule_data[i].flags = entry && i % 11 == 5 ?
+			AUDIT_FILTER_ENTRY : AUDIT_FILTER_EXIT;
+		rule_data[i].action = AUDIT_ALWAYS;
+		rule_data[i].values[0] = i;
+		rules[i] = &rule_data[i];
+	}
+}
+
+static int fail(const char *test, const char *what)
+{
+	printf("%s: %s\n", test, what);
+	return 1;
+}
+
+/* Checks what each rule got and that the requests went out in order */
+static int check(const char *test, int cnt, int type, int rc, int entry)
+{
+	int i, r = 0, failed = 0;
+
+	for (i = 0; i < cnt; i++) {
+		int want = entry && i % 11 == 5 ? -EINVAL : error_for(i);
+
+		if (want)
+			failed++;
+		if (errors[i] != want) {
+			printf("%s: rule %d got %d, not %d\n", test, i,
+				errors[i], want);
+			return 1;
+		}
+		if (want == -EINVAL)
+			continue;
+		if (r >= nreq || reqs[r].id != i || reqs[r].type != type ||
+				reqs[r].flags != AUDIT_FILTER_EXIT)
+			return fail(test, "requests were not sent in order");
+		r++;
+	}
+	if (r != nreq)
+		return fail(test, "more requests were sent than rules");
+	if (rc != failed) {
+		printf("%s: returned %d, not %d\n", test, rc, failed);
+		return 1;
+	}
+	if (in_flight)
+		return fail(test, "acks were left unread");
+	i = nreq < WINDOW ? nreq : WINDOW;
+	if (max_in_flight != i) {
+		printf("%s: %d requests were in flight, not %d\n", test,
+			max_in_flight, i);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	int rc, i, seq[3], s, e, errs = 0;
+
+	if (open_kernel()) {
+		printf("Can't make a fake kernel (%s)\n", strerror(errno));
+		return 1;
+	}
+	set_aumessage_mode(MSG_QUIET, DBG_NO);
+
+	// All rules go in with acks in order
+	make_rules(0);
+	rc = audit_add_rules_batch(lib_fd, rules, 200, errors);
+	errs += check("in order", 200, AUDIT_ADD_RULE, rc, 0);
+
+	// Acks come last first, along with ones that aren't for any rule
+	reset();
+	make_rules(1);
+	reverse = with_errors = noise = 1;
+	rc = audit_add_rules_batch(lib_fd, rules, RULES, errors);
+	errs += check("out of order", RULES, AUDIT_ADD_RULE, rc, 1);
+
+	// Fewer rules than the window
+	reset();
+	make_rules(0);
+	reverse = with_errors = 1;
+	rc = audit_delete_rules_batch(lib_fd, rules, 10, errors);
+	errs += check("delete", 10, AUDIT_DEL_RULE, rc, 0);
+
+	// Acks can't be read partway through, after one window was acked
+	reset();
+	fail_read = 2;
+	rc = audit_add_rules_batch(lib_fd, rules, 150, errors);
+	if (rc != -EIO || errno != EIO)
+		errs += fail("read error", "the error was not returned");
+	for (i = 0; i < 150; i++) {
+		if (errors[i] != (i < WINDOW ? 0 : -EIO)) {
+			printf("read error: rule %d got %d\n", i, errors[i]);
+			errs++;
+			break;
+		}
+	}
+	if (nreq != 2 * WINDOW || max_in_flight != WINDOW)
+		errs += fail("read error", "the window was not kept");
+
+	// Acks read one at a time
+	reset();
+	hold = 1;
+	for (i = 0; i < 3; i++) {
+		seq[i] = audit_send_nowait(lib_fd, AUDIT_ADD_RULE, rules[i + 3],
+			sizeof(struct audit_rule_data));
+		if (seq[i] <= 0 || (i && seq[i] != seq[i - 1] + 1))
+			errs += fail("nowait", "bad sequence number");
+	}
+	if (audit_get_ack(lib_fd, &s, &e, GET_REPLY_NONBLOCKING) != -EAGAIN)
+		errs += fail("nowait", "got an ack before it was sent");
+	reverse = with_errors = noise = 1;
+	release();
+	// The stale ack comes back, the status message doesn't
+	if (audit_get_ack(lib_fd, &s, &e, GET_REPLY_BLOCKING) ||
+			s != stale_seq || e != -EPERM)
+		errs += fail("nowait", "the stale ack was not read");
+	for (i = 2; i >= 0; i--) {
+		if (audit_get_ack(lib_fd, &s, &e, GET_REPLY_NONBLOCKING) ||
+				s != seq[i] || e != error_for(i + 3))
+			errs += fail("nowait", "wrong ack");
+		if (i == 2 && (audit_get_ack(lib_fd, &s, &e,
+				GET_REPLY_NONBLOCKING) || s != seq[i] ||
+				e != -ENOENT))
+			errs += fail("nowait", "the ack again was not read");
+	}
+	if (audit_get_ack(lib_fd, &s, &e, GET_REPLY_NONBLOCKING) != -EAGAIN)
+		errs += fail("nowait", "too many acks");
+
+	close(lib_fd);
+	close(kern_fd);
+	if (errs == 0)
+		printf("5 tests passed\n");
+	return errs ? 1 : 0;
+}
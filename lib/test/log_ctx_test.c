@@ -0,0 +1,569 @@
+/* log_ctx_test.c -- A test of logging user messages in batches.
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The logging context talks to a fake kernel here. The netlink socket it
+ * opens is one end of a socket pair, the messages it sends are taken out
+ * of sendto, and their acks are held back until the context waits for
+ * one in poll. So the test knows when the context sends, how many
+ * messages are in flight, and when it has to wait. Hostname lookups and
+ * the clock are faked too, to see when the context looks a name up.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <netdb.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <linux/netlink.h>
+
+#include "../libaudit.h"
+
+#define BATCH 8			// CTX_BATCH in audit_logging.c
+#define WINDOW (BATCH*2)	// CTX_WINDOW
+#define MESSAGES 64
+
+struct request {
+	int seq;
+	int type;
+	char text[128];
+	int acked;
+	int read;
+};
+
+static struct request reqs[MESSAGES];
+static int nreq, sends, batch_max, in_flight, max_in_flight, polls, opens;
+static int lib_fd = -1, kern_fd = -1;
+
+/* How the fake kernel acks when the context waits */
+static int per_poll;		// Acks let go at a time, 0 for all
+static int reverse;		// Newest first
+static int old_kernel;		// Doesn't know the user message types
+static int bad_kernel;		// Refuses every message
+
+/* What the callback was given */
+struct outcome {
+	int seq;
+	int type;
+	int error;
+	char text[128];
+};
+
+static struct outcome outcomes[MESSAGES];
+static int noutcomes;
+
+static void callback(int seq, int type, const char *message, int error,
+	void *data)
+{
+	(void)data;
+	if (noutcomes == MESSAGES)
+		return;
+	outcomes[noutcomes].seq = seq;
+	outcomes[noutcomes].type = type;
+	outcomes[noutcomes].error = error;
+	snprintf(outcomes[noutcomes].text, sizeof(outcomes[0].text), "%s",
+		message);
+	noutcomes++;
+}
+
+static void reset(void)
+{
+	nreq = sends = batch_max = in_flight = max_in_flight = polls = 0;
+	per_poll = reverse = old_kernel = bad_kernel = 0;
+	noutcomes = 0;
+}
+
+static int answer(const struct request *r)
+{
+	if (bad_kernel)
+		return -EINVAL;
+	if (old_kernel && r->type >= AUDIT_FIRST_USER_MSG &&
+			r->type <= AUDIT_LAST_USER_MSG)
+		return -EINVAL;
+	return 0;
+}
+
+static void send_ack(struct request *r)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct nlmsgerr err;
+	} ack;
+
+	memset(&ack, 0, sizeof(ack));
+	ack.nlh.nlmsg_len = sizeof(ack);
+	ack.nlh.nlmsg_type = NLMSG_ERROR;
+	ack.nlh.nlmsg_seq = r->seq;
+	ack.err.error = answer(r);
+	if (send(kern_fd, &ack, sizeof(ack), 0) != sizeof(ack))
+		printf("Can't send an ack (%s)\n", strerror(errno));
+	r->acked = 1;
+}
+
+/* Acks up to n of the messages that have none yet, all if n is 0 */
+static void release(int n)
+{
+	int i, cnt = 0;
+
+	for (i = 0; i < nreq && (n == 0 || cnt < n); i++) {
+		struct request *r = &reqs[reverse ? nreq - 1 - i : i];
+
+		if (r->acked == 0) {
+			send_ack(r);
+			cnt++;
+		}
+	}
+}
+
+/*
+ * Replies have to come from an address the size of a netlink one with a
+ * port id of 0. An abstract unix socket name of 10 bytes looks like
+ * that, with its bytes 2 to 5 where the port id goes. The kernel end of
+ * the last socket is closed, the library has closed its own by now.
+ */
+int socket(int domain, int type, int protocol)
+{
+	struct sockaddr_un addr;
+	int sv[2];
+	pid_t pid = getpid();
+
+	if (domain != PF_NETLINK)
+		return syscall(SYS_socket, domain, type, protocol);
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+		return -1;
+	if (kern_fd >= 0)
+		close(kern_fd);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(&addr.sun_path[6], &pid, sizeof(pid));
+	if (bind(sv[1], (struct sockaddr *)&addr,
+			offsetof(struct sockaddr_un, sun_path) + 10)) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	lib_fd = sv[0];
+	kern_fd = sv[1];
+	opens++;
+	return lib_fd;
+}
+
+ssize_t sendto(int fd, const void *buf, size_t len, int flags,
+	const struct sockaddr *addr, socklen_t alen)
+{
+	const struct nlmsghdr *nlh;
+	unsigned int left = len;
+	int cnt = 0;
+
+	if (fd != lib_fd || addr == NULL || addr->sa_family != AF_NETLINK)
+		return syscall(SYS_sendto, fd, buf, len, flags, addr, alen);
+	for (nlh = buf; NLMSG_OK(nlh, left); nlh = NLMSG_NEXT(nlh, left)) {
+		struct request *r = &reqs[nreq];
+
+		if (nreq == MESSAGES) {
+			errno = ENOBUFS;
+			return -1;
+		}
+		r->seq = nlh->nlmsg_seq;
+		r->type = nlh->nlmsg_type;
+		snprintf(r->text, sizeof(r->text), "%s",
+			(const char *)NLMSG_DATA(nlh));
+		r->acked = r->read = 0;
+		nreq++;
+		cnt++;
+		if (++in_flight > max_in_flight)
+			max_in_flight = in_flight;
+	}
+	sends++;
+	if (cnt > batch_max)
+		batch_max = cnt;
+	return len;
+}
+
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags,
+	struct sockaddr *addr, socklen_t *alen)
+{
+	ssize_t rc = syscall(SYS_recvfrom, fd, buf, len, flags, addr, alen);
+	const struct nlmsghdr *nlh = buf;
+	int i;
+
+	if (fd != lib_fd || rc < (ssize_t)sizeof(*nlh) || (flags & MSG_PEEK))
+		return rc;
+	for (i = 0; i < nreq; i++) {
+		if (reqs[i].seq == (int)nlh->nlmsg_seq && !reqs[i].read) {
+			reqs[i].read = 1;
+			in_flight--;
+		}
+	}
+	return rc;
+}
+
+/*
+ * The context only polls when it has to wait for an ack. This doesn't
+ * include poll.h, whose declaration of poll says the fds aren't read.
+ */
+struct wait_fd {
+	int fd;
+	short events;
+	short revents;
+};
+
+int poll(struct wait_fd *fds, unsigned long nfds, int timeout)
+{
+	struct timespec ts = { 1, 0 };
+
+	if (nfds == 1 && fds[0].fd == lib_fd) {
+		polls++;
+		release(per_poll);
+		// Don't wait long if nothing was let go
+		if (timeout < 0 || timeout > 1000)
+			timeout = 1000;
+	}
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000L;
+	return syscall(SYS_ppoll, fds, nfds, timeout < 0 ? NULL : &ts, NULL,
+		(size_t)8);
+}
+
+/* A clock that only moves when the test says so */
+static time_t now = 1000;
+
+time_t time(time_t *t)
+{
+	if (t)
+		*t = now;
+	return now;
+}
+
+/* Hosts starting with bad don't resolve, others get a new address each
+ * time they are looked up */
+static int lookups;
+
+int getaddrinfo(const char *node, const char *service,
+	const struct addrinfo *hints, struct addrinfo **res)
+{
+	struct {
+		struct addrinfo ai;
+		struct sockaddr_in sin;
+	} *a;
+
+	(void)service;
+	(void)hints;
+	lookups++;
+	if (strncmp(node, "bad", 3) == 0)
+		return EAI_NONAME;
+	a = calloc(1, sizeof(*a));
+	if (a == NULL)
+		return EAI_MEMORY;
+	a->ai.ai_family = AF_INET;
+	a->ai.ai_addrlen = sizeof(a->sin);
+	a->ai.ai_addr = (struct sockaddr *)&a->sin;
+	a->sin.sin_family = AF_INET;
+	a->sin.sin_addr.s_addr = htonl(0x0a000000 + lookups);
+	*res = &a->ai;
+	return 0;
+}
+
+void freeaddrinfo(struct addrinfo *res)
+{
+	free(res);
+}
+
+static int fail(const char *test, const char *what)
+{
+	printf("%s: %s\n", test, what);
+	return 1;
+}
+
+/* Logs message number i */
+static int log_one(audit_log_ctx *ctx, int type, int i)
+{
+	char msg[32];
+
+	snprintf(msg, sizeof(msg), "op=test%d", i);
+	return audit_log_ctx_user_message(ctx, type, msg, NULL, "10.1.1.1",
+		"pts/1", 1);
+}
+
+/*
+ * Checks each message was handed to the callback once, with no error,
+ * in the order of the acks.
+ */
+static int check_outcomes(const char *test, const int *seqs, int cnt)
+{
+	int i, j, rc = 0;
+
+	if (noutcomes != cnt) {
+		printf("%s: %d messages done, not %d\n", test, noutcomes, cnt);
+		return 1;
+	}
+	for (i = 0; i < cnt; i++) {
+		j = reverse ? cnt - 1 - i : i;
+		if (outcomes[i].seq != seqs[j] || outcomes[i].error ||
+				outcomes[i].type != AUDIT_USER_LOGIN)
+			rc = 1;
+	}
+	if (rc)
+		return fail(test, "messages were done out of order");
+	return 0;
+}
+
+/* Messages are sent 8 at a time and no more than 16 are waited for */
+static int test_window(int one_at_a_time)
+{
+	const char *test = one_at_a_time ? "window" : "batch";
+	audit_log_ctx *ctx;
+	int seqs[MESSAGES], i, errs = 0;
+
+	reset();
+	per_poll = one_at_a_time;
+	reverse = !one_at_a_time;
+	ctx = audit_log_ctx_new(AUDIT_LOG_NORESOLVE, callback, NULL);
+	if (ctx == NULL)
+		return fail(test, "no context");
+
+	for (i = 0; i < WINDOW; i++) {
+		seqs[i] = log_one(ctx, AUDIT_USER_LOGIN, i);
+		if (seqs[i] <= 0)
+			errs += fail(test, "message not queued");
+		if (sends != (i + 1) / BATCH)
+			errs += fail(test, "the batch wasn't sent when full");
+	}
+	if (polls || noutcomes)
+		errs += fail(test, "waited before the window was full");
+
+	// One more has to wait for the oldest to be done
+	seqs[i] = log_one(ctx, AUDIT_USER_LOGIN, i);
+	if (one_at_a_time) {
+		if (polls != 1 || noutcomes != 1)
+			errs += fail(test, "didn't wait for one message");
+	} else {
+		// All acks came in, newest first
+		errs += check_outcomes(test, seqs, WINDOW);
+		reverse = 0;
+	}
+	for (i++; i < MESSAGES - 1; i++)
+		seqs[i] = log_one(ctx, AUDIT_USER_LOGIN, i);
+	if (audit_log_ctx_process(ctx) > WINDOW)
+		errs += fail(test, "too many messages in flight");
+	if (audit_log_ctx_flush(ctx))
+		errs += fail(test, "flush failed");
+	if (one_at_a_time)
+		errs += check_outcomes(test, seqs, MESSAGES - 1);
+	else if (noutcomes != MESSAGES - 1)
+		errs += fail(test, "messages were lost");
+	if (max_in_flight != WINDOW || batch_max != BATCH)
+		errs += fail(test, "the window or batch size was wrong");
+	if (in_flight || nreq != MESSAGES - 1)
+		errs += fail(test, "acks were left or messages sent again");
+	audit_log_ctx_free(ctx);
+	return errs;
+}
+
+/* An old kernel gets the user message types as AUDIT_USER */
+static int test_old_kernel(void)
+{
+	const char *test = "old kernel";
+	audit_log_ctx *ctx;
+	int seqs[3], errs = 0;
+
+	reset();
+	old_kernel = 1;
+	ctx = audit_log_ctx_new(AUDIT_LOG_NORESOLVE, callback, NULL);
+	if (ctx == NULL)
+		return fail(test, "no context");
+	seqs[0] = log_one(ctx, AUDIT_USER_LOGIN, 0);
+	seqs[1] = log_one(ctx, AUDIT_USER, 1);
+	seqs[2] = log_one(ctx, AUDIT_USER_LOGIN, 2);
+	audit_log_ctx_flush(ctx);
+	if (nreq != 5 || reqs[3].type != AUDIT_USER ||
+			reqs[4].type != AUDIT_USER ||
+			strcmp(reqs[3].text, reqs[0].text) ||
+			strcmp(reqs[4].text, reqs[2].text))
+		errs += fail(test, "messages were not sent again as AUDIT_USER");
+	// The AUDIT_USER one is done first, the others with their own type
+	if (noutcomes != 3 || outcomes[0].seq != seqs[1] ||
+			outcomes[1].seq != seqs[0] || outcomes[2].seq != seqs[2] ||
+			outcomes[0].type != AUDIT_USER ||
+			outcomes[1].type != AUDIT_USER_LOGIN ||
+			outcomes[2].type != AUDIT_USER_LOGIN)
+		errs += fail(test, "messages were done wrong");
+	else if (outcomes[0].error || outcomes[1].error || outcomes[2].error)
+		errs += fail(test, "a message was not delivered");
+
+	// A message that fails as AUDIT_USER too is only sent again once
+	reset();
+	bad_kernel = 1;
+	seqs[0] = log_one(ctx, AUDIT_USER_LOGIN, 0);
+	audit_log_ctx_flush(ctx);
+	if (nreq != 2 || noutcomes != 1 || outcomes[0].seq != seqs[0] ||
+			outcomes[0].error != -EINVAL)
+		errs += fail(test, "the error was not given");
+	audit_log_ctx_free(ctx);
+	return errs;
+}
+
+/* A forked child opens its own socket and leaves the parent's messages */
+static int test_fork(void)
+{
+	const char *test = "fork";
+	audit_log_ctx *ctx;
+	int i, errs = 0, status, parent_fd;
+	pid_t pid;
+
+	reset();
+	opens = 0;
+	ctx = audit_log_ctx_new(AUDIT_LOG_NORESOLVE, callback, NULL);
+	if (ctx == NULL)
+		return fail(test, "no context");
+	parent_fd = audit_log_ctx_fd(ctx);
+	for (i = 0; i < 3; i++)
+		log_one(ctx, AUDIT_USER_LOGIN, i);
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return fail(test, "can't fork");
+	if (pid == 0) {
+		log_one(ctx, AUDIT_USER_LOGIN, 10);
+		if (audit_log_ctx_flush(ctx) || opens != 2 ||
+				audit_log_ctx_fd(ctx) != lib_fd)
+			errs += fail(test, "the child didn't open a socket");
+		if (noutcomes != 1 || strncmp(outcomes[0].text, "op=test10 ",
+				10))
+			errs += fail(test, "the child got the parent's messages");
+		if (sends != 1 || nreq != 1)
+			errs += fail(test, "the child sent the parent's messages");
+		audit_log_ctx_free(ctx);
+		exit(errs ? 1 : 0);
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+			WEXITSTATUS(status))
+		errs++;
+
+	// The parent's messages are still there and go out on its socket
+	if (audit_log_ctx_fd(ctx) != parent_fd || opens != 1)
+		errs += fail(test, "the parent's socket changed");
+	audit_log_ctx_flush(ctx);
+	if (sends != 1 || nreq != 3 || noutcomes != 3)
+		errs += fail(test, "the parent's messages were lost");
+	audit_log_ctx_free(ctx);
+	return errs;
+}
+
+/* Gives the address the last message had */
+static const char *last_addr(void)
+{
+	const char *a = nreq ? strstr(reqs[nreq - 1].text, " addr=") : NULL;
+	static char addr[INET6_ADDRSTRLEN];
+
+	if (a == NULL)
+		return "";
+	sscanf(a, " addr=%45s", addr);
+	return addr;
+}
+
+/* Logs a message from host at a time and checks the lookups so far */
+static int log_host(audit_log_ctx *ctx, const char *host, time_t when,
+	int looked_up, const char *addr)
+{
+	now = when;
+	audit_log_ctx_user_message(ctx, AUDIT_USER_LOGIN, "op=host", host,
+		NULL, "pts/1", 1);
+	audit_log_ctx_flush(ctx);
+	if (lookups != looked_up || strcmp(last_addr(), addr)) {
+		printf("hosts: %s at %ld gave %s after %d lookups, not %s "
+			"after %d\n", host, (long)when, last_addr(), lookups,
+			addr, looked_up);
+		return 1;
+	}
+	return 0;
+}
+
+/* Hostnames are looked up again after a minute, or if the clock goes
+ * back, and the oldest of 16 is dropped for a new one */
+static int test_hosts(void)
+{
+	audit_log_ctx *ctx;
+	char host[16], addr[16];
+	int i, errs = 0;
+
+	reset();
+	lookups = 0;
+	ctx = audit_log_ctx_new(0, callback, NULL);
+	if (ctx == NULL)
+		return fail("hosts", "no context");
+	errs += log_host(ctx, "a", 1000, 1, "10.0.0.1");
+	errs += log_host(ctx, "a", 1059, 1, "10.0.0.1");
+	errs += log_host(ctx, "a", 1060, 2, "10.0.0.2");
+	errs += log_host(ctx, "a", 1000, 3, "10.0.0.3");
+	errs += log_host(ctx, "bad", 1000, 4, "?");
+	errs += log_host(ctx, "bad", 1030, 4, "?");
+	errs += log_host(ctx, "bad", 1061, 5, "?");
+	audit_log_ctx_free(ctx);
+
+	lookups = 0;
+	ctx = audit_log_ctx_new(0, callback, NULL);
+	if (ctx == NULL)
+		return fail("hosts", "no context");
+	for (i = 0; i <= 16; i++) {
+		snprintf(host, sizeof(host), "h%d", i);
+		snprintf(addr, sizeof(addr), "10.0.0.%d", i + 1);
+		errs += log_host(ctx, host, 2000 + i, i + 1, addr);
+	}
+	// h0 made room for h16, h1 is still there
+	errs += log_host(ctx, "h1", 2020, 17, "10.0.0.2");
+	errs += log_host(ctx, "h0", 2021, 18, "10.0.0.18");
+	audit_log_ctx_free(ctx);
+
+	// Or they are never looked up
+	lookups = 0;
+	ctx = audit_log_ctx_new(AUDIT_LOG_NORESOLVE, callback, NULL);
+	if (ctx == NULL)
+		return fail("hosts", "no context");
+	errs += log_host(ctx, "a", 3000, 0, "?");
+	audit_log_ctx_free(ctx);
+	return errs;
+}
+
+int main(void)
+{
+	int errs = 0;
+
+	set_aumessage_mode(MSG_QUIET, DBG_NO);
+	errs += test_window(0);
+	errs += test_window(1);
+	errs += test_old_kernel();
+	errs += test_fork();
+	errs += test_hosts();
+	if (errs)
+		return 1;
+	printf("5 tests passed\n");
+	return 0;
+}
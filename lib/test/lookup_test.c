@@ -396,6 +396,50 @@ test_optab(void)
 #undef I2S
 }
 
+/* The lookups on all machines and of lists agree with one at a time. */
+static void
+test_syscall_batch(void)
+{
+	static const struct entry t[] = {
+#include "../x86_64_table.h"
+	};
+	static const char *const names[] = {
+		"open", "OPEN", "socketcall", "no_such_syscall", "execve"
+	};
+	int all[AUDIT_MACHINES], nums[sizeof(t) / sizeof(*t)];
+	const char *found[sizeof(t) / sizeof(*t)];
+	const char *s[sizeof(t) / sizeof(*t)];
+	size_t i;
+	int m;
+
+	printf("Testing syscall batch lookups...\n");
+	for (i = 0; i < sizeof(names) / sizeof(*names); i++) {
+		int n = 0;
+
+		audit_name_to_syscall_all(names[i], all);
+		for (m = 0; m < AUDIT_MACHINES; m++) {
+			assert(all[m] == audit_name_to_syscall(names[i], m));
+			if (all[m] >= 0)
+				n++;
+		}
+		assert(audit_name_to_syscall_all(names[i], all) == n);
+	}
+	for (i = 0; i < sizeof(t) / sizeof(*t); i++) {
+		s[i] = t[i].s;
+		nums[i] = t[i].val;
+	}
+	assert(audit_syscalls_to_names(nums, i, MACH_86_64, found) == 0);
+	for (i = 0; i < sizeof(t) / sizeof(*t); i++)
+		assert(strcmp(found[i], t[i].s) == 0);
+	assert(audit_names_to_syscalls(s, i, MACH_86_64, nums) == 0);
+	for (i = 0; i < sizeof(t) / sizeof(*t); i++)
+		assert(nums[i] == t[i].val);
+	assert(audit_names_to_syscalls(names, 4, MACH_86_64, nums) == 2);
+	assert(nums[0] == nums[1] && nums[0] >= 0);
+	assert(nums[2] == -1 && nums[3] == -1);
+	assert(audit_names_to_syscalls(names, 1, -1, nums) == 1);
+}
+
 int
 main(void)
 {
@@ -417,6 +461,7 @@ main(void)
 	test_s390_table();
 	test_s390x_table();
 	test_x86_64_table();
+	test_syscall_batch();
 	test_actiontab();
 	test_errtab();
 	test_fieldtab();
@@ -0,0 +1,372 @@
+/* reply_iter_test.c -- A test of walking the replies in datagrams.
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The library reads from one end of a socket pair here, and the fake
+ * kernel sends on the other. Each datagram can hold several messages,
+ * and the test checks the iterator walks all of them and none from
+ * datagrams it can't trust: those cut short, and those whose address
+ * recvmmsg or recvmsg changes to a spoofer's or one of another size.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+
+#include "../libaudit.h"
+
+#define SLOTS 16	// ITER_SLOTS in netlink.c
+#define MAX_MSGS 8
+
+static int lib_fd = -1, kern_fd = -1;
+
+/* Who the datagram looks like it came from, kept in its first header */
+#define FROM_KERNEL	0
+#define FROM_SPOOFER	1
+#define FROM_ODD	2	// An address of another size
+
+/* recvmmsg fails the way it does on an old kernel when this is set */
+static int no_mmsg;
+
+static void forge(struct msghdr *m, unsigned int len)
+{
+	const struct nlmsghdr *nlh = m->msg_iov[0].iov_base;
+
+	if (len < NLMSG_HDRLEN)
+		return;
+	if (nlh->nlmsg_pid == FROM_SPOOFER)
+		((struct sockaddr_nl *)m->msg_name)->nl_pid = 4321;
+	else if (nlh->nlmsg_pid == FROM_ODD)
+		m->msg_namelen--;
+}
+
+/* The library calls these instead of the ones in libc */
+int recvmmsg(int fd, struct mmsghdr *vec, unsigned int vlen, int flags,
+	struct timespec *tmo)
+{
+	int i, rc;
+
+	if (no_mmsg) {
+		errno = ENOSYS;
+		return -1;
+	}
+	rc = syscall(SYS_recvmmsg, fd, vec, vlen, flags, tmo);
+	for (i = 0; i < rc; i++)
+		forge(&vec[i].msg_hdr, vec[i].msg_len);
+	return rc;
+}
+
+ssize_t recvmsg(int fd, struct msghdr *m, int flags)
+{
+	ssize_t rc = syscall(SYS_recvmsg, fd, m, flags);
+
+	if (rc >= 0)
+		forge(m, rc);
+	return rc;
+}
+
+/*
+ * The library checks that replies come from an address the size of a
+ * netlink one with a port id of 0. An abstract unix socket name of 10
+ * bytes looks like that, with its bytes 2 to 5 where the port id goes.
+ */
+static int open_kernel(void)
+{
+	struct sockaddr_un addr;
+	int sv[2];
+	pid_t pid = getpid();
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+		return 1;
+	lib_fd = sv[0];
+	kern_fd = sv[1];
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(&addr.sun_path[6], &pid, sizeof(pid));
+	return bind(kern_fd, (struct sockaddr *)&addr,
+		offsetof(struct sockaddr_un, sun_path) + 10);
+}
+
+/* The messages each datagram holds, and what the test expects back */
+struct message {
+	int type;
+	int seq;
+};
+
+static struct message expected[SLOTS * 4 * MAX_MSGS];
+static int nexpected;
+static int next_seq = 1;
+
+/* Message text whose length changes so the messages need padding */
+static int text_of(int seq, char *text, size_t size)
+{
+	return snprintf(text, size, "seq=%d%.*s", seq, seq % 5, "xxxxx") + 1;
+}
+
+/* The last message of the next datagram says it is longer than it is */
+static int overlong;
+
+/*
+ * Sends a datagram of cnt messages as if from, with extra bytes of junk
+ * after them. If the messages are from the kernel, the iterator should
+ * hand them back.
+ */
+static void send_dgram(int from, int cnt, int extra)
+{
+	static union {
+		struct nlmsghdr nlh;
+		char data[MAX_MSGS * 64 + 64];
+	} buf;
+	unsigned int len = 0;
+	int i;
+
+	memset(&buf, 0, sizeof(buf));
+	for (i = 0; i < cnt; i++) {
+		struct nlmsghdr *nlh = (struct nlmsghdr *)(buf.data + len);
+		int size, seq = next_seq++;
+
+		size = text_of(seq, NLMSG_DATA(nlh), 64);
+		nlh->nlmsg_len = NLMSG_LENGTH(size);
+		// A mix of types, the last is often the end of a list
+		nlh->nlmsg_type = i == cnt - 1 && cnt > 2 ? NLMSG_DONE :
+			seq % 2 ? AUDIT_USER : AUDIT_LIST_RULES;
+		nlh->nlmsg_seq = seq;
+		nlh->nlmsg_pid = from;
+		len += NLMSG_SPACE(size);
+		if (overlong && i == cnt - 1) {
+			nlh->nlmsg_len += 64;
+			continue;
+		}
+		if (from == FROM_KERNEL) {
+			expected[nexpected].type = nlh->nlmsg_type;
+			expected[nexpected].seq = seq;
+			nexpected++;
+		}
+	}
+	overlong = 0;
+	len += extra;
+	if (send(kern_fd, &buf, len, 0) != (ssize_t)len)
+		printf("Can't send a datagram (%s)\n", strerror(errno));
+}
+
+/*
+ * Sends a datagram too big for the library's buffer. Its first message
+ * fits, but what came after it is lost so none of it can be trusted.
+ */
+static void send_too_big(void)
+{
+	size_t size = sizeof(struct audit_message) + 512;
+	struct nlmsghdr *nlh = calloc(1, size);
+
+	if (nlh == NULL)
+		return;
+	nlh->nlmsg_len = NLMSG_LENGTH(text_of(next_seq, NLMSG_DATA(nlh), 64));
+	nlh->nlmsg_type = AUDIT_USER;
+	nlh->nlmsg_seq = next_seq++;
+	if (send(kern_fd, nlh, size, 0) != (ssize_t)size)
+		printf("Can't send a datagram (%s)\n", strerror(errno));
+	free(nlh);
+}
+
+static void reset(void)
+{
+	nexpected = 0;
+}
+
+static int fail(const char *test, const char *what)
+{
+	printf("%s: %s\n", test, what);
+	return 1;
+}
+
+/* Checks rep is the nth message expected */
+static int check_reply(const char *test, const struct audit_reply *rep,
+	int n)
+{
+	char text[64];
+	int size;
+
+	if (n >= nexpected)
+		return fail(test, "too many messages were walked");
+	size = text_of(expected[n].seq, text, sizeof(text));
+	if (rep->type != expected[n].type ||
+			(int)rep->nlh->nlmsg_seq != expected[n].seq ||
+			rep->len != (int)NLMSG_LENGTH(size) ||
+			strcmp(NLMSG_DATA(rep->nlh), text)) {
+		printf("%s: message %d was type %d seq %d, not type %d seq "
+			"%d\n", test, n, rep->type, (int)rep->nlh->nlmsg_seq,
+			expected[n].type, expected[n].seq);
+		return 1;
+	}
+	if (rep->type == AUDIT_USER && rep->message != NLMSG_DATA(rep->nlh))
+		return fail(test, "the message text was not set");
+	if (rep->type == AUDIT_LIST_RULES &&
+			(void *)rep->ruledata != NLMSG_DATA(rep->nlh))
+		return fail(test, "the rule was not set");
+	return 0;
+}
+
+/*
+ * Receives what is queued, as many times as it takes, and walks all of
+ * it. Returns 0 if it got just the messages expected, in order.
+ */
+static int walk(const char *test, int datagrams)
+{
+	struct audit_reply rep;
+	audit_reply_iter *it;
+	int rc, n = 0, got = 0, errs = 0;
+
+	it = audit_reply_iter_new();
+	if (it == NULL)
+		return fail(test, "no iterator");
+	while ((rc = audit_reply_iter_recv(lib_fd, it,
+			GET_REPLY_NONBLOCKING)) > 0) {
+		if (rc > (no_mmsg ? 1 : SLOTS))
+			errs += fail(test, "too many datagrams at once");
+		got += rc;
+		while (audit_reply_iter_next(it, &rep))
+			errs += check_reply(test, &rep, n++);
+		// Once walked, there is nothing more
+		if (audit_reply_iter_next(it, &rep))
+			errs += fail(test, "the walk started again");
+	}
+	if (rc != -EAGAIN)
+		errs += fail(test, "the last receive didn't find nothing");
+	if (got != datagrams) {
+		printf("%s: received %d datagrams, not %d\n", test, got,
+			datagrams);
+		errs++;
+	}
+	if (n != nexpected) {
+		printf("%s: walked %d messages, not %d\n", test, n, nexpected);
+		errs++;
+	}
+	audit_reply_iter_free(it);
+	return errs;
+}
+
+/* Every message of every datagram is walked, more than fit at once */
+static int test_walk(const char *test)
+{
+	int i;
+
+	reset();
+	for (i = 0; i < SLOTS + 5; i++)
+		send_dgram(FROM_KERNEL, 1 + i % MAX_MSGS, 0);
+	return walk(test, SLOTS + 5);
+}
+
+/* Datagrams that can't be trusted are passed over */
+static int test_skip(const char *test)
+{
+	reset();
+	send_dgram(FROM_KERNEL, 2, 0);
+	send_dgram(FROM_SPOOFER, 3, 0);
+	send_dgram(FROM_KERNEL, 1, 0);
+	send_too_big();
+	send_dgram(FROM_ODD, 2, 0);
+	send_dgram(FROM_KERNEL, 3, 0);
+	// Junk too short for a message after the good ones
+	send_dgram(FROM_KERNEL, 2, 8);
+	// A message that says it is longer than what was sent
+	overlong = 1;
+	send_dgram(FROM_KERNEL, 3, 0);
+	send_dgram(FROM_KERNEL, 0, 0);
+	send_dgram(FROM_SPOOFER, 1, 0);
+	send_dgram(FROM_KERNEL, 4, 0);
+	return walk(test, 11);
+}
+
+/* Messages that were not walked are dropped by the next receive */
+static int test_drop(void)
+{
+	const char *test = "drop";
+	struct audit_reply rep;
+	audit_reply_iter *it;
+	int n = 0, errs = 0;
+
+	reset();
+	it = audit_reply_iter_new();
+	if (it == NULL)
+		return fail(test, "no iterator");
+	if (audit_reply_iter_next(it, &rep))
+		errs += fail(test, "a new iterator had a message");
+	if (audit_reply_iter_recv(lib_fd, it, GET_REPLY_NONBLOCKING) != -EAGAIN
+			|| audit_reply_iter_next(it, &rep))
+		errs += fail(test, "received something from nothing");
+	send_dgram(FROM_KERNEL, 3, 0);
+	if (audit_reply_iter_recv(lib_fd, it, GET_REPLY_BLOCKING) != 1 ||
+			!audit_reply_iter_next(it, &rep) ||
+			check_reply(test, &rep, 0))
+		errs += fail(test, "the first message was not walked");
+	// Finding nothing drops the two messages left
+	if (audit_reply_iter_recv(lib_fd, it, GET_REPLY_NONBLOCKING) != -EAGAIN
+			|| audit_reply_iter_next(it, &rep))
+		errs += fail(test, "messages were left after finding nothing");
+	send_dgram(FROM_KERNEL, 3, 0);
+	if (audit_reply_iter_recv(lib_fd, it, GET_REPLY_NONBLOCKING) != 1 ||
+			!audit_reply_iter_next(it, &rep))
+		errs += fail(test, "the next datagram was not received");
+	reset();
+	send_dgram(FROM_KERNEL, 2, 0);
+	if (audit_reply_iter_recv(lib_fd, it, GET_REPLY_NONBLOCKING) != 1)
+		errs += fail(test, "the last datagram was not received");
+	// The two messages left of the last one are gone
+	while (audit_reply_iter_next(it, &rep))
+		errs += check_reply(test, &rep, n++);
+	if (n != 2)
+		errs += fail(test, "the last datagram was not walked");
+	if (audit_reply_iter_recv(-1, it, GET_REPLY_NONBLOCKING) != -EBADF)
+		errs += fail(test, "a bad fd was used");
+	audit_reply_iter_free(it);
+	return errs;
+}
+
+int main(void)
+{
+	int errs = 0;
+
+	if (open_kernel()) {
+		printf("Can't make a fake kernel (%s)\n", strerror(errno));
+		return 1;
+	}
+	set_aumessage_mode(MSG_QUIET, DBG_NO);
+
+	errs += test_walk("walk");
+	errs += test_skip("skip");
+	errs += test_drop();
+	// The same, one datagram at a time
+	no_mmsg = 1;
+	errs += test_walk("walk one by one");
+	errs += test_skip("skip one by one");
+
+	close(lib_fd);
+	close(kern_fd);
+	if (errs == 0)
+		printf("5 tests passed\n");
+	return errs ? 1 : 0;
+}
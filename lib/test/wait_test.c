@@ -0,0 +1,389 @@
+/* wait_test.c -- A test of waiting for the replies to a request.
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * audit_wait_replies reads from one end of a socket pair here, and a
+ * fake kernel sends on the other. Each test scripts the datagrams the
+ * kernel sends and how long after the library starts waiting each one
+ * comes. The library's clock is fake too, so each wait is known to the
+ * millisecond: when the library polls, the clock moves on to the next
+ * datagram and it is sent, or to the deadline if that comes first.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+
+#include "../libaudit.h"
+
+#define SEQ 500		// The request waited for
+#define STEPS 8
+#define MSGS 4
+#define WAITS 16
+
+static int lib_fd = -1, kern_fd = -1;
+
+/* The datagrams the kernel sends, each after a delay in milliseconds */
+struct step {
+	int delay;
+	int cnt;
+	struct {
+		int type;
+		int seq;
+		int error;
+	} msgs[MSGS];
+};
+
+static const struct step *script;
+static int nsteps, cur;
+
+/* The timeout of each poll */
+static int waits[WAITS];
+static int nwaits;
+
+static long long now = 1000000;	// Milliseconds
+
+static void send_step(const struct step *s)
+{
+	union {
+		struct nlmsghdr nlh;
+		char data[MSGS * NLMSG_SPACE(sizeof(struct nlmsgerr))];
+	} buf;
+	unsigned int len = 0;
+	int i;
+
+	memset(&buf, 0, sizeof(buf));
+	for (i = 0; i < s->cnt; i++) {
+		struct nlmsghdr *nlh = (struct nlmsghdr *)(buf.data + len);
+		struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+		nlh->nlmsg_len = NLMSG_LENGTH(sizeof(*err));
+		nlh->nlmsg_type = s->msgs[i].type;
+		nlh->nlmsg_seq = s->msgs[i].seq;
+		err->error = s->msgs[i].error;
+		len += NLMSG_SPACE(sizeof(*err));
+	}
+	if (send(kern_fd, &buf, len, 0) != (ssize_t)len)
+		printf("Can't send a reply (%s)\n", strerror(errno));
+}
+
+/* The library calls these instead of the ones in libc */
+int clock_gettime(clockid_t clk, struct timespec *ts)
+{
+	if (clk != CLOCK_MONOTONIC)
+		return syscall(SYS_clock_gettime, clk, ts);
+	ts->tv_sec = now / 1000;
+	ts->tv_nsec = (now % 1000) * 1000000L;
+	return 0;
+}
+
+/*
+ * This doesn't include poll.h, whose declaration of poll says the fds
+ * aren't read.
+ */
+struct wait_fd {
+	int fd;
+	short events;
+	short revents;
+};
+
+int poll(struct wait_fd *fds, unsigned long nfds, int timeout)
+{
+	struct timespec ts = { 0, 0 };
+
+	if (nfds != 1 || fds[0].fd != lib_fd)
+		return syscall(SYS_ppoll, fds, nfds, timeout < 0 ? NULL : &ts,
+			NULL, (size_t)8);
+	if (nwaits < WAITS)
+		waits[nwaits++] = timeout;
+	if (cur == nsteps) {
+		// The kernel has nothing more to say
+		if (timeout < 0) {
+			errno = EDEADLK;
+			return -1;
+		}
+		now += timeout;
+		return 0;
+	}
+	if (timeout >= 0 && script[cur].delay > timeout) {
+		now += timeout;
+		return 0;
+	}
+	now += script[cur].delay;
+	send_step(&script[cur++]);
+	return syscall(SYS_ppoll, fds, nfds, &ts, NULL, (size_t)8);
+}
+
+/*
+ * The library checks that replies come from an address the size of a
+ * netlink one with a port id of 0. An abstract unix socket name of 10
+ * bytes looks like that, with its bytes 2 to 5 where the port id goes.
+ */
+static int open_kernel(void)
+{
+	struct sockaddr_un addr;
+	int sv[2];
+	pid_t pid = getpid();
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+		return 1;
+	lib_fd = sv[0];
+	kern_fd = sv[1];
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(&addr.sun_path[6], &pid, sizeof(pid));
+	return bind(kern_fd, (struct sockaddr *)&addr,
+		offsetof(struct sockaddr_un, sun_path) + 10);
+}
+
+/* What the handler was given, and when it stops the wait */
+struct seen {
+	int cnt;
+	int types[MSGS * STEPS];
+	int seqs[MSGS * STEPS];
+	int stop_at;	// The reply it stops at, counting from 1
+	int stop_with;
+};
+
+static int handler(struct audit_reply *rep, void *data)
+{
+	struct seen *s = data;
+
+	if (s->cnt < MSGS * STEPS) {
+		s->types[s->cnt] = rep->type;
+		s->seqs[s->cnt] = rep->nlh->nlmsg_seq;
+	}
+	s->cnt++;
+	if (s->cnt == s->stop_at)
+		return s->stop_with;
+	return 0;
+}
+
+/* Drops what is left of the last script */
+static void drain(void)
+{
+	char buf[256];
+
+	while (recv(lib_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		;
+}
+
+/*
+ * Runs a script and checks what came of it: the return code, the types
+ * of the replies the handler got, and the timeout of each poll.
+ */
+static int run(const char *test, const struct step *steps, int cnt,
+	int seq, struct seen *s, int timeout, int want_rc, const int *types,
+	int ntypes, const int *want_waits, int nwant)
+{
+	int i, rc, errs = 0;
+
+	drain();
+	script = steps;
+	nsteps = cnt;
+	cur = nwaits = 0;
+	errno = 0;
+	rc = audit_wait_replies(lib_fd, seq, s ? handler : NULL, s, timeout);
+	if (rc != want_rc || (rc && errno != -rc)) {
+		printf("%s: returned %d errno %d, not %d\n", test, rc, errno,
+			want_rc);
+		errs++;
+	}
+	if (s && s->cnt != ntypes) {
+		printf("%s: the handler got %d replies, not %d\n", test,
+			s->cnt, ntypes);
+		errs++;
+	}
+	for (i = 0; s && i < s->cnt && i < ntypes; i++) {
+		if (s->types[i] != types[i] || (seq && s->seqs[i] != seq)) {
+			printf("%s: reply %d was type %d seq %d\n", test, i,
+				s->types[i], s->seqs[i]);
+			errs++;
+		}
+	}
+	if (nwaits != nwant || (nwant && memcmp(waits, want_waits,
+			nwant * sizeof(int)))) {
+		printf("%s: waited", test);
+		for (i = 0; i < nwaits; i++)
+			printf(" %d", waits[i]);
+		printf(" ms\n");
+		errs++;
+	}
+	return errs;
+}
+
+/*
+ * Replies to other requests are passed over, and don't keep the wait
+ * going. Replies to this one do, so it lasts longer than the timeout.
+ */
+static const struct step stale[] = {
+	{ 600, 2, { { NLMSG_ERROR, SEQ - 1, -EPERM },
+		    { AUDIT_LIST_RULES, SEQ - 2, 0 } } },
+	{ 300, 3, { { AUDIT_LIST_RULES, SEQ + 1, 0 },
+		    { AUDIT_LIST_RULES, SEQ, 0 },
+		    { NLMSG_DONE, SEQ - 1, 0 } } },
+	{ 900, 1, { { AUDIT_LIST_RULES, SEQ, 0 } } },
+	{ 999, 2, { { NLMSG_ERROR, SEQ, 0 },
+		    { NLMSG_DONE, SEQ, 0 } } },
+	{ 10, 1, { { AUDIT_LIST_RULES, SEQ, 0 } } },
+};
+
+/* Stale replies alone run out the clock */
+static const struct step quiet[] = {
+	{ 600, 1, { { AUDIT_LIST_RULES, SEQ - 1, 0 } } },
+	{ 399, 1, { { NLMSG_ERROR, SEQ + 1, -EPERM } } },
+	{ 2, 1, { { AUDIT_LIST_RULES, SEQ, 0 } } },
+};
+
+/* Replies to any request */
+static const struct step any[] = {
+	{ 5, 3, { { AUDIT_LIST_RULES, SEQ - 1, 0 },
+		  { AUDIT_LIST_RULES, SEQ + 3, 0 },
+		  { NLMSG_DONE, SEQ + 7, 0 } } },
+};
+
+/* Rules and an ack in one datagram, then the end of the list */
+static const struct step list[] = {
+	{ 5, 4, { { AUDIT_LIST_RULES, SEQ, 0 },
+		  { AUDIT_LIST_RULES, SEQ, 0 },
+		  { NLMSG_ERROR, SEQ, 0 },
+		  { AUDIT_LIST_RULES, SEQ, 0 } } },
+	{ 5, 1, { { NLMSG_DONE, SEQ, 0 } } },
+	{ 5, 1, { { AUDIT_LIST_RULES, SEQ, 0 } } },
+};
+
+/* The request fails after a rule */
+static const struct step failed[] = {
+	{ 5, 3, { { AUDIT_LIST_RULES, SEQ, 0 },
+		  { NLMSG_ERROR, SEQ, -EEXIST },
+		  { AUDIT_LIST_RULES, SEQ, 0 } } },
+	{ 5, 1, { { NLMSG_DONE, SEQ, 0 } } },
+};
+
+/* Just an ack */
+static const struct step acked[] = {
+	{ 5, 2, { { NLMSG_ERROR, SEQ - 1, -EPERM },
+		  { NLMSG_ERROR, SEQ, 0 } } },
+	{ 5, 1, { { NLMSG_DONE, SEQ, 0 } } },
+};
+
+#define N(a) ((int)(sizeof(a)/sizeof(a[0])))
+
+int main(void)
+{
+	static const int stale_types[] = { AUDIT_LIST_RULES, AUDIT_LIST_RULES,
+		NLMSG_ERROR, NLMSG_DONE };
+	static const int stale_waits[] = { 1000, 400, 1000, 1000 };
+	static const int quiet_waits[] = { 1000, 400, 1 };
+	static const int any_types[] = { AUDIT_LIST_RULES, AUDIT_LIST_RULES,
+		NLMSG_DONE };
+	static const int list_types[] = { AUDIT_LIST_RULES, AUDIT_LIST_RULES,
+		NLMSG_ERROR, AUDIT_LIST_RULES, NLMSG_DONE };
+	static const int list_waits[] = { 50, 50 };
+	static const int forever[] = { -1, -1 };
+	static const int one_wait[] = { 50 };
+	static const int failed_types[] = { AUDIT_LIST_RULES, NLMSG_ERROR };
+	struct seen s;
+	int errs = 0;
+
+	if (open_kernel()) {
+		printf("Can't make a fake kernel (%s)\n", strerror(errno));
+		return 1;
+	}
+	set_aumessage_mode(MSG_QUIET, DBG_NO);
+
+	memset(&s, 0, sizeof(s));
+	errs += run("stale", stale, N(stale), SEQ, &s, 1000, 0, stale_types,
+		N(stale_types), stale_waits, N(stale_waits));
+
+	memset(&s, 0, sizeof(s));
+	errs += run("timeout", quiet, N(quiet), SEQ, &s, 1000, -ETIMEDOUT,
+		NULL, 0, quiet_waits, N(quiet_waits));
+
+	// Any request's replies with no sequence number
+	memset(&s, 0, sizeof(s));
+	errs += run("any", any, N(any), 0, &s, 50, 0, any_types,
+		N(any_types), one_wait, 1);
+	if (s.seqs[0] != SEQ - 1 || s.seqs[1] != SEQ + 3 ||
+			s.seqs[2] != SEQ + 7) {
+		printf("any: replies were passed over\n");
+		errs++;
+	}
+
+	memset(&s, 0, sizeof(s));
+	errs += run("done", list, N(list), SEQ, &s, 50, 0, list_types,
+		N(list_types), list_waits, N(list_waits));
+
+	// Never giving up
+	memset(&s, 0, sizeof(s));
+	errs += run("forever", list, N(list), SEQ, &s, -1, 0, list_types,
+		N(list_types), forever, N(forever));
+
+	// The handler ends the request early, or stops with an error
+	memset(&s, 0, sizeof(s));
+	s.stop_at = 2;
+	s.stop_with = 1;
+	errs += run("handler done", list, N(list), SEQ, &s, 50, 0,
+		list_types, 2, one_wait, 1);
+	memset(&s, 0, sizeof(s));
+	s.stop_at = 4;
+	s.stop_with = -EPERM;
+	errs += run("handler error", list, N(list), SEQ, &s, 50, -EPERM,
+		list_types, 4, one_wait, 1);
+
+	// What the handler says wins over the reply it was given
+	memset(&s, 0, sizeof(s));
+	s.stop_at = 5;
+	s.stop_with = -EPERM;
+	errs += run("handler error at the end", list, N(list), SEQ, &s, 50,
+		-EPERM, list_types, N(list_types), list_waits, N(list_waits));
+	memset(&s, 0, sizeof(s));
+	s.stop_at = 2;
+	s.stop_with = 1;
+	errs += run("handler done at an error", failed, N(failed), SEQ, &s,
+		50, 0, failed_types, N(failed_types), one_wait, 1);
+
+	// An error ack ends it, the handler seeing it first
+	memset(&s, 0, sizeof(s));
+	errs += run("error ack", failed, N(failed), SEQ, &s, 50, -EEXIST,
+		failed_types, N(failed_types), one_wait, 1);
+	errs += run("no handler error", failed, N(failed), SEQ, NULL, 50,
+		-EEXIST, NULL, 0, one_wait, 1);
+
+	// Without a handler, an ack is the end of it
+	errs += run("no handler", acked, N(acked), SEQ, NULL, 50, 0, NULL, 0,
+		one_wait, 1);
+
+	if (audit_wait_replies(-1, SEQ, handler, &s, 50) != -EBADF)
+		errs++;
+
+	close(lib_fd);
+	close(kern_fd);
+	if (errs == 0)
+		printf("13 tests passed\n");
+	return errs ? 1 : 0;
+}
@@ -0,0 +1,399 @@
+/*
+* auditctl-cache.c - Keep built rules from one load of a file for the next
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * Building a rule looks up syscall, field, user, and group names, which
+ * is most of what auditctl -R spends in user space. With --rule-cache,
+ * a load that goes without errors saves the rules as they were sent,
+ * and the lines that aren't add rules as they were read. The next load
+ * of the same text sends the saved rules without parsing them.
+ *
+ * The cache is keyed on a hash of the text of the rules file and of
+ * everything else the built rules depend on: the machine type used for
+ * syscall names, the kernel release and audit features, and the user
+ * and group databases. If any of them changed, the file is parsed again
+ * and the cache is written anew.
+ *
+ * The file starts with a header holding the key and a hash of the rest.
+ * Each entry is a small header followed by the rule, or by the fields of
+ * the line one after the other. Entries are padded to 8 bytes so rules
+ * can be used where they are.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include "libaudit.h"
+#include "private.h"
+#include "auditctl-cache.h"
+
+#define CACHE_MAGIC	"AURULES"
+#define CACHE_VERSION	1
+#define CACHE_MAX	(64*1024*1024)	// Bigger than any sane rules file
+
+struct cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t rule_size;	// sizeof(struct audit_rule_data)
+	uint64_t key;
+	uint64_t sum;		// Hash of the entries
+	uint32_t count;		// Number of entries
+	uint32_t size;		// Bytes of entries
+};
+
+struct cache_entry {
+	uint32_t type;
+	uint32_t lineno;
+	uint32_t size;		// Bytes of data, without the padding
+	uint32_t count;		// Number of fields of a line
+};
+
+#define PAD(x) (((x) + 7) & ~7)
+
+static char *buf = NULL;	// Entries being recorded or loaded
+static size_t buf_len = 0, buf_size = 0, buf_pos = 0;
+static uint32_t entries = 0;
+static int lost = 0;		// An entry didn't fit, the cache is no good
+static char **item_fields = NULL;
+
+static uint64_t hash64(uint64_t h, const void *ptr, size_t len)
+{
+	const unsigned char *p = ptr;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ p[i]) * 1099511628211ULL;
+	return h;
+}
+
+/* Folds in what can change user and group names into ids */
+static uint64_t hash_file_stamp(uint64_t h, const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) == 0) {
+		h = hash64(h, &st.st_ino, sizeof(st.st_ino));
+		h = hash64(h, &st.st_size, sizeof(st.st_size));
+		h = hash64(h, &st.st_mtime, sizeof(st.st_mtime));
+	}
+	return hash64(h, path, strlen(path));
+}
+
+/* Keeps the feature bits of the reply */
+static int feature_reply(struct audit_reply *rep, void *data)
+{
+	const struct audit_features *f;
+
+	if (rep->type != AUDIT_GET_FEATURE)
+		return 0;
+	f = NLMSG_DATA(rep->nlh);
+	*(uint64_t *)data = ((uint64_t)f->lock << 32) | f->features;
+	return 1;
+}
+
+/* Returns the audit feature bits of the kernel, 0 if it has none */
+static uint64_t kernel_features(int fd)
+{
+	uint64_t features = 0;
+	int seq;
+
+	seq = audit_request_features(fd);
+	if (seq <= 0)
+		return 0;
+	if (audit_wait_replies(fd, seq, feature_reply, &features, 4000))
+		return 0;
+	return features;
+}
+
+uint64_t cache_key(int fd, const char *text, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL, features;
+	struct utsname uts;
+	int machine;
+
+	h = hash64(h, text, len);
+	machine = audit_detect_machine();
+	h = hash64(h, &machine, sizeof(machine));
+	if (uname(&uts) == 0)
+		h = hash64(h, uts.release, strlen(uts.release));
+	features = kernel_features(fd);
+	h = hash64(h, &features, sizeof(features));
+	h = hash_file_stamp(h, "/etc/passwd");
+	h = hash_file_stamp(h, "/etc/group");
+	return h;
+}
+
+/* Makes room for an entry with size bytes of data and returns it */
+static struct cache_entry *add_entry(int type, int lineno, size_t size)
+{
+	struct cache_entry *e;
+	size_t need = sizeof(struct cache_entry) + PAD(size);
+
+	if (buf_len + need > buf_size) {
+		size_t new_size = buf_size ? buf_size * 2 : 65536;
+		char *tmp;
+
+		while (new_size < buf_len + need)
+			new_size *= 2;
+		tmp = realloc(buf, new_size);
+		if (tmp == NULL) {
+			lost = 1;
+			return NULL;
+		}
+		buf = tmp;
+		buf_size = new_size;
+	}
+	e = (struct cache_entry *)(buf + buf_len);
+	memset(e, 0, need);
+	e->type = type;
+	e->lineno = lineno;
+	e->size = size;
+	buf_len += need;
+	entries++;
+	return e;
+}
+
+void cache_add_rule(const struct audit_rule_data *r, int lineno)
+{
+	size_t size = sizeof(struct audit_rule_data) + r->buflen;
+	struct cache_entry *e = add_entry(CACHE_RULE, lineno, size);
+
+	if (e)
+		memcpy(e + 1, r, size);
+}
+
+void cache_add_line(int count, char *const fields[], int lineno)
+{
+	struct cache_entry *e;
+	size_t size = 0;
+	char *ptr;
+	int i;
+
+	for (i = 0; i < count; i++)
+		size += strlen(fields[i]) + 1;
+	e = add_entry(CACHE_LINE, lineno, size);
+	if (e == NULL)
+		return;
+	e->count = count;
+	ptr = (char *)(e + 1);
+	for (i = 0; i < count; i++) {
+		size_t len = strlen(fields[i]) + 1;
+
+		memcpy(ptr, fields[i], len);
+		ptr += len;
+	}
+}
+
+int cache_save(const char *path, uint64_t key)
+{
+	struct cache_header h;
+	char *tmp;
+	int fd, rc = 0;
+
+	if (buf == NULL || lost)
+		return -1;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+	h.version = CACHE_VERSION;
+	h.rule_size = sizeof(struct audit_rule_data);
+	h.key = key;
+	h.sum = hash64(14695981039346656037ULL, buf, buf_len);
+	h.count = entries;
+	h.size = buf_len;
+
+	// Write it next to the old one and swap them
+	if (asprintf(&tmp, "%s.tmp", path) < 0)
+		return -1;
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC|O_NOFOLLOW, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "Error creating %s (%s)\n", tmp,
+			strerror(errno));
+		free(tmp);
+		return -1;
+	}
+	if (write(fd, &h, sizeof(h)) != sizeof(h) ||
+			write(fd, buf, buf_len) != (ssize_t)buf_len ||
+			fsync(fd) < 0)
+		rc = -1;
+	if (close(fd) < 0)
+		rc = -1;
+	if (rc == 0 && rename(tmp, path) < 0)
+		rc = -1;
+	if (rc) {
+		fprintf(stderr, "Error writing %s (%s)\n", path,
+			strerror(errno));
+		unlink(tmp);
+	}
+	free(tmp);
+	return rc;
+}
+
+/* Checks that each entry lies inside the cache and is well formed */
+static int check_entries(uint32_t count)
+{
+	size_t pos = 0;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		const struct cache_entry *e;
+		const char *data;
+
+		if (buf_len - pos < sizeof(struct cache_entry))
+			return -1;
+		e = (const struct cache_entry *)(buf + pos);
+		data = (const char *)(e + 1);
+		pos += sizeof(struct cache_entry);
+		if (e->size > buf_len - pos || PAD(e->size) > buf_len - pos)
+			return -1;
+		if (e->type == CACHE_RULE) {
+			const struct audit_rule_data *r =
+				(const struct audit_rule_data *)data;
+
+			if (e->size < sizeof(struct audit_rule_data) ||
+				    e->size != sizeof(struct audit_rule_data) +
+						r->buflen ||
+				    r->field_count > AUDIT_MAX_FIELDS)
+				return -1;
+		} else if (e->type == CACHE_LINE) {
+			const char *ptr = data, *end = data + e->size;
+			uint32_t n = 0;
+
+			if (e->size == 0 || end[-1] != 0 || e->count < 2)
+				return -1;
+			while (ptr < end) {
+				ptr += strlen(ptr) + 1;
+				n++;
+			}
+			if (n != e->count)
+				return -1;
+		} else
+			return -1;
+		pos += PAD(e->size);
+	}
+	return pos == buf_len ? 0 : -1;
+}
+
+int cache_load(const char *path, uint64_t key)
+{
+	struct cache_header h;
+	struct stat st;
+	int fd, rc = -1;
+
+	cache_clear();
+	fd = open(path, O_RDONLY|O_NOFOLLOW);
+	if (fd < 0)
+		return 1;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_uid != 0 ||
+			(st.st_mode & (S_IWGRP|S_IWOTH))) {
+		fprintf(stderr, "Error - %s isn't a root only file\n", path);
+		goto out;
+	}
+	if (read(fd, &h, sizeof(h)) != sizeof(h) ||
+			memcmp(h.magic, CACHE_MAGIC, sizeof(h.magic)))
+		goto out;
+	if (h.version != CACHE_VERSION ||
+			h.rule_size != sizeof(struct audit_rule_data) ||
+			h.key != key) {
+		rc = 1;		// Written for other rules
+		goto out;
+	}
+	if (h.size > CACHE_MAX || (off_t)(sizeof(h) + h.size) != st.st_size)
+		goto out;
+	buf = malloc(h.size + 1);
+	if (buf == NULL)
+		goto out;
+	buf_size = h.size + 1;
+	buf_len = h.size;
+	if (read(fd, buf, buf_len) != (ssize_t)buf_len)
+		goto out;
+	if (hash64(14695981039346656037ULL, buf, buf_len) != h.sum ||
+			check_entries(h.count))
+		goto out;
+	entries = h.count;
+	buf_pos = 0;
+	rc = 0;
+out:
+	close(fd);
+	if (rc) {
+		if (rc < 0)
+			fprintf(stderr, "Ignoring damaged rule cache %s\n",
+				path);
+		cache_clear();
+	}
+	return rc;
+}
+
+int cache_next(struct cache_item *it)
+{
+	const struct cache_entry *e;
+	char *ptr;
+	uint32_t i;
+
+	if (buf == NULL || buf_pos >= buf_len)
+		return 0;
+	e = (const struct cache_entry *)(buf + buf_pos);
+	buf_pos += sizeof(struct cache_entry) + PAD(e->size);
+	it->type = e->type;
+	it->lineno = e->lineno;
+	it->rule = NULL;
+	it->size = 0;
+	it->count = 0;
+	it->fields = NULL;
+	if (e->type == CACHE_RULE) {
+		it->rule = (const struct audit_rule_data *)(e + 1);
+		it->size = e->size;
+		return 1;
+	}
+
+	free(item_fields);
+	item_fields = malloc((e->count + 1) * sizeof(char *));
+	if (item_fields == NULL)
+		return 0;
+	ptr = (char *)(e + 1);
+	for (i = 0; i < e->count; i++) {
+		item_fields[i] = ptr;
+		ptr += strlen(ptr) + 1;
+	}
+	item_fields[i] = NULL;
+	it->count = e->count;
+	it->fields = item_fields;
+	return 1;
+}
+
+void cache_clear(void)
+{
+	free(buf);
+	buf = NULL;
+	buf_len = buf_size = buf_pos = 0;
+	entries = 0;
+	lost = 0;
+	free(item_fields);
+	item_fields = NULL;
+}
+
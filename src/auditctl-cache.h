@@ -0,0 +1,65 @@
+/*
+* auditctl-cache.h - Header file for auditctl-cache.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef CTLCACHE_HEADER
+#define CTLCACHE_HEADER
+
+#include "config.h"
+#include <stdint.h>
+#include "libaudit.h"
+
+/* The kinds of entries in a cache */
+#define CACHE_RULE	1	// A built rule ready to be sent
+#define CACHE_LINE	2	// Any other line, run as it was read
+
+/* One entry of a loaded cache */
+struct cache_item {
+	int type;
+	int lineno;
+	const struct audit_rule_data *rule;	// CACHE_RULE, in the cache
+	size_t size;				// Size of the rule
+	int count;				// CACHE_LINE
+	char **fields;				// Valid until the next item
+};
+
+/* Works out the key a cache of the rules file text has to carry: a hash
+ * of the text and of what building the rules depends on. */
+uint64_t cache_key(int fd, const char *text, size_t len);
+
+/* Recording the lines of a rules file as they are loaded */
+void cache_add_rule(const struct audit_rule_data *r, int lineno);
+void cache_add_line(int count, char *const fields[], int lineno);
+/* Writes what was recorded to path. Returns 0 on success. */
+int cache_save(const char *path, uint64_t key);
+
+/* Reads the cache at path. Returns 0 if it is valid for the key, 1 if
+ * there is none or it is stale, and -1 if it is damaged. */
+int cache_load(const char *path, uint64_t key);
+/* Fills in the next entry. Returns 1 if there was one, 0 at the end. */
+int cache_next(struct cache_item *it);
+
+/* Drops what was recorded or loaded */
+void cache_clear(void);
+
+#endif
+
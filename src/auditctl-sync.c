@@ -0,0 +1,333 @@
+/*
+* auditctl-sync.c - Bring the kernel rules in line with a rules file
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * auditctl --sync lists the rules in the kernel and compares them with
+ * the ones in the rules file instead of deleting all rules and adding
+ * them again. The kernel stops at the first rule of a filter list that
+ * matches, so the order of the rules in a list matters. Rules can only
+ * be added at the ends of a list, which means the rules that stay have
+ * to be a run of the rules of the file for that list, in the same order.
+ * Loaded rules that are not among them are deleted, the rules of the
+ * file in front of the run are put at the head of the list, and the
+ * ones after it are appended. Adding or removing a rule only sends that
+ * rule if it is at either end of a list or removed. Changing a rule in
+ * the middle of a list sends the rules on the shorter side of it again.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "libaudit.h"
+#include "private.h"
+#include "auditctl-llist.h"
+#include "auditctl-sync.h"
+
+/* Only the list a rule is on matters, not where it was put in it */
+static inline int rule_list(const struct audit_rule_data *r)
+{
+	return r->flags & AUDIT_FILTER_MASK;
+}
+
+static uint32_t hash_bytes(uint32_t h, const void *ptr, size_t len)
+{
+	const unsigned char *p = ptr;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ p[i]) * 16777619U;
+	return h;
+}
+
+/*
+ * This function hashes the parts of a rule the kernel keeps, so a rule
+ * from a file hashes the same as its copy listed by the kernel.
+ */
+uint32_t rule_hash(const struct audit_rule_data *r)
+{
+	uint32_t h = 2166136261U, list = rule_list(r);
+	size_t n = r->field_count;
+
+	h = hash_bytes(h, &list, sizeof(list));
+	h = hash_bytes(h, &r->action, sizeof(r->action));
+	h = hash_bytes(h, &r->field_count, sizeof(r->field_count));
+	h = hash_bytes(h, r->mask, sizeof(r->mask));
+	h = hash_bytes(h, r->fields, n * sizeof(r->fields[0]));
+	h = hash_bytes(h, r->values, n * sizeof(r->values[0]));
+	h = hash_bytes(h, r->fieldflags, n * sizeof(r->fieldflags[0]));
+	h = hash_bytes(h, &r->buflen, sizeof(r->buflen));
+	return hash_bytes(h, r->buf, r->buflen);
+}
+
+/* Returns 1 if the kernel would treat both rules as the same rule */
+int rule_same(const struct audit_rule_data *a,
+	const struct audit_rule_data *b)
+{
+	size_t n;
+
+	if (rule_list(a) != rule_list(b) || a->action != b->action ||
+			a->field_count != b->field_count ||
+			a->buflen != b->buflen)
+		return 0;
+	n = a->field_count;
+	if (memcmp(a->mask, b->mask, sizeof(a->mask)) ||
+			memcmp(a->fields, b->fields, n * sizeof(a->fields[0])) ||
+			memcmp(a->values, b->values, n * sizeof(a->values[0])) ||
+			memcmp(a->fieldflags, b->fieldflags,
+				n * sizeof(a->fieldflags[0])) ||
+			memcmp(a->buf, b->buf, a->buflen))
+		return 0;
+	return 1;
+}
+
+/* A loaded rule of the list being worked on */
+struct hpos {
+	uint32_t hash;
+	int pos;	// Where it is in the list
+	int idx;	// Where it is in the caller's array
+};
+
+static int hpos_cmp(const void *a, const void *b)
+{
+	const struct hpos *x = a, *y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return x->pos - y->pos;
+}
+
+/*
+ * This function looks for a loaded copy of a wanted rule that comes
+ * after the one at prev. Returns its entry or NULL if there isn't one.
+ */
+static const struct hpos *find(const struct hpos *hp, int cnt,
+	struct audit_rule_data **have, const struct audit_rule_data *r,
+	uint32_t hash, int prev)
+{
+	int lo = 0, hi = cnt;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (hp[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < cnt && hp[lo].hash == hash; lo++) {
+		if (hp[lo].pos > prev && rule_same(have[hp[lo].idx], r))
+			return &hp[lo];
+	}
+	return NULL;
+}
+
+/*
+ * For each list, the rules that stay are the longest run of wanted rules
+ * that are loaded in the same order. The wanted rules in front of it are
+ * put at the head of the list and the ones after it are appended.
+ */
+void sync_diff(struct audit_rule_data **have, int have_cnt,
+	struct audit_rule_data **want, int want_cnt, int *keep, int *loaded)
+{
+	const struct hpos *h;
+	struct hpos *hp;
+	uint32_t *whash;
+	int i, j, l, n, prev, len, start, best, best_len, best_end;
+
+	for (i = 0; i < have_cnt; i++)
+		keep[i] = 0;
+	for (i = 0; i < want_cnt; i++)
+		loaded[i] = SYNC_APPEND;
+	hp = malloc((have_cnt + 1) * sizeof(struct hpos));
+	whash = malloc((want_cnt + 1) * sizeof(uint32_t));
+	if (hp == NULL || whash == NULL)
+		goto out;	// Everything gets loaded again
+	for (j = 0; j < want_cnt; j++)
+		whash[j] = rule_hash(want[j]);
+
+	for (l = 0; l <= AUDIT_FILTER_MASK; l++) {
+		for (i = 0, n = 0; i < have_cnt; i++) {
+			if (rule_list(have[i]) != l)
+				continue;
+			hp[n].hash = rule_hash(have[i]);
+			hp[n].pos = n;
+			hp[n++].idx = i;
+		}
+		if (n == 0)
+			continue;
+		qsort(hp, n, sizeof(struct hpos), hpos_cmp);
+
+		// Find the longest run
+		best = best_len = best_end = 0;
+		start = len = 0;
+		prev = -1;
+		for (j = 0; j < want_cnt; j++) {
+			if (rule_list(want[j]) != l)
+				continue;
+			h = find(hp, n, have, want[j], whash[j], prev);
+			if (h == NULL) {
+				// Out of order, a run can start here
+				start = j;
+				len = 0;
+				h = find(hp, n, have, want[j], whash[j], -1);
+				if (h == NULL) {
+					start = j + 1;
+					prev = -1;
+					continue;
+				}
+			}
+			prev = h->pos;
+			if (++len > best_len) {
+				best = start;
+				best_len = len;
+				best_end = j + 1;
+			}
+		}
+
+		prev = -1;
+		for (j = 0; j < want_cnt; j++) {
+			if (rule_list(want[j]) != l)
+				continue;
+			if (j < best)
+				loaded[j] = SYNC_PREPEND;
+			else if (j < best_end) {
+				h = find(hp, n, have, want[j], whash[j], prev);
+				if (h == NULL)
+					continue;
+				keep[h->idx] = 1;
+				loaded[j] = SYNC_LOADED;
+				prev = h->pos;
+			}
+		}
+	}
+out:
+	free(hp);
+	free(whash);
+}
+
+/* Keeps each rule listed */
+static int list_reply(struct audit_reply *rep, void *data)
+{
+	if (rep->type == AUDIT_LIST_RULES)
+		list_append(data, rep->ruledata,
+			sizeof(struct audit_rule_data) +
+			rep->ruledata->buflen);
+	return 0;
+}
+
+/* Reads all rules the kernel has into the list. Returns 0 on success. */
+static int get_rules(int fd, llist *l)
+{
+	int seq, rc;
+
+	seq = audit_request_rules_list_data(fd);
+	if (seq <= 0)
+		return -1;
+	rc = audit_wait_replies(fd, seq, list_reply, l, 40000);
+	if (rc < 0) {
+		fprintf(stderr, "Error receiving rules list (%s)\n",
+			strerror(-rc));
+		return -1;
+	}
+	return 0;
+}
+
+int sync_rules(int fd, struct audit_rule_data **want, int cnt, int *loaded)
+{
+	struct audit_rule_data **have = NULL, **gone = NULL;
+	int i, n = 0, rc = -1, *keep = NULL, *errors = NULL;
+	llist l;
+	lnode *node;
+
+	list_create(&l);
+	if (get_rules(fd, &l))
+		goto out;
+	have = malloc((l.cnt + 1) * sizeof(struct audit_rule_data *));
+	gone = malloc((l.cnt + 1) * sizeof(struct audit_rule_data *));
+	keep = malloc((l.cnt + 1) * sizeof(int));
+	errors = malloc((l.cnt + 1) * sizeof(int));
+	if (have == NULL || gone == NULL || keep == NULL || errors == NULL) {
+		fprintf(stderr, "Out of memory syncing rules\n");
+		goto out;
+	}
+	list_first(&l);
+	for (i = 0, node = l.cur; node; node = list_next(&l))
+		have[i++] = node->r;
+	sync_diff(have, l.cnt, want, cnt, keep, loaded);
+
+	for (i = 0; i < (int)l.cnt; i++) {
+		if (keep[i] == 0)
+			gone[n++] = have[i];
+	}
+	rc = 0;
+	if (n && audit_delete_rules_batch(fd, gone, n, errors)) {
+		for (i = 0; i < n; i++) {
+			if (errors[i] == 0 || errors[i] == -ENOENT)
+				continue;
+			fprintf(stderr, "Error deleting rule (%s)\n",
+				strerror(-errors[i]));
+			rc = -1;
+			break;
+		}
+	}
+out:
+	list_clear(&l);
+	free(have);
+	free(gone);
+	free(keep);
+	free(errors);
+	return rc;
+}
+
+int load_rules(int fd, struct audit_rule_data **rules, int cnt, int *errors,
+	int stop)
+{
+	int i, j, rc;
+
+	audit_add_rules_batch(fd, rules, cnt, errors);
+	for (i = 0; i < cnt; i++) {
+		struct audit_rule_data *rule = rules[i];
+
+		/* Retry for legacy kernels */
+		if (errors[i] == -EINVAL && rule->fields[0] == AUDIT_DIR) {
+			rule->fields[0] = AUDIT_WATCH;
+			rc = audit_add_rule_data(fd, rule, rule->flags,
+						rule->action);
+			errors[i] = rc > 0 ? 0 : rc ? rc : -EIO;
+		}
+		if (errors[i] && (stop || errors[i] == -ECONNREFUSED))
+			break;
+	}
+	if (i == cnt || errors[i] == -ECONNREFUSED)
+		return i;
+
+	// Take back what was loaded past the rule that stopped us
+	for (j = cnt - 1; j > i; j--) {
+		if (errors[j] == 0)
+			audit_delete_rule_data(fd, rules[j], rules[j]->flags,
+						rules[j]->action);
+	}
+	return i;
+}
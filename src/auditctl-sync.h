@@ -0,0 +1,55 @@
+/*
+* auditctl-sync.h - Header file for auditctl-sync.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef CTLSYNC_HEADER
+#define CTLSYNC_HEADER
+
+#include "config.h"
+#include <stdint.h>
+#include "libaudit.h"
+
+/* What has to be done for a wanted rule */
+#define SYNC_APPEND	0	// Add it at the end of its list
+#define SYNC_LOADED	1	// It's loaded where it should be
+#define SYNC_PREPEND	2	// Add it at the head of its list
+
+uint32_t rule_hash(const struct audit_rule_data *r);
+int rule_same(const struct audit_rule_data *a,
+	const struct audit_rule_data *b);
+/* Works out which of the loaded rules in have can stay, setting keep[i],
+ * and what to do with each wanted rule in loaded[j]. The wanted rules
+ * are in the order they have to end up in. */
+void sync_diff(struct audit_rule_data **have, int have_cnt,
+	struct audit_rule_data **want, int want_cnt, int *keep, int *loaded);
+/* Deletes the kernel rules that are not wanted and fills in loaded[j] as
+ * sync_diff does. The caller adds the rules that aren't loaded, the ones
+ * to prepend last first. Returns 0 on success and -1 on error. */
+int sync_rules(int fd, struct audit_rule_data **want, int cnt, int *loaded);
+/* Adds the rules in a batch, putting 0 or -errno for each in errors. If
+ * stop is set, loading stops at the first rule that fails and the rules
+ * after it that were added are deleted again. Returns the index of the
+ * rule that stopped loading, or cnt. */
+int load_rules(int fd, struct audit_rule_data **rules, int cnt, int *errors,
+	int stop);
+
+#endif
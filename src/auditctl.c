@@ -38,6 +38,8 @@
 #include <limits.h>	/* PATH_MAX */
 #include "libaudit.h"
 #include "auditctl-listing.h"
+#include "auditctl-sync.h"
+#include "auditctl-cache.h"
 #include "private.h"
 
 /* This define controls the size of the line that we will request when
@@ -48,7 +50,7 @@
 
 /* Global functions */
 static int handle_request(int status);
-static void get_reply(void);
+static void get_reply(int seq);
 extern int delete_all_rules(int fd);
 
 /* Global vars */
@@ -61,6 +63,10 @@ static int add = AUDIT_FILTER_UNSET, del = AUDIT_FILTER_UNSET, action = -1;
 static int ignore = 0, continue_error = 0;
 static int exclude = 0;
 static int multiple = 0;
+static int syncing = 0;
+static const char *cache_file = NULL;
+static int caching = 0, load_errors = 0;
+static int reply_seq = 0;	// Request whose reply handle_request prints
 static struct audit_rule_data *rule_new = NULL;
 
 /*
@@ -128,7 +134,9 @@ static void usage(void)
      "    -v                  Version\n"
      "    -w <path>           Insert watch at <path>\n"
      "    -W <path>           Remove watch at <path>\n"
-     "    --loginuid-immutable   Make loginuids unchangeable once set"
+     "    --loginuid-immutable   Make loginuids unchangeable once set\n"
+     "    --rule-cache <file> With -R or --sync, keep the built rules in <file>\n"
+     "    --sync <file>       Change the loaded rules to the ones in <file>"
      );
 }
 
@@ -167,7 +175,8 @@ static int lookup_action(const char *str, int *act)
  * Returns 0 ok, 1 deprecated action, 2 rule error,
  * 3 multiple rule insert/delete
  */
-static int audit_rule_setup(char *opt, int *filter, int *act, int lineno)
+static int audit_rule_setup(char *opt, int *filter, int *act, int lineno,
+		FILE *err)
 {
 	int rc;
 	char *p;
@@ -209,11 +218,11 @@ static int audit_rule_setup(char *opt, int *filter, int *act, int lineno)
 	/* Consolidate rules on exit filter */
 	if (*filter == AUDIT_FILTER_ENTRY) {
 		*filter = AUDIT_FILTER_EXIT;
-		fprintf(stderr,
+		fprintf(err,
 		    "Warning - entry rules deprecated, changing to exit rule");
 		if (lineno)
-			fprintf(stderr, " in line %d", lineno);
-		fprintf(stderr, "\n");
+			fprintf(err, " in line %d", lineno);
+		fprintf(err, "\n");
 	}
 
 	return 0;
@@ -223,17 +232,17 @@ static int audit_rule_setup(char *opt, int *filter, int *act, int lineno)
  * This function will check the path before accepting it. It returns
  * 1 on error and 0 on success.
  */
-static int check_path(const char *path)
+static int check_path(const char *path, FILE *err)
 {
 	char *ptr, *base;
 	size_t nlen;
 	size_t plen = strlen(path);
 	if (plen >= PATH_MAX) {
-		fprintf(stderr, "The path passed for the watch is too big\n");
+		fprintf(err, "The path passed for the watch is too big\n");
 		return 1;
 	}
 	if (path[0] != '/') {
-		fprintf(stderr, "The path must start with '/'\n");
+		fprintf(err, "The path must start with '/'\n");
 		return 1;
 	}
 	ptr = strdup(path);
@@ -241,16 +250,16 @@ static int check_path(const char *path)
 	nlen = strlen(base);
 	free(ptr);
 	if (nlen > NAME_MAX) {
-		fprintf(stderr, "The base name of the path is too big\n");
+		fprintf(err, "The base name of the path is too big\n");
 		return 1;
 	}
 
 	/* These are warnings, not errors */
 	if (strstr(path, ".."))
-		fprintf(stderr, 
+		fprintf(err, 
 			"Warning - relative path notation is not supported\n");
 	if (strchr(path, '*') || strchr(path, '?'))
-		fprintf(stderr, 
+		fprintf(err, 
 			"Warning - wildcard notation is not supported\n");
 
 	return 0;
@@ -262,13 +271,14 @@ static int check_path(const char *path)
  * down to <name> (of terminating file or directory). 
  * Returns a 1 on success & -1 on failure.
  */
-static int audit_setup_watch_name(struct audit_rule_data **rulep, char *path)
+static int audit_setup_watch_name(struct audit_rule_data **rulep, char *path,
+		FILE *err)
 {
 	int type = AUDIT_WATCH;
 	size_t len;
 	struct stat buf;
 
-	if (check_path(path))
+	if (check_path(path, err))
 		return -1;
 
 	// Trim trailing '/' should they exist
@@ -294,7 +304,8 @@ static int audit_setup_watch_name(struct audit_rule_data **rulep, char *path)
  * Setup a watch permissions.
  * Returns a 1 on success & -1 on failure.
  */
-static int audit_setup_perms(struct audit_rule_data *rule, const char *opt)
+static int audit_setup_perms(struct audit_rule_data *rule, const char *opt,
+		FILE *err)
 {
 	unsigned int i, len, val = 0;
 
@@ -317,7 +328,7 @@ static int audit_setup_perms(struct audit_rule_data *rule, const char *opt)
 				val |= AUDIT_PERM_ATTR;
 				break;
 			default:
-				fprintf(stderr,
+				fprintf(err,
 					"Permission %c isn't supported\n",
 					opt[i]);
 				return -1;
@@ -360,7 +371,7 @@ static int lookup_iseverity(const char *severity)
 }
 
 /* 0 success, -1 failure */
-static int check_ids_key(const char *k)
+static int check_ids_key(const char *k, FILE *err)
 {
 	char *ptr, *kindptr, *ratingptr;
 	char keyptr[AUDIT_MAX_KEY_LEN+1];
@@ -385,17 +396,17 @@ static int check_ids_key(const char *k)
 		goto fail_exit;
 
 	if (lookup_itype(kindptr)) {
-		fprintf(stderr, "ids key type is bad\n");
+		fprintf(err, "ids key type is bad\n");
 		return -1;
 	}
 	if (lookup_iseverity(ratingptr)) {
-		fprintf(stderr, "ids key severity is bad\n");
+		fprintf(err, "ids key severity is bad\n");
 		return -1;
 	}
 	return 0;
 
 fail_exit:
-	fprintf(stderr, "ids key is bad\n");
+	fprintf(err, "ids key is bad\n");
 	return -1;
 }
 
@@ -417,15 +428,17 @@ static int equiv_parse(char *optarg, char **mp, char **sub)
 
 int audit_request_rule_list(int fd)
 {
-	if (audit_request_rules_list_data(fd) > 0) {
+	int seq = audit_request_rules_list_data(fd);
+
+	if (seq > 0) {
 		list_requested = 1;
-		get_reply();
+		get_reply(seq);
 		return 1;
 	}
 	return 0;
 }
 
-void check_rule_mismatch(int lineno, const char *option)
+void check_rule_mismatch(int lineno, const char *option, FILE *err)
 {
 	struct audit_rule_data tmprule;
 	unsigned int old_audit_elf = _audit_elf;
@@ -449,10 +462,10 @@ void check_rule_mismatch(int lineno, const char *option)
 		rc = 1;
 	_audit_elf = old_audit_elf;
 	if (rc) { 
-		fprintf(stderr, "WARNING - 32/64 bit syscall mismatch");
+		fprintf(err, "WARNING - 32/64 bit syscall mismatch");
 		if (lineno)
-			fprintf(stderr, " in line %d", lineno);
-		fprintf(stderr, ", you should specify an arch\n");
+			fprintf(err, " in line %d", lineno);
+		fprintf(err, ", you should specify an arch\n");
 	}
 }
 
@@ -466,7 +479,7 @@ int report_status(int fd)
 			fprintf(stderr,	"The audit system is disabled\n");
 		return -1;
 	}
-	get_reply();
+	get_reply(retval);
 	retval = audit_request_features(fd);
 	if (retval == -1) {
 		// errno is EINVAL if the kernel does support features API
@@ -474,13 +487,15 @@ int report_status(int fd)
 			return -2;
 		return -1;
 	}
-	get_reply();
+	get_reply(retval);
 	return -2;
 }
 
 struct option long_opts[] =
 {
   {"loginuid-immutable", 0, NULL, 1},
+  {"sync", 1, NULL, 2},
+  {"rule-cache", 1, NULL, 3},
   {NULL, 0, NULL, 0}
 };
 
@@ -489,7 +504,7 @@ struct option long_opts[] =
  * returns: -3 deprecated, -2 success - no reply, -1 error - noreply,
  * 0 success - reply, > 0 success - rule
  */
-static int setopt(int count, int lineno, char *vars[])
+static int setopt(int count, int lineno, char *vars[], FILE *err)
 {
     int c;
     int retval = 0, rc;
@@ -497,6 +512,7 @@ static int setopt(int count, int lineno, char *vars[])
     optind = 0;
     opterr = 0;
     key[0] = 0;
+    reply_seq = 0;
     keylen = AUDIT_MAX_KEY_LEN;
 
     while ((retval >= 0) && (c = getopt_long(count, vars,
@@ -526,11 +542,11 @@ static int setopt(int count, int lineno, char *vars[])
 				(strcmp(optarg, "1") == 0) ||
 				(strcmp(optarg, "2") == 0))) {
 			if (audit_set_enabled(fd, strtoul(optarg,NULL,0)) > 0)
-				audit_request_status(fd);
+				reply_seq = audit_request_status(fd);
 			else
 				retval = -1;
 		} else {
-			fprintf(stderr, "Enable must be 0, 1, or 2 was %s\n", 
+			fprintf(err, "Enable must be 0, 1, or 2 was %s\n", 
 				optarg);
 			retval = -1;
 		}
@@ -540,11 +556,11 @@ static int setopt(int count, int lineno, char *vars[])
 				(strcmp(optarg, "1") == 0) ||
 				(strcmp(optarg, "2") == 0))) {
 			if (audit_set_failure(fd, strtoul(optarg,NULL,0)) > 0)
-				audit_request_status(fd);
+				reply_seq = audit_request_status(fd);
 			else
 				return -1;
 		} else {
-			fprintf(stderr, "Failure must be 0, 1, or 2 was %s\n", 
+			fprintf(err, "Failure must be 0, 1, or 2 was %s\n", 
 				optarg);
 			retval = -1;
 		}
@@ -555,15 +571,15 @@ static int setopt(int count, int lineno, char *vars[])
 			errno = 0;
 			rate = strtoul(optarg,NULL,0);
 			if (errno) {
-				fprintf(stderr, "Error converting rate\n");
+				fprintf(err, "Error converting rate\n");
 				return -1;
 			}
 			if (audit_set_rate_limit(fd, rate) > 0)
-				audit_request_status(fd);
+				reply_seq = audit_request_status(fd);
 			else
 				return -1;
 		} else {
-			fprintf(stderr, "Rate must be a numeric value was %s\n",
+			fprintf(err, "Rate must be a numeric value was %s\n",
 				optarg);
 			retval = -1;
 		}
@@ -574,15 +590,15 @@ static int setopt(int count, int lineno, char *vars[])
 			errno = 0;
 			limit = strtoul(optarg,NULL,0);
 			if (errno) {
-				fprintf(stderr, "Error converting backlog\n");
+				fprintf(err, "Error converting backlog\n");
 				return -1;
 			}
 			if (audit_set_backlog_limit(fd, limit) > 0)
-				audit_request_status(fd);
+				reply_seq = audit_request_status(fd);
 			else
 				return -1;
 		} else {
-			fprintf(stderr, 
+			fprintf(err, 
 				"Backlog must be a numeric value was %s\n", 
 				optarg);
 			retval = -1;
@@ -590,7 +606,7 @@ static int setopt(int count, int lineno, char *vars[])
 		break;
         case 'l':
 		if (count > 4) {
-			fprintf(stderr,
+			fprintf(err,
 				"Wrong number of options for list request\n");
 			retval = -1;
 			break;
@@ -600,7 +616,7 @@ static int setopt(int count, int lineno, char *vars[])
 				interpret = 1;
 				count -= 1;
 			} else {
-				fprintf(stderr,
+				fprintf(err,
 					"Only -k or -i options are allowed\n");
 				retval = -1;
 			}
@@ -609,7 +625,7 @@ static int setopt(int count, int lineno, char *vars[])
 				strncat(key, vars[3], keylen);
 				count -= 2;
 			} else {
-				fprintf(stderr,
+				fprintf(err,
 					"Only -k or -i options are allowed\n");
 				retval = -1;
 				break;
@@ -623,22 +639,23 @@ static int setopt(int count, int lineno, char *vars[])
 		break;
         case 'a':
 		if (strstr(optarg, "task") && _audit_syscalladded) {
-			fprintf(stderr, 
+			fprintf(err, 
 				"Syscall auditing requested for task list\n");
 			retval = -1;
 		} else {
-			rc = audit_rule_setup(optarg, &add, &action, lineno);
+			rc = audit_rule_setup(optarg, &add, &action, lineno,
+					err);
 			if (rc == 3) {
-				fprintf(stderr,
+				fprintf(err,
 		"Multiple rule insert/delete operations are not allowed\n");
 				retval = -1;
 			} else if (rc == 2) {
-				fprintf(stderr, 
+				fprintf(err, 
 					"Append rule - bad keyword %s\n",
 					optarg);
 				retval = -1;
 			} else if (rc == 1) {
-				fprintf(stderr, 
+				fprintf(err, 
 				    "Append rule - possible is deprecated\n");
 				return -3; /* deprecated - eat it */
 			} else
@@ -647,21 +664,22 @@ static int setopt(int count, int lineno, char *vars[])
 		break;
         case 'A': 
 		if (strstr(optarg, "task") && _audit_syscalladded) {
-			fprintf(stderr, 
+			fprintf(err, 
 			   "Error: syscall auditing requested for task list\n");
 			retval = -1;
 		} else {
-			rc = audit_rule_setup(optarg, &add, &action, lineno);
+			rc = audit_rule_setup(optarg, &add, &action, lineno,
+					err);
 			if (rc == 3) {
-				fprintf(stderr,
+				fprintf(err,
 		"Multiple rule insert/delete operations are not allowed\n");
 				retval = -1;
 			} else if (rc == 2) {
-				fprintf(stderr,
+				fprintf(err,
 				"Add rule - bad keyword %s\n", optarg);
 				retval = -1;
 			} else if (rc == 1) {
-				fprintf(stderr, 
+				fprintf(err, 
 				    "Append rule - possible is deprecated\n");
 				return -3; /* deprecated - eat it */
 			} else {
@@ -671,17 +689,17 @@ static int setopt(int count, int lineno, char *vars[])
 		}
 		break;
         case 'd': 
-		rc = audit_rule_setup(optarg, &del, &action, lineno);
+		rc = audit_rule_setup(optarg, &del, &action, lineno, err);
 		if (rc == 3) {
-			fprintf(stderr,
+			fprintf(err,
 		"Multiple rule insert/delete operations are not allowed\n");
 			retval = -1;
 		} else if (rc == 2) {
-			fprintf(stderr, "Delete rule - bad keyword %s\n", 
+			fprintf(err, "Delete rule - bad keyword %s\n", 
 				optarg);
 			retval = -1;
 		} else if (rc == 1) {
-			fprintf(stderr, 
+			fprintf(err, 
 			    "Delete rule - possible is deprecated\n");
 			return -3; /* deprecated - eat it */
 		} else
@@ -695,18 +713,18 @@ static int setopt(int count, int lineno, char *vars[])
 				AUDIT_FILTER_TASK || (del & 
 				(AUDIT_FILTER_MASK|AUDIT_FILTER_UNSET)) == 
 				AUDIT_FILTER_TASK)) {
-			fprintf(stderr, 
+			fprintf(err, 
 			  "Error: syscall auditing being added to task list\n");
 			return -1;
 		} else if (((add & (AUDIT_FILTER_MASK|AUDIT_FILTER_UNSET)) ==
 				AUDIT_FILTER_USER || (del &
 				(AUDIT_FILTER_MASK|AUDIT_FILTER_UNSET)) ==
 				AUDIT_FILTER_USER)) {
-			fprintf(stderr, 
+			fprintf(err, 
 			  "Error: syscall auditing being added to user list\n");
 			return -1;
 		} else if (exclude) {
-			fprintf(stderr, 
+			fprintf(err, 
 		    "Error: syscall auditing cannot be put on exclude list\n");
 			return -1;
 		} else {
@@ -715,13 +733,13 @@ static int setopt(int count, int lineno, char *vars[])
 				unsigned int elf;
 				machine = audit_detect_machine();
 				if (machine < 0) {
-					fprintf(stderr, 
+					fprintf(err, 
 					    "Error detecting machine type");
 					return -1;
 				}
 				elf = audit_machine_to_elf(machine);
                                 if (elf == 0) {
-					fprintf(stderr, 
+					fprintf(err, 
 					    "Error looking up elf type");
 					return -1;
 				}
@@ -734,15 +752,16 @@ static int setopt(int count, int lineno, char *vars[])
 			case 0:
 				_audit_syscalladded = 1;
 				if (unknown_arch && add != AUDIT_FILTER_UNSET)
-					check_rule_mismatch(lineno, optarg);
+					check_rule_mismatch(lineno, optarg,
+						err);
 				break;
 			case -1:
-				fprintf(stderr, "Syscall name unknown: %s\n", 
+				fprintf(err, "Syscall name unknown: %s\n", 
 							optarg);
 				retval = -1;
 				break;
 			case -2:
-				fprintf(stderr, "Elf type unknown: 0x%x\n", 
+				fprintf(err, "Elf type unknown: 0x%x\n", 
 							_audit_elf);
 				retval = -1;
 				break;
@@ -757,7 +776,7 @@ static int setopt(int count, int lineno, char *vars[])
 		// can allow it
 		else if ((optind >= count) || (strstr(optarg, "arch=") == NULL)
 				 || (strcmp(vars[optind], "-t") != 0)) {
-			fprintf(stderr, "List must be given before field\n");
+			fprintf(err, "List must be given before field\n");
 			retval = -1;
 			break;
 		}
@@ -791,7 +810,7 @@ static int setopt(int count, int lineno, char *vars[])
 		break;
         case 'm':
 		if (count > 3) {
-			fprintf(stderr,
+			fprintf(err,
 	"The -m option must be only the only option and takes 1 parameter\n");
 			retval = -1;
 		} else if (audit_log_user_message( fd, AUDIT_USER,
@@ -801,12 +820,18 @@ static int setopt(int count, int lineno, char *vars[])
 			return -2;  // success - no reply for this
 		break;
 	case 'R':
-		fprintf(stderr, "Error - nested rule files not supported\n");
+	case 2:
+		fprintf(err, "Error - nested rule files not supported\n");
+		retval = -1;
+		break;
+	case 3:
+		fprintf(err,
+			"The --rule-cache option only works with -R or --sync\n");
 		retval = -1;
 		break;
 	case 'D':
 		if (count > 4 || count == 3) {
-			fprintf(stderr,
+			fprintf(err,
 			    "Wrong number of options for Delete all request\n");
 			retval = -1;
 			break;
@@ -816,7 +841,7 @@ static int setopt(int count, int lineno, char *vars[])
 				strncat(key, vars[3], keylen);
 				count -= 2;
 			} else {
-				fprintf(stderr, 
+				fprintf(err, 
 					"Only the -k option is allowed\n");
 				retval = -1;
 				break;
@@ -832,16 +857,17 @@ static int setopt(int count, int lineno, char *vars[])
 	case 'w':
 		if (add != AUDIT_FILTER_UNSET ||
 			del != AUDIT_FILTER_UNSET) {
-			fprintf(stderr,
+			fprintf(err,
 				"watch option can't be given with a syscall\n");
 			retval = -1;
 		} else if (optarg) { 
 			add = AUDIT_FILTER_EXIT;
 			action = AUDIT_ALWAYS;
 			_audit_syscalladded = 1;
-			retval = audit_setup_watch_name(&rule_new, optarg);
+			retval = audit_setup_watch_name(&rule_new, optarg,
+					err);
 		} else {
-			fprintf(stderr, "watch option needs a path\n");	
+			fprintf(err, "watch option needs a path\n");	
 			retval = -1;
 		}
 		break;
@@ -850,9 +876,10 @@ static int setopt(int count, int lineno, char *vars[])
 			del = AUDIT_FILTER_EXIT;
 			action = AUDIT_ALWAYS;
 			_audit_syscalladded = 1;
-			retval = audit_setup_watch_name(&rule_new, optarg);
+			retval = audit_setup_watch_name(&rule_new, optarg,
+					err);
 		} else {
-			fprintf(stderr, "watch option needs a path\n");	
+			fprintf(err, "watch option needs a path\n");	
 			retval = -1;
 		}
 		break;
@@ -860,25 +887,25 @@ static int setopt(int count, int lineno, char *vars[])
 		if (!(_audit_syscalladded || _audit_permadded ) ||
 				(add==AUDIT_FILTER_UNSET &&
 					del==AUDIT_FILTER_UNSET)) {
-			fprintf(stderr,
+			fprintf(err,
 			"key option needs a watch or syscall given prior to it\n");
 			retval = -1;
 		} else if (!optarg) {
-			fprintf(stderr, "key option needs a value\n");
+			fprintf(err, "key option needs a value\n");
 			retval = -1;
 		} else if ((strlen(optarg)+strlen(key)+(!!key[0])) >
 							AUDIT_MAX_KEY_LEN) {
-			fprintf(stderr, "key option exceeds size limit\n");
+			fprintf(err, "key option exceeds size limit\n");
 			retval = -1;
 		} else {
 			if (strncmp(optarg, "ids-", 4) == 0) {
-				if (check_ids_key(optarg)) {
+				if (check_ids_key(optarg, err)) {
 					retval = -1;
 					break;
 				}
 			}
 			if (strchr(optarg, AUDIT_KEY_SEPARATOR)) 
-				fprintf(stderr,
+				fprintf(err,
 				    "key %s has illegal character\n", optarg);
 			if (key[0]) { // Add the separator if we need to
 				strcat(key, key_sep);
@@ -890,25 +917,25 @@ static int setopt(int count, int lineno, char *vars[])
 		break;
 	case 'p':
 		if (!add && !del) {
-			fprintf(stderr,
+			fprintf(err,
 			"permission option needs a watch given prior to it\n");
 			retval = -1;
 		} else if (!optarg) {
-			fprintf(stderr, "permission option needs a filter\n");
+			fprintf(err, "permission option needs a filter\n");
 			retval = -1;
 		} else 
-			retval = audit_setup_perms(rule_new, optarg);
+			retval = audit_setup_perms(rule_new, optarg, err);
 		break;
         case 'q':
 		if (_audit_syscalladded) {
-			fprintf(stderr, 
+			fprintf(err, 
 			   "Syscall auditing requested for make equivalent\n");
 			retval = -1;
 		} else {
 			char *mp, *sub;
 			retval = equiv_parse(optarg, &mp, &sub);
 			if (retval < 0) {
-				fprintf(stderr, 
+				fprintf(err, 
 			   "Error parsing equivalent parts\n");
 				retval = -1;
 			} else {
@@ -949,7 +976,7 @@ static int setopt(int count, int lineno, char *vars[])
     if (optind == 1)
 	retval = -1;
     else if ((optind < count) && (retval != -1)) {
-	fprintf(stderr, "parameter passed without an option given\n");	
+	fprintf(err, "parameter passed without an option given\n");	
 	retval = -1;
     }
 
@@ -967,7 +994,7 @@ static int setopt(int count, int lineno, char *vars[])
 	/* Build the command */
 	if (asprintf(&cmd, "key=%s", key) < 0) {
 		cmd = NULL;
-		fprintf(stderr, "Out of memory adding key\n");
+		fprintf(err, "Out of memory adding key\n");
 		retval = -1;
 	} else {
 		/* Add this to the rule */
@@ -978,7 +1005,7 @@ static int setopt(int count, int lineno, char *vars[])
 	}
     }
     if (retval == -1 && errno == ECONNREFUSED)
-		fprintf(stderr,	"The audit system is disabled\n");
+		fprintf(err,	"The audit system is disabled\n");
     return retval;
 }
 
@@ -1054,15 +1081,362 @@ void postprocess(char *buf)
 }
 
 
+/* Rules read from a file that wait to be sent in one batch */
+struct pending_rule {
+	struct audit_rule_data *rule;
+	int lineno;
+	char *msgs;		// What parsing the line wrote to stderr
+};
+static struct pending_rule *pending = NULL;
+static int pending_cnt = 0, pending_size = 0;
+
+/* Queues a built rule. Returns 0 on success and -1 on error. */
+static int push_pending(struct audit_rule_data *rule, int lineno, char *msgs)
+{
+	if (pending_cnt == pending_size) {
+		int size = pending_size ? pending_size * 2 : 256;
+		struct pending_rule *tmp = realloc(pending,
+					size * sizeof(struct pending_rule));
+		if (tmp == NULL)
+			return -1;
+		pending = tmp;
+		pending_size = size;
+	}
+	pending[pending_cnt].rule = rule;
+	pending[pending_cnt].lineno = lineno;
+	pending[pending_cnt].msgs = msgs;
+	pending_cnt++;
+	return 0;
+}
+
+/*
+ * This function takes the add rule that setopt built and queues it to be
+ * sent with the ones around it. Returns 0 on success and -1 on error.
+ */
+static int queue_rule(int lineno, char *msgs)
+{
+	if ((add & AUDIT_FILTER_MASK) != AUDIT_FILTER_TASK && 
+			_audit_syscalladded != 1)
+		audit_rule_syscallbyname_data(rule_new, "all");
+	rule_new->flags = add;
+	rule_new->action = action;
+	if (push_pending(rule_new, lineno, msgs))
+		return -1;
+	if (caching)
+		cache_add_rule(rule_new, lineno);
+	rule_new = NULL;	// reset_vars makes the next one
+	return 0;
+}
+
+/*
+ * This function sends the queued rules and reports the errors of each
+ * line the way they are reported when rules are sent one at a time. If
+ * loading stops on an error, the rules after the bad line that were
+ * added are deleted again so the kernel ends up with the same rules. It
+ * returns 0 to go on, -1 to stop on an error, and 1 if the audit system
+ * is disabled.
+ */
+static int send_pending(const char *file)
+{
+	struct audit_rule_data **rules;
+	int i, rc, *errors, retval = 0;
+
+	if (pending_cnt == 0)
+		return 0;
+	rules = malloc(pending_cnt * sizeof(struct audit_rule_data *));
+	errors = malloc(pending_cnt * sizeof(int));
+	if (rules == NULL || errors == NULL) {
+		fprintf(stderr, "Out of memory loading rules\n");
+		retval = -1;
+		goto out;
+	}
+	for (i = 0; i < pending_cnt; i++)
+		rules[i] = pending[i].rule;
+	set_aumessage_mode(MSG_QUIET, DBG_NO);
+	load_rules(fd, rules, pending_cnt, errors, ignore == 0);
+	set_aumessage_mode(MSG_STDERR, DBG_NO);
+
+	for (i = 0; i < pending_cnt; i++) {
+		if (pending[i].msgs)
+			fputs(pending[i].msgs, stderr);
+		rc = errors[i];
+		if (rc == 0)
+			continue;
+		load_errors++;
+		fprintf(stderr, "Error sending add rule data request (%s)\n",
+			rc == -EEXIST ? "Rule exists" : strerror(-rc));
+		if (rc != -ECONNREFUSED)
+			fprintf(stderr, "There was an error in line %d of %s\n",
+				pending[i].lineno, file);
+		else {
+			fprintf(stderr, "The audit system is disabled\n");
+			retval = 1;
+			break;
+		}
+		if (ignore == 0) {
+			retval = -1;
+			break;
+		}
+		if (continue_error)
+			continue_error = -1;
+	}
+out:
+	for (i = 0; i < pending_cnt; i++) {
+		free(pending[i].rule);
+		free(pending[i].msgs);
+	}
+	pending_cnt = 0;
+	free(rules);
+	free(errors);
+	return retval;
+}
+
+/*
+ * When syncing, the add rules of the file are all queued before anything
+ * is sent. This function then makes the loaded rules the queued ones,
+ * leaving the ones already in place alone. Lines after it are loaded as
+ * usual. It returns what send_pending returns.
+ */
+static int sync_pending(const char *file)
+{
+	struct pending_rule *ordered;
+	struct audit_rule_data **want;
+	int i, n = 0, rc = -1, *loaded;
+
+	syncing = 0;
+	ordered = malloc((pending_cnt + 1) * sizeof(struct pending_rule));
+	want = malloc((pending_cnt + 1) * sizeof(struct audit_rule_data *));
+	loaded = malloc((pending_cnt + 1) * sizeof(int));
+	if (ordered == NULL || want == NULL || loaded == NULL) {
+		fprintf(stderr, "Out of memory syncing rules\n");
+		goto out;
+	}
+
+	// Put the rules in the order they end up in, -A ones go first
+	for (i = pending_cnt - 1; i >= 0; i--) {
+		if (pending[i].rule->flags & AUDIT_FILTER_PREPEND)
+			ordered[n++] = pending[i];
+	}
+	for (i = 0; i < pending_cnt; i++) {
+		if ((pending[i].rule->flags & AUDIT_FILTER_PREPEND) == 0)
+			ordered[n++] = pending[i];
+	}
+	for (i = 0; i < n; i++) {
+		ordered[i].rule->flags &= ~AUDIT_FILTER_PREPEND;
+		want[i] = ordered[i].rule;
+	}
+	if (sync_rules(fd, want, n, loaded))
+		goto out;
+
+	// Only what isn't loaded yet is left to send
+	n = 0;
+	for (i = pending_cnt - 1; i >= 0; i--) {
+		if (loaded[i] == SYNC_PREPEND) {
+			ordered[i].rule->flags |= AUDIT_FILTER_PREPEND;
+			pending[n++] = ordered[i];
+		}
+	}
+	for (i = 0; i < pending_cnt; i++) {
+		if (loaded[i] == SYNC_LOADED) {
+			free(ordered[i].rule);
+			free(ordered[i].msgs);
+		} else if (loaded[i] == SYNC_APPEND)
+			pending[n++] = ordered[i];
+	}
+	pending_cnt = n;
+	rc = send_pending(file);
+out:
+	if (rc < 0) {
+		for (i = 0; i < pending_cnt; i++) {
+			free(pending[i].rule);
+			free(pending[i].msgs);
+		}
+		pending_cnt = 0;
+	}
+	free(ordered);
+	free(want);
+	free(loaded);
+	return rc;
+}
+
+/*
+ * This function runs one line of a rules file. Add rules are queued and
+ * sent in batches, anything else first sends the queue so the lines take
+ * effect in order. It returns 0 to go on with the next line, -1 to stop
+ * on an error, and 1 to stop without one.
+ */
+static int do_line(const char *file, int lineno, int count, char *fields[])
+{
+	int rc, sent, batch;
+
+	/* Options other than adding a rule act while parsing */
+	batch = !strcmp(fields[1], "-a") || !strcmp(fields[1], "-A") ||
+			!strcmp(fields[1], "-w");
+	if (!batch) {
+		if (caching)
+			cache_add_line(count, fields, lineno);
+		if (syncing && strcmp(fields[1], "-D") == 0) {
+			// Rules the file doesn't have get deleted anyway
+			return 0;
+		}
+		if (!syncing)
+			sent = send_pending(file);
+		else if (strcmp(fields[1], "-e") == 0)
+			sent = sync_pending(file);	// -e 2 locks rules
+		else
+			sent = 0;
+		if (sent)
+			return sent < 0 ? -1 : 1;
+	}
+
+	/* Parse it */
+	if (reset_vars()) {
+		if (!syncing)
+			send_pending(file);
+		return -1;
+	}
+	if (batch) {
+		/*
+		 * The rules before this one may still fail, so what
+		 * parsing says is held back to come out after their
+		 * errors, or not at all if loading stops at one.
+		 */
+		FILE *mem;
+		char *msgs = NULL;
+		size_t len = 0;
+
+		mem = syncing ? NULL : open_memstream(&msgs, &len);
+		set_aumessage_stream(mem);
+		rc = setopt(count, lineno, fields, mem ? mem : stderr);
+		set_aumessage_stream(NULL);
+		if (mem)
+			fclose(mem);
+		if (len == 0) {
+			free(msgs);
+			msgs = NULL;
+		}
+
+		/* Queue the rule if it's added */
+		if (rc > 0 && add != AUDIT_FILTER_UNSET &&
+		    (add & AUDIT_FILTER_MASK) != AUDIT_FILTER_ENTRY &&
+				queue_rule(lineno, msgs) == 0)
+			return 0;
+		if (caching)
+			cache_add_line(count, fields, lineno);
+		sent = syncing ? 0 : send_pending(file);
+		if (msgs) {
+			if (sent == 0)
+				fputs(msgs, stderr);
+			free(msgs);
+		}
+		if (sent)
+			return sent < 0 ? -1 : 1;
+	} else
+		rc = setopt(count, lineno, fields, stderr);
+
+	/* handle reply or send rule */
+	if (rc != -3) {
+		if (handle_request(rc) == -1) {
+			load_errors++;
+			if (errno != ECONNREFUSED)
+				fprintf(stderr,
+					"There was an error in line %d of %s\n",
+					lineno, file);
+			else {
+				fprintf(stderr,
+					"The audit system is disabled\n");
+				return 1;
+			}
+			if (ignore == 0)
+				return -1;
+			if (continue_error)
+				continue_error = -1;
+		}
+	}
+	return 0;
+}
+
+/* Sends what is still queued at the end of a rules file */
+static int finish_file(const char *file)
+{
+	int sent;
+
+	sent = syncing ? sync_pending(file) : send_pending(file);
+	audit_close(fd);
+	fd = -1;
+	free(pending);
+	pending = NULL;
+	pending_size = 0;
+	return sent < 0 ? -1 : 0;
+}
+
+/*
+ * This function loads the rule cache if it was made from the same text
+ * as the rules file on tfd. The key for a new cache is put in key either
+ * way. Returns 0 if the cache can be used.
+ */
+static int open_cache(int tfd, const struct stat *st, uint64_t *key)
+{
+	char *text;
+	ssize_t len;
+
+	*key = 0;
+	text = malloc(st->st_size + 1);
+	if (text == NULL)
+		return 1;
+	len = pread(tfd, text, st->st_size, 0);
+	if (len != st->st_size) {
+		free(text);
+		return 1;
+	}
+	*key = cache_key(fd, text, len);
+	free(text);
+	return cache_load(cache_file, *key) ? 1 : 0;
+}
+
+/* This function loads the rules from the cache the way fileopt would */
+static int replay_cache(const char *file)
+{
+	struct cache_item it;
+	int rc = 0;
+
+	while (rc == 0 && cache_next(&it)) {
+		if (it.type == CACHE_RULE) {
+			struct audit_rule_data *r;
+
+			// Lines before it may have closed the socket
+			if (reset_vars()) {
+				rc = -1;
+				break;
+			}
+			r = malloc(it.size);
+			if (r == NULL || (memcpy(r, it.rule, it.size),
+					push_pending(r, it.lineno, NULL))) {
+				fprintf(stderr, "Out of memory loading rules\n");
+				free(r);
+				rc = -1;
+			}
+		} else
+			rc = do_line(file, it.lineno, it.count, it.fields);
+	}
+	cache_clear();
+	if (rc)
+		return rc < 0 ? -1 : 0;
+	return finish_file(file);
+}
+
 /*
  * This function reads the given file line by line and executes the rule.
  * It returns 0 if everything went OK, 1 if there are problems before reading
  * the file and -1 on error conditions after executing some of the rules.
- * It will abort reading the file if it encounters any problems.
+ * It will abort reading the file if it encounters any problems. With a
+ * rule cache, a cache made from the same file is loaded instead, and a
+ * load that had no errors writes one.
  */
 static int fileopt(const char *file)
 {
 	int i, tfd, rc, lineno = 1;
+	uint64_t key = 0;
 	struct stat st;
         FILE *f;
         char buf[LINE_SIZE];
@@ -1103,6 +1477,19 @@ static int fileopt(const char *file)
 		return 1;
 	}
 
+	if (cache_file) {
+		if (fd < 0 && (fd = audit_open()) < 0) {
+			fprintf(stderr, "Cannot open netlink audit socket\n");
+			close(tfd);
+			return 1;
+		}
+		if (open_cache(tfd, &st, &key) == 0) {
+			close(tfd);
+			return replay_cache(file);
+		}
+		caching = 1;
+	}
+
         f = fdopen(tfd, "rm");
         if (f == NULL) {
                 fprintf(stderr, "Error - fdopen failed (%s)\n",
@@ -1145,44 +1532,62 @@ static int fileopt(const char *file)
 		
 		fields[i] = NULL;
 
-		/* Parse it */
-		if (reset_vars()) {
-			free(fields);
-			fclose(f);
-			return -1;
-		}
-		rc = setopt(i, lineno, fields);
+		rc = do_line(file, lineno, i, fields);
 		free(fields);
-
-		/* handle reply or send rule */
-		if (rc != -3) {
-			if (handle_request(rc) == -1) {
-				if (errno != ECONNREFUSED)
-					fprintf(stderr,
-					"There was an error in line %d of %s\n",
-					lineno, file);
-				else {
-					fprintf(stderr,
-					"The audit system is disabled\n");
-					fclose(f);
-					return 0;
-				}
-				if (ignore == 0) {
-					fclose(f);
-					return -1;
-				}
-				if (continue_error)
-					continue_error = -1;
-			}
+		if (rc) {
+			fclose(f);
+			cache_clear();
+			return rc < 0 ? -1 : 0;
 		}
 		lineno++;
 	}
 	fclose(f);
-	return 0;
+	rc = finish_file(file);
+	if (caching && rc == 0 && load_errors == 0)
+		cache_save(cache_file, key);
+	caching = 0;
+	cache_clear();
+	return rc;
+}
+
+/*
+ * This function checks if the command line only loads a rules file, with
+ * -R or --sync and maybe --rule-cache, in any order. It returns the file
+ * or NULL if the options are for setopt to handle.
+ */
+static const char *rules_file(int count, char *vars[])
+{
+	const char *file = NULL, *cache = NULL;
+	int c, sync = 0;
+
+	optind = 0;
+	opterr = 0;
+	while ((c = getopt_long(count, vars, "R:", long_opts, NULL)) != EOF) {
+		switch (c) {
+		case 'R':
+		case 2:
+			if (file)
+				return NULL;
+			file = optarg;
+			sync = c == 2;
+			break;
+		case 3:
+			cache = optarg;
+			break;
+		default:
+			return NULL;
+		}
+	}
+	if (file == NULL || optind < count)
+		return NULL;
+	syncing = sync;
+	cache_file = cache;
+	return file;
 }
 
 int main(int argc, char *argv[])
 {
+	const char *file;
 	int retval = 1;
 
 	set_aumessage_mode(MSG_STDERR, DBG_NO);
@@ -1199,7 +1604,8 @@ int main(int argc, char *argv[])
 	}
 #endif
 	/* Check where the rules are coming from: commandline or file */
-	if ((argc == 3) && (strcmp(argv[1], "-R") == 0)) {
+	file = rules_file(argc, argv);
+	if (file) {
 		fd = audit_open();
 		if (audit_is_enabled(fd) == 2) {
 			fprintf(stderr,
@@ -1209,7 +1615,7 @@ int main(int argc, char *argv[])
 		} else if (errno == ECONNREFUSED) {
 			fprintf(stderr, "The audit system is disabled\n");
 			return 0;
-		} else if (fileopt(argv[2])) {
+		} else if (fileopt(file)) {
 			free(rule_new);
 			return 1;
 		} else {
@@ -1223,7 +1629,7 @@ int main(int argc, char *argv[])
 			free(rule_new);
 			return 1;
 		}
-		retval = setopt(argc, 0, argv);
+		retval = setopt(argc, 0, argv, stderr);
 		if (retval == -3) {
 			free(rule_new);
 			return 0;
@@ -1264,7 +1670,7 @@ static int handle_request(int status)
 			fprintf(stderr, "Error - no list specified\n");
 			return -1;
 		}
-		get_reply();
+		get_reply(reply_seq);
 	} else if (status == -2)
 		status = 0;  // report success 
 	else if (status > 0) {
@@ -1336,42 +1742,30 @@ static int handle_request(int status)
 	return status;
 }
 
+/* Prints a reply, returns 1 once there is nothing more to read */
+static int print_reply(struct audit_reply *rep, void *data)
+{
+	if (rep->type == NLMSG_ERROR && rep->error->error == 0)
+		return 0;	/* This was an ack */
+	if (audit_print_reply(rep, fd) == 0)
+		return 1;
+	return 0;
+}
+
 /*
- * A reply from the kernel is expected. Get and display it.
+ * A reply from the kernel is expected. Get and display it. If the
+ * sequence number of the request isn't known, any reply will do.
  */
-static void get_reply(void)
+static void get_reply(int seq)
 {
-	int i, retval;
-	int timeout = 40; /* loop has delay of .1 - so this is 4 seconds */
-	struct audit_reply rep;
-	fd_set read_mask;
-	FD_ZERO(&read_mask);
-	FD_SET(fd, &read_mask);
+	/* The kernel owes an answer to a known request, so wait for it
+	 * even if it is busy. Otherwise don't wait long for nothing. */
+	int timeout = seq > 0 ? 40000 : 4000; /* milliseconds */
 
 	// Reset printing counter
 	audit_print_init();
 
-	for (i = 0; i < timeout; i++) {
-		struct timeval t;
-
-		t.tv_sec  = 0;
-		t.tv_usec = 100000; /* .1 second */
-		do {
-			retval=select(fd+1, &read_mask, NULL, NULL, &t);
-		} while (retval < 0 && errno == EINTR);
-		// We'll try to read just in case
-		retval = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
-		if (retval > 0) {
-			if (rep.type == NLMSG_ERROR && rep.error->error == 0) {
-				i = 0;    /* reset timeout */
-				continue; /* This was an ack */
-			}
-			
-			if ((retval = audit_print_reply(&rep, fd)) == 0) 
-				break;
-			else
-				i = 0; /* If getting more, reset timeout */
-		}
-	}
+	(void)audit_wait_replies(fd, seq > 0 ? seq : 0, print_reply, NULL,
+		timeout);
 }
 
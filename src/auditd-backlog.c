@@ -0,0 +1,113 @@
+/* auditd-backlog.c --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+/*
+ * auditd asks the kernel for its status every few seconds to see how far
+ * behind it is. When the kernel's backlog passes half its limit, or the
+ * kernel has lost events since the last look, auditd drains the backlog
+ * first: it reads more records per wakeup, does fewer log syncs, and
+ * doesn't wait on a full dispatcher. Events the kernel drops are gone
+ * for good, while the rest only come a little later. Drain mode ends
+ * once the backlog is back under an eighth of the limit with no new
+ * losses.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdint.h>
+#include "libaudit.h"
+#include "private.h"
+#include "auditd-backlog.h"
+
+#define DRAIN_ENTER	2	// Drain from 1/2 of the backlog limit
+#define DRAIN_LEAVE	8	// down to 1/8 of it
+
+static volatile int draining = 0;
+static unsigned int polls = 0, drains = 0;
+static uint32_t backlog = 0, backlog_limit = 0, high_water = 0;
+static uint32_t last_lost = 0, start_lost = 0;
+static unsigned long lost = 0;	// Since the first look
+
+int backlog_status(const struct audit_status *s)
+{
+	uint32_t new_lost = 0;
+	int was_draining = draining;
+
+	if (polls && s->lost != last_lost) {
+		new_lost = s->lost - last_lost;
+		lost += new_lost;
+		audit_msg(LOG_WARNING,
+			"Kernel lost %u audit events, backlog %u of %u",
+			new_lost, s->backlog, s->backlog_limit);
+	} else if (polls == 0)
+		start_lost = s->lost;
+	last_lost = s->lost;
+	backlog = s->backlog;
+	backlog_limit = s->backlog_limit;
+	if (backlog > high_water)
+		high_water = backlog;
+	polls++;
+
+	if (!draining && (new_lost ||
+			(backlog_limit && backlog >= backlog_limit /
+				DRAIN_ENTER))) {
+		draining = 1;
+		drains++;
+		audit_msg(LOG_NOTICE,
+			"Kernel backlog at %u of %u, draining it first",
+			backlog, backlog_limit);
+	} else if (draining && new_lost == 0 &&
+			backlog <= backlog_limit / DRAIN_LEAVE) {
+		draining = 0;
+		audit_msg(LOG_NOTICE, "Kernel backlog drained to %u",
+			backlog);
+	}
+	return draining != was_draining;
+}
+
+int backlog_draining(void)
+{
+	return draining;
+}
+
+void backlog_report(FILE *f)
+{
+	fprintf(f, "kernel status polls = %u\n", polls);
+	fprintf(f, "kernel backlog = %u\n", backlog);
+	fprintf(f, "kernel backlog limit = %u\n", backlog_limit);
+	fprintf(f, "kernel backlog high water = %u\n", high_water);
+	fprintf(f, "kernel lost before start = %u\n", start_lost);
+	fprintf(f, "kernel lost = %lu\n", lost);
+	fprintf(f, "drain mode = %s\n", draining ? "on" : "off");
+	fprintf(f, "drain episodes = %u\n", drains);
+}
+
+void backlog_clear(void)
+{
+	draining = 0;
+	polls = drains = 0;
+	backlog = backlog_limit = high_water = 0;
+	last_lost = start_lost = 0;
+	lost = 0;
+}
+
@@ -0,0 +1,43 @@
+/* auditd-backlog.h --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+#ifndef AUDITD_BACKLOG_H
+#define AUDITD_BACKLOG_H
+
+#include <stdio.h>
+#include "libaudit.h"
+
+#define STATUS_POLL	5.0	// Seconds between kernel status requests
+#define DRAIN_POLL	1.0	// Same, while draining the backlog
+#define DRAIN_BATCH	64	// Records read per wakeup while draining
+#define DRAIN_SYNC_EVERY 8	// Only one in this many log syncs is done
+
+/* Takes a status reply. Returns 1 if drain mode was entered or left. */
+int backlog_status(const struct audit_status *s);
+/* Returns 1 while the kernel backlog is being drained first */
+int backlog_draining(void);
+void backlog_report(FILE *f);
+void backlog_clear(void);
+
+#endif
+
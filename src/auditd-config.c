@@ -38,6 +38,7 @@
 #include "auditd-config.h"
 #include "libaudit.h"
 #include "private.h"
+#include "disp-ring.h"
 
 #define TCP_PORT_MAX 65535
 
@@ -74,6 +75,8 @@ static int log_group_parser(struct nv_pair *nv, int line,
 		struct daemon_conf *config);
 static int qos_parser(struct nv_pair *nv, int line, 
 		struct daemon_conf *config);
+static int disp_ring_size_parser(struct nv_pair *nv, int line, 
+		struct daemon_conf *config);
 static int dispatch_parser(struct nv_pair *nv, int line,
 		struct daemon_conf *config);
 static int name_format_parser(struct nv_pair *nv, int line,
@@ -138,6 +141,7 @@ static const struct kw_pair keywords[] =
   {"name_format",              name_format_parser,		0 },
   {"name",                     name_parser,			0 },
   {"disp_qos",                 qos_parser,			0 },
+  {"disp_ring_size",           disp_ring_size_parser,		0 },
   {"max_log_file",             max_log_size_parser,		0 },
   {"max_log_file_action",      max_log_size_action_parser,	0 },
   {"space_left",               space_left_parser,		0 },
@@ -249,6 +253,7 @@ void clear_config(struct daemon_conf *config)
 	config->freq = 0;
 	config->num_logs = 0L;
 	config->dispatcher = NULL;
+	config->disp_ring_size = 0L;
 	config->node_name_format = N_NONE;
 	config->node_name = NULL;
 	config->max_log_size = 0L;
@@ -633,6 +638,51 @@ static int qos_parser(struct nv_pair *nv, int line,
 	return 1;
 }
 
+static int disp_ring_size_parser(struct nv_pair *nv, int line,
+		struct daemon_conf *config)
+{
+	const char *ptr = nv->value;
+	unsigned long i;
+
+	audit_msg(LOG_DEBUG, "disp_ring_size_parser called with: %s",
+								nv->value);
+
+	/* check that all chars are numbers */
+	for (i=0; ptr[i]; i++) {
+		if (!isdigit(ptr[i])) {
+			audit_msg(LOG_ERR,
+				"Value %s should only be numbers - line %d",
+				nv->value, line);
+			return 1;
+		}
+	}
+
+	/* convert to unsigned long */
+	errno = 0;
+	i = strtoul(nv->value, NULL, 10);
+	if (errno) {
+		audit_msg(LOG_ERR,
+			"Error converting string to a number (%s) - line %d",
+			strerror(errno), line);
+		return 1;
+	}
+	/* Check its range, 0 means the socket is used */
+	if (i > DISP_RING_MAX_KB) {
+		audit_msg(LOG_ERR,
+			"Error - converted number (%s) is too large - line %d",
+			nv->value, line);
+		return 1;
+	}
+	if (i && i < DISP_RING_MIN_KB) {
+		audit_msg(LOG_ERR,
+			"Error - converted number (%s) is too small - line %d",
+			nv->value, line);
+		return 1;
+	}
+	config->disp_ring_size = i;
+	return 0;
+}
+
 static int dispatch_parser(struct nv_pair *nv, int line,
 	struct daemon_conf *config)
 {
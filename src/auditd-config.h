@@ -55,6 +55,7 @@ struct daemon_conf
 	unsigned int freq;
 	unsigned int num_logs;
 	const char *dispatcher;
+	unsigned long disp_ring_size;	/* KB, 0 means use the socket */
 	node_t node_name_format;
 	const char *node_name;
 	unsigned long max_log_size;
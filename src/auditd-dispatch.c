@@ -29,10 +29,20 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #include "libaudit.h"
 #include "private.h"
+#include "disp-ring.h"
 #include "auditd-dispatch.h"
+#include "auditd-metrics.h"
+#include "auditd-backlog.h"
 
 /* This is the communications channel between auditd & the dispatcher */
 static int disp_pipe[2] = {-1, -1};
@@ -40,6 +50,19 @@ static pid_t pid = 0;
 static int n_errs = 0;
 #define REPORT_LIMIT 10
 
+/* Optional shared memory ring, see disp-ring.h */
+static struct disp_ring *ring = NULL;
+static size_t ring_map_size = 0;
+static int ring_fd = -1, data_fd = -1, space_fd = -1;
+static qos_t ring_qos;
+/* Reconfigure runs in the logger thread, so the ring can go away
+ * underneath dispatch_event. */
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+/* How long a lossy dispatcher may hold up auditd when the ring is full */
+#define RING_WAIT_MS 20
+
+static void shutdown_dispatcher_locked(void);
+
 int dispatcher_pid(void)
 {
 	return pid;
@@ -68,6 +91,106 @@ static int set_flags(int fn, int flags)
 	return fcntl(fn, F_SETFL, fl);
 }
 
+static void close_ring(void)
+{
+	if (ring) {
+		munmap(ring, ring_map_size);
+		ring = NULL;
+	}
+	if (ring_fd >= 0) {
+		close(ring_fd);
+		ring_fd = -1;
+	}
+	if (data_fd >= 0) {
+		close(data_fd);
+		data_fd = -1;
+	}
+	if (space_fd >= 0) {
+		close(space_fd);
+		space_fd = -1;
+	}
+}
+
+static int create_shm(void)
+{
+	int fd;
+#ifdef __NR_memfd_create
+	fd = syscall(__NR_memfd_create, "audit-dispatcher", 0);
+	if (fd >= 0)
+		return fd;
+#endif
+	/* Older kernels - fall back to an unlinked file in /dev/shm */
+	{
+		char path[] = "/dev/shm/audit-dispatcher-XXXXXX";
+
+		fd = mkstemp(path);
+		if (fd >= 0)
+			unlink(path);
+	}
+	return fd;
+}
+
+/* This function returns 1 on error & 0 on success */
+static int init_ring(const struct daemon_conf *config)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	uint32_t size = DISP_RING_MIN_KB * 1024;
+
+	/* The data area must be a power of 2 */
+	while (size < config->disp_ring_size * 1024)
+		size <<= 1;
+	ring_map_size = disp_ring_map_size(size);
+
+	ring_fd = create_shm();
+	if (ring_fd < 0 || ftruncate(ring_fd, ring_map_size)) {
+		audit_msg(LOG_ERR, "Failed creating dispatcher ring (%s)",
+			strerror(errno));
+		close_ring();
+		return 1;
+	}
+	ring = mmap(NULL, ring_map_size, PROT_READ|PROT_WRITE, MAP_SHARED,
+			ring_fd, 0);
+	if (ring == MAP_FAILED) {
+		ring = NULL;
+		audit_msg(LOG_ERR, "Failed mapping dispatcher ring (%s)",
+			strerror(errno));
+		close_ring();
+		return 1;
+	}
+	data_fd = eventfd(0, EFD_NONBLOCK);
+	space_fd = eventfd(0, EFD_NONBLOCK);
+	if (data_fd < 0 || space_fd < 0) {
+		audit_msg(LOG_ERR, "Failed creating dispatcher eventfd (%s)",
+			strerror(errno));
+		close_ring();
+		return 1;
+	}
+	ring->magic = DISP_RING_MAGIC;
+	ring->version = DISP_RING_VERSION;
+	ring->size = size;
+	ring->data_offset = ring_map_size - size;
+	ring_qos = config->qos;
+	audit_msg(LOG_INFO, "Using a %uk shared memory ring for the dispatcher",
+		size / 1024);
+	return 0;
+#else
+	audit_msg(LOG_ERR,
+		"eventfd is not supported - disp_ring_size is ignored");
+	return 0;
+#endif
+}
+
+/* Moves fd to target in the child, which may already be in use */
+static int move_fd(int fd, int target)
+{
+	if (fd == target)
+		return 0;
+	if (dup2(fd, target) < 0)
+		return -1;
+	close(fd);
+	return 0;
+}
+
 /* This function returns 1 on error & 0 on success */
 int init_dispatcher(const struct daemon_conf *config)
 {
@@ -81,6 +204,16 @@ int init_dispatcher(const struct daemon_conf *config)
 		return 1;
 	}
 
+	pthread_mutex_lock(&ring_lock);
+	if (config->disp_ring_size && init_ring(config)) {
+		pthread_mutex_unlock(&ring_lock);
+		close(disp_pipe[0]);
+		close(disp_pipe[1]);
+		disp_pipe[0] = disp_pipe[1] = -1;
+		return 1;
+	}
+	pthread_mutex_unlock(&ring_lock);
+
 	/* Make both disp_pipe non-blocking */
 	if (config->qos == QOS_NON_BLOCKING) {
 		if (set_flags(disp_pipe[0], O_NONBLOCK) < 0 ||
@@ -100,11 +233,32 @@ int init_dispatcher(const struct daemon_conf *config)
 			sigfillset (&sa.sa_mask);
 			sigprocmask (SIG_UNBLOCK, &sa.sa_mask, 0);
 			setsid();
-			execl(config->dispatcher, config->dispatcher, NULL);
+			if (ring) {
+				/* Get out of the way of the fixed numbers
+				   before moving to them */
+				ring_fd = fcntl(ring_fd, F_DUPFD, 10);
+				data_fd = fcntl(data_fd, F_DUPFD, 10);
+				space_fd = fcntl(space_fd, F_DUPFD, 10);
+				if (ring_fd < 0 || data_fd < 0 ||
+					space_fd < 0 ||
+					move_fd(ring_fd, DISP_RING_FD) ||
+					move_fd(data_fd, DISP_RING_DATA_FD) ||
+					move_fd(space_fd, DISP_RING_SPACE_FD)){
+					audit_msg(LOG_ERR,
+					    "Failed passing dispatcher ring");
+					exit(1);
+				}
+				execl(config->dispatcher, config->dispatcher,
+					"--ring", NULL);
+			} else
+				execl(config->dispatcher, config->dispatcher,
+					NULL);
 			audit_msg(LOG_ERR, "exec() failed");
 			exit(1);
 			break;
 		case -1:	// error
+			pid = 0;
+			shutdown_dispatcher();
 			return 1;
 			break;
 		default:	// parent
@@ -116,6 +270,18 @@ int init_dispatcher(const struct daemon_conf *config)
 					"Failed to set FD_CLOEXEC flag");
 				return 1;
 			}
+			/* The child has its own copy of the memfd */
+			if (ring_fd >= 0) {
+				close(ring_fd);
+				ring_fd = -1;
+			}
+			if (space_fd >= 0 &&
+				(fcntl(space_fd, F_SETFD, FD_CLOEXEC) < 0 ||
+				 fcntl(data_fd, F_SETFD, FD_CLOEXEC) < 0)) {
+				audit_msg(LOG_ERR,
+					"Failed to set FD_CLOEXEC flag");
+				return 1;
+			}
 			audit_msg(LOG_INFO, "Started dispatcher: %s pid: %u",
 					config->dispatcher, pid);
 			break;
@@ -125,6 +291,13 @@ int init_dispatcher(const struct daemon_conf *config)
 }
 
 void shutdown_dispatcher(void)
+{
+	pthread_mutex_lock(&ring_lock);
+	shutdown_dispatcher_locked();
+	pthread_mutex_unlock(&ring_lock);
+}
+
+static void shutdown_dispatcher_locked(void)
 {
 	// kill child
 	if (pid)
@@ -142,6 +315,7 @@ void shutdown_dispatcher(void)
 		close(disp_pipe[1]);
 		disp_pipe[1] = -1;
 	}
+	close_ring();
 }
 
 void reconfigure_dispatcher(const struct daemon_conf *config)
@@ -153,10 +327,131 @@ void reconfigure_dispatcher(const struct daemon_conf *config)
 		init_dispatcher(config);
 }
 
+static void report_lost(const char *reason)
+{
+	metrics_inc(M_DISPATCH_LOST);
+	if (n_errs <= REPORT_LIMIT) {
+		audit_msg(LOG_ERR, "dispatch err (%s) event lost", reason);
+		n_errs++;
+	}
+	if (n_errs == REPORT_LIMIT) {
+		audit_msg(LOG_ERR, "dispatch error reporting limit"
+			" reached - ending report notification.");
+		n_errs++;
+	}
+}
+
+/*
+ * Wait for the dispatcher to free up space. Returns 0 when it is worth
+ * looking again, 1 if we gave up, and -1 if the dispatcher went away.
+ */
+static int wait_for_space(int *waited)
+{
+	struct pollfd pfd[2];
+	int rc, timeout;
+
+	if (ring_qos == QOS_NON_BLOCKING) {
+		/* Don't hold up draining the kernel backlog */
+		if (*waited >= RING_WAIT_MS || backlog_draining())
+			return 1;
+		timeout = RING_WAIT_MS - *waited;
+	} else
+		timeout = 1000;
+
+	pfd[0].fd = space_fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = disp_pipe[1];
+	pfd[1].events = 0;	/* Only hang ups */
+	do {
+		rc = poll(pfd, 2, timeout);
+	} while (rc < 0 && errno == EINTR);
+	if (rc == 0)
+		*waited += timeout;
+	else if (rc > 0) {
+		uint64_t cnt;
+
+		if (pfd[1].revents & (POLLHUP|POLLERR))
+			return -1;
+		/* Clear the wakeup, it's non-blocking */
+		rc = read(space_fd, &cnt, sizeof(cnt));
+	}
+	return 0;
+}
+
+/* Same return codes as dispatch_event */
+static int dispatch_ring(const struct audit_dispatcher_header *hdr,
+		const char *msg)
+{
+	uint32_t size = ring->size, pos, contig, rec, need;
+	uint64_t head = ring->head, tail;
+	char *data = disp_ring_data(ring);
+	int waited = 0, rc;
+
+	rec = DISP_RING_REC_LEN(hdr->size);
+	pos = head & (size - 1);
+	contig = size - pos;
+	need = rec <= contig ? rec : contig + rec;
+	for (;;) {
+		tail = ring->tail;
+		if (size - (uint32_t)(head - tail) >= need)
+			break;
+
+		/* Full - ask the dispatcher to kick us and look again */
+		ring->producer_waiting = 1;
+		__sync_synchronize();
+		if (size - (uint32_t)(head - ring->tail) >= need)
+			continue;
+		if (waited == 0)
+			ring->waits++;
+		rc = wait_for_space(&waited);
+		if (rc < 0) {
+			shutdown_dispatcher_locked();
+			n_errs = 0;
+			return -1;
+		}
+		if (rc) {
+			ring->lost++;
+			report_lost("ring full");
+			return 1;
+		}
+	}
+	/* Make sure the data is not written ahead of reading the tail */
+	__sync_synchronize();
+
+	if (rec > contig) {
+		if (contig >= sizeof(*hdr)) {
+			struct audit_dispatcher_header pad;
+
+			memset(&pad, 0, sizeof(pad));
+			pad.type = DISP_RING_PAD;
+			memcpy(data + pos, &pad, sizeof(pad));
+		}
+		head += contig;
+		pos = 0;
+	}
+	memcpy(data + pos, hdr, sizeof(*hdr));
+	memcpy(data + pos + sizeof(*hdr), msg, hdr->size);
+
+	/* Publish the record, then see if the dispatcher is asleep */
+	__sync_synchronize();
+	ring->head = head + rec;
+	if (head + rec - tail > ring->high_water)
+		ring->high_water = head + rec - tail;
+	__sync_synchronize();
+	if (ring->consumer_sleeping &&
+		__sync_bool_compare_and_swap(&ring->consumer_sleeping, 1, 0)) {
+		uint64_t one = 1;
+
+		rc = write(data_fd, &one, sizeof(one));
+	}
+	n_errs = 0;
+	return 0;
+}
+
 /* Returns -1 on err, 0 on success, and 1 if eagain occurred and not an err */
 int dispatch_event(const struct audit_reply *rep, int is_err)
 {
-	int rc, count = 0;
+	int rc, count = 0, tries = backlog_draining() ? 1 : 8;
 	struct iovec vec[2];
 	struct audit_dispatcher_header hdr;
 
@@ -173,6 +468,14 @@ int dispatch_event(const struct audit_reply *rep, int is_err)
 	hdr.type = rep->type;
 	hdr.size = rep->len;
 
+	pthread_mutex_lock(&ring_lock);
+	if (ring) {
+		rc = dispatch_ring(&hdr, rep->message);
+		pthread_mutex_unlock(&ring_lock);
+		return rc;
+	}
+	pthread_mutex_unlock(&ring_lock);
+
 	vec[0].iov_base = (void*)&hdr;
 	vec[0].iov_len = sizeof(hdr);
 	vec[1].iov_base = (void*)rep->message;
@@ -180,7 +483,7 @@ int dispatch_event(const struct audit_reply *rep, int is_err)
 
 	do {
 		rc = writev(disp_pipe[1], vec, 2);
-	} while (rc < 0 && errno == EAGAIN && count++ < 8);
+	} while (rc < 0 && errno == EAGAIN && count++ < tries);
 
 	// close pipe if no child or peer has been lost
 	if (rc <= 0) {
@@ -188,22 +491,11 @@ int dispatch_event(const struct audit_reply *rep, int is_err)
 			shutdown_dispatcher();
 			n_errs = 0;
 		} else if (errno == EAGAIN && !is_err) {
+			metrics_inc(M_DISPATCH_RETRIES);
 			return 1;
 		} else {
-			if (n_errs <= REPORT_LIMIT) {
-				audit_msg(LOG_ERR, 
-					"dispatch err (%s) event lost",
-					errno == EAGAIN ? "pipe full" :
+			report_lost(errno == EAGAIN ? "pipe full" :
 					strerror(errno));
-				n_errs++;
-			}
-			if (n_errs == REPORT_LIMIT) {
-				audit_msg(LOG_ERR, 
-					"dispatch error reporting limit"
-					" reached - ending report"
-					" notification.");
-				n_errs++;
-			}
 			return -1;
 		}
 	} else
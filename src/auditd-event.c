@@ -39,6 +39,8 @@
 #include "auditd-listen.h"
 #include "libaudit.h"
 #include "private.h"
+#include "auditd-metrics.h"
+#include "auditd-backlog.h"
 
 /* This is defined in auditd.c */
 extern volatile int stop;
@@ -51,6 +53,7 @@ struct auditd_consumer_data {
     struct auditd_reply_list *tail;
     int log_fd;
     FILE *log_file;
+    unsigned int depth;	// Records on the queue
 };
 
 /* Local function prototypes */
@@ -152,6 +155,26 @@ int init_event(struct daemon_conf *config)
 	return 0;
 }
 
+/* This function links rep in at the end of the queue */
+static void queue_event(struct auditd_reply_list *rep)
+{
+	pthread_mutex_lock(&consumer_data.queue_lock);
+	if (consumer_data.head == NULL) {
+		consumer_data.head = consumer_data.tail = rep;
+		pthread_cond_signal(&consumer_data.queue_nonempty);
+	} else {
+		/* FIXME: wait for room on the queue */
+
+		/* OK there's room...add it in */
+		consumer_data.tail->next = rep; /* link in at end */
+		consumer_data.tail = rep; /* move end to newest */
+	}
+	consumer_data.depth++;
+	metrics_record(H_QUEUE_DEPTH, consumer_data.depth);
+	pthread_mutex_unlock(&consumer_data.queue_lock);
+	metrics_inc(M_QUEUED);
+}
+
 /* This function takes a malloc'd rep and places it on the queue. The 
    dequeue'r is responsible for freeing the memory. */
 void enqueue_event(struct auditd_reply_list *rep)
@@ -207,18 +230,7 @@ void enqueue_event(struct auditd_reply_list *rep)
 
 	rep->next = NULL; /* new packet goes at end - so zero this */
 
-	pthread_mutex_lock(&consumer_data.queue_lock);
-	if (consumer_data.head == NULL) {
-		consumer_data.head = consumer_data.tail = rep;
-		pthread_cond_signal(&consumer_data.queue_nonempty);
-	} else {
-		/* FIXME: wait for room on the queue */
-
-		/* OK there's room...add it in */
-		consumer_data.tail->next = rep; /* link in at end */
-		consumer_data.tail = rep; /* move end to newest */
-	}
-	pthread_mutex_unlock(&consumer_data.queue_lock);
+	queue_event(rep);
 }
 
 /* This function takes a preformatted message and places it on the
@@ -237,6 +249,7 @@ void enqueue_formatted_event(char *msg, ack_func_type ack_func, void *ack_data,
 	rep->ack_func = ack_func;
 	rep->ack_data = ack_data;
 	rep->sequence_id = sequence_id;
+	rep->stamp = metrics_now();
 
 	len = strlen (msg);
 	if (len < MAX_AUDIT_MESSAGE_LENGTH - 1)
@@ -247,18 +260,7 @@ void enqueue_formatted_event(char *msg, ack_func_type ack_func, void *ack_data,
 		rep->reply.msg.data[MAX_AUDIT_MESSAGE_LENGTH-1] = 0;
 	}
 
-	pthread_mutex_lock(&consumer_data.queue_lock);
-	if (consumer_data.head == NULL) {
-		consumer_data.head = consumer_data.tail = rep;
-		pthread_cond_signal(&consumer_data.queue_nonempty);
-	} else {
-		/* FIXME: wait for room on the queue */
-
-		/* OK there's room...add it in */
-		consumer_data.tail->next = rep; /* link in at end */
-		consumer_data.tail = rep; /* move end to newest */
-	}
-	pthread_mutex_unlock(&consumer_data.queue_lock);
+	queue_event(rep);
 }
 
 void resume_logging(void)
@@ -283,6 +285,7 @@ static void *event_thread_main(void *arg)
 	sigaddset(&sigs, SIGHUP);
 	sigaddset(&sigs, SIGUSR1);
 	sigaddset(&sigs, SIGUSR2);
+	sigaddset(&sigs, SIGCONT);
 	pthread_sigmask(SIG_SETMASK, &sigs, NULL);
 
 	while (1) {
@@ -301,6 +304,7 @@ static void *event_thread_main(void *arg)
 		if (data->tail == data->head)
 			data->tail = NULL;
 		data->head = data->head->next;
+		data->depth--;
 		if (data->head == NULL && stop && 
 				( cur->reply.type == AUDIT_DAEMON_END ||
 				cur->reply.type == AUDIT_DAEMON_ABORT) )
@@ -313,6 +317,7 @@ static void *event_thread_main(void *arg)
 			free((void *)cur->reply.message);
 		} 
 		free(cur);
+		metrics_inc(M_LOGGED);
 		if (stop_req)
 			break;
 	}
@@ -349,17 +354,25 @@ static void handle_event(struct auditd_consumer_data *data)
 	if (!logging_suspended) {
 
 		write_to_log(buf, data);
+		if (data->head->stamp)
+			metrics_record(H_LOG_LATENCY,
+				metrics_now() - data->head->stamp);
 
-		/* See if we need to flush to disk manually */
+		/* See if we need to flush to disk manually. While the
+		   kernel backlog is drained, most flushes are skipped. */
 		if (data->config->flush == FT_INCREMENTAL) {
 			count++;
-			if ((count % data->config->freq) == 0) {
+			if ((count % data->config->freq) == 0 &&
+				(!backlog_draining() || (count /
+				data->config->freq) % DRAIN_SYNC_EVERY == 0)) {
+				uint64_t start = metrics_now();
 				int rc;
 				errno = 0;
 				do {
 					rc = fflush(data->log_file);
 				} while (rc < 0 && errno == EINTR);
 		                if (errno) {
+					metrics_inc(M_LOG_ERRORS);
 		                	if (errno == ENOSPC && 
 					     fs_space_left == 1) {
 					     fs_space_left = 0;
@@ -373,9 +386,12 @@ static void handle_event(struct auditd_consumer_data *data)
 				/* EIO is only likely failure mode */
 				if ((data->config->daemonize == D_BACKGROUND)&& 
 						(fsync(data->log_fd) != 0)) {
+				     metrics_inc(M_LOG_ERRORS);
 				     do_disk_error_action("fsync",
 					data->config, errno);
 				}
+				metrics_record(H_SYNC_LATENCY,
+					metrics_now() - start);
 			}
 		}
 	}
@@ -408,6 +424,7 @@ static void write_to_log(const char *buf, struct auditd_consumer_data *data)
 
 	/* error? Handle it */
 	if (rc < 0) {
+		metrics_inc(M_LOG_ERRORS);
 		if (errno == ENOSPC) {
 			ack_type = AUDIT_RMW_TYPE_DISKFULL;
 			msg = "disk full";
@@ -1101,6 +1118,7 @@ static void reconfigure(struct auditd_consumer_data *data)
 	char date[40];
 	unsigned int seq_num;
 	int need_size_check = 0, need_reopen = 0, need_space_check = 0;
+	int need_disp_restart = 0;
 
 	snprintf(txt, sizeof(txt),
 		"config change requested by pid=%d auid=%u subj=%s",
@@ -1156,6 +1174,10 @@ static void reconfigure(struct auditd_consumer_data *data)
 
 	/* Now look at audit dispatcher changes */
 	oconf->qos = nconf->qos; // dispatcher qos
+	if (oconf->disp_ring_size != nconf->disp_ring_size) {
+		oconf->disp_ring_size = nconf->disp_ring_size;
+		need_disp_restart = 1;
+	}
 
 	// do the dispatcher app change
 	if (oconf->dispatcher || nconf->dispatcher) {
@@ -1187,8 +1209,9 @@ static void reconfigure(struct auditd_consumer_data *data)
 			free((char *)oconf->dispatcher);
 			oconf->dispatcher = NULL;
 		} 
-		// they are different apps
-		else if (strcmp(oconf->dispatcher, nconf->dispatcher)) {
+		// they are different apps or the transport changed
+		else if (strcmp(oconf->dispatcher, nconf->dispatcher) ||
+				need_disp_restart) {
 			shutdown_dispatcher();
 			free((char *)oconf->dispatcher);
 			oconf->dispatcher = strdup(nconf->dispatcher);
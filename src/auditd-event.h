@@ -34,6 +34,7 @@ struct auditd_reply_list {
 	ack_func_type ack_func;
 	void *ack_data;
 	unsigned long sequence_id;
+	uint64_t stamp;		// When it was received, for the metrics
 };
 
 #include "auditd-config.h"
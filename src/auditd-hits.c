@@ -0,0 +1,279 @@
+/* auditd-hits.c --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+/*
+ * These counters show which rules make the events. Each syscall record
+ * is counted once for each key it has. Records that have no key are
+ * counted by their syscall and exe, which is what tells the rules that
+ * have no key apart. Only the main thread counts and reports, so there
+ * is no locking. aureport --rule-hits does the same counting on the logs.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "libaudit.h"
+#include "auditd-hits.h"
+
+#define HIT_BUCKETS	1024
+#define HITS_MAX	8192	// Distinct entries kept, the rest are other
+#define FIELD_MAX	1024	// Longest key or exe kept
+
+struct hit {
+	struct hit *next;
+	unsigned long count;
+	unsigned int arch;	// Arch and syscall when there is no key
+	int syscall;		// -1 for a key
+	char name[];		// The key or the exe
+};
+
+static struct hit *buckets[HIT_BUCKETS];
+static unsigned int entries = 0;
+static unsigned long records = 0, other = 0;
+static time_t since = 0;
+
+/*
+ * This function finds a field in the len bytes at msg. name has the space
+ * in front of it and the equal sign. Returns where the value starts, with
+ * its length in vlen, or NULL if it isn't there.
+ */
+static const char *find_field(const char *msg, size_t len, const char *name,
+	size_t *vlen)
+{
+	const char *ptr, *end = msg + len;
+	size_t nlen = strlen(name);
+
+	ptr = memmem(msg, len, name, nlen);
+	if (ptr == NULL)
+		return NULL;
+	ptr += nlen;
+	*vlen = 0;
+	while (ptr + *vlen < end && ptr[*vlen] != ' ' && ptr[*vlen] != 0 &&
+			ptr[*vlen] != '\n')
+		(*vlen)++;
+	return ptr;
+}
+
+/*
+ * This function copies a value into buf without its quotes, or decodes
+ * it if it is in hex. Returns its length or -1 if there is no value.
+ */
+static int decode(const char *val, size_t vlen, char *buf)
+{
+	size_t i;
+
+	if (vlen >= 2 && val[0] == '"' && val[vlen-1] == '"') {
+		vlen -= 2;
+		if (vlen >= FIELD_MAX)
+			vlen = FIELD_MAX - 1;
+		memcpy(buf, val + 1, vlen);
+		buf[vlen] = 0;
+		return vlen;
+	}
+	if (vlen == 0 || vlen % 2 || vlen / 2 >= FIELD_MAX)
+		return -1;	// (null) or damaged
+	for (i = 0; i < vlen; i += 2) {
+		char hex[3] = { val[i], val[i+1], 0 };
+
+		if (!isxdigit((unsigned char)hex[0]) ||
+				!isxdigit((unsigned char)hex[1]))
+			return -1;
+		buf[i/2] = strtoul(hex, NULL, 16);
+	}
+	buf[i/2] = 0;
+	return vlen / 2;
+}
+
+/* Reads a number out of a field value that isn't terminated */
+static unsigned long field_num(const char *val, size_t vlen, int base)
+{
+	char num[24];
+
+	if (val == NULL || vlen >= sizeof(num))
+		return 0;
+	memcpy(num, val, vlen);
+	num[vlen] = 0;
+	return strtoul(num, NULL, base);
+}
+
+static void add_hit(const char *name, size_t len, unsigned int arch,
+	int syscall)
+{
+	unsigned int h = 2166136261U;
+	struct hit *e;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)name[i]) * 16777619U;
+	h ^= arch ^ (syscall * 2654435761U);
+	h %= HIT_BUCKETS;
+	for (e = buckets[h]; e; e = e->next) {
+		if (e->syscall == syscall && e->arch == arch &&
+				strncmp(e->name, name, len) == 0 &&
+				e->name[len] == 0) {
+			e->count++;
+			return;
+		}
+	}
+	if (entries < HITS_MAX)
+		e = malloc(sizeof(*e) + len + 1);
+	if (entries >= HITS_MAX || e == NULL) {
+		other++;
+		return;
+	}
+	e->count = 1;
+	e->arch = arch;
+	e->syscall = syscall;
+	memcpy(e->name, name, len);
+	e->name[len] = 0;
+	e->next = buckets[h];
+	buckets[h] = e;
+	entries++;
+}
+
+void hits_count(const struct audit_reply *rep)
+{
+	char buf[FIELD_MAX];
+	const char *val, *sys;
+	size_t vlen, slen;
+	unsigned int arch;
+	int len, syscall;
+
+	if (rep->type != AUDIT_SYSCALL || rep->message == NULL)
+		return;
+	if (since == 0)
+		since = time(NULL);
+	records++;
+
+	val = find_field(rep->message, rep->len, " key=", &vlen);
+	if (val && (len = decode(val, vlen, buf)) > 0) {
+		char *key = buf, *end = buf + len;
+
+		// A rule can have several keys
+		while (key < end) {
+			char *sep;
+
+			sep = memchr(key, AUDIT_KEY_SEPARATOR, end - key);
+
+			if (sep == NULL)
+				sep = end;
+			if (sep > key)
+				add_hit(key, sep - key, 0, -1);
+			key = sep + 1;
+		}
+		return;
+	}
+
+	// No key, count it by arch, syscall, and exe
+	val = find_field(rep->message, rep->len, " arch=", &vlen);
+	sys = find_field(rep->message, rep->len, " syscall=", &slen);
+	if (val == NULL || sys == NULL)
+		return;
+	arch = field_num(val, vlen, 16);
+	syscall = field_num(sys, slen, 10);
+	val = find_field(rep->message, rep->len, " exe=", &vlen);
+	if (val == NULL || (len = decode(val, vlen, buf)) < 0) {
+		strcpy(buf, "?");
+		len = 1;
+	}
+	add_hit(buf, len, arch, syscall);
+}
+
+/* Biggest counts first, then by name */
+static int hit_cmp(const void *a, const void *b)
+{
+	const struct hit *x = *(struct hit * const *)a;
+	const struct hit *y = *(struct hit * const *)b;
+
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+	if (x->syscall != y->syscall)
+		return x->syscall - y->syscall;
+	return strcmp(x->name, y->name);
+}
+
+void hits_report(FILE *f)
+{
+	struct hit **sorted, *e;
+	unsigned int i, n = 0;
+	char start[32];
+
+	if (since)
+		strftime(start, sizeof(start), "%x %T", localtime(&since));
+	else
+		strcpy(start, "?");
+	fprintf(f, "rule hits since = %s\n", start);
+	fprintf(f, "syscall records = %lu\n", records);
+	fprintf(f, "total  rule\n");
+	sorted = malloc((entries + 1) * sizeof(struct hit *));
+	if (sorted == NULL)
+		return;
+	for (i = 0; i < HIT_BUCKETS; i++) {
+		for (e = buckets[i]; e; e = e->next)
+			sorted[n++] = e;
+	}
+	qsort(sorted, n, sizeof(struct hit *), hit_cmp);
+	for (i = 0; i < n; i++) {
+		const char *sys = NULL;
+		int machine;
+
+		e = sorted[i];
+		if (e->syscall < 0) {
+			fprintf(f, "%lu  key=%s\n", e->count, e->name);
+			continue;
+		}
+		machine = audit_elf_to_machine(e->arch);
+		if (machine >= 0)
+			sys = audit_syscall_to_name(e->syscall, machine);
+		if (sys)
+			fprintf(f, "%lu  syscall=%s exe=%s\n", e->count, sys,
+				e->name);
+		else	// auditd is built without the syscall tables
+			fprintf(f, "%lu  syscall=%d arch=%x exe=%s\n",
+				e->count, e->syscall, e->arch, e->name);
+	}
+	if (other)
+		fprintf(f, "%lu  (other)\n", other);
+	free(sorted);
+}
+
+void hits_clear(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < HIT_BUCKETS; i++) {
+		while (buckets[i]) {
+			struct hit *e = buckets[i];
+
+			buckets[i] = e->next;
+			free(e);
+		}
+	}
+	entries = 0;
+	records = other = 0;
+	since = 0;
+}
+
@@ -0,0 +1,37 @@
+/* auditd-hits.h --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+#ifndef AUDITD_HITS_H
+#define AUDITD_HITS_H
+
+#include <stdio.h>
+#include "libaudit.h"
+
+/* Counts a syscall record against its keys, or its syscall and exe */
+void hits_count(const struct audit_reply *rep);
+/* Writes the counts, biggest first */
+void hits_report(FILE *f);
+void hits_clear(void);
+
+#endif
+
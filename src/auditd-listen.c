@@ -35,6 +35,7 @@
 #include <libgen.h>
 #include <arpa/inet.h>
 #include <limits.h>	/* INT_MAX */
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -50,6 +51,8 @@
 #include "libaudit.h"
 #include "auditd-event.h"
 #include "auditd-config.h"
+#include "auditd-listen.h"
+#include "auditd-metrics.h"
 #include "private.h"
 
 #include "ev.h"
@@ -64,6 +67,8 @@ typedef struct ev_tcp {
 	struct ev_tcp *next, *prev;
 	unsigned int bufptr;
 	int client_active;
+	time_t connected;
+	unsigned long events, bytes;	// What the client has sent
 #ifdef USE_GSSAPI
 	/* This holds the negotiated security context for this client.  */
 	gss_ctx_id_t gss_context;
@@ -533,15 +538,20 @@ static void client_message (struct ev_tcp *io, unsigned int length,
 			AUDIT_RMW_PACK_HEADER (ack, 0, AUDIT_RMW_TYPE_ACK,
 				0, seq);
 			client_ack (io, ack, "");
-		} else 
+		} else {
 			enqueue_formatted_event(header+AUDIT_RMW_HEADER_SIZE,
 				client_ack, io, seq);
+			io->events++;
+			metrics_inc(M_REMOTE_EVENTS);
+		}
 		header[length] = ch;
 	} else {
 		header[length] = 0;
 		if (length > 1 && header[length-1] == '\n')
 			header[length-1] = 0;
 		enqueue_formatted_event (header, NULL, NULL, 0);
+		io->events++;
+		metrics_inc(M_REMOTE_EVENTS);
 	}
 }
 
@@ -595,6 +605,7 @@ read_more:
 	}
 
 	total_this_call += r;
+	io->bytes += r;
 
 more_messages:
 #ifdef USE_GSSAPI
@@ -836,6 +847,7 @@ static void auditd_tcp_listen_handler( struct ev_loop *loop,
 
 	memset (client, 0, sizeof (struct ev_tcp));
 	client->client_active = 1;
+	client->connected = time(NULL);
 
 	// Was watching for EV_ERROR, but libev 3.48 took it away
 	ev_io_init (&(client->io), auditd_tcp_client_handler, afd, EV_READ);
@@ -1026,6 +1038,27 @@ void auditd_tcp_listen_uninit ( struct ev_loop *loop,
 		ev_periodic_stop (loop, &periodic_watcher);
 }
 
+void auditd_tcp_listen_report(FILE *f)
+{
+	struct ev_tcp *client;
+	time_t now = time(NULL);
+	unsigned int n = 0;
+
+	for (client = client_chain; client; client = client->next)
+		n++;
+	fprintf(f, "remote clients = %u\n", n);
+	for (client = client_chain; client; client = client->next) {
+		time_t secs = now - client->connected;
+
+		fprintf(f, "client %s = events=%lu bytes=%lu "
+			"events/sec=%lu connected=%lu\n",
+			sockaddr_to_addr4(&client->addr), client->events,
+			client->bytes,
+			client->events / (secs > 0 ? secs : 1),
+			(unsigned long)secs);
+	}
+}
+
 static void periodic_reconfigure(struct daemon_conf *config)
 {
 	struct ev_loop *loop = ev_default_loop (EVFLAG_AUTO);
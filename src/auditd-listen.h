@@ -24,6 +24,7 @@
 #ifndef AUDITD_LISTEN_H
 #define AUDITD_LISTEN_H
 
+#include <stdio.h>
 #include "ev.h"
 
 #ifdef USE_LISTENER
@@ -32,6 +33,8 @@ void auditd_tcp_listen_uninit ( struct ev_loop *loop,
 				struct daemon_conf *config );
 void auditd_tcp_listen_reconfigure ( struct daemon_conf *nconf,
 				     struct daemon_conf *oconf );
+/* Writes what each remote client has sent for the state report */
+void auditd_tcp_listen_report(FILE *f);
 #else
 static inline int auditd_tcp_listen_init ( struct ev_loop *loop,
 					   struct daemon_conf *config )
@@ -50,6 +53,11 @@ static inline void auditd_tcp_listen_reconfigure ( struct daemon_conf *nconf,
 {
 	return;
 }
+
+static inline void auditd_tcp_listen_report(FILE *f)
+{
+	return;
+}
 #endif /* USE_LISTENER */
 
 #endif
@@ -0,0 +1,181 @@
+/* auditd-metrics.c --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+/*
+ * These metrics show where time goes between reading a record and having
+ * it on disk. They are meant to stay on, so recording a value costs an
+ * add or a few adds and no locks. Counters are bumped atomically since
+ * several threads count. Each histogram is written by one thread at a
+ * time (the queue depth under the queue lock) and is read by the main
+ * thread when it reports, so a report may be off by the few values being
+ * recorded at that moment.
+ *
+ * The histograms keep 8 buckets for each power of two, so a value is
+ * known to within 12.5% whatever its size, and the percentiles reported
+ * are the top of the bucket they fall in.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "auditd-metrics.h"
+
+#define SUB_BITS	3
+#define SUB_BUCKETS	(1 << SUB_BITS)
+#define HIST_BUCKETS	((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+struct hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[HIST_BUCKETS];
+};
+
+uint64_t metric_counters[M_COUNTERS];
+static struct hist hists[H_HISTS];
+
+static const char *counter_names[M_COUNTERS] = {
+	"netlink records",
+	"remote records",
+	"queued records",
+	"logged records",
+	"log errors",
+	"dispatch retries",
+	"dispatch lost",
+};
+
+static const struct {
+	const char *name;
+	unsigned int scale;	// Divides the values for the report
+} hist_info[H_HISTS] = {
+	{ "queue depth",	1 },
+	{ "log latency (us)",	1000 },
+	{ "sync latency (us)",	1000 },
+};
+
+uint64_t metrics_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int bucket_of(uint64_t value)
+{
+	unsigned int msb;
+
+	if (value < SUB_BUCKETS)
+		return value;
+	msb = 63 - __builtin_clzll(value);
+	return (msb - SUB_BITS + 1) * SUB_BUCKETS +
+		((value >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+/* Returns the biggest value that goes in bucket b */
+static uint64_t bucket_top(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < SUB_BUCKETS)
+		return b;
+	shift = b / SUB_BUCKETS - 1;
+	return (((uint64_t)(SUB_BUCKETS + b % SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+void metrics_record(enum metric_hist h, uint64_t value)
+{
+	struct hist *hp = &hists[h];
+
+	hp->buckets[bucket_of(value)]++;
+	hp->count++;
+	hp->sum += value;
+	if (value > hp->max)
+		hp->max = value;
+}
+
+/* Returns the value that per_mille of the values are at or below */
+static uint64_t percentile(const struct hist *hp, uint64_t total,
+	unsigned int per_mille)
+{
+	uint64_t want, seen = 0;
+	unsigned int b;
+
+	want = (total * per_mille + 999) / 1000;
+	if (want == 0)
+		want = 1;
+	for (b = 0; b < HIST_BUCKETS; b++) {
+		seen += hp->buckets[b];
+		if (seen >= want)
+			break;
+	}
+	if (b == HIST_BUCKETS || bucket_top(b) > hp->max)
+		return hp->max;
+	return bucket_top(b);
+}
+
+void metrics_report(FILE *f)
+{
+	unsigned int i, b;
+	uint64_t queued, logged;
+
+	for (i = 0; i < M_COUNTERS; i++)
+		fprintf(f, "%s = %llu\n", counter_names[i],
+			(unsigned long long)metric_counters[i]);
+	queued = metric_counters[M_QUEUED];
+	logged = metric_counters[M_LOGGED];
+	fprintf(f, "records waiting = %llu\n",
+		(unsigned long long)(queued > logged ? queued - logged : 0));
+
+	for (i = 0; i < H_HISTS; i++) {
+		const struct hist *hp = &hists[i];
+		unsigned int scale = hist_info[i].scale;
+		uint64_t total = 0;
+
+		// Counted again so the percentiles agree with the buckets
+		for (b = 0; b < HIST_BUCKETS; b++)
+			total += hp->buckets[b];
+		if (total == 0) {
+			fprintf(f, "%s = count=0\n", hist_info[i].name);
+			continue;
+		}
+		fprintf(f, "%s = count=%llu mean=%llu p50=%llu p90=%llu "
+			"p99=%llu p99.9=%llu max=%llu\n", hist_info[i].name,
+			(unsigned long long)total,
+			(unsigned long long)(hp->count ?
+				hp->sum / hp->count / scale : 0),
+			(unsigned long long)(percentile(hp, total, 500)/scale),
+			(unsigned long long)(percentile(hp, total, 900)/scale),
+			(unsigned long long)(percentile(hp, total, 990)/scale),
+			(unsigned long long)(percentile(hp, total, 999)/scale),
+			(unsigned long long)(hp->max / scale));
+	}
+}
+
+void metrics_clear(void)
+{
+	memset(metric_counters, 0, sizeof(metric_counters));
+	memset(hists, 0, sizeof(hists));
+}
+
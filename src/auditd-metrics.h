@@ -0,0 +1,64 @@
+/* auditd-metrics.h --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+#ifndef AUDITD_METRICS_H
+#define AUDITD_METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Things that only go up. Any thread can count them. */
+enum metric_counter {
+	M_NETLINK_EVENTS,	// Records read from the kernel
+	M_REMOTE_EVENTS,	// Records from remote clients
+	M_QUEUED,		// Records put on the logging queue
+	M_LOGGED,		// Records the logger thread is done with
+	M_LOG_ERRORS,		// Failed writes, flushes, and syncs
+	M_DISPATCH_RETRIES,	// Dispatcher pipe full, tried again later
+	M_DISPATCH_LOST,	// Records the dispatcher never got
+	M_COUNTERS
+};
+
+/* Distributions. Only one thread at a time may record each one. */
+enum metric_hist {
+	H_QUEUE_DEPTH,		// Logging queue length as records are added
+	H_LOG_LATENCY,		// Nanoseconds from receipt to written to log
+	H_SYNC_LATENCY,		// Nanoseconds spent flushing the log to disk
+	H_HISTS
+};
+
+extern uint64_t metric_counters[M_COUNTERS];
+
+static inline void metrics_inc(enum metric_counter c)
+{
+	__sync_fetch_and_add(&metric_counters[c], 1);
+}
+
+/* Monotonic time in nanoseconds, for stamping and measuring */
+uint64_t metrics_now(void);
+void metrics_record(enum metric_hist h, uint64_t value);
+void metrics_report(FILE *f);
+void metrics_clear(void);
+
+#endif
+
@@ -44,6 +44,9 @@
 #include "auditd-config.h"
 #include "auditd-dispatch.h"
 #include "auditd-listen.h"
+#include "auditd-hits.h"
+#include "auditd-metrics.h"
+#include "auditd-backlog.h"
 #include "private.h"
 
 #include "ev.h"
@@ -63,9 +66,11 @@ volatile int stop = 0;
 static int fd = -1;
 static struct daemon_conf config;
 static const char *pidfile = "/var/run/auditd.pid";
+static const char *state_file = "/var/run/auditd.state";
 static int init_pipe[2];
 static int do_fork = 1;
 static struct auditd_reply_list *rep = NULL;
+static struct ev_timer status_watcher;
 static int hup_info_requested = 0;
 static int usr1_info_requested = 0, usr2_info_requested = 0;
 static char subj[SUBJ_LEN];
@@ -159,6 +164,50 @@ static void user2_handler( struct ev_loop *loop, struct ev_signal *sig, int reve
 		usr2_info_requested = 1;
 }
 
+/*
+ * This function writes what the daemon has counted so far where an admin
+ * can read it.
+ */
+static void write_state_report(void)
+{
+	FILE *f;
+	int sfd;
+	time_t now = time(NULL);
+	char buf[32];
+
+	sfd = open(state_file, O_CREAT | O_TRUNC | O_NOFOLLOW | O_WRONLY,
+			0640);
+	if (sfd < 0) {
+		audit_msg(LOG_ERR, "Unable to write state report (%s)",
+			strerror(errno));
+		return;
+	}
+	f = fdopen(sfd, "w");
+	if (f == NULL) {
+		close(sfd);
+		return;
+	}
+	strftime(buf, sizeof(buf), "%x %T", localtime(&now));
+	fprintf(f, "audit version = %s\n", VERSION);
+	fprintf(f, "current time = %s\n", buf);
+	fprintf(f, "\n");
+	backlog_report(f);
+	metrics_report(f);
+	auditd_tcp_listen_report(f);
+	fprintf(f, "\n");
+	hits_report(f);
+	fclose(f);
+}
+
+/*
+ * Used to dump the state report
+ */
+static void cont_handler(struct ev_loop *loop, struct ev_signal *sig,
+			int revents)
+{
+	write_state_report();
+}
+
 /*
  * Used with email alerts to cleanup
  */
@@ -177,6 +226,8 @@ static void distribute_event(struct auditd_reply_list *rep)
 {
 	int attempt = 0;
 
+	hits_count(&rep->reply);
+
 	/* Make first attempt to send to plugins */
 	if (dispatch_event(&rep->reply, attempt) == 1)
 		attempt++; /* Failed sending, retry after writing to disk */
@@ -222,6 +273,7 @@ int send_audit_event(int type, const char *str)
 	}
 
 	rep->reply.type = type;
+	rep->stamp = metrics_now();
 	rep->reply.message = (char *)malloc(DMSG_SIZE);
 	if (rep->reply.message == NULL) {
 		free(rep);
@@ -391,8 +443,11 @@ static void tell_parent(int status)
 	} while (rc < 0 && errno == EINTR);
 }
 
-static void netlink_handler(struct ev_loop *loop, struct ev_io *io,
-			int revents)
+/*
+ * This function reads one reply from the kernel and acts on it. Returns 1
+ * if one was read, 0 if there was none, and -1 if auditd is going down.
+ */
+static int read_netlink(struct ev_loop *loop)
 {
 	if (rep == NULL) { 
 		if ((rep = malloc(sizeof(*rep))) == NULL) {
@@ -413,20 +468,28 @@ static void netlink_handler(struct ev_loop *loop, struct ev_io *io,
 			if (pidfile)
 				unlink(pidfile);
 			shutdown_dispatcher();
-			return;
+			return -1;
 		}
 	}
 	if (audit_get_reply(fd, &rep->reply, 
 			    GET_REPLY_NONBLOCKING, 0) > 0) {
+		rep->stamp = metrics_now();
 		switch (rep->reply.type)
 		{	/* For now dont process these */
 		case NLMSG_NOOP:
 		case NLMSG_DONE:
 		case NLMSG_ERROR:
-		case AUDIT_GET: /* Or these */
-		case AUDIT_LIST_RULES:
+		case AUDIT_LIST_RULES: /* Or these */
 		case AUDIT_FIRST_DAEMON...AUDIT_LAST_DAEMON:
 			break;
+		case AUDIT_GET:
+			if (backlog_status(rep->reply.status)) {
+				/* Look more often while draining */
+				status_watcher.repeat = backlog_draining() ?
+					DRAIN_POLL : STATUS_POLL;
+				ev_timer_again(loop, &status_watcher);
+			}
+			break;
 		case AUDIT_SIGNAL_INFO:
 			if (hup_info_requested) {
 				audit_msg(LOG_DEBUG,
@@ -474,15 +537,39 @@ static void netlink_handler(struct ev_loop *loop, struct ev_io *io,
 			}
 			break;
 		default:
+			metrics_inc(M_NETLINK_EVENTS);
 			distribute_event(rep);
 			rep = NULL;
 			break;
 		}
+		return 1;
 	} else {
 		if (errno == EFBIG) {
 			// FIXME do err action
 		}
 	}
+	return 0;
+}
+
+static void netlink_handler(struct ev_loop *loop, struct ev_io *io,
+			int revents)
+{
+	int i, batch = backlog_draining() ? DRAIN_BATCH : 1;
+
+	for (i = 0; i < batch && stop == 0; i++) {
+		if (read_netlink(loop) <= 0)
+			break;
+	}
+}
+
+/*
+ * Asks the kernel how far behind we are. The answer comes in through
+ * netlink_handler.
+ */
+static void status_handler(struct ev_loop *loop, struct ev_timer *timer,
+			int revents)
+{
+	audit_send_nowait(fd, AUDIT_GET, NULL, 0);
 }
 
 int main(int argc, char *argv[])
@@ -501,6 +588,7 @@ int main(int argc, char *argv[])
 	struct ev_signal sigusr1_watcher;
 	struct ev_signal sigusr2_watcher;
 	struct ev_signal sigchld_watcher;
+	struct ev_signal sigcont_watcher;
 
 	/* Get params && set mode */
 	while ((c = getopt(argc, argv, "flns:")) != -1) {
@@ -724,6 +812,9 @@ int main(int argc, char *argv[])
 	ev_io_init (&netlink_watcher, netlink_handler, fd, EV_READ);
 	ev_io_start (loop, &netlink_watcher);
 
+	ev_timer_init (&status_watcher, status_handler, 0, STATUS_POLL);
+	ev_timer_start (loop, &status_watcher);
+
 	ev_signal_init (&sigterm_watcher, term_handler, SIGTERM);
 	ev_signal_start (loop, &sigterm_watcher);
 
@@ -739,6 +830,9 @@ int main(int argc, char *argv[])
 	ev_signal_init (&sigchld_watcher, child_handler, SIGCHLD);
 	ev_signal_start (loop, &sigchld_watcher);
 
+	ev_signal_init (&sigcont_watcher, cont_handler, SIGCONT);
+	ev_signal_start (loop, &sigcont_watcher);
+
 	if (auditd_tcp_listen_init (loop, &config)) {
 		char emsg[DEFAULT_BUF_SZ];
 		if (*subj)
@@ -775,6 +869,8 @@ int main(int argc, char *argv[])
 	ev_signal_stop (loop, &sighup_watcher);
 	ev_signal_stop (loop, &sigusr1_watcher);
 	ev_signal_stop (loop, &sigusr2_watcher);
+	ev_signal_stop (loop, &sigcont_watcher);
+	ev_timer_stop (loop, &status_watcher);
 	ev_signal_stop (loop, &sigterm_watcher);
 
 	/* Write message to log that we are going down */
@@ -813,6 +909,7 @@ int main(int argc, char *argv[])
 
 	close_down();
 	free_config(&config);
+	hits_clear();
 	ev_default_destroy();
 
 	return 0;
@@ -850,42 +947,34 @@ static void clean_exit(void)
 	closelog();
 }
 
+/* Copies the signal info reply to the caller's reply */
+static int signal_reply(struct audit_reply *rep, void *data)
+{
+	struct audit_reply *trep = data;
+	unsigned int len = rep->nlh->nlmsg_len;
+
+	if (rep->type != AUDIT_SIGNAL_INFO)
+		return 0;
+	if (len > sizeof(trep->msg))
+		return -EFBIG;
+	memcpy(&trep->msg, rep->nlh, len);
+	trep->type = rep->type;
+	trep->len = rep->len;
+	trep->nlh = &trep->msg.nlh;
+	trep->signal_info = NLMSG_DATA(trep->nlh);
+	return 1;
+}
+
 /*
  * This function is used to get the reply for term info.
  * Returns 1 on success & -1 on failure.
  */
 static int get_reply(int fd, struct audit_reply *rep, int seq)
 {
-        int rc, i;
-        int timeout = 30; /* tenths of seconds */
-
-	for (i = 0; i < timeout; i++) {
-		struct timeval t;
-		fd_set read_mask;
-
-		t.tv_sec  = 0;
-		t.tv_usec = 100000; /* .1 second */
-		FD_ZERO(&read_mask);
-		FD_SET(fd, &read_mask);
-		do {
-			rc = select(fd+1, &read_mask, NULL, NULL, &t);
-		} while (rc < 0 && errno == EINTR);
-		rc = audit_get_reply(fd, rep, 
-			GET_REPLY_NONBLOCKING, 0);
-		if (rc > 0) {
-			/* Don't make decisions based on wrong packet */
-			if (rep->nlh->nlmsg_seq != seq)
-				continue;
-
-			/* If its not what we are expecting, keep looping */
-			if (rep->type == AUDIT_SIGNAL_INFO)
-				return 1;
-
-			/* If we get done or error, break out */
-			if (rep->type == NLMSG_DONE || rep->type == NLMSG_ERROR)
-				break;
-		}
-	}
+	rep->signal_info = NULL;
+	if (audit_wait_replies(fd, seq, signal_reply, rep, 3000) == 0 &&
+			rep->signal_info)
+		return 1;
 	return -1;
 }
 
@@ -70,6 +70,9 @@ failed_t event_failed = F_BOTH;
 conf_act_t event_conf_act = C_NEITHER;
 success_t event_success = S_SUCCESS;
 int event_pid = 0;
+unsigned int report_top = 0;
+unsigned int report_threads = 1;
+int report_rollup = 0;
 
 struct nv_pair {
     int        value;
@@ -81,7 +84,7 @@ enum {  R_INFILE, R_TIME_END, R_TIME_START, R_VERSION, R_SUMMARY, R_LOG_TIMES,
 	R_AVCS, R_SYSCALLS, R_PIDS, R_EVENTS, R_ACCT_MODS,  
 	R_INTERPRET, R_HELP, R_ANOMALY, R_RESPONSE, R_SUMMARY_DET, R_CRYPTO,
 	R_MAC, R_FAILED, R_SUCCESS, R_ADD, R_DEL, R_AUTH, R_NODE, R_IN_LOGS,
-	R_KEYS, R_TTY, R_NO_CONFIG };
+	R_KEYS, R_TTY, R_NO_CONFIG, R_TOP, R_THREADS, R_ROLLUP, R_RULE_HITS };
 
 static struct nv_pair optiontab[] = {
 	{ R_AUTH, "-au" },
@@ -124,6 +127,8 @@ static struct nv_pair optiontab[] = {
 	{ R_PIDS, "--pid" },
 	{ R_RESPONSE, "-r" },
 	{ R_RESPONSE, "--response" },
+	{ R_ROLLUP, "--rollup" },
+	{ R_RULE_HITS, "--rule-hits" },
 	{ R_SYSCALLS, "-s" },
 	{ R_SYSCALLS, "--syscall" },
 	{ R_SUCCESS, "--success" },
@@ -134,8 +139,10 @@ static struct nv_pair optiontab[] = {
 	{ R_TIME_END, "--end"},
 	{ R_TERMINALS, "-tm"}, // don't like this
 	{ R_TERMINALS, "--terminal"}, // don't like this
+	{ R_THREADS, "--threads" },
 	{ R_TIME_START, "-ts" },
 	{ R_TTY, "--tty" },
+	{ R_TOP, "--top" },
 	{ R_TIME_START, "--start" },
 	{ R_USERS, "-u" },
 	{ R_USERS, "--user" },
@@ -181,10 +188,14 @@ static void usage(void)
 	"\t--node <node name>\t\tOnly events from a specific node\n"
 	"\t-p,--pid\t\t\tPid report\n"
 	"\t-r,--response\t\t\tResponse to anomaly report\n"
+	"\t--rollup\t\t\tkeep per hour summaries of rotated logs\n"
+	"\t--rule-hits\t\t\tsyscall events per rule key, or syscall and exe\n"
 	"\t-s,--syscall\t\t\tSyscall report\n"
 	"\t--success\t\t\tonly success events in report\n"
 	"\t--summary\t\t\tsorted totals for main object in report\n"
+	"\t--top <number>\t\t\tonly the most frequent entries in summaries\n"
 	"\t-t,--log\t\t\tLog time range report\n"
+	"\t--threads <number>\t\tread rotated logs with this many threads\n"
 	"\t-te,--end [end date] [end time]\tending date & time for reports\n"
 	"\t-tm,--terminal\t\t\tTerMinal name report\n"
 	"\t-ts,--start [start date] [start time]\tstarting data & time for reports\n"
@@ -505,6 +516,22 @@ int check_params(int count, char *vars[])
 				}
 			}
 			break;
+		case R_RULE_HITS:
+			if (set_report(RPT_RULE))
+				retval = -1;
+			else if (optarg) {
+				fprintf(stderr,
+					"Argument is NOT required for %s\n",
+					vars[c]);
+				retval = -1;
+			} else {
+				// Only a summary, with syscall names like auditd
+				set_detail(D_SUM);
+				report_format = RPT_INTERP;
+				event_exe = dummy;
+				event_key = dummy;
+			}
+			break;
 		case R_TTY:
 			if (set_report(RPT_TTY))
 				retval = -1;
@@ -628,6 +655,50 @@ int check_params(int count, char *vars[])
 		case R_SUMMARY_DET:
 			set_detail(D_SUM);
 			break;
+		case R_TOP:
+			if (!optarg) {
+				fprintf(stderr,
+					"Argument is required for %s\n",
+					vars[c]);
+				retval = -1;
+			} else {
+				size_t len = strlen(optarg);
+
+				if (strspn(optarg, "0123456789") != len ||
+						len > 9) {
+					fprintf(stderr,
+						"Top count %s is invalid\n",
+						optarg);
+					retval = -1;
+				} else
+					report_top = strtoul(optarg, NULL, 10);
+				c++;
+			}
+			break;
+		case R_THREADS:
+			if (!optarg) {
+				fprintf(stderr,
+					"Argument is required for %s\n",
+					vars[c]);
+				retval = -1;
+			} else {
+				size_t len = strlen(optarg);
+
+				if (strspn(optarg, "0123456789") != len ||
+					len == 0 || len > 3 ||
+					atoi(optarg) < 1 || atoi(optarg) > 256) {
+					fprintf(stderr,
+					    "Thread count %s is invalid\n",
+						optarg);
+					retval = -1;
+				} else
+					report_threads = atoi(optarg);
+				c++;
+			}
+			break;
+		case R_ROLLUP:
+			report_rollup = 1;
+			break;
 		case R_FAILED:
 			event_failed = F_FAILED;
 			break;
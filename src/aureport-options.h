@@ -35,13 +35,16 @@ typedef enum { RPT_UNSET, RPT_TIME, RPT_SUMMARY, RPT_AVC, RPT_MAC,
 	RPT_CONFIG, RPT_EVENT, RPT_FILE, RPT_HOST, RPT_LOGIN,
 	RPT_ACCT_MOD, RPT_PID, RPT_SYSCALL, RPT_TERM, RPT_USER,
 	RPT_EXE, RPT_ANOMALY, RPT_RESPONSE, RPT_CRYPTO, 
-	RPT_AUTH, RPT_KEY, RPT_TTY } report_type_t;
+	RPT_AUTH, RPT_KEY, RPT_TTY, RPT_RULE } report_type_t;
 
 typedef enum { D_UNSET, D_SUM, D_DETAILED, D_SPECIFIC } report_det_t;
 
 extern report_type_t report_type;
 extern report_det_t report_detail;
 extern report_t report_format;
+extern unsigned int report_top;	/* Entries in a summary, 0 is all */
+extern unsigned int report_threads;	/* Threads reading rotated logs */
+extern int report_rollup;		/* Use saved summaries of rotated logs */
 
 
 /* Function to process commandline options */
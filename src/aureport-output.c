@@ -33,12 +33,12 @@
 static void print_title_summary(void);
 static void print_title_detailed(void);
 static void do_summary_output(void);
-static void do_file_summary_output(slist *sptr);
-static void do_string_summary_output(slist *sptr);
-static void do_user_summary_output(slist *sptr);
-static void do_int_summary_output(ilist *sptr);
-static void do_syscall_summary_output(ilist *sptr);
-static void do_type_summary_output(ilist *sptr);
+static void do_file_summary_output(shash *sptr);
+static void do_string_summary_output(shash *sptr);
+static void do_user_summary_output(shash *sptr);
+static void do_int_summary_output(ihash *sptr);
+static void do_syscall_summary_output(ihash *sptr);
+static void do_type_summary_output(ihash *sptr);
 
 /* Local Data */
 unsigned int line_item;
@@ -177,6 +177,12 @@ static void print_title_summary(void)
 			printf("total  key\n");
 			printf("===========================\n");
 			break;
+		case RPT_RULE:
+			printf("Rule Hit Summary Report\n");
+			printf("===========================\n");
+			printf("total  rule\n");
+			printf("===========================\n");
+			break;
 		case RPT_TTY:
 			UNIMPLEMENTED;
 			break;
@@ -649,73 +655,60 @@ void print_wrap_up(void)
 			do_summary_output();
 			break;
 		case RPT_AVC:
-			slist_sort_by_hits(&sd.avc_objs);
 			do_string_summary_output(&sd.avc_objs);
 			break;
 		case RPT_CONFIG:
 			break;
 		case RPT_AUTH:
-			slist_sort_by_hits(&sd.users);
 			do_user_summary_output(&sd.users);
 			break;
 		case RPT_LOGIN:
-			slist_sort_by_hits(&sd.users);
 			do_user_summary_output(&sd.users);
 			break;
 		case RPT_ACCT_MOD:
 			break;
 		case RPT_EVENT: /* We will borrow the pid list */
-			ilist_sort_by_hits(&sd.pids);
 			do_type_summary_output(&sd.pids);
 			break;
 		case RPT_FILE:
-			slist_sort_by_hits(&sd.files);
 			do_file_summary_output(&sd.files);
 			break;
 		case RPT_HOST:
-			slist_sort_by_hits(&sd.hosts);
 			do_string_summary_output(&sd.hosts);
 			break;
 		case RPT_PID:
-			ilist_sort_by_hits(&sd.pids);
 			do_int_summary_output(&sd.pids);
 			break;
 		case RPT_SYSCALL:
-			ilist_sort_by_hits(&sd.sys_list);
 			do_syscall_summary_output(&sd.sys_list);
 			break;
 		case RPT_TERM:
-			slist_sort_by_hits(&sd.terms);
 			do_string_summary_output(&sd.terms);
 			break;
 		case RPT_USER:
-			slist_sort_by_hits(&sd.users);
 			do_user_summary_output(&sd.users);
 			break;
 		case RPT_EXE:
-			slist_sort_by_hits(&sd.exes);
 			do_file_summary_output(&sd.exes);
 			break;
 		case RPT_ANOMALY:
-			ilist_sort_by_hits(&sd.anom_list);
 			do_type_summary_output(&sd.anom_list);
 			break;
 		case RPT_RESPONSE:
-			ilist_sort_by_hits(&sd.resp_list);
 			do_type_summary_output(&sd.resp_list);
 			break;
 		case RPT_MAC:
-			ilist_sort_by_hits(&sd.mac_list);
 			do_type_summary_output(&sd.mac_list);
 			break;
 		case RPT_CRYPTO:
-			ilist_sort_by_hits(&sd.crypto_list);
 			do_type_summary_output(&sd.crypto_list);
 			break;
 		case RPT_KEY:
-			slist_sort_by_hits(&sd.keys);
 			do_file_summary_output(&sd.keys);
 			break;
+		case RPT_RULE:
+			do_string_summary_output(&sd.keys);
+			break;
 		default:
 			break;
 	}
@@ -783,49 +776,48 @@ static void do_summary_output(void)
 	printf("\n");
 }
 
-static void do_file_summary_output(slist *sptr)
+static void do_file_summary_output(shash *sptr)
 {
-	const snode *sn;
+	shnode **sorted;
+	unsigned int i, cnt;
 
 	if (sptr->cnt == 0) {
 		printf("<no events of interest were found>\n\n");
 		return;
 	}
-	slist_first(sptr);
-	sn=slist_get_cur(sptr);
-	while (sn) {
-		printf("%u  %s\n", sn->hits, sn->str);
-		sn=slist_next(sptr);
-	}
+	sorted = shash_sort_by_hits(sptr, report_top, &cnt);
+	for (i = 0; i < cnt; i++)
+		printf("%u  %s\n", sorted[i]->hits, sorted[i]->str);
+	free(sorted);
 }
 
-static void do_string_summary_output(slist *sptr)
+static void do_string_summary_output(shash *sptr)
 {
-	const snode *sn;
+	shnode **sorted;
+	unsigned int i, cnt;
 
 	if (sptr->cnt == 0) {
 		printf("<no events of interest were found>\n\n");
 		return;
 	}
-	slist_first(sptr);
-	sn=slist_get_cur(sptr);
-	while (sn) {
-		printf("%u  %s\n", sn->hits, sn->str);
-		sn=slist_next(sptr);
-	}
+	sorted = shash_sort_by_hits(sptr, report_top, &cnt);
+	for (i = 0; i < cnt; i++)
+		printf("%u  %s\n", sorted[i]->hits, sorted[i]->str);
+	free(sorted);
 }
 
-static void do_user_summary_output(slist *sptr)
+static void do_user_summary_output(shash *sptr)
 {
-	const snode *sn;
+	shnode **sorted;
+	unsigned int i, cnt;
 
 	if (sptr->cnt == 0) {
 		printf("<no events of interest were found>\n\n");
 		return;
 	}
-	slist_first(sptr);
-	sn=slist_get_cur(sptr);
-	while (sn) {
+	sorted = shash_sort_by_hits(sptr, report_top, &cnt);
+	for (i = 0; i < cnt; i++) {
+		const shnode *sn = sorted[i];
 		long uid;
 		char name[64];
 
@@ -835,37 +827,37 @@ static void do_user_summary_output(slist *sptr)
 				aulookup_uid(uid, name, sizeof(name)));
 		} else 
 			printf("%u  %s\n", sn->hits, sn->str); 
-		sn=slist_next(sptr);
 	}
+	free(sorted);
 }
 
-static void do_int_summary_output(ilist *sptr)
+static void do_int_summary_output(ihash *sptr)
 {
-	const int_node *in;
+	ihnode **sorted;
+	unsigned int i, cnt;
 
 	if (sptr->cnt == 0) {
 		printf("<no events of interest were found>\n\n");
 		return;
 	}
-	ilist_first(sptr);
-	in=ilist_get_cur(sptr);
-	while (in) {
-		printf("%u  %d\n", in->hits, in->num);
-		in=ilist_next(sptr);
-	}
+	sorted = ihash_sort_by_hits(sptr, report_top, &cnt);
+	for (i = 0; i < cnt; i++)
+		printf("%u  %d\n", sorted[i]->hits, sorted[i]->num);
+	free(sorted);
 }
 
-static void do_syscall_summary_output(ilist *sptr)
+static void do_syscall_summary_output(ihash *sptr)
 {
-	const int_node *in;
+	ihnode **sorted;
+	unsigned int i, cnt;
 
 	if (sptr->cnt == 0) {
 		printf("<no events of interest were found>\n\n");
 		return;
 	}
-	ilist_first(sptr);
-	in=ilist_get_cur(sptr);
-	while (in) {
+	sorted = ihash_sort_by_hits(sptr, report_top, &cnt);
+	for (i = 0; i < cnt; i++) {
+		const ihnode *in = sorted[i];
 		const char *sys = NULL;
 		int machine = audit_elf_to_machine(in->aux1);
 		if (machine >= 0) 
@@ -874,27 +866,27 @@ static void do_syscall_summary_output(ilist *sptr)
 			printf("%u  %s\n", in->hits, sys);
 		else
 			printf("%u  %d\n", in->hits, in->num);
-		in=ilist_next(sptr);
 	}
+	free(sorted);
 }
 
-static void do_type_summary_output(ilist *sptr)
+static void do_type_summary_output(ihash *sptr)
 {
-	const int_node *in;
+	ihnode **sorted;
+	unsigned int i, cnt;
 
 	if (sptr->cnt == 0) {
 		printf("<no events of interest were found>\n\n");
 		return;
 	}
-	ilist_first(sptr);
-	in=ilist_get_cur(sptr);
-	while (in) {
+	sorted = ihash_sort_by_hits(sptr, report_top, &cnt);
+	for (i = 0; i < cnt; i++) {
+		const ihnode *in = sorted[i];
 		const char *name = audit_msg_type_to_name(in->num);
 		if (report_format == RPT_DEFAULT)
 			printf("%u  %d\n", in->hits, in->num);
 		else
 			printf("%u  %s\n", in->hits, name);
-		in=ilist_next(sptr);
 	}
+	free(sorted);
 }
-
@@ -0,0 +1,865 @@
+/*
+ * aureport-rollup.c - per hour summaries of rotated logs
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *     Steve Grubb <sgrubb@redhat.com>
+ */
+
+/*
+ * A rotated log never changes, so the summary counters for it only need
+ * to be worked out once. The first time --rollup meets a rotated log it
+ * counts each hour of it separately and saves the counts, together with
+ * the byte range that hour's records occupy, in ROLLUP_DIR next to the
+ * logs. Later runs add up the saved hours that lie completely inside the
+ * -ts/-te window and only read the records of the hours the window cuts
+ * through. Rollups are found by inode and checked against the device,
+ * size and modification time of the log, as well as against the report
+ * and the options that change what gets counted. Events can go on from
+ * one log into the next, so those of the first and last seconds of a log
+ * are left out of its rollup, and aureport reads them from the log along
+ * with the events the logs either side leave open.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include "libaudit.h"
+#include "aureport-options.h"
+#include "aureport-scan.h"
+#include "aureport-rollup.h"
+#include "ausearch-lol.h"
+#include "ausearch-logdir.h"
+
+#define ROLLUP_MAGIC	0x41524c50	/* "ARLP" */
+#define ROLLUP_VERSION	2
+#define HOUR		3600
+
+extern int no_config;
+extern slist *event_node_list;
+extern int report_rollup;
+
+static const size_t counter_offsets[] = {
+	offsetof(summary_data, changes),
+	offsetof(summary_data, crypto),
+	offsetof(summary_data, acct_changes),
+	offsetof(summary_data, good_logins),
+	offsetof(summary_data, bad_logins),
+	offsetof(summary_data, good_auth),
+	offsetof(summary_data, bad_auth),
+	offsetof(summary_data, events),
+	offsetof(summary_data, avcs),
+	offsetof(summary_data, mac),
+	offsetof(summary_data, failed_syscalls),
+	offsetof(summary_data, anomalies),
+	offsetof(summary_data, responses)
+};
+#define COUNTERS (sizeof(counter_offsets)/sizeof(counter_offsets[0]))
+#define COUNTER(d, i) (*(unsigned long *)((char *)(d) + counter_offsets[i]))
+
+static const size_t shash_offsets[] = {
+	offsetof(summary_data, users),
+	offsetof(summary_data, terms),
+	offsetof(summary_data, files),
+	offsetof(summary_data, hosts),
+	offsetof(summary_data, exes),
+	offsetof(summary_data, avc_objs),
+	offsetof(summary_data, keys)
+};
+#define SHASHES (sizeof(shash_offsets)/sizeof(shash_offsets[0]))
+#define SHASH(d, i) ((shash *)((char *)(d) + shash_offsets[i]))
+
+static const size_t ihash_offsets[] = {
+	offsetof(summary_data, pids),
+	offsetof(summary_data, sys_list),
+	offsetof(summary_data, anom_list),
+	offsetof(summary_data, resp_list),
+	offsetof(summary_data, mac_list),
+	offsetof(summary_data, crypto_list)
+};
+#define IHASHES (sizeof(ihash_offsets)/sizeof(ihash_offsets[0]))
+#define IHASH(d, i) ((ihash *)((char *)(d) + ihash_offsets[i]))
+
+struct rollup_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t report_type;
+	uint32_t signature;	// Hash of the options that change the counts
+	uint32_t buckets;
+	uint32_t pad;
+	int64_t head_sec;	// The seconds left out of the buckets
+	int64_t tail_sec;
+	uint64_t head_end;	// and where their records are
+	uint64_t tail_start;
+};
+
+/* One hour of a log. It is followed by its tables on disk. */
+struct rollup_bucket {
+	int64_t hour;		// sec / HOUR
+	uint64_t start;		// Byte range holding the hour's records
+	uint64_t end;
+	uint64_t tables_len;	// Bytes of tables after this
+	int64_t first_sec;	// First and last event of the hour in the
+	int64_t last_sec;	// order they were grouped
+	uint32_t first_milli;
+	uint32_t last_milli;
+	uint32_t have_events;
+	uint32_t pad;
+	uint64_t counters[COUNTERS];
+};
+
+struct bucket {
+	struct rollup_bucket b;
+	summary_data part;	// Counts of the hour
+	int loaded;		// part holds something
+};
+
+/* Inodes of the logs seen this run, for pruning old rollups */
+static inode_list seen = INODE_LIST_INIT;
+
+/* Rollups only hold what summary reports count */
+int rollup_usable(void)
+{
+	return report_rollup && report_detail == D_SUM &&
+		report_type != RPT_TIME;
+}
+
+static uint32_t hash_bytes(uint32_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static uint32_t option_signature(void)
+{
+	uint32_t h = 2166136261U;
+	int opts[5];
+
+	opts[0] = report_type;
+	opts[1] = report_format;
+	opts[2] = event_failed;
+	opts[3] = event_conf_act;
+	opts[4] = no_config;
+	h = hash_bytes(h, opts, sizeof(opts));
+	if (event_node_list) {
+		const snode *sn;
+
+		slist_first(event_node_list);
+		sn = slist_get_cur(event_node_list);
+		while (sn) {
+			if (sn->str)
+				h = hash_bytes(h, sn->str, strlen(sn->str) + 1);
+			sn = slist_next(event_node_list);
+		}
+	}
+	return h;
+}
+
+/* Returns the time stamp seconds of a record, or -1 */
+time_t rollup_record_time(const char *buf)
+{
+	const char *ptr = strstr(buf, "audit(");
+
+	if (ptr == NULL)
+		return -1;
+	return strtoul(ptr + 6, NULL, 10);
+}
+
+/*
+ * Returns the index of the bucket for an hour, adding it if needed. The
+ * index in cur is moved along if the bucket goes in front of it.
+ */
+static int find_bucket(struct bucket **buckets, unsigned int *cnt,
+		unsigned int *size, int64_t hour, int *cur)
+{
+	struct bucket *b;
+	unsigned int i = *cnt;
+
+	// The logs are mostly in order, so look from the end
+	while (i > 0 && (*buckets)[i-1].b.hour > hour)
+		i--;
+	if (i > 0 && (*buckets)[i-1].b.hour == hour)
+		return i - 1;
+
+	if (*cnt == *size) {
+		unsigned int nsize = *size ? *size * 2 : 64;
+		struct bucket *tmp = realloc(*buckets,
+					nsize * sizeof(struct bucket));
+		if (tmp == NULL)
+			return -1;
+		*buckets = tmp;
+		*size = nsize;
+	}
+	memmove(&(*buckets)[i+1], &(*buckets)[i],
+			(*cnt - i) * sizeof(struct bucket));
+	(*cnt)++;
+	if (*cur >= (int)i)
+		(*cur)++;
+	b = &(*buckets)[i];
+	memset(b, 0, sizeof(struct bucket));
+	b->b.hour = hour;
+	b->b.start = UINT64_MAX;
+	return i;
+}
+
+static void note_event(struct rollup_bucket *b, const llist *l)
+{
+	if (!b->have_events) {
+		b->first_sec = l->e.sec;
+		b->first_milli = l->e.milli;
+		b->have_events = 1;
+	}
+	b->last_sec = l->e.sec;
+	b->last_milli = l->e.milli;
+}
+
+/* Counts an event into the bucket of its hour */
+static void count_event(struct bucket *buckets, unsigned int cnt, int *cur,
+		llist *l)
+{
+	int i;
+
+	// Every record added a bucket for its hour
+	for (i = cnt - 1; i >= 0; i--)
+		if (buckets[i].b.hour == l->e.sec / HOUR)
+			break;
+	if (i >= 0 && i != *cur) {
+		if (*cur >= 0)
+			buckets[*cur].part = sd;
+		if (buckets[i].loaded)
+			sd = buckets[i].part;
+		else
+			reset_counters();
+		buckets[i].loaded = 1;
+		*cur = i;
+	}
+	if (i >= 0) {
+		note_event(&buckets[i].b, l);
+		if (scan_event(l))
+			per_event_processing(l);
+	}
+	list_clear(l);
+	free(l);
+}
+
+/* Where the records of a second start, for the seconds that could still
+ * be among the last ones of the log */
+struct sec_pos {
+	time_t sec;
+	uint64_t pos;
+};
+
+static int note_sec(struct sec_pos **secs, unsigned int *cnt,
+		unsigned int *size, time_t sec, uint64_t pos)
+{
+	unsigned int i = *cnt;
+
+	while (i > 0 && (*secs)[i-1].sec > sec)
+		i--;
+	if (i > 0 && (*secs)[i-1].sec == sec)
+		return 0;
+	if (*cnt == *size) {
+		unsigned int nsize = *size ? *size * 2 : 16;
+		struct sec_pos *tmp = realloc(*secs,
+					nsize * sizeof(struct sec_pos));
+		if (tmp == NULL)
+			return -1;
+		*secs = tmp;
+		*size = nsize;
+	}
+	memmove(&(*secs)[i+1], &(*secs)[i],
+			(*cnt - i) * sizeof(struct sec_pos));
+	(*secs)[i].sec = sec;
+	(*secs)[i].pos = pos;
+	(*cnt)++;
+	return 0;
+}
+
+/*
+ * Counts every hour of the log into its own bucket. The per event code
+ * counts into sd, so each bucket's counters are swapped in and out of
+ * sd as the events move from one hour to the next.
+ *
+ * The events of the first seconds of the log may be the rest of ones
+ * the log before left open, and those still open at its end may go on
+ * in the next log. Neither are counted, and h gets told which seconds
+ * they are in and where their records are, so they can be read along
+ * with the other logs. A finished event is held back until the log is
+ * more than 2 seconds past it and the events still open are all newer,
+ * as only then is it known not to be among the last ones. If it turns
+ * out to be after all, because the log is out of order, the seconds are
+ * left overlapping and the rollup isn't used.
+ */
+static int build_buckets(FILE *f, struct bucket **buckets, unsigned int *cnt,
+		struct rollup_header *h)
+{
+	summary_data saved = sd;
+	unsigned int size = 0, held_cnt = 0, held_size = 0, k;
+	unsigned int sec_cnt = 0, sec_size = 0;
+	llist **held = NULL;
+	struct sec_pos *secs = NULL;
+	time_t counted = 0, last_sec = 0, first, last;
+	uint64_t pos = 0;
+	char *buff;
+	lol lo;
+	int rc = 0, eof = 0, cur = -1, have_first = 0;
+
+	*buckets = NULL;
+	*cnt = 0;
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	if (buff == NULL)
+		return -1;
+	lol_create(&lo);
+	lo.all_times = 1;
+	h->head_sec = h->tail_sec = 0;
+	h->head_end = 0;
+	while (rc == 0 && !eof) {
+		llist *l;
+		int open;
+
+		if (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+			size_t len = strlen(buff);
+			time_t t = rollup_record_time(buff);
+
+			if (t != -1) {
+				struct bucket *b;
+				int i = find_bucket(buckets, cnt, &size,
+						t / HOUR, &cur);
+				if (i < 0 || (t > counted && note_sec(&secs,
+					&sec_cnt, &sec_size, t, pos))) {
+					rc = -1;
+					break;
+				}
+				b = &(*buckets)[i];
+				if (pos < b->b.start)
+					b->b.start = pos;
+				if (pos + len > b->b.end)
+					b->b.end = pos + len;
+				if (!have_first) {
+					h->head_sec = t + 2;
+					have_first = 1;
+				}
+				if (t <= h->head_sec)
+					h->head_end = pos + len;
+				if (t > last_sec)
+					last_sec = t;
+			}
+			pos += len;
+			if (lol_add_record(&lo, buff) == 0)
+				continue;
+		} else {
+			if (ferror_unlocked(f))
+				rc = -1;
+			eof = 1;
+		}
+		while ((l = get_ready_event(&lo))) {
+			llist **tmp;
+
+			if (l->e.sec <= h->head_sec) {
+				list_clear(l);
+				free(l);
+				continue;
+			}
+			if (held_cnt == held_size) {
+				held_size = held_size ? held_size * 2 : 64;
+				tmp = realloc(held, held_size *
+						sizeof(llist *));
+				if (tmp == NULL) {
+					list_clear(l);
+					free(l);
+					rc = -1;
+					break;
+				}
+				held = tmp;
+			}
+			held[held_cnt++] = l;
+		}
+		// Count what is older than the events still open, and than
+		// any that could start now
+		open = lol_open_times(&lo, &first, &last);
+		for (k = 0; k < held_cnt && (eof ||
+				(held[k]->e.sec + 2 < last_sec &&
+				 (!open || held[k]->e.sec < first))); k++) {
+			if (eof && held[k]->e.sec >= (open ? first :
+					last_sec + 1)) {
+				list_clear(held[k]);
+				free(held[k]);
+				continue;
+			}
+			if (held[k]->e.sec > counted)
+				counted = held[k]->e.sec;
+			count_event(*buckets, *cnt, &cur, held[k]);
+		}
+		held_cnt -= k;
+		memmove(held, held + k, held_cnt * sizeof(llist *));
+		// Forget where the seconds already counted are
+		for (k = 0; k < sec_cnt && secs[k].sec <= counted; k++)
+			;
+		sec_cnt -= k;
+		memmove(secs, secs + k, sec_cnt * sizeof(struct sec_pos));
+		if (eof) {
+			h->tail_sec = open ? first : last_sec + 1;
+			h->tail_start = pos;
+			for (k = 0; k < sec_cnt; k++) {
+				if (secs[k].sec >= h->tail_sec &&
+						secs[k].pos < h->tail_start)
+					h->tail_start = secs[k].pos;
+			}
+			if (counted >= h->tail_sec ||
+					h->tail_sec <= h->head_sec)
+				h->tail_sec = h->head_sec;
+		}
+	}
+	if (cur >= 0)
+		(*buckets)[cur].part = sd;
+	sd = saved;
+	for (k = 0; k < held_cnt; k++) {
+		list_clear(held[k]);
+		free(held[k]);
+	}
+	free(held);
+	free(secs);
+	lol_clear(&lo);
+	free(buff);
+	return rc;
+}
+
+static void free_buckets(struct bucket *buckets, unsigned int cnt)
+{
+	unsigned int i;
+
+	for (i = 0; i < cnt; i++)
+		free_counters(&buckets[i].part);
+	free(buckets);
+}
+
+/* Returns the bytes the tables of a bucket take on disk */
+static uint64_t tables_len(summary_data *d)
+{
+	uint64_t len = (SHASHES + IHASHES) * sizeof(uint32_t);
+	unsigned int i, j;
+
+	for (i = 0; i < SHASHES; i++) {
+		shash *h = SHASH(d, i);
+
+		for (j = 0; j < h->size; j++) {
+			const shnode *n;
+
+			for (n = h->table[j]; n; n = n->next)
+				len += 2 * sizeof(uint32_t) + strlen(n->str);
+		}
+	}
+	for (i = 0; i < IHASHES; i++)
+		len += IHASH(d, i)->cnt * 3 * sizeof(uint32_t);
+	return len;
+}
+
+static int write_tables(FILE *f, summary_data *d)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < SHASHES; i++) {
+		shash *h = SHASH(d, i);
+		uint32_t cnt = h->cnt;
+		shnode **a = shash_by_seq(h);
+
+		if (a == NULL)
+			return -1;
+		fwrite(&cnt, sizeof(cnt), 1, f);
+		for (j = 0; j < cnt; j++) {
+			uint32_t rec[2];
+
+			rec[0] = a[j]->hits;
+			rec[1] = strlen(a[j]->str);
+			fwrite(rec, sizeof(rec), 1, f);
+			fwrite(a[j]->str, rec[1], 1, f);
+		}
+		free(a);
+	}
+	for (i = 0; i < IHASHES; i++) {
+		ihash *h = IHASH(d, i);
+		uint32_t cnt = h->cnt;
+
+		fwrite(&cnt, sizeof(cnt), 1, f);
+		for (j = 0; j < h->size; j++) {
+			const ihnode *n;
+
+			for (n = h->table[j]; n; n = n->next) {
+				uint32_t rec[3];
+
+				rec[0] = n->num;
+				rec[1] = n->aux1;
+				rec[2] = n->hits;
+				fwrite(rec, sizeof(rec), 1, f);
+			}
+		}
+	}
+	return ferror(f) ? -1 : 0;
+}
+
+static int read_tables(FILE *f, summary_data *d)
+{
+	char *str = NULL;
+	size_t str_size = 0;
+	unsigned int i, j;
+
+	for (i = 0; i < SHASHES; i++) {
+		uint32_t cnt;
+
+		if (fread(&cnt, sizeof(cnt), 1, f) != 1)
+			goto err;
+		for (j = 0; j < cnt; j++) {
+			uint32_t rec[2];
+
+			if (fread(rec, sizeof(rec), 1, f) != 1 ||
+					rec[1] > MAX_AUDIT_MESSAGE_LENGTH)
+				goto err;
+			if (rec[1] >= str_size) {
+				char *tmp = realloc(str, rec[1] + 1);
+
+				if (tmp == NULL)
+					goto err;
+				str = tmp;
+				str_size = rec[1] + 1;
+			}
+			if (fread(str, rec[1], 1, f) != 1 && rec[1])
+				goto err;
+			str[rec[1]] = 0;
+			if (shash_add_hits(SHASH(d, i), str, rec[0]) < 0)
+				goto err;
+		}
+	}
+	for (i = 0; i < IHASHES; i++) {
+		uint32_t cnt;
+
+		if (fread(&cnt, sizeof(cnt), 1, f) != 1)
+			goto err;
+		for (j = 0; j < cnt; j++) {
+			uint32_t rec[3];
+
+			if (fread(rec, sizeof(rec), 1, f) != 1)
+				goto err;
+			if (ihash_add_hits(IHASH(d, i), (int)rec[0],
+					(int)rec[1], rec[2]) < 0)
+				goto err;
+		}
+	}
+	free(str);
+	return 0;
+err:
+	free(str);
+	return -1;
+}
+
+/* Returns 0 if the name of the rollup fits in path and -1 if not */
+static int rollup_name(char *path, size_t size, const char *filename,
+		const struct rollup_header *h)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "%llu-%u-%08x",
+		(unsigned long long)h->ino, h->report_type, h->signature);
+	return logdir_path(path, size, filename, ROLLUP_DIR, name);
+}
+
+static void fill_header(struct rollup_header *h, const struct stat *st,
+		uint32_t sig)
+{
+	memset(h, 0, sizeof(*h));
+	h->magic = ROLLUP_MAGIC;
+	h->version = ROLLUP_VERSION;
+	h->dev = st->st_dev;
+	h->ino = st->st_ino;
+	h->size = st->st_size;
+	h->mtime = st->st_mtime;
+	h->report_type = report_type;
+	h->signature = sig;
+}
+
+/* Saves the buckets. Failing to is not an error, we just rebuild later */
+static void save_rollup(const char *filename, const char *path,
+		struct rollup_header *h, struct bucket *buckets)
+{
+	char tmp[MAXPATHLEN + 16];
+	unsigned int i, k;
+	FILE *f;
+	int fd;
+
+	if (logdir_path(tmp, sizeof(tmp), filename, ROLLUP_DIR, NULL) ||
+			(mkdir(tmp, 0750) && errno != EEXIST))
+		return;
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0640);
+	if (fd < 0)
+		return;
+	f = fdopen(fd, "w");
+	if (f == NULL) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+	fwrite(h, sizeof(*h), 1, f);
+	for (i = 0; i < h->buckets; i++) {
+		struct rollup_bucket *b = &buckets[i].b;
+
+		for (k = 0; k < COUNTERS; k++)
+			b->counters[k] = COUNTER(&buckets[i].part, k);
+		b->tables_len = tables_len(&buckets[i].part);
+		fwrite(b, sizeof(*b), 1, f);
+		if (write_tables(f, &buckets[i].part))
+			break;
+	}
+	if (fclose(f) || i < h->buckets) {
+		unlink(tmp);
+		return;
+	}
+	if (rename(tmp, path))
+		unlink(tmp);
+}
+
+/* Bucket lies completely inside the time range of the report */
+static int bucket_covered(const struct rollup_bucket *b)
+{
+	time_t first = b->hour * HOUR, last = first + HOUR - 1;
+
+	return (start_time == 0 || first >= start_time) &&
+		(end_time == 0 || last <= end_time);
+}
+
+static int bucket_outside(const struct rollup_bucket *b)
+{
+	time_t first = b->hour * HOUR, last = first + HOUR - 1;
+
+	return (start_time && last < start_time) ||
+		(end_time && first > end_time);
+}
+
+/*
+ * Loads the buckets of a saved rollup. Only the tables of the hours the
+ * report covers completely are read. Returns 0 on success, 1 if there is
+ * no usable rollup.
+ */
+static int load_rollup(const char *path, struct rollup_header *h,
+		struct bucket **buckets)
+{
+	struct rollup_header want = *h;
+	struct bucket *b;
+	unsigned int i;
+	FILE *f;
+
+	f = fopen(path, "rm");
+	if (f == NULL)
+		return 1;
+	__fsetlocking(f, FSETLOCKING_BYCALLER);
+	if (fread(h, sizeof(*h), 1, f) != 1)
+		goto bad;
+	// Everything up to the bucket count has to match
+	if (memcmp(h, &want, offsetof(struct rollup_header, buckets)) ||
+			h->buckets > 10000000)
+		goto bad;
+	b = calloc(h->buckets ? h->buckets : 1, sizeof(struct bucket));
+	if (b == NULL)
+		goto bad;
+	for (i = 0; i < h->buckets; i++) {
+		unsigned int k;
+
+		if (fread(&b[i].b, sizeof(b[i].b), 1, f) != 1)
+			break;
+		if (bucket_covered(&b[i].b)) {
+			for (k = 0; k < COUNTERS; k++)
+				COUNTER(&b[i].part, k) = b[i].b.counters[k];
+			b[i].loaded = 1;
+			if (read_tables(f, &b[i].part))
+				break;
+		} else if (fseeko(f, b[i].b.tables_len, SEEK_CUR))
+			break;
+	}
+	if (i < h->buckets) {
+		free_buckets(b, h->buckets);
+		goto bad;
+	}
+	fclose(f);
+	*buckets = b;
+	return 0;
+bad:
+	fclose(f);
+	unlink(path);
+	*h = want;
+	return 1;
+}
+
+/*
+ * Counts the events of a partly covered hour straight from the log. The
+ * events inside the time range replace the bucket's first and last. The
+ * first and last seconds of the log are left out, like in the bucket.
+ */
+static int scan_range(FILE *f, struct rollup_bucket *b,
+		const struct rollup_header *h)
+{
+	char *buff;
+	uint64_t pos = b->start;
+	lol lo;
+	int eof = 0;
+
+	if (fseeko(f, b->start, SEEK_SET))
+		return -1;
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	if (buff == NULL)
+		return -1;
+	b->have_events = 0;
+	lol_create(&lo);
+	while (!eof) {
+		llist *l;
+
+		if (pos < b->end &&
+		    fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+			pos += strlen(buff);
+			if (lol_add_record(&lo, buff) == 0)
+				continue;
+		} else {
+			eof = 1;
+			terminate_all_events(&lo);
+		}
+		while ((l = get_ready_event(&lo))) {
+			if (l->e.sec / HOUR == b->hour &&
+					l->e.sec > h->head_sec &&
+					l->e.sec < h->tail_sec) {
+				note_event(b, l);
+				if (scan(l))
+					per_event_processing(l);
+			}
+			list_clear(l);
+			free(l);
+		}
+	}
+	lol_clear(&lo);
+	free(buff);
+	return 0;
+}
+
+/*
+ * Adds the summary of a rotated log to sd using its rollup, which gets
+ * made if there isn't one yet. What else the caller needs to know, like
+ * the first and last seconds of the log that it has to read itself, is
+ * passed back in r. It returns 0 on success, 1 if the log has to be read
+ * the usual way.
+ */
+int rollup_file(const char *filename, rollup_info *r)
+{
+	char path[MAXPATHLEN];
+	struct rollup_header h;
+	struct bucket *buckets;
+	unsigned int i;
+	struct stat st;
+	FILE *f = NULL;
+	int rc = 0;
+
+	if (stat(filename, &st) || !S_ISREG(st.st_mode))
+		return 1;
+	logdir_remember(&seen, st.st_ino);
+	fill_header(&h, &st, option_signature());
+	// Without a name for the rollup, the log is read every time
+	if (rollup_name(path, sizeof(path), filename, &h))
+		return 1;
+	if (load_rollup(path, &h, &buckets)) {
+		f = fopen(filename, "rm");
+		if (f == NULL)
+			return 1;
+		__fsetlocking(f, FSETLOCKING_BYCALLER);
+		if (build_buckets(f, &buckets, &h.buckets, &h)) {
+			free_buckets(buckets, h.buckets);
+			fclose(f);
+			return 1;
+		}
+		save_rollup(filename, path, &h, buckets);
+	}
+	// Events are left open over too much of the log
+	if (h.tail_sec <= h.head_sec) {
+		free_buckets(buckets, h.buckets);
+		if (f)
+			fclose(f);
+		return 1;
+	}
+
+	r->have = 0;
+	r->head_sec = h.head_sec;
+	r->tail_sec = h.tail_sec;
+	r->head_end = h.head_end;
+	r->tail_start = h.tail_start;
+	for (i = 0; i < h.buckets; i++) {
+		struct rollup_bucket *b = &buckets[i].b;
+
+		if (bucket_outside(b))
+			continue;
+		if (bucket_covered(b)) {
+			if (merge_counters(&buckets[i].part))
+				rc = 1;
+		} else if (b->start < b->end) {
+			if (f == NULL) {
+				f = fopen(filename, "rm");
+				if (f)
+					__fsetlocking(f,
+						FSETLOCKING_BYCALLER);
+			}
+			if (f == NULL || scan_range(f, b, &h))
+				rc = 1;
+		}
+		if (b->have_events) {
+			if (r->have == 0) {
+				r->first.sec = b->first_sec;
+				r->first.milli = b->first_milli;
+				r->have = 1;
+			}
+			r->last.sec = b->last_sec;
+			r->last.milli = b->last_milli;
+		}
+	}
+	free_buckets(buckets, h.buckets);
+	if (f)
+		fclose(f);
+	if (rc)
+		fprintf(stderr, "Error using the rollup of %s\n", filename);
+	return 0;
+}
+
+/*
+ * Removes the rollups of logs that are gone. Only call this once all of
+ * the rotated logs of log_file have been through rollup_file().
+ */
+void rollup_prune(const char *log_file)
+{
+	logdir_prune(&seen, log_file, ROLLUP_DIR);
+}
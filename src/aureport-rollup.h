@@ -0,0 +1,54 @@
+/* aureport-rollup.h --
+ * Copyright 2014 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:
+ *   Steve Grubb <sgrubb@redhat.com>
+ *
+ */
+
+#ifndef AUREPORT_ROLLUP_H
+#define AUREPORT_ROLLUP_H
+
+#include "ausearch-llist.h"
+
+/* Directory next to the logs that holds the rollups */
+#define ROLLUP_DIR "aureport.rollup"
+
+/*
+ * What rollup_file() hands back besides the counts. The events of the
+ * first and last seconds of a log can go on from the log before it or
+ * into the one after, so the rollup leaves them to be read from the log
+ * along with the events the other logs left open.
+ */
+typedef struct {
+	event first;		// First and last event counted
+	event last;
+	int have;		// Counted any events
+	time_t head_sec;	// Events up to this second are left out
+	time_t tail_sec;	// and those from this second on
+	off_t head_end;		// The first ones' records are before this
+	off_t tail_start;	// and the last ones' from this on
+} rollup_info;
+
+int rollup_usable(void);
+int rollup_file(const char *filename, rollup_info *r);
+time_t rollup_record_time(const char *buf);
+void rollup_prune(const char *log_file);
+
+#endif
+
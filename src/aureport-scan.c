@@ -24,6 +24,7 @@
 #include "config.h"
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include <pwd.h>
 #include "libaudit.h"
 #include "aureport-options.h"
@@ -36,7 +37,7 @@ static void do_summary_total(llist *l);
 static int per_event_summary(llist *l);
 static int per_event_detailed(llist *l);
 
-summary_data sd;
+__thread summary_data sd;
 
 /* This function inits the counters */
 void reset_counters(void)
@@ -54,19 +55,19 @@ void reset_counters(void)
 	sd.failed_syscalls = 0UL;
 	sd.anomalies = 0UL;
 	sd.responses = 0UL;
-	slist_create(&sd.users);
-	slist_create(&sd.terms);
-	slist_create(&sd.files);
-	slist_create(&sd.hosts);
-	slist_create(&sd.exes);
-	slist_create(&sd.avc_objs);
-	slist_create(&sd.keys);
-	ilist_create(&sd.pids);
-	ilist_create(&sd.sys_list);
-	ilist_create(&sd.anom_list);
-	ilist_create(&sd.mac_list);
-	ilist_create(&sd.resp_list);
-	ilist_create(&sd.crypto_list);
+	shash_create(&sd.users);
+	shash_create(&sd.terms);
+	shash_create(&sd.files);
+	shash_create(&sd.hosts);
+	shash_create(&sd.exes);
+	shash_create(&sd.avc_objs);
+	shash_create(&sd.keys);
+	ihash_create(&sd.pids);
+	ihash_create(&sd.sys_list);
+	ihash_create(&sd.anom_list);
+	ihash_create(&sd.mac_list);
+	ihash_create(&sd.resp_list);
+	ihash_create(&sd.crypto_list);
 }
 
 /* This function inits the counters */
@@ -85,19 +86,114 @@ void destroy_counters(void)
 	sd.failed_syscalls = 0UL;
 	sd.anomalies = 0UL;
 	sd.responses = 0UL;
-	slist_clear(&sd.users);
-	slist_clear(&sd.terms);
-	slist_clear(&sd.files);
-	slist_clear(&sd.hosts);
-	slist_clear(&sd.exes);
-	slist_clear(&sd.avc_objs);
-	slist_clear(&sd.keys);
-	ilist_clear(&sd.pids);
-	ilist_clear(&sd.sys_list);
-	ilist_clear(&sd.anom_list);
-	ilist_create(&sd.mac_list);
-	ilist_clear(&sd.resp_list);
-	ilist_create(&sd.crypto_list);
+	shash_clear(&sd.users);
+	shash_clear(&sd.terms);
+	shash_clear(&sd.files);
+	shash_clear(&sd.hosts);
+	shash_clear(&sd.exes);
+	shash_clear(&sd.avc_objs);
+	shash_clear(&sd.keys);
+	ihash_clear(&sd.pids);
+	ihash_clear(&sd.sys_list);
+	ihash_clear(&sd.anom_list);
+	ihash_clear(&sd.mac_list);
+	ihash_clear(&sd.resp_list);
+	ihash_clear(&sd.crypto_list);
+}
+
+/*
+ * This function adds the counters a worker thread collected to ours and
+ * frees them. It returns 0 on success and -1 if out of memory.
+ */
+int merge_counters(summary_data *part)
+{
+	int rc = 0;
+
+	sd.changes += part->changes;
+	sd.crypto += part->crypto;
+	sd.acct_changes += part->acct_changes;
+	sd.good_logins += part->good_logins;
+	sd.bad_logins += part->bad_logins;
+	sd.good_auth += part->good_auth;
+	sd.bad_auth += part->bad_auth;
+	sd.events += part->events;
+	sd.avcs += part->avcs;
+	sd.mac += part->mac;
+	sd.failed_syscalls += part->failed_syscalls;
+	sd.anomalies += part->anomalies;
+	sd.responses += part->responses;
+	rc |= shash_merge(&sd.users, &part->users);
+	rc |= shash_merge(&sd.terms, &part->terms);
+	rc |= shash_merge(&sd.files, &part->files);
+	rc |= shash_merge(&sd.hosts, &part->hosts);
+	rc |= shash_merge(&sd.exes, &part->exes);
+	rc |= shash_merge(&sd.avc_objs, &part->avc_objs);
+	rc |= shash_merge(&sd.keys, &part->keys);
+	rc |= ihash_merge(&sd.pids, &part->pids);
+	rc |= ihash_merge(&sd.sys_list, &part->sys_list);
+	rc |= ihash_merge(&sd.anom_list, &part->anom_list);
+	rc |= ihash_merge(&sd.mac_list, &part->mac_list);
+	rc |= ihash_merge(&sd.resp_list, &part->resp_list);
+	rc |= ihash_merge(&sd.crypto_list, &part->crypto_list);
+	free_counters(part);
+	return rc;
+}
+
+/* This function frees the lists of a set of counters */
+void free_counters(summary_data *d)
+{
+	shash_clear(&d->users);
+	shash_clear(&d->terms);
+	shash_clear(&d->files);
+	shash_clear(&d->hosts);
+	shash_clear(&d->exes);
+	shash_clear(&d->avc_objs);
+	shash_clear(&d->keys);
+	ihash_clear(&d->pids);
+	ihash_clear(&d->sys_list);
+	ihash_clear(&d->anom_list);
+	ihash_clear(&d->mac_list);
+	ihash_clear(&d->resp_list);
+	ihash_clear(&d->crypto_list);
+}
+
+/*
+ * This function counts a syscall event against each of its keys, or its
+ * syscall and exe if it has none, the way auditd's rule hits do.
+ */
+static void count_rule_hits(llist *l)
+{
+	char buf[PATH_MAX + 64];
+	const char *sys = NULL;
+	int keyed = 0, machine;
+
+	if (!list_find_msg(l, AUDIT_SYSCALL))
+		return;
+	if (l->s.key) {
+		const snode *sn;
+
+		slist_first(l->s.key);
+		for (sn = slist_get_cur(l->s.key); sn;
+					sn = slist_next(l->s.key)) {
+			if (sn->str == NULL || strcmp(sn->str, "(null)") == 0)
+				continue;
+			snprintf(buf, sizeof(buf), "key=%s", sn->str);
+			shash_add(&sd.keys, buf);
+			keyed = 1;
+		}
+	}
+	if (keyed)
+		return;
+	machine = audit_elf_to_machine(l->s.arch);
+	if (machine >= 0)
+		sys = audit_syscall_to_name(l->s.syscall, machine);
+	if (sys)
+		snprintf(buf, sizeof(buf), "syscall=%s exe=%s", sys,
+			l->s.exe ? l->s.exe : "?");
+	else
+		snprintf(buf, sizeof(buf), "syscall=%d exe=%s", l->s.syscall,
+			l->s.exe ? l->s.exe : "?");
+	shash_add(&sd.keys, buf);
 }
 
 /* This function will return 0 on no match and 1 on match */
@@ -199,35 +295,40 @@ int scan(llist *l)
 {
 	// Are we within time range?
 	if (start_time == 0 || l->e.sec >= start_time) {
-		if (end_time == 0 || l->e.sec <= end_time) {
-			// OK - do the heavier checking
-			int rc = extract_search_items(l);
-			if (rc == 0) {
-				if (event_node_list) {
-					const snode *sn;
-					int found=0;
-					slist *sptr = event_node_list;
-
-					if (l->e.node == NULL)
-						return 0;
-
-					slist_first(sptr);
-					sn=slist_get_cur(sptr);
-					while (sn && !found) {
-						if (sn->str && (!strcmp(sn->str, l->e.node)))
-							found++;
-						else
-							sn=slist_next(sptr);
-					}
-					
-				  	if (!found)
-				  		return 0;
-				}
-				if (classify_success(l) && classify_conf(l))
-					return 1;
+		if (end_time == 0 || l->e.sec <= end_time)
+			return scan_event(l);
+	}
+	return 0;
+}
+
+/* Same as scan(), but the time range is left to the caller */
+int scan_event(llist *l)
+{
+	// OK - do the heavier checking
+	int rc = extract_search_items(l);
+	if (rc == 0) {
+		if (event_node_list) {
+			const snode *sn;
+			int found=0;
+			slist *sptr = event_node_list;
+
+			if (l->e.node == NULL)
 				return 0;
+
+			slist_first(sptr);
+			sn=slist_get_cur(sptr);
+			while (sn && !found) {
+				if (sn->str && (!strcmp(sn->str, l->e.node)))
+					found++;
+				else
+					sn=slist_next(sptr);
 			}
+			
+		  	if (!found)
+		  		return 0;
 		}
+		if (classify_success(l) && classify_conf(l))
+			return 1;
 	}
 	return 0;
 }
@@ -266,7 +367,7 @@ static int per_event_summary(llist *l)
 			if (list_find_msg(l, AUDIT_AVC)) {
 				if (alist_find_avc(l->s.avc)) {
 					do { 
-						slist_add_if_uniq(&sd.avc_objs,
+						shash_add(&sd.avc_objs,
 						      l->s.avc->cur->tcontext);
 					} while (alist_next_avc(l->s.avc));
 				}
@@ -274,7 +375,7 @@ static int per_event_summary(llist *l)
 				if (list_find_msg(l, AUDIT_USER_AVC)) {
 					if (alist_find_avc(l->s.avc)) { 
 						do {
-							slist_add_if_uniq(
+							shash_add(
 								&sd.avc_objs,
 						    l->s.avc->cur->tcontext);
 						} while (alist_next_avc(
@@ -286,13 +387,13 @@ static int per_event_summary(llist *l)
 		case RPT_MAC:
 			if (list_find_msg_range(l, AUDIT_MAC_POLICY_LOAD,
 						AUDIT_MAC_MAP_DEL)) {
-				ilist_add_if_uniq(&sd.mac_list, 
+				ihash_add(&sd.mac_list, 
 							l->head->type, 0);
 			} else {
 				if (list_find_msg_range(l, 
 					AUDIT_FIRST_USER_LSPP_MSG,
 						AUDIT_LAST_USER_LSPP_MSG)) {
-					ilist_add_if_uniq(&sd.mac_list, 
+					ihash_add(&sd.mac_list, 
 							l->head->type, 0);
 				}
 			}
@@ -303,11 +404,11 @@ static int per_event_summary(llist *l)
 		case RPT_AUTH:
 			if (list_find_msg(l, AUDIT_USER_AUTH)) {
 				if (l->s.loginuid == -2 && l->s.acct != NULL)
-					slist_add_if_uniq(&sd.users, l->s.acct);
+					shash_add(&sd.users, l->s.acct);
 				else {
 					char name[64];
 
-					slist_add_if_uniq(&sd.users,
+					shash_add(&sd.users,
 						aulookup_uid(l->s.loginuid,
 							name,
 							sizeof(name))
@@ -318,11 +419,11 @@ static int per_event_summary(llist *l)
 				if (l->s.success == S_FAILED) {
 					if (l->s.loginuid == -2 && 
 						l->s.acct != NULL)
-					slist_add_if_uniq(&sd.users, l->s.acct);
+					shash_add(&sd.users, l->s.acct);
 					else {
 						char name[64];
 	
-						slist_add_if_uniq(&sd.users,
+						shash_add(&sd.users,
 							aulookup_uid(
 								l->s.loginuid,
 								name,
@@ -335,11 +436,11 @@ static int per_event_summary(llist *l)
 		case RPT_LOGIN:
 			if (list_find_msg(l, AUDIT_USER_LOGIN)) {
 				if (l->s.loginuid == -2 && l->s.acct != NULL)
-					slist_add_if_uniq(&sd.users, l->s.acct);
+					shash_add(&sd.users, l->s.acct);
 				else {
 					char name[64];
 
-					slist_add_if_uniq(&sd.users,
+					shash_add(&sd.users,
 						aulookup_uid(l->s.loginuid,
 							name,
 							sizeof(name))
@@ -352,7 +453,7 @@ static int per_event_summary(llist *l)
 			break;
 		case RPT_EVENT: /* We will borrow the pid list */
 			if (l->head->type != -1) {
-				ilist_add_if_uniq(&sd.pids, l->head->type, 0);
+				ihash_add(&sd.pids, l->head->type, 0);
 			}
 			break;
 		case RPT_FILE:
@@ -364,7 +465,7 @@ static int per_event_summary(llist *l)
 				sn=slist_get_cur(sptr);
 				while (sn) {
 					if (sn->str)
-						slist_add_if_uniq(&sd.files,
+						shash_add(&sd.files,
 								sn->str);
 					sn=slist_next(sptr);
 				} 
@@ -372,44 +473,44 @@ static int per_event_summary(llist *l)
 			break;
 		case RPT_HOST:
 			if (l->s.hostname)
-				slist_add_if_uniq(&sd.hosts, l->s.hostname);
+				shash_add(&sd.hosts, l->s.hostname);
 			break;
 		case RPT_PID:
 			if (l->s.pid != -1) {
-				ilist_add_if_uniq(&sd.pids, l->s.pid, 0);
+				ihash_add(&sd.pids, l->s.pid, 0);
 			}
 			break;
 		case RPT_SYSCALL:
 			if (l->s.syscall > 0) {
-				ilist_add_if_uniq(&sd.sys_list,
+				ihash_add(&sd.sys_list,
 						l->s.syscall, l->s.arch);
 			}
 			break;
 		case RPT_TERM:
 			if (l->s.terminal)
-				slist_add_if_uniq(&sd.terms, l->s.terminal);
+				shash_add(&sd.terms, l->s.terminal);
 			break;
 		case RPT_USER:
 			if (l->s.loginuid != -2) {
 				char tmp[32];
 				snprintf(tmp, sizeof(tmp), "%d", l->s.loginuid);
-				slist_add_if_uniq(&sd.users, tmp);
+				shash_add(&sd.users, tmp);
 			}
 			break;
 		case RPT_EXE:
 			if (l->s.exe)
-				slist_add_if_uniq(&sd.exes, l->s.exe);
+				shash_add(&sd.exes, l->s.exe);
 			break;
 		case RPT_ANOMALY:
 			if (list_find_msg_range(l, AUDIT_FIRST_ANOM_MSG,
 							AUDIT_LAST_ANOM_MSG)) {
-				ilist_add_if_uniq(&sd.anom_list, 
+				ihash_add(&sd.anom_list, 
 							l->head->type, 0);
 			} else {
 				if (list_find_msg_range(l, 
 					AUDIT_FIRST_KERN_ANOM_MSG,
 						AUDIT_LAST_KERN_ANOM_MSG)) {
-					ilist_add_if_uniq(&sd.anom_list, 
+					ihash_add(&sd.anom_list, 
 							l->head->type, 0);
 				}
 			}
@@ -417,20 +518,20 @@ static int per_event_summary(llist *l)
 		case RPT_RESPONSE:
 			if (list_find_msg_range(l, AUDIT_FIRST_ANOM_RESP,
 							AUDIT_LAST_ANOM_RESP)) {
-				ilist_add_if_uniq(&sd.resp_list, 
+				ihash_add(&sd.resp_list, 
 							l->head->type, 0);
 			}
 			break;
 		case RPT_CRYPTO:
 			if (list_find_msg_range(l, AUDIT_FIRST_KERN_CRYPTO_MSG,
 						AUDIT_LAST_KERN_CRYPTO_MSG)) {
-				ilist_add_if_uniq(&sd.crypto_list, 
+				ihash_add(&sd.crypto_list, 
 							l->head->type, 0);
 			} else {
 				if (list_find_msg_range(l, 
 					AUDIT_FIRST_CRYPTO_MSG,
 						AUDIT_LAST_CRYPTO_MSG)) {
-					ilist_add_if_uniq(&sd.crypto_list, 
+					ihash_add(&sd.crypto_list, 
 							l->head->type, 0);
 				}
 			}
@@ -445,12 +546,15 @@ static int per_event_summary(llist *l)
 				while (sn) {
 					if (sn->str &&
 						    strcmp(sn->str, "(null)"))
-						slist_add_if_uniq(&sd.keys,
+						shash_add(&sd.keys,
 								sn->str);
 					sn=slist_next(sptr);
 				} 
 			}
 			break;
+		case RPT_RULE:
+			count_rule_hits(l);
+			break;
 		case RPT_TTY:
 			UNIMPLEMENTED;
 			break;
@@ -774,20 +878,20 @@ static void do_summary_total(llist *l)
 	if (l->s.loginuid != -2) {
 		char tmp[32];
 		snprintf(tmp, sizeof(tmp), "%d", l->s.loginuid);
-		slist_add_if_uniq(&sd.users, tmp);
+		shash_add(&sd.users, tmp);
 	}
 
 	// add terminals
 	if (l->s.terminal)
-		slist_add_if_uniq(&sd.terms, l->s.terminal);
+		shash_add(&sd.terms, l->s.terminal);
 
 	// add hosts
 	if (l->s.hostname)
-		slist_add_if_uniq(&sd.hosts, l->s.hostname);
+		shash_add(&sd.hosts, l->s.hostname);
 
 	// add execs
 	if (l->s.exe)
-		slist_add_if_uniq(&sd.exes, l->s.exe);
+		shash_add(&sd.exes, l->s.exe);
 
 	// add files
 	if (l->s.filename) {
@@ -798,7 +902,7 @@ static void do_summary_total(llist *l)
 		sn=slist_get_cur(sptr);
 		while (sn) {
 			if (sn->str)
-				slist_add_if_uniq(&sd.files, sn->str);
+				shash_add(&sd.files, sn->str);
 			sn=slist_next(sptr);
 		} 
 	}
@@ -824,7 +928,7 @@ static void do_summary_total(llist *l)
 
 	// add pids
 	if (l->s.pid != -1) {
-		ilist_add_if_uniq(&sd.pids, l->s.pid, 0);
+		ihash_add(&sd.pids, l->s.pid, 0);
 	}
 
 	// add anomalies
@@ -847,7 +951,7 @@ static void do_summary_total(llist *l)
 		sn=slist_get_cur(sptr);
 		while (sn) {
 			if (sn->str && strcmp(sn->str, "(null)")) {
-				slist_add_if_uniq(&sd.keys, sn->str);
+				shash_add(&sd.keys, sn->str);
 			}
 			sn=slist_next(sptr);
 		} 
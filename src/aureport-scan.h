@@ -26,21 +26,22 @@
 
 #include "ausearch-llist.h"
 #include "ausearch-int.h"
+#include "ausearch-hash.h"
 
 typedef struct sdata {
-	slist users;
-	slist terms;
-	slist files;
-	slist hosts;
-	slist exes;
-	slist avc_objs;
-	slist keys;
-	ilist pids;
-	ilist sys_list;
-	ilist anom_list;
-	ilist resp_list;
-	ilist mac_list;
-	ilist crypto_list;
+	shash users;
+	shash terms;
+	shash files;
+	shash hosts;
+	shash exes;
+	shash avc_objs;
+	shash keys;
+	ihash pids;
+	ihash sys_list;
+	ihash anom_list;
+	ihash resp_list;
+	ihash mac_list;
+	ihash crypto_list;
 	unsigned long changes;
 	unsigned long crypto;
 	unsigned long acct_changes;
@@ -58,14 +59,18 @@ typedef struct sdata {
 
 void reset_counters(void);
 void destroy_counters(void);
+int merge_counters(summary_data *part);
+void free_counters(summary_data *d);
 int scan(llist *l);
+int scan_event(llist *l);
 int per_event_processing(llist *l);
 
 void print_title(void);
 void print_per_event_item(llist *l);
 void print_wrap_up(void);
 
-extern summary_data sd;
+/* Each aureport worker thread counts into its own copy */
+extern __thread summary_data sd;
 
 #endif
 
@@ -35,10 +35,12 @@
 #include <sys/stat.h>
 #include <locale.h>
 #include <sys/param.h>
+#include <pthread.h>
 #include "libaudit.h"
 #include "auditd-config.h"
 #include "aureport-options.h"
 #include "aureport-scan.h"
+#include "aureport-rollup.h"
 #include "ausearch-lol.h"
 #include "ausearch-lookup.h"
 
@@ -53,7 +55,11 @@ static int process_logs(void);
 static int process_log_fd(const char *filename);
 static int process_stdin(void);
 static int process_file(char *filename);
-static int get_record(llist **);
+static int process_rotated(char *filename);
+static int process_files_threaded(char **files, unsigned int cnt);
+static void print_file_times(const char *filename, int first,
+		const event *first_event, const event *last_event);
+static int get_record(lol *lo, FILE *f, int last, llist **);
 
 extern char *user_file;
 extern int force_logs;
@@ -182,6 +188,36 @@ static int process_logs(void)
 	 */
 	files_to_process = num;
 
+	/* Hand the files to worker threads, oldest first */
+	if (report_threads > 1 && num > 0) {
+		char **files = malloc((num + 1) * sizeof(char *));
+		int i, ret;
+
+		if (!files) {
+			fprintf(stderr, "No memory\n");
+			free(filename);
+			free_config(&config);
+			return 1;
+		}
+		for (i = 0; i <= num; i++) {
+			if (i < num)
+				snprintf(filename, len, "%s.%d",
+					config.log_file, num - i);
+			else
+				snprintf(filename, len, "%s", config.log_file);
+			files[i] = strdup(filename);
+		}
+		ret = process_files_threaded(files, num + 1);
+		if (ret == 0 && rollup_usable())
+			rollup_prune(config.log_file);
+		for (i = 0; i <= num; i++)
+			free(files[i]);
+		free(files);
+		free(filename);
+		free_config(&config);
+		return ret;
+	}
+
 	/* Got it, now process logs from last to first */
 	if (num > 0)
 		snprintf(filename, len, "%s.%d", config.log_file, num);
@@ -189,7 +225,11 @@ static int process_logs(void)
 		snprintf(filename, len, "%s", config.log_file);
 	do {
 		int ret;
-		if ((ret = process_file(filename))) {
+		if (num > 0)
+			ret = process_rotated(filename);
+		else
+			ret = process_file(filename);
+		if (ret) {
 			free(filename);
 			free_config(&config);
 			return ret;
@@ -205,6 +245,8 @@ static int process_logs(void)
 		else
 			break;
 	} while (1);
+	if (rollup_usable())
+		rollup_prune(config.log_file);
 	free(filename);
 	free_config(&config);
 	return 0;
@@ -222,7 +264,7 @@ static int process_log_fd(const char *filename)
 
 	/* For each record in file */
 	do {
-		ret = get_record(&entries);
+		ret = get_record(&lo, log_fd, files_to_process == 0, &entries);
 		if ((ret != 0)||(entries->cnt == 0))
 			break;
 		// If report is RPT_TIME or RPT_SUMMARY, get 
@@ -246,28 +288,577 @@ static int process_log_fd(const char *filename)
 	} while (ret == 0);
 	fclose(log_fd);
 	// This is the per file action items
-	very_last_event.sec = last_event.sec;
-	very_last_event.milli = last_event.milli;
-	if (report_type == RPT_TIME) {
-		if (first == 0) {
-			printf("%s: no records\n", filename);
-		} else {
-			struct tm *btm;
-			char tmp[32];
-
-			printf("%s: ", filename);
-			btm = localtime(&first_event.sec);
-			strftime(tmp, sizeof(tmp), "%x %T", btm);
-			printf("%s.%03d - ", tmp, first_event.milli);
-			btm = localtime(&last_event.sec);
-			strftime(tmp, sizeof(tmp), "%x %T", btm);
-			printf("%s.%03d\n", tmp, last_event.milli);
-		}
+	if (first) {
+		very_last_event.sec = last_event.sec;
+		very_last_event.milli = last_event.milli;
+	}
+	if (report_type == RPT_TIME)
+		print_file_times(filename, first, &first_event, &last_event);
+
+	return 0;
+}
+
+static void print_file_times(const char *filename, int first,
+		const event *first_event, const event *last_event)
+{
+	if (first == 0) {
+		printf("%s: no records\n", filename);
+	} else {
+		struct tm *btm;
+		char tmp[32];
+
+		printf("%s: ", filename);
+		btm = localtime(&first_event->sec);
+		strftime(tmp, sizeof(tmp), "%x %T", btm);
+		printf("%s.%03d - ", tmp, first_event->milli);
+		btm = localtime(&last_event->sec);
+		strftime(tmp, sizeof(tmp), "%x %T", btm);
+		printf("%s.%03d\n", tmp, last_event->milli);
 	}
+}
+
+/*
+ * With --threads, rotated logs are handed out a whole file at a time to
+ * worker threads. Each worker groups and parses the events of its file
+ * and counts them into its own summary_data. The main thread takes the
+ * results back in file order, merging the counters and printing the
+ * events of detailed reports, so the output reads as if one thread had
+ * gone through the logs.
+ *
+ * Read in one go, the events still open at the end of a log are finished
+ * by the records at the start of the next one. A worker doesn't have
+ * those, so it leaves the events from the first SEAM_SECS seconds of its
+ * file to the main thread. The main thread reads those lines again with
+ * the events left open by the log before. If that leaves the same events
+ * open as the worker had at that point, the worker's results are good
+ * from there on. If not, the main thread reads the rest of the file too.
+ */
+#define SEAM_SECS 10
 
+struct log_job {
+	const char *filename;
+	int rotated;		// Not the current log
+	int done;		// Worker is finished with it
+	int rc;			// 0 or error opening the file
+	int rolled;		// Counted from its rollup
+	rollup_info roll;	// What else the rollup tells
+	unsigned long head;	// Lines left to the main thread
+	lol tail;		// Events still open at the end of the file
+	int first;		// Got any events
+	event first_event, last_event;
+	summary_data part;	// Counters for summary reports
+	llist **events;		// Matches for detailed reports
+	unsigned int cnt, size;
+	int found;
+};
+
+static struct log_job *jobs;
+static unsigned int job_cnt, job_next, job_taken;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+
+static int keep_event(struct log_job *j, llist *l)
+{
+	if (j->cnt == j->size) {
+		unsigned int size = j->size ? j->size * 2 : 256;
+		llist **tmp = realloc(j->events, size * sizeof(llist *));
+
+		if (tmp == NULL)
+			return -1;
+		j->events = tmp;
+		j->size = size;
+	}
+	j->events[j->cnt++] = l;
 	return 0;
 }
 
+/* Counts an event of a job, or keeps it for the main thread to print */
+static void job_event(struct log_job *j, llist *entries)
+{
+	if (report_type <= RPT_SUMMARY) {
+		if (j->first == 0) {
+			list_get_event(entries, &j->first_event);
+			j->first = 1;
+		}
+		list_get_event(entries, &j->last_event);
+	}
+	if (scan(entries)) {
+		if (report_detail == D_DETAILED && report_type != RPT_TIME) {
+			if (keep_event(j, entries) == 0)
+				return;
+			fprintf(stderr, "No memory\n");
+			j->rc = 1;
+		} else if (per_event_processing(entries))
+			j->found = 1;
+	}
+	list_clear(entries);
+	free(entries);
+}
+
+static void scan_job(struct log_job *j, int defer)
+{
+	llist *entries;
+	FILE *f;
+	char *buff;
+	time_t start = 0;
+
+	reset_counters();
+	lol_create(&j->tail);
+	if (j->rotated && rollup_usable() &&
+			rollup_file(j->filename, &j->roll) == 0) {
+		j->rolled = 1;
+		j->part = sd;
+		return;
+	}
+	f = fopen(j->filename, "rm");
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	if (f == NULL || buff == NULL) {
+		if (f == NULL)
+			fprintf(stderr, "Error opening %s (%s)\n",
+				j->filename, strerror(errno));
+		else {
+			fprintf(stderr, "No memory\n");
+			fclose(f);
+		}
+		free(buff);
+		j->rc = 1;
+		j->part = sd;
+		return;
+	}
+	__fsetlocking(f, FSETLOCKING_BYCALLER);
+	while (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+		int past = 0;
+
+		if (defer)
+			j->head++;
+		if (lol_add_record(&j->tail, buff) == 0)
+			continue;
+		while ((entries = get_ready_event(&j->tail))) {
+			if (defer) {
+				if (start == 0)
+					start = entries->e.sec;
+				if (entries->e.sec > start + SEAM_SECS)
+					past = 1;
+				list_clear(entries);
+				free(entries);
+			} else
+				job_event(j, entries);
+		}
+		if (past)
+			defer = 0;
+	}
+	// The current log finishes off what is still open
+	if (!j->rotated) {
+		terminate_all_events(&j->tail);
+		while ((entries = get_ready_event(&j->tail)))
+			job_event(j, entries);
+	}
+	free(buff);
+	fclose(f);
+	j->part = sd;	// The main thread takes these over
+}
+
+static void *log_worker(void *arg)
+{
+	unsigned int window = *(unsigned int *)arg;
+
+	while (1) {
+		struct log_job *j;
+
+		pthread_mutex_lock(&job_lock);
+		// Don't get too far ahead of the output
+		while (job_next < job_cnt && job_next >= job_taken + window)
+			pthread_cond_wait(&job_cond, &job_lock);
+		if (job_next >= job_cnt) {
+			pthread_mutex_unlock(&job_lock);
+			break;
+		}
+		j = &jobs[job_next++];
+		pthread_mutex_unlock(&job_lock);
+
+		// Nothing is left open before the first log
+		scan_job(j, j != jobs);
+
+		pthread_mutex_lock(&job_lock);
+		j->done = 1;
+		pthread_cond_broadcast(&job_cond);
+		pthread_mutex_unlock(&job_lock);
+	}
+	return NULL;
+}
+
+/* Handles an event the main thread put together itself */
+static void seam_event(llist *entries, int *first, event *first_event,
+		event *last_event)
+{
+	if (report_type <= RPT_SUMMARY) {
+		if (*first == 0) {
+			list_get_event(entries, first_event);
+			*first = 1;
+		}
+		list_get_event(entries, last_event);
+	}
+	if (scan(entries) && per_event_processing(entries))
+		found = 1;
+	list_clear(entries);
+	free(entries);
+}
+
+/*
+ * Reads the lines a worker left at the start of its log, and the rest of
+ * them as well if the worker's results can't be used. The events still
+ * open are kept in lo. Returns 1 if the worker's results are good, 0 if
+ * not, and -1 on error.
+ */
+static int read_head(struct log_job *j, int *first, event *first_event,
+		event *last_event)
+{
+	llist *entries;
+	lol sim;
+	FILE *f;
+	char *buff;
+	unsigned long line = 0;
+	int same;
+
+	// Follow along with what the worker had to see where it got to
+	lol_create(&sim);
+	if (j->head == 0 && lol_same(&lo, &sim)) {
+		lol_clear(&sim);
+		return 1;
+	}
+	f = fopen(j->filename, "rm");
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	if (f == NULL || buff == NULL) {
+		if (f == NULL)
+			fprintf(stderr, "Error opening %s (%s)\n",
+				j->filename, strerror(errno));
+		else {
+			fprintf(stderr, "No memory\n");
+			fclose(f);
+		}
+		free(buff);
+		lol_clear(&sim);
+		return -1;
+	}
+	__fsetlocking(f, FSETLOCKING_BYCALLER);
+	while (line < j->head &&
+			fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+		line++;
+		if (lol_add_record(&lo, buff) == 0)
+			continue;
+		lol_add_record(&sim, buff);
+		while ((entries = get_ready_event(&lo)))
+			seam_event(entries, first, first_event, last_event);
+		while ((entries = get_ready_event(&sim))) {
+			list_clear(entries);
+			free(entries);
+		}
+	}
+	same = lol_same(&lo, &sim);
+	lol_clear(&sim);
+	if (!same) {
+		while (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+			if (lol_add_record(&lo, buff) == 0)
+				continue;
+			while ((entries = get_ready_event(&lo)))
+				seam_event(entries, first, first_event,
+						last_event);
+		}
+		if (!j->rotated) {
+			terminate_all_events(&lo);
+			while ((entries = get_ready_event(&lo)))
+				seam_event(entries, first, first_event,
+						last_event);
+		}
+	}
+	free(buff);
+	fclose(f);
+	return same;
+}
+
+/* Throws away what a worker found */
+static void drop_job(struct log_job *j)
+{
+	unsigned int k;
+
+	lol_clear(&j->tail);
+	free_counters(&j->part);
+	for (k = 0; k < j->cnt; k++) {
+		list_clear(j->events[k]);
+		free(j->events[k]);
+	}
+	free(j->events);
+	j->events = NULL;
+	j->cnt = 0;
+	j->first = 0;
+	j->found = 0;
+}
+
+/*
+ * Reads the first seconds of a rolled up log with the events the logs
+ * before it left open in lo, counting them and the log's own events of
+ * those seconds. It goes on until lo has the same events open as the log
+ * read on its own, like the rollup was made, and lets go of them: the
+ * rollup counts them or read_rolled_tail() reads them again. If that is
+ * not before the last seconds, it reads all of the log. Returns 0, 1 if
+ * it read all of it, or -1 on error.
+ */
+static int read_rolled_head(FILE *f, const rollup_info *r, int *first,
+		event *first_event, event *last_event)
+{
+	llist *entries;
+	lol sim;
+	char *buff;
+	off_t pos = 0;
+	time_t open_first, open_last;
+	int all = 1;
+
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	if (buff == NULL) {
+		fprintf(stderr, "No memory\n");
+		return -1;
+	}
+	lol_create(&sim);
+	while (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+		pos += strlen(buff);
+		if (lol_add_record(&lo, buff))
+			lol_add_record(&sim, buff);
+		while ((entries = get_ready_event(&lo))) {
+			// The rollup counted the ones in between
+			if (entries->e.sec > r->head_sec &&
+					entries->e.sec < r->tail_sec) {
+				list_clear(entries);
+				free(entries);
+			} else
+				seam_event(entries, first, first_event,
+						last_event);
+		}
+		while ((entries = get_ready_event(&sim))) {
+			list_clear(entries);
+			free(entries);
+		}
+		if (pos >= r->head_end && pos <= r->tail_start &&
+				(!lol_open_times(&sim, &open_first, &open_last)
+				 || open_first > r->head_sec) &&
+				lol_same(&lo, &sim)) {
+			all = 0;
+			break;
+		}
+	}
+	lol_clear(&sim);
+	free(buff);
+	if (ferror_unlocked(f)) {
+		fprintf(stderr, "Error reading the rolled up log\n");
+		return -1;
+	}
+	if (!all) {
+		lol_clear(&lo);
+		lol_create(&lo);
+	}
+	return all;
+}
+
+/* Reads the last seconds of a rolled up log, leaving the events still
+ * open in lo for the next log */
+static int read_rolled_tail(FILE *f, const rollup_info *r, int *first,
+		event *first_event, event *last_event)
+{
+	llist *entries;
+	char *buff;
+
+	if (fseeko(f, r->tail_start, SEEK_SET))
+		return -1;
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	if (buff == NULL) {
+		fprintf(stderr, "No memory\n");
+		return -1;
+	}
+	while (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+		if (rollup_record_time(buff) < r->tail_sec ||
+				lol_add_record(&lo, buff) == 0)
+			continue;
+		while ((entries = get_ready_event(&lo)))
+			seam_event(entries, first, first_event, last_event);
+	}
+	free(buff);
+	return ferror_unlocked(f) ? -1 : 0;
+}
+
+/*
+ * Counts a rotated log from its rollup, whose counts are in part, and
+ * reads the first and last seconds the rollup left out of it. Returns 1
+ * if the events left open in lo are newer than the first seconds, so the
+ * log has to be read the usual way, and part is left alone. Otherwise
+ * part is added to sd and it returns 0, or -1 on error.
+ */
+static int read_rolled(const char *filename, const rollup_info *r,
+		summary_data *part, int *first, event *first_event,
+		event *last_event)
+{
+	time_t open_first, open_last;
+	FILE *f;
+	int rc;
+
+	if (lol_open_times(&lo, &open_first, &open_last) &&
+			open_last > r->head_sec)
+		return 1;
+	f = fopen(filename, "rm");
+	if (f == NULL) {
+		fprintf(stderr, "Error opening %s (%s)\n", filename,
+			strerror(errno));
+		free_counters(part);
+		return -1;
+	}
+	__fsetlocking(f, FSETLOCKING_BYCALLER);
+	// Counted in the order the events are in the log
+	rc = read_rolled_head(f, r, first, first_event, last_event);
+	if (merge_counters(part)) {
+		fprintf(stderr, "No memory\n");
+		rc = -1;
+	}
+	if (r->have && report_type <= RPT_SUMMARY) {
+		if (*first == 0) {
+			*first_event = r->first;
+			*last_event = r->last;
+			*first = 1;
+		} else if (r->last.sec > last_event->sec ||
+				(r->last.sec == last_event->sec &&
+				 r->last.milli > last_event->milli))
+			*last_event = r->last;
+	}
+	if (rc == 0)
+		rc = read_rolled_tail(f, r, first, first_event, last_event);
+	fclose(f);
+	return rc < 0 ? -1 : 0;
+}
+
+static int process_files_threaded(char **files, unsigned int cnt)
+{
+	pthread_t *workers;
+	unsigned int i, k, nthreads, window;
+	int rc = 0;
+
+	nthreads = report_threads < cnt ? report_threads : cnt;
+	window = 2 * nthreads;
+	jobs = calloc(cnt, sizeof(struct log_job));
+	workers = malloc(nthreads * sizeof(pthread_t));
+	if (jobs == NULL || workers == NULL) {
+		fprintf(stderr, "No memory\n");
+		free(jobs);
+		free(workers);
+		return 1;
+	}
+	for (i = 0; i < cnt; i++) {
+		jobs[i].filename = files[i];
+		jobs[i].rotated = i < cnt - 1;
+	}
+	job_cnt = cnt;
+	job_next = job_taken = 0;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&workers[i], NULL, log_worker, &window)) {
+			fprintf(stderr, "Error creating thread (%s)\n",
+				strerror(errno));
+			break;
+		}
+	}
+	nthreads = i;
+	if (nthreads == 0) {
+		free(jobs);
+		free(workers);
+		return 1;
+	}
+
+	for (i = 0; i < cnt && rc == 0; i++) {
+		struct log_job *j = &jobs[i];
+		int use = 1, first = 0;
+		event first_event, last_event;
+
+		pthread_mutex_lock(&job_lock);
+		while (!j->done)
+			pthread_cond_wait(&job_cond, &job_lock);
+		pthread_mutex_unlock(&job_lock);
+
+		rc = j->rc;
+		last_event.sec = 0;
+		last_event.milli = 0;
+		if (rc == 0 && j->rolled) {
+			// This adds in the rollup's counts
+			use = read_rolled(j->filename, &j->roll, &j->part,
+					&first, &first_event, &last_event);
+			if (use > 0)
+				use = read_head(j, &first, &first_event,
+						&last_event);
+			else if (use == 0)
+				use = 1;
+		} else if (rc == 0)
+			use = read_head(j, &first, &first_event, &last_event);
+		if (use < 0)
+			rc = 1;
+		if (use <= 0 || rc)
+			drop_job(j);
+		else {
+			if (j->rolled)
+				lol_clear(&j->tail);
+			else {
+				lol_clear(&lo);
+				lo = j->tail;
+				if (merge_counters(&j->part)) {
+					fprintf(stderr, "No memory\n");
+					rc = 1;
+				}
+			}
+			if (j->first) {
+				if (first == 0)
+					first_event = j->first_event;
+				first = 1;
+				last_event = j->last_event;
+			}
+		}
+		if (rc == 0) {
+			if (first && very_first_event.sec == 0)
+				very_first_event = first_event;
+			if (first) {
+				very_last_event.sec = last_event.sec;
+				very_last_event.milli = last_event.milli;
+			}
+			if (report_type == RPT_TIME)
+				print_file_times(j->filename, first,
+					&first_event, &last_event);
+			if (j->found)
+				found = 1;
+		}
+		for (k = 0; k < j->cnt; k++) {
+			if (rc == 0 && per_event_processing(j->events[k]))
+				found = 1;
+			list_clear(j->events[k]);
+			free(j->events[k]);
+		}
+		free(j->events);
+		j->events = NULL;
+		j->cnt = 0;
+
+		pthread_mutex_lock(&job_lock);
+		job_taken++;
+		// Stop handing out files after an error
+		if (rc)
+			job_next = job_cnt;
+		pthread_cond_broadcast(&job_cond);
+		pthread_mutex_unlock(&job_lock);
+	}
+
+	for (k = 0; k < nthreads; k++)
+		pthread_join(workers[k], NULL);
+	// Whatever the workers finished after an error
+	for (; i < cnt; i++) {
+		if (jobs[i].done)
+			drop_job(&jobs[i]);
+	}
+	free(workers);
+	free(jobs);
+	jobs = NULL;
+	return rc;
+}
+
 static int process_stdin(void)
 {
 	log_fd = stdin;
@@ -275,6 +866,43 @@ static int process_stdin(void)
 	return process_log_fd("stdin");
 }
 
+/*
+ * Counts a rotated log from its rollup when it can and reads it the usual
+ * way otherwise.
+ */
+static int process_rotated(char *filename)
+{
+	summary_data saved, part;
+	event first_event, last_event;
+	rollup_info r;
+	int first = 0, rc;
+
+	if (!rollup_usable())
+		return process_file(filename);
+	// The rollup's counts go in after those of the log's first seconds
+	saved = sd;
+	reset_counters();
+	rc = rollup_file(filename, &r);
+	part = sd;
+	sd = saved;
+	if (rc == 0)
+		rc = read_rolled(filename, &r, &part, &first, &first_event,
+				&last_event);
+	if (rc > 0) {
+		free_counters(&part);
+		return process_file(filename);
+	}
+	if (rc < 0)
+		return 1;
+	if (first) {
+		if (very_first_event.sec == 0)
+			very_first_event = first_event;
+		very_last_event.sec = last_event.sec;
+		very_last_event.milli = last_event.milli;
+	}
+	return 0;
+}
+
 static int process_file(char *filename)
 {
 	log_fd = fopen(filename, "rm");
@@ -292,12 +920,12 @@ static int process_file(char *filename)
  * This function returns a malloc'd buffer of the next record in the audit
  * logs. It returns 0 on success, 1 on eof, -1 on error. 
  */
-static int get_record(llist **l)
+static int get_record(lol *lo, FILE *f, int last, llist **l)
 {
 	char *rc;
 	char *buff = NULL;
 
-	*l = get_ready_event(&lo);
+	*l = get_ready_event(lo);
 	if (*l)
 		return 0;
 
@@ -307,23 +935,22 @@ static int get_record(llist **l)
 			if (!buff)
 				return -1;
 		}
-		rc = fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH,
-					log_fd);
+		rc = fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f);
 		if (rc) {
-			if (lol_add_record(&lo, buff)) {
-				*l = get_ready_event(&lo);
+			if (lol_add_record(lo, buff)) {
+				*l = get_ready_event(lo);
 				if (*l)
 					break;
 			}
 		} else {
 			free(buff);
-			if (feof_unlocked(log_fd)) {
+			if (feof_unlocked(f)) {
 				// Only mark all events complete if this is
 				// the last file.
-				if (files_to_process == 0) {
-					terminate_all_events(&lo);
+				if (last) {
+					terminate_all_events(lo);
 				}
-				*l = get_ready_event(&lo);
+				*l = get_ready_event(lo);
 				if (*l)
 					return 0;
 				else
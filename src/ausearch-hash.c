@@ -0,0 +1,432 @@
+/*
+* ausearch-hash.c - Minimal hash tables for counting strings & numbers
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#include "ausearch-hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKETS	64
+#define CHUNK_SIZE	(64*1024)
+#define ALIGN(x)	(((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+typedef int (*rank_fn)(const void *a, const void *b);
+
+static void *chunk_alloc(struct hchunk **chunks, size_t len)
+{
+	struct hchunk *c = *chunks;
+
+	len = ALIGN(len);
+	if (c == NULL || c->size - c->used < len) {
+		size_t size = len > CHUNK_SIZE ? len : CHUNK_SIZE;
+
+		c = malloc(sizeof(struct hchunk) + size);
+		if (c == NULL)
+			return NULL;
+		c->used = 0;
+		c->size = size;
+		/* Keep the one with room at the front */
+		if (*chunks && size == len) {
+			c->next = (*chunks)->next;
+			(*chunks)->next = c;
+		} else {
+			c->next = *chunks;
+			*chunks = c;
+		}
+	}
+	c->used += len;
+	return c->data + c->used - len;
+}
+
+static void chunk_free(struct hchunk **chunks)
+{
+	struct hchunk *c = *chunks;
+
+	while (c) {
+		struct hchunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	*chunks = NULL;
+}
+
+/* FNV-1a */
+static unsigned int hash_str(const char *s, size_t *len)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	unsigned int h = 2166136261U;
+
+	while (*p) {
+		h ^= *p++;
+		h *= 16777619U;
+	}
+	*len = (const char *)p - s;
+	return h;
+}
+
+static unsigned int hash_int(int num)
+{
+	unsigned int h = (unsigned int)num;
+
+	h ^= h >> 16;
+	h *= 0x45d9f3bU;
+	h ^= h >> 16;
+	return h;
+}
+
+/* Moves a[i] down until the heap, whose root ranks last, is valid */
+static void sift_down(void **a, unsigned int n, unsigned int i, rank_fn rank)
+{
+	for (;;) {
+		unsigned int l = 2*i + 1, r = l + 1, last = i;
+		void *tmp;
+
+		if (l < n && rank(a[l], a[last]) > 0)
+			last = l;
+		if (r < n && rank(a[r], a[last]) > 0)
+			last = r;
+		if (last == i)
+			return;
+		tmp = a[i];
+		a[i] = a[last];
+		a[last] = tmp;
+		i = last;
+	}
+}
+
+/*
+ * Puts the top entries of a in front, in rank order, and returns how
+ * many there are. Keeping only top of them uses a heap so that large
+ * tables don't need to be sorted completely.
+ */
+static unsigned int select_top(void **a, unsigned int n, unsigned int top,
+		rank_fn rank, int (*qcmp)(const void *, const void *))
+{
+	unsigned int i;
+
+	if (top && top < n) {
+		for (i = top / 2; i-- > 0; )
+			sift_down(a, top, i, rank);
+		for (i = top; i < n; i++) {
+			if (rank(a[i], a[0]) < 0) {
+				a[0] = a[i];
+				sift_down(a, top, 0, rank);
+			}
+		}
+		n = top;
+	}
+	qsort(a, n, sizeof(void *), qcmp);
+	return n;
+}
+
+void shash_create(shash *h)
+{
+	h->table = NULL;
+	h->size = 0;
+	h->cnt = 0;
+	h->chunks = NULL;
+}
+
+void shash_clear(shash *h)
+{
+	free(h->table);
+	chunk_free(&h->chunks);
+	shash_create(h);
+}
+
+static int shash_grow(shash *h)
+{
+	unsigned int size = h->size ? h->size * 2 : INITIAL_BUCKETS, i;
+	shnode **table = calloc(size, sizeof(shnode *));
+
+	if (table == NULL)
+		return -1;
+	for (i = 0; i < h->size; i++) {
+		shnode *n = h->table[i];
+
+		while (n) {
+			shnode *next = n->next;
+			unsigned int b = n->hash & (size - 1);
+
+			n->next = table[b];
+			table[b] = n;
+			n = next;
+		}
+	}
+	free(h->table);
+	h->table = table;
+	h->size = size;
+	return 0;
+}
+
+int shash_add_hits(shash *h, const char *str, unsigned int hits)
+{
+	unsigned int hash, b;
+	size_t len;
+	shnode *n;
+
+	hash = hash_str(str, &len);
+	if (h->size) {
+		n = h->table[hash & (h->size - 1)];
+		while (n) {
+			if (n->hash == hash && strcmp(n->str, str) == 0) {
+				n->hits += hits;
+				return 0;
+			}
+			n = n->next;
+		}
+	}
+
+	/* Keep the chains short */
+	if (h->cnt >= h->size - h->size/4 && shash_grow(h))
+		return -1;
+
+	n = chunk_alloc(&h->chunks, sizeof(shnode) + len + 1);
+	if (n == NULL)
+		return -1;
+	memcpy(n->str, str, len + 1);
+	n->hash = hash;
+	n->hits = hits;
+	n->seq = h->cnt;
+	b = hash & (h->size - 1);
+	n->next = h->table[b];
+	h->table[b] = n;
+	h->cnt++;
+	return 1;
+}
+
+int shash_add(shash *h, const char *str)
+{
+	return shash_add_hits(h, str, 1);
+}
+
+static int shnode_seq_cmp(const void *a, const void *b)
+{
+	const shnode *x = *(shnode * const *)a, *y = *(shnode * const *)b;
+
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+shnode **shash_by_seq(const shash *h)
+{
+	shnode **a;
+	unsigned int i, n = 0;
+
+	a = malloc((h->cnt ? h->cnt : 1) * sizeof(shnode *));
+	if (a == NULL)
+		return NULL;
+	for (i = 0; i < h->size; i++) {
+		shnode *node = h->table[i];
+
+		while (node) {
+			a[n++] = node;
+			node = node->next;
+		}
+	}
+	qsort(a, n, sizeof(shnode *), shnode_seq_cmp);
+	return a;
+}
+
+int shash_merge(shash *h, const shash *src)
+{
+	shnode **a;
+	unsigned int i;
+	int rc = 0;
+
+	if (src->cnt == 0)
+		return 0;
+	/* Keep the order things were first seen in across the tables */
+	a = shash_by_seq(src);
+	if (a == NULL)
+		return -1;
+	for (i = 0; i < src->cnt && rc >= 0; i++)
+		rc = shash_add_hits(h, a[i]->str, a[i]->hits);
+	free(a);
+	return rc < 0 ? -1 : 0;
+}
+
+/* Most hits first, ties in the order they were first seen */
+static int shnode_rank(const void *a, const void *b)
+{
+	const shnode *x = a, *y = b;
+
+	if (x->hits != y->hits)
+		return x->hits > y->hits ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int shnode_qcmp(const void *a, const void *b)
+{
+	return shnode_rank(*(void * const *)a, *(void * const *)b);
+}
+
+shnode **shash_sort_by_hits(shash *h, unsigned int top, unsigned int *cnt)
+{
+	shnode **a;
+	unsigned int i, n = 0;
+
+	*cnt = 0;
+	a = malloc((h->cnt ? h->cnt : 1) * sizeof(shnode *));
+	if (a == NULL)
+		return NULL;
+	for (i = 0; i < h->size; i++) {
+		shnode *node = h->table[i];
+
+		while (node) {
+			a[n++] = node;
+			node = node->next;
+		}
+	}
+	*cnt = select_top((void **)a, n, top, shnode_rank, shnode_qcmp);
+	return a;
+}
+
+void ihash_create(ihash *h)
+{
+	h->table = NULL;
+	h->size = 0;
+	h->cnt = 0;
+	h->chunks = NULL;
+}
+
+void ihash_clear(ihash *h)
+{
+	free(h->table);
+	chunk_free(&h->chunks);
+	ihash_create(h);
+}
+
+static int ihash_grow(ihash *h)
+{
+	unsigned int size = h->size ? h->size * 2 : INITIAL_BUCKETS, i;
+	ihnode **table = calloc(size, sizeof(ihnode *));
+
+	if (table == NULL)
+		return -1;
+	for (i = 0; i < h->size; i++) {
+		ihnode *n = h->table[i];
+
+		while (n) {
+			ihnode *next = n->next;
+			unsigned int b = hash_int(n->num) & (size - 1);
+
+			n->next = table[b];
+			table[b] = n;
+			n = next;
+		}
+	}
+	free(h->table);
+	h->table = table;
+	h->size = size;
+	return 0;
+}
+
+int ihash_add_hits(ihash *h, int num, int aux, unsigned int hits)
+{
+	unsigned int b;
+	ihnode *n;
+
+	if (h->size) {
+		n = h->table[hash_int(num) & (h->size - 1)];
+		while (n) {
+			if (n->num == num) {
+				n->hits += hits;
+				return 0;
+			}
+			n = n->next;
+		}
+	}
+
+	if (h->cnt >= h->size - h->size/4 && ihash_grow(h))
+		return -1;
+
+	n = chunk_alloc(&h->chunks, sizeof(ihnode));
+	if (n == NULL)
+		return -1;
+	n->num = num;
+	n->aux1 = aux;
+	n->hits = hits;
+	b = hash_int(num) & (h->size - 1);
+	n->next = h->table[b];
+	h->table[b] = n;
+	h->cnt++;
+	return 1;
+}
+
+int ihash_add(ihash *h, int num, int aux)
+{
+	return ihash_add_hits(h, num, aux, 1);
+}
+
+int ihash_merge(ihash *h, const ihash *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < src->size; i++) {
+		const ihnode *node = src->table[i];
+
+		while (node) {
+			if (ihash_add_hits(h, node->num, node->aux1,
+						node->hits) < 0)
+				return -1;
+			node = node->next;
+		}
+	}
+	return 0;
+}
+
+/* Most hits first, ties from low to high */
+static int ihnode_rank(const void *a, const void *b)
+{
+	const ihnode *x = a, *y = b;
+
+	if (x->hits != y->hits)
+		return x->hits > y->hits ? -1 : 1;
+	return x->num < y->num ? -1 : x->num > y->num;
+}
+
+static int ihnode_qcmp(const void *a, const void *b)
+{
+	return ihnode_rank(*(void * const *)a, *(void * const *)b);
+}
+
+ihnode **ihash_sort_by_hits(ihash *h, unsigned int top, unsigned int *cnt)
+{
+	ihnode **a;
+	unsigned int i, n = 0;
+
+	*cnt = 0;
+	a = malloc((h->cnt ? h->cnt : 1) * sizeof(ihnode *));
+	if (a == NULL)
+		return NULL;
+	for (i = 0; i < h->size; i++) {
+		ihnode *node = h->table[i];
+
+		while (node) {
+			a[n++] = node;
+			node = node->next;
+		}
+	}
+	*cnt = select_top((void **)a, n, top, ihnode_rank, ihnode_qcmp);
+	return a;
+}
+
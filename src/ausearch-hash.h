@@ -0,0 +1,93 @@
+/*
+* ausearch-hash.h - Header file for ausearch-hash.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUHASH_HEADER
+#define AUHASH_HEADER
+
+#include "config.h"
+
+/* Nodes and strings are carved out of these so that counting millions of
+ * distinct items doesn't cost a malloc each. */
+struct hchunk {
+  struct hchunk *next;
+  unsigned int used;	// Bytes handed out
+  unsigned int size;	// Bytes in data
+  char data[];
+};
+
+/* A counted string. The string is stored right behind the node. */
+typedef struct _shnode{
+  struct _shnode *next;	// Next node in the bucket
+  unsigned int hash;	// Hash of str
+  unsigned int hits;	// Number of times this string was added
+  unsigned int seq;	// Order in which it was first seen
+  char str[];		// The string
+} shnode;
+
+typedef struct {
+  shnode **table;	// Buckets
+  unsigned int size;	// Number of buckets, a power of 2
+  unsigned int cnt;	// How many distinct strings
+  struct hchunk *chunks;	// Storage for nodes
+} shash;
+
+void shash_create(shash *h);
+void shash_clear(shash *h);
+/* Count a string. Returns 1 if it was not seen before. */
+int shash_add(shash *h, const char *str);
+int shash_add_hits(shash *h, const char *str, unsigned int hits);
+/* Adds the counts in src to h. Strings new to h keep the order in which
+ * src first saw them. Returns -1 if out of memory. */
+int shash_merge(shash *h, const shash *src);
+/* Returns all entries in the order they were first seen. The array is
+ * malloc'ed and holds cnt entries. */
+shnode **shash_by_seq(const shash *h);
+/* Returns the top entries by hits, or all of them if top is 0. The
+ * array is malloc'ed and its length is returned in cnt. */
+shnode **shash_sort_by_hits(shash *h, unsigned int top, unsigned int *cnt);
+
+/* A counted number */
+typedef struct _ihnode{
+  struct _ihnode *next;	// Next node in the bucket
+  int num;		// The number
+  int aux1;		// Extra spot for data, from the first add
+  unsigned int hits;	// Number of times this number was added
+} ihnode;
+
+typedef struct {
+  ihnode **table;	// Buckets
+  unsigned int size;	// Number of buckets, a power of 2
+  unsigned int cnt;	// How many distinct numbers
+  struct hchunk *chunks;	// Storage for nodes
+} ihash;
+
+void ihash_create(ihash *h);
+void ihash_clear(ihash *h);
+/* Count a number. Returns 1 if it was not seen before. */
+int ihash_add(ihash *h, int num, int aux);
+int ihash_add_hits(ihash *h, int num, int aux, unsigned int hits);
+int ihash_merge(ihash *h, const ihash *src);
+ihnode **ihash_sort_by_hits(ihash *h, unsigned int top, unsigned int *cnt);
+
+#endif
+
@@ -0,0 +1,969 @@
+/*
+* ausearch-index.c - Bloom filter block indexes of rotated logs
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * ausearch --build-index cuts each rotated log into blocks of about
+ * INDEX_BLOCK bytes and keeps a Bloom filter of the keys, file names,
+ * executables, host names, and user ids found in each block. Searching
+ * for one of those then only needs to read the blocks whose filter might
+ * hold it. Blocks also know the time range of their records, which lets
+ * -ts and -te skip them too.
+ *
+ * Blocks are only cut where no event has records on both sides, so a
+ * block that is skipped takes whole events with it and the events that
+ * are read are the same as without the index. The values are the ones
+ * the search parser extracts when only that kind of search is asked for.
+ * String searches match substrings unless -w is given, so every 3 byte
+ * piece of a value goes in the filter as well as the whole value. The
+ * first and last few seconds of a log may belong to events that continue
+ * in the next log, so those blocks are never skipped by the filter.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include "libaudit.h"
+#include "ausearch-options.h"
+#include "ausearch-parse.h"
+#include "ausearch-lol.h"
+#include "ausearch-index.h"
+#include "ausearch-logdir.h"
+
+#define INDEX_MAGIC	0x41534958	/* "ASIX" */
+#define INDEX_VERSION	1
+#define INDEX_BLOCK	(1024*1024)
+#define BITS_PER_ITEM	10		// About 1% false positives
+#define BLOOM_HASHES	7
+#define MIN_SHIFT	9		// Smallest filter is 64 bytes
+#define MAX_SHIFT	30
+#define COMPACT_ITEMS	65536		// Dedup the items of a block this often
+
+#define BLOCK_NO_FILTER	0x0001		// Block has to be read for any search
+
+struct index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t blocks;
+	uint32_t reserved;
+};
+
+struct index_block {
+	uint64_t start;		// Byte range of the block in the log
+	uint64_t end;
+	int64_t first_sec;	// Oldest record in the block
+	int64_t last_sec;	// Newest record in the block
+	uint32_t flags;
+	uint32_t shift;		// The filter has 1 << shift bits
+};
+
+/* Where an event's records are while the index is being made */
+struct ev {
+	time_t sec;
+	unsigned int milli;
+	unsigned long serial;
+	uint64_t node;		// Hash of the node name
+	uint64_t first;		// Offset of its first record
+	uint64_t end;		// End of its last record
+	unsigned int block;
+	unsigned int next;	// Next in the hash chain, plus 1
+};
+
+struct bblock {
+	struct index_block b;
+	uint64_t *items;	// Hashes of the values in the block
+	unsigned int cnt;
+	unsigned int size;
+};
+
+struct build {
+	struct ev *ev;
+	unsigned int cnt, size;
+	unsigned int *table;	// Hash chain heads, plus 1
+	unsigned int tsize;
+	struct bblock *blk;
+	unsigned int blocks;
+	time_t last_sec;	// Time of the last record of the log
+};
+
+/* Inodes of the logs indexed this run, for pruning old indexes */
+static inode_list seen = INODE_LIST_INIT;
+
+/* FNV-1a with a final mix so all bits of the result are usable */
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static uint64_t hash_item(char tag, const char *s, size_t len)
+{
+	uint64_t h = hash_bytes(14695981039346656037ULL, &tag, 1);
+
+	h = hash_bytes(h, s, len);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static void bloom_add(unsigned char *bloom, unsigned int shift, uint64_t h)
+{
+	uint32_t h1 = h, h2 = (h >> 32) | 1, mask = (1U << shift) - 1;
+	unsigned int i;
+
+	for (i = 0; i < BLOOM_HASHES; i++) {
+		uint32_t bit = (h1 + i * h2) & mask;
+		bloom[bit >> 3] |= 1 << (bit & 7);
+	}
+}
+
+static int bloom_has(const unsigned char *bloom, unsigned int shift,
+		uint64_t h)
+{
+	uint32_t h1 = h, h2 = (h >> 32) | 1, mask = (1U << shift) - 1;
+	unsigned int i;
+
+	for (i = 0; i < BLOOM_HASHES; i++) {
+		uint32_t bit = (h1 + i * h2) & mask;
+		if ((bloom[bit >> 3] & (1 << (bit & 7))) == 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Returns 0 if the name of the index fits in path and -1 if not */
+static int index_name(char *path, size_t size, const char *filename,
+		unsigned long long ino)
+{
+	char name[24];
+
+	snprintf(name, sizeof(name), "%llu", ino);
+	return logdir_path(path, size, filename, INDEX_DIR, name);
+}
+
+static void fill_header(struct index_header *h, const struct stat *st)
+{
+	memset(h, 0, sizeof(*h));
+	h->magic = INDEX_MAGIC;
+	h->version = INDEX_VERSION;
+	h->dev = st->st_dev;
+	h->ino = st->st_ino;
+	h->size = st->st_size;
+	h->mtime = st->st_mtime;
+}
+
+/*
+ * Picks the event id out of a record the same way the lol does. Returns
+ * 0 on success and -1 if the record has none.
+ */
+static int line_id(const char *buf, struct ev *e)
+{
+	const char *ptr;
+	char *end;
+
+	e->node = 0;
+	if (strncmp(buf, "node=", 5) == 0) {
+		ptr = strchr(buf, ' ');
+		if (ptr == NULL)
+			return -1;
+		e->node = hash_item('N', buf + 5, ptr - buf - 5);
+		buf = ptr + 1;
+	}
+	// Skip type=, then msg=audit( should follow
+	ptr = strchr(buf, ' ');
+	if (ptr == NULL)
+		return -1;
+	ptr = strchr(ptr + 1, '(');
+	if (ptr == NULL)
+		return -1;
+	errno = 0;
+	e->sec = strtoul(ptr + 1, &end, 10);
+	e->milli = 0;
+	e->serial = 0;
+	if (*end == '.')
+		e->milli = strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		e->serial = strtoul(end + 1, &end, 10);
+	return errno ? -1 : 0;
+}
+
+static unsigned int ev_hash(const struct ev *e)
+{
+	uint64_t h = e->node ^ ((uint64_t)e->sec << 20) ^ e->milli ^
+			((uint64_t)e->serial << 32) ^ e->serial;
+
+	h ^= h >> 29;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 32;
+	return h;
+}
+
+static struct ev *find_ev(struct build *b, const struct ev *key)
+{
+	unsigned int i;
+
+	if (b->tsize == 0)
+		return NULL;
+	i = b->table[ev_hash(key) & (b->tsize - 1)];
+	while (i) {
+		struct ev *e = &b->ev[i - 1];
+
+		if (e->sec == key->sec && e->milli == key->milli &&
+				e->serial == key->serial &&
+				e->node == key->node)
+			return e;
+		i = e->next;
+	}
+	return NULL;
+}
+
+static int grow_table(struct build *b)
+{
+	unsigned int size = b->tsize ? b->tsize * 2 : 4096, i;
+	unsigned int *table = calloc(size, sizeof(unsigned int));
+
+	if (table == NULL)
+		return -1;
+	for (i = 0; i < b->cnt; i++) {
+		unsigned int h = ev_hash(&b->ev[i]) & (size - 1);
+
+		b->ev[i].next = table[h];
+		table[h] = i + 1;
+	}
+	free(b->table);
+	b->table = table;
+	b->tsize = size;
+	return 0;
+}
+
+/* Notes where a record is. Events are kept in the order they started. */
+static int note_record(struct build *b, const struct ev *key, uint64_t pos,
+		uint64_t end)
+{
+	struct ev *e = find_ev(b, key);
+	unsigned int h;
+
+	if (e) {
+		e->end = end;
+		return 0;
+	}
+	if (b->cnt == b->size) {
+		unsigned int size = b->size ? b->size * 2 : 4096;
+		struct ev *tmp = realloc(b->ev, size * sizeof(struct ev));
+
+		if (tmp == NULL)
+			return -1;
+		b->ev = tmp;
+		b->size = size;
+	}
+	if (b->cnt >= b->tsize && grow_table(b))
+		return -1;
+	e = &b->ev[b->cnt];
+	*e = *key;
+	e->first = pos;
+	e->end = end;
+	h = ev_hash(e) & (b->tsize - 1);
+	e->next = b->table[h];
+	b->table[h] = ++b->cnt;
+	return 0;
+}
+
+static int add_block(struct build *b, uint64_t start, uint32_t flags)
+{
+	struct bblock *tmp = realloc(b->blk,
+			(b->blocks + 1) * sizeof(struct bblock));
+
+	if (tmp == NULL)
+		return -1;
+	b->blk = tmp;
+	tmp = &b->blk[b->blocks++];
+	memset(tmp, 0, sizeof(*tmp));
+	tmp->b.start = start;
+	tmp->b.end = start;
+	tmp->b.first_sec = INT64_MAX;
+	tmp->b.last_sec = INT64_MIN;
+	tmp->b.flags = flags;
+	return 0;
+}
+
+/*
+ * Cuts the log into blocks. A cut is only made in front of an event that
+ * starts after every earlier event has ended.
+ */
+static int make_blocks(struct build *b, uint64_t size)
+{
+	uint64_t max_end = 0;
+	unsigned int i;
+	int head = 1, tail = 0;
+
+	if (add_block(b, 0, BLOCK_NO_FILTER))
+		return -1;
+	for (i = 0; i < b->cnt; i++) {
+		struct ev *e = &b->ev[i];
+		struct bblock *cur = &b->blk[b->blocks - 1];
+
+		if (e->first >= max_end && e->first > cur->b.start) {
+			int cut = 0;
+
+			if (head) {
+				if (e->sec > b->ev[0].sec +
+						MAX_EVENT_DELTA_SECS)
+					cut = 1;
+			} else if (!tail && e->sec + MAX_EVENT_DELTA_SECS
+						>= b->last_sec)
+				cut = tail = 1;
+			else if (!tail && e->first - cur->b.start >=
+						INDEX_BLOCK)
+				cut = 1;
+			if (cut) {
+				cur->b.end = e->first;
+				if (add_block(b, e->first,
+						tail ? BLOCK_NO_FILTER : 0))
+					return -1;
+				cur = &b->blk[b->blocks - 1];
+				head = 0;
+			}
+		}
+		if (e->end > max_end)
+			max_end = e->end;
+		if (e->sec < cur->b.first_sec)
+			cur->b.first_sec = e->sec;
+		if (e->sec > cur->b.last_sec)
+			cur->b.last_sec = e->sec;
+		e->block = b->blocks - 1;
+	}
+	b->blk[b->blocks - 1].b.end = size;
+	return 0;
+}
+
+static int cmp_item(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void compact_items(struct bblock *blk)
+{
+	unsigned int i, n = 0;
+
+	if (blk->cnt == 0)
+		return;
+	qsort(blk->items, blk->cnt, sizeof(uint64_t), cmp_item);
+	for (i = 1; i < blk->cnt; i++)
+		if (blk->items[i] != blk->items[n])
+			blk->items[++n] = blk->items[i];
+	blk->cnt = n + 1;
+}
+
+static int add_item(struct bblock *blk, uint64_t h)
+{
+	if (blk->cnt == blk->size) {
+		unsigned int size;
+		uint64_t *tmp;
+
+		if (blk->cnt >= COMPACT_ITEMS) {
+			compact_items(blk);
+			if (blk->cnt < blk->size / 2)
+				goto add;
+		}
+		size = blk->size ? blk->size * 2 : 1024;
+		tmp = realloc(blk->items, size * sizeof(uint64_t));
+		if (tmp == NULL)
+			return -1;
+		blk->items = tmp;
+		blk->size = size;
+	}
+add:
+	blk->items[blk->cnt++] = h;
+	return 0;
+}
+
+/* Adds a string value as a whole and as every 3 byte piece of it */
+static int add_str(struct bblock *blk, char tag, const char *str)
+{
+	size_t i, len;
+
+	if (str == NULL)
+		return 0;
+	len = strlen(str);
+	if (add_item(blk, hash_item(tag, str, len)))
+		return -1;
+	for (i = 0; i + 3 <= len; i++)
+		if (add_item(blk, hash_item(tag | 0x20, str + i, 3)))
+			return -1;
+	return 0;
+}
+
+static int add_list(struct bblock *blk, char tag, slist *sl)
+{
+	const snode *sn;
+
+	if (sl == NULL)
+		return 0;
+	slist_first(sl);
+	for (sn = slist_get_cur(sl); sn; sn = slist_next(sl))
+		if (add_str(blk, tag, sn->str))
+			return -1;
+	return 0;
+}
+
+static int add_id(struct bblock *blk, char tag, uid_t id)
+{
+	char buf[16];
+
+	snprintf(buf, sizeof(buf), "%u", (unsigned int)id);
+	return add_item(blk, hash_item(tag, buf, strlen(buf)));
+}
+
+/*
+ * The parser only extracts the fields of the searches that were asked
+ * for, and what it finds can depend on which those are. So each kind of
+ * value is parsed on its own, just like a search for it would.
+ */
+static int index_event(struct build *b, llist *l)
+{
+	struct bblock *blk;
+	struct ev key, *e;
+	int rc = 0;
+
+	key.sec = l->e.sec;
+	key.milli = l->e.milli;
+	key.serial = l->e.serial;
+	key.node = l->e.node ? hash_item('N', l->e.node,
+					strlen(l->e.node)) : 0;
+	e = find_ev(b, &key);
+	if (e == NULL)
+		return -1;
+	blk = &b->blk[e->block];
+
+	event_key = "";
+	if (extract_needed_items(l, SI_KEY))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	rc |= add_list(blk, 'K', l->s.key);
+	list_clear_items(l);
+	event_key = NULL;
+
+	event_filename = "";
+	if (extract_needed_items(l, SI_FILE))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	rc |= add_list(blk, 'F', l->s.filename);
+	rc |= add_str(blk, 'F', l->s.cwd);
+	list_clear_items(l);
+	event_filename = NULL;
+
+	event_exe = "";
+	if (extract_needed_items(l, SI_EXE))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	rc |= add_str(blk, 'X', l->s.exe);
+	list_clear_items(l);
+	event_exe = NULL;
+
+	event_hostname = "";
+	if (extract_needed_items(l, SI_HOST))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	rc |= add_str(blk, 'H', l->s.hostname);
+	list_clear_items(l);
+	event_hostname = NULL;
+
+	event_uid = 0;
+	if (extract_needed_items(l, SI_IDS))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	if (l->s.uid != (uid_t)-1)
+		rc |= add_id(blk, 'U', l->s.uid);
+	list_clear_items(l);
+	event_uid = -1;
+
+	event_euid = 0;
+	if (extract_needed_items(l, SI_IDS))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	if (l->s.euid != (uid_t)-1)
+		rc |= add_id(blk, 'E', l->s.euid);
+	list_clear_items(l);
+	event_euid = -1;
+
+	event_loginuid = 0;
+	if (extract_needed_items(l, SI_IDS))
+		blk->b.flags |= BLOCK_NO_FILTER;
+	if (l->s.loginuid != (uid_t)-2)
+		rc |= add_id(blk, 'L', l->s.loginuid);
+	list_clear_items(l);
+	event_loginuid = -2;
+
+	return rc;
+}
+
+/* First pass: where does each event start and end */
+static int find_events(FILE *f, struct build *b, char *buff)
+{
+	uint64_t pos = 0;
+
+	while (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+		size_t len = strlen(buff);
+		struct ev key;
+
+		if (line_id(buff, &key) == 0) {
+			if (note_record(b, &key, pos, pos + len))
+				return -1;
+			b->last_sec = key.sec;
+		}
+		pos += len;
+	}
+	return ferror_unlocked(f) ? -1 : 0;
+}
+
+/* Second pass: put the values of each event in its block */
+static int fill_blocks(FILE *f, struct build *b, char *buff)
+{
+	lol lo;
+	int rc = 0, eof = 0;
+
+	if (fseeko(f, 0, SEEK_SET))
+		return -1;
+	lol_create(&lo);
+	lo.all_times = 1;
+	while (rc == 0 && !eof) {
+		llist *l;
+
+		if (fgets_unlocked(buff, MAX_AUDIT_MESSAGE_LENGTH, f)) {
+			if (lol_add_record(&lo, buff) == 0)
+				continue;
+		} else {
+			if (ferror_unlocked(f))
+				rc = -1;
+			eof = 1;
+			terminate_all_events(&lo);
+		}
+		while ((l = get_ready_event(&lo))) {
+			if (rc == 0 && index_event(b, l))
+				rc = -1;
+			list_clear(l);
+			free(l);
+		}
+	}
+	lol_clear(&lo);
+	return rc;
+}
+
+static int save_index(const char *filename, struct index_header *h,
+		struct build *b)
+{
+	char dir[MAXPATHLEN], path[MAXPATHLEN], tmp[MAXPATHLEN+16];
+	unsigned int i;
+	FILE *f;
+	int fd;
+
+	if (logdir_path(dir, sizeof(dir), filename, INDEX_DIR, NULL) ||
+			(mkdir(dir, 0750) && errno != EEXIST))
+		return -1;
+	if (index_name(path, sizeof(path), filename, h->ino))
+		return -1;
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0640);
+	if (fd < 0)
+		return -1;
+	f = fdopen(fd, "w");
+	if (f == NULL) {
+		close(fd);
+		unlink(tmp);
+		return -1;
+	}
+	h->blocks = b->blocks;
+	fwrite(h, sizeof(*h), 1, f);
+	for (i = 0; i < b->blocks; i++) {
+		struct bblock *blk = &b->blk[i];
+		unsigned int shift = MIN_SHIFT;
+
+		compact_items(blk);
+		while (shift < MAX_SHIFT &&
+			(1ULL << shift) < (uint64_t)blk->cnt * BITS_PER_ITEM)
+			shift++;
+		blk->b.shift = shift;
+		fwrite(&blk->b, sizeof(blk->b), 1, f);
+	}
+	for (i = 0; i < b->blocks; i++) {
+		struct bblock *blk = &b->blk[i];
+		size_t len = (1U << blk->b.shift) / 8;
+		unsigned char *bloom = calloc(1, len);
+		unsigned int k;
+
+		if (bloom == NULL)
+			break;
+		for (k = 0; k < blk->cnt; k++)
+			bloom_add(bloom, blk->b.shift, blk->items[k]);
+		fwrite(bloom, len, 1, f);
+		free(bloom);
+	}
+	if (fclose(f) || i < b->blocks || rename(tmp, path)) {
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+int index_build(const char *filename)
+{
+	struct index_header h;
+	struct build b;
+	struct stat st;
+	unsigned int i;
+	char *buff;
+	FILE *f;
+	int rc;
+
+	f = fopen(filename, "rm");
+	if (f == NULL) {
+		fprintf(stderr, "Error opening %s (%s)\n", filename,
+			strerror(errno));
+		return 1;
+	}
+	__fsetlocking(f, FSETLOCKING_BYCALLER);
+	if (fstat(fileno(f), &st)) {
+		fclose(f);
+		return 1;
+	}
+	logdir_remember(&seen, st.st_ino);
+	fill_header(&h, &st);
+	buff = malloc(MAX_AUDIT_MESSAGE_LENGTH);
+	memset(&b, 0, sizeof(b));
+	rc = buff == NULL || find_events(f, &b, buff) ||
+		make_blocks(&b, st.st_size) || fill_blocks(f, &b, buff);
+	fclose(f);
+	free(buff);
+	if (rc == 0 && save_index(filename, &h, &b))
+		rc = 1;
+	if (rc)
+		fprintf(stderr, "Error indexing %s\n", filename);
+	for (i = 0; i < b.blocks; i++)
+		free(b.blk[i].items);
+	free(b.blk);
+	free(b.ev);
+	free(b.table);
+	return rc;
+}
+
+void index_prune(const char *log_file)
+{
+	logdir_prune(&seen, log_file, INDEX_DIR);
+}
+
+/* The hashes a block's filter has to hold for a value to be in it */
+struct needle {
+	unsigned int cnt;
+	uint64_t *hash;
+};
+
+/* What one search needs a block to have */
+struct wanted {
+	struct needle all[8];	// Every one of these has to be there
+	unsigned int all_cnt;
+	struct needle any[3];	// One of these has to be there
+	unsigned int any_cnt;
+	time_t start, end;
+};
+
+/* A block is read if any of the searches might match in it */
+static struct {
+	int ready;
+	int unfiltered;		// One of the searches can't use an index
+	struct wanted *w;
+	unsigned int cnt;
+} search;
+
+static struct {
+	int active;
+	struct index_header h;
+	struct index_block *blk;
+	unsigned char **bloom;
+	unsigned char *data;
+	unsigned int cur;
+	uint64_t pos;
+} idx;
+
+static int str_needle(struct needle *n, char tag, const char *str)
+{
+	size_t i, len = strlen(str);
+
+	if (event_exact_match) {
+		n->hash = malloc(sizeof(uint64_t));
+		if (n->hash == NULL)
+			return 0;
+		n->hash[0] = hash_item(tag, str, len);
+		n->cnt = 1;
+		return 1;
+	}
+	// Substrings shorter than the pieces can't be looked for
+	if (len < 3)
+		return 0;
+	n->hash = malloc((len - 2) * sizeof(uint64_t));
+	if (n->hash == NULL)
+		return 0;
+	for (i = 0; i + 3 <= len; i++)
+		n->hash[i] = hash_item(tag | 0x20, str + i, 3);
+	n->cnt = len - 2;
+	return 1;
+}
+
+static int id_needle(struct needle *n, char tag, uid_t id)
+{
+	char buf[16];
+
+	snprintf(buf, sizeof(buf), "%u", (unsigned int)id);
+	n->hash = malloc(sizeof(uint64_t));
+	if (n->hash == NULL)
+		return 0;
+	n->hash[0] = hash_item(tag, buf, strlen(buf));
+	n->cnt = 1;
+	return 1;
+}
+
+void index_add_search(void)
+{
+	struct wanted *tmp, *w;
+
+	// Debug output has to see every malformed record
+	if (event_debug) {
+		search.unfiltered = 1;
+		return;
+	}
+	tmp = realloc(search.w, (search.cnt + 1) * sizeof(struct wanted));
+	if (tmp == NULL) {
+		search.unfiltered = 1;
+		return;
+	}
+	search.w = tmp;
+	w = &search.w[search.cnt++];
+	memset(w, 0, sizeof(*w));
+	w->start = start_time;
+	w->end = end_time;
+	if (event_key && str_needle(&w->all[w->all_cnt], 'K', event_key))
+		w->all_cnt++;
+	if (event_filename && str_needle(&w->all[w->all_cnt], 'F',
+						event_filename))
+		w->all_cnt++;
+	if (event_exe && str_needle(&w->all[w->all_cnt], 'X', event_exe))
+		w->all_cnt++;
+	if (event_hostname && str_needle(&w->all[w->all_cnt], 'H',
+						event_hostname))
+		w->all_cnt++;
+	if (event_ua) {
+		// Any one of the ids may match
+		if (id_needle(&w->any[0], 'U', event_uid) &&
+			id_needle(&w->any[1], 'E', event_euid) &&
+			id_needle(&w->any[2], 'L', event_loginuid))
+			w->any_cnt = 3;
+	} else {
+		if (event_uid != (uid_t)-1 && id_needle(
+				&w->all[w->all_cnt], 'U', event_uid))
+			w->all_cnt++;
+		if (event_euid != (uid_t)-1 && id_needle(
+				&w->all[w->all_cnt], 'E', event_euid))
+			w->all_cnt++;
+		if (event_loginuid != (uid_t)-2 && id_needle(
+				&w->all[w->all_cnt], 'L', event_loginuid))
+			w->all_cnt++;
+	}
+	if (w->all_cnt == 0 && w->any_cnt == 0 && w->start == 0 &&
+			w->end == 0)
+		search.unfiltered = 1;
+}
+
+static int needle_in(const struct needle *n, unsigned int b)
+{
+	unsigned int i;
+
+	for (i = 0; i < n->cnt; i++)
+		if (!bloom_has(idx.bloom[b], idx.blk[b].shift, n->hash[i]))
+			return 0;
+	return 1;
+}
+
+static int wanted_in(const struct wanted *w, unsigned int b)
+{
+	const struct index_block *blk = &idx.blk[b];
+	unsigned int i;
+
+	if (w->start && blk->last_sec < w->start)
+		return 0;
+	if (w->end && blk->first_sec > w->end)
+		return 0;
+	if (blk->flags & BLOCK_NO_FILTER)
+		return 1;
+	for (i = 0; i < w->all_cnt; i++)
+		if (!needle_in(&w->all[i], b))
+			return 0;
+	if (w->any_cnt == 0)
+		return 1;
+	for (i = 0; i < w->any_cnt; i++)
+		if (needle_in(&w->any[i], b))
+			return 1;
+	return 0;
+}
+
+static int block_may_match(unsigned int b)
+{
+	unsigned int i;
+
+	for (i = 0; i < search.cnt; i++)
+		if (wanted_in(&search.w[i], b))
+			return 1;
+	return 0;
+}
+
+/* Moves f to the first block from cur on that might match */
+static void next_block(FILE *f)
+{
+	while (idx.cur < idx.h.blocks && !block_may_match(idx.cur))
+		idx.cur++;
+	if (idx.cur < idx.h.blocks) {
+		if (idx.blk[idx.cur].start != idx.pos) {
+			idx.pos = idx.blk[idx.cur].start;
+			fseeko(f, idx.pos, SEEK_SET);
+		}
+	} else if (idx.pos != idx.h.size) {
+		idx.pos = idx.h.size;
+		fseeko(f, 0, SEEK_END);
+	}
+}
+
+static int load_index(const char *filename, const struct stat *st)
+{
+	char path[MAXPATHLEN];
+	struct index_header want;
+	uint64_t len = 0, prev = 0;
+	unsigned int i;
+	FILE *f;
+
+	if (index_name(path, sizeof(path), filename, st->st_ino))
+		return -1;
+	f = fopen(path, "rm");
+	if (f == NULL)
+		return -1;
+	fill_header(&want, st);
+	if (fread(&idx.h, sizeof(idx.h), 1, f) != 1 ||
+			memcmp(&idx.h, &want,
+				offsetof(struct index_header, blocks)) ||
+			idx.h.blocks == 0 || idx.h.blocks > 10000000)
+		goto bad;
+	idx.blk = malloc(idx.h.blocks * sizeof(struct index_block));
+	idx.bloom = malloc(idx.h.blocks * sizeof(unsigned char *));
+	if (idx.blk == NULL || idx.bloom == NULL ||
+			fread(idx.blk, sizeof(struct index_block),
+				idx.h.blocks, f) != idx.h.blocks)
+		goto bad;
+	for (i = 0; i < idx.h.blocks; i++) {
+		const struct index_block *b = &idx.blk[i];
+
+		if (b->start != prev || b->end < b->start ||
+				b->shift < MIN_SHIFT || b->shift > MAX_SHIFT)
+			goto bad;
+		prev = b->end;
+		len += (1U << b->shift) / 8;
+	}
+	if (prev != idx.h.size)
+		goto bad;
+	idx.data = malloc(len);
+	if (idx.data == NULL || fread(idx.data, len, 1, f) != 1)
+		goto bad;
+	len = 0;
+	for (i = 0; i < idx.h.blocks; i++) {
+		idx.bloom[i] = idx.data + len;
+		len += (1U << idx.blk[i].shift) / 8;
+	}
+	fclose(f);
+	return 0;
+bad:
+	fclose(f);
+	free(idx.blk);
+	free(idx.bloom);
+	free(idx.data);
+	idx.blk = NULL;
+	idx.bloom = NULL;
+	idx.data = NULL;
+	return -1;
+}
+
+void index_open(const char *filename, FILE *f)
+{
+	struct stat st;
+
+	idx.active = 0;
+	if (!search.ready) {
+		if (search.cnt == 0)
+			index_add_search();
+		search.ready = 1;
+	}
+	if (search.unfiltered)
+		return;
+	if (fstat(fileno(f), &st) || !S_ISREG(st.st_mode))
+		return;
+	if (load_index(filename, &st))
+		return;
+	idx.active = 1;
+	idx.cur = 0;
+	idx.pos = 0;
+	next_block(f);
+}
+
+void index_skip(FILE *f, const char *line)
+{
+	if (!idx.active)
+		return;
+	idx.pos += strlen(line);
+	if (idx.cur < idx.h.blocks && idx.pos >= idx.blk[idx.cur].end) {
+		idx.cur++;
+		next_block(f);
+	}
+}
+
+void index_close(void)
+{
+	if (!idx.active)
+		return;
+	free(idx.blk);
+	free(idx.bloom);
+	free(idx.data);
+	idx.blk = NULL;
+	idx.bloom = NULL;
+	idx.data = NULL;
+	idx.active = 0;
+}
+
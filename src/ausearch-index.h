@@ -0,0 +1,51 @@
+/*
+* ausearch-index.h - Header file for ausearch-index.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUSEARCH_INDEX_HEADER
+#define AUSEARCH_INDEX_HEADER
+
+#include "config.h"
+#include <stdio.h>
+
+/* Directory next to the logs that holds the indexes */
+#define INDEX_DIR "ausearch.index"
+
+/* Writes the index of a log. Returns 0 on success. */
+int index_build(const char *filename);
+/* Removes the indexes of logs that index_build() was not called on */
+void index_prune(const char *log_file);
+
+/* Adds the search the options describe to the ones that blocks are
+ * checked against. Without a call, the options at the first index_open()
+ * are used. */
+void index_add_search(void);
+/* Loads the index of a log that was just opened as f, if it has a usable
+ * one, and moves f to the first block that might hold a match. */
+void index_open(const char *filename, FILE *f);
+/* Called with each line read from f. When the end of a block is reached,
+ * f is moved past the blocks that can't match. */
+void index_skip(FILE *f, const char *line);
+void index_close(void);
+
+#endif
+
@@ -164,6 +164,15 @@ void list_clear(llist* l)
 	free((char *)l->e.node);
 	l->e.node = NULL;
 	l->e.type = 0;         
+	list_clear_items(l);
+}
+
+/*
+ * Frees the searchable items that were parsed out of the records so that
+ * the event can be parsed again.
+ */
+void list_clear_items(llist *l)
+{
 	l->s.gid = -1;
 	l->s.egid = -1;
 	l->s.ppid = -1;
@@ -101,6 +101,7 @@ lnode *list_prev(llist *l);
 static inline lnode *list_get_cur(llist *l) { return l->cur; }
 void list_append(llist *l, lnode *node);
 void list_clear(llist* l);
+void list_clear_items(llist *l);
 int list_get_event(llist* l, event *e);
 
 /* Given a numeric index, find that record. */
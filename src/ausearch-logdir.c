@@ -0,0 +1,116 @@
+/*
+* ausearch-logdir.c - files kept in a directory next to the logs
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * ausearch indexes and aureport rollups are both kept in a directory next
+ * to the rotated logs, named after the inode of the log they describe.
+ * A log that is rotated keeps its inode, so the files follow it along.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/param.h>
+#include "ausearch-logdir.h"
+
+int logdir_path(char *path, size_t size, const char *log_file,
+		const char *subdir, const char *name)
+{
+	const char *slash = strrchr(log_file, '/');
+	int dlen, len;
+
+	// The directory is everything before the last slash
+	if (slash == NULL) {
+		log_file = ".";
+		dlen = 1;
+	} else if (slash == log_file)
+		dlen = 0;
+	else
+		dlen = slash - log_file;
+	if (name)
+		len = snprintf(path, size, "%.*s/%s/%s", dlen, log_file,
+				subdir, name);
+	else
+		len = snprintf(path, size, "%.*s/%s", dlen, log_file, subdir);
+	if (len < 0 || (size_t)len >= size)
+		return -1;
+	return 0;
+}
+
+void logdir_remember(inode_list *l, unsigned long long ino)
+{
+	pthread_mutex_lock(&l->lock);
+	if (l->cnt == l->size) {
+		unsigned int size = l->size ? l->size * 2 : 32;
+		unsigned long long *tmp;
+
+		tmp = realloc(l->ino, size * sizeof(unsigned long long));
+		if (tmp == NULL) {
+			pthread_mutex_unlock(&l->lock);
+			return;
+		}
+		l->ino = tmp;
+		l->size = size;
+	}
+	l->ino[l->cnt++] = ino;
+	pthread_mutex_unlock(&l->lock);
+}
+
+void logdir_prune(inode_list *l, const char *log_file, const char *subdir)
+{
+	char dir[MAXPATHLEN], path[MAXPATHLEN];
+	struct dirent *ent;
+	DIR *d = NULL;
+
+	if (logdir_path(dir, sizeof(dir), log_file, subdir, NULL) == 0)
+		d = opendir(dir);
+	if (d) {
+		while ((ent = readdir(d))) {
+			unsigned long long ino;
+			unsigned int i;
+			char *end;
+
+			if (ent->d_name[0] == '.')
+				continue;
+			// Leave alone what we didn't name, like temp files
+			ino = strtoull(ent->d_name, &end, 10);
+			if (end == ent->d_name || (*end && *end != '-'))
+				continue;
+			for (i = 0; i < l->cnt; i++)
+				if (l->ino[i] == ino)
+					break;
+			if (i < l->cnt)
+				continue;
+			if (logdir_path(path, sizeof(path), log_file, subdir,
+					ent->d_name) == 0)
+				unlink(path);
+		}
+		closedir(d);
+	}
+	free(l->ino);
+	l->ino = NULL;
+	l->cnt = l->size = 0;
+}
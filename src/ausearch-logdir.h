@@ -0,0 +1,53 @@
+/*
+* ausearch-logdir.h - files kept in a directory next to the logs
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUSEARCH_LOGDIR_HEADER
+#define AUSEARCH_LOGDIR_HEADER
+
+#include "config.h"
+#include <stddef.h>
+#include <pthread.h>
+
+/* Inodes of the logs a run looked at. Files kept for other inodes belong
+ * to logs that are gone. */
+typedef struct {
+	unsigned long long *ino;
+	unsigned int cnt;
+	unsigned int size;
+	pthread_mutex_t lock;
+} inode_list;
+
+#define INODE_LIST_INIT { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER }
+
+/* Puts subdir/name in the directory of the log into path, or just the
+ * subdir if name is NULL. Returns 0 on success and -1 if it doesn't fit. */
+int logdir_path(char *path, size_t size, const char *log_file,
+		const char *subdir, const char *name);
+/* Notes that a log with this inode is still there. Thread safe. */
+void logdir_remember(inode_list *l, unsigned long long ino);
+/* Removes the files in subdir next to log_file whose names don't start
+ * with a remembered inode, and then forgets the inodes. */
+void logdir_prune(inode_list *l, const char *log_file, const char *subdir);
+
+#endif
+
@@ -29,7 +29,6 @@
 #include "ausearch-common.h"
 
 #define ARRAY_LIMIT 80
-static int ready = 0;
 
 void lol_create(lol *lo)
 {
@@ -37,6 +36,9 @@ void lol_create(lol *lo)
 
 	lo->maxi = -1;
 	lo->limit = ARRAY_LIMIT;
+	lo->ready = 0;
+	lo->all_times = 0;
+	lo->seq = 0;
 	lo->array = (lolnode *)malloc(size);
 	memset(lo->array, 0, size);
 }
@@ -54,6 +56,7 @@ void lol_clear(lol *lo)
 	free(lo->array);
 	lo->array = NULL;
 	lo->maxi = -1;
+	lo->ready = 0;
 }
 
 static void lol_append(lol *lo, llist *l)
@@ -67,6 +70,7 @@ static void lol_append(lol *lo, llist *l)
 		if (cur->status == L_EMPTY) {
 			cur->l = l;
 			cur->status = L_BUILDING;
+			cur->seq = lo->seq++;
 			if (i > lo->maxi)
 				lo->maxi = i;
 			return;
@@ -80,6 +84,7 @@ static void lol_append(lol *lo, llist *l)
 		memset(&lo->array[lo->limit], 0, sizeof(lolnode) * ARRAY_LIMIT);
 		lo->array[i].l = l;
 		lo->array[i].status = L_BUILDING;
+		lo->array[i].seq = lo->seq++;
 		lo->maxi = i;
 		lo->limit += ARRAY_LIMIT;
 	}
@@ -128,21 +133,21 @@ static int inline events_are_equal(event *e1, event *e2)
 /*
  * This function will look at the line and pick out pieces of it.
  */
-static int extract_timestamp(const char *b, event *e)
+static int extract_timestamp(const char *b, event *e, int all_times)
 {
-	char *ptr, *tmp, *tnode, *ttype;
+	char *ptr, *tmp, *tnode, *ttype, *saved;
 
 	e->node = NULL;
 	if (*b == 'n')
 		tmp = strndupa(b, 340);
 	else
 		tmp = strndupa(b, 80);
-	ptr = strtok(tmp, " ");
+	ptr = strtok_r(tmp, " ", &saved);
 	if (ptr) {
 		// Check to see if this is the node info
 		if (*ptr == 'n') {
 			tnode = ptr+5;
-			ptr = strtok(NULL, " ");
+			ptr = strtok_r(NULL, " ", &saved);
 		} else
 			tnode = NULL;
 
@@ -150,7 +155,7 @@ static int extract_timestamp(const char *b, event *e)
 		ttype = ptr+5;
 
 		// Now should be pointing to msg=
-		ptr = strtok(NULL, " ");
+		ptr = strtok_r(NULL, " ", &saved);
 		if (ptr) {
 			if (*(ptr+9) == '(')
 				ptr+=9;
@@ -168,8 +173,9 @@ static int extract_timestamp(const char *b, event *e)
 					  "Error extracting time stamp (%s)\n",
 						ptr);
 					return 0;
-				} else if ((start_time && e->sec < start_time)
-					|| (end_time && e->sec > end_time))
+				} else if (!all_times &&
+					((start_time && e->sec < start_time)
+					|| (end_time && e->sec > end_time)))
 					return 0;
 				else {
 					if (tnode)
@@ -186,6 +192,12 @@ static int extract_timestamp(const char *b, event *e)
 	return 0;
 }
 
+// This function tells if a record of this type is always a whole event
+static int inline stands_alone(int type)
+{
+	return type < AUDIT_FIRST_EVENT || type >= AUDIT_FIRST_ANOM_MSG;
+}
+
 // This function will check events to see if they are complete 
 // FIXME: Can we think of other ways to determine if the event is done?
 static void check_events(lol *lo, time_t sec)
@@ -198,12 +210,11 @@ static void check_events(lol *lo, time_t sec)
 			// If 2 seconds have elapsed, we are done
 			if (cur->l->e.sec + 2 < sec) { 
 				cur->status = L_COMPLETE;
-				ready++;
-			} else if (cur->l->e.type < AUDIT_FIRST_EVENT ||
-				    cur->l->e.type >= AUDIT_FIRST_ANOM_MSG) {
+				lo->ready++;
+			} else if (stands_alone(cur->l->e.type)) {
 				// If known to be 1 record event, we are done
 				cur->status = L_COMPLETE;
-				ready++;
+				lo->ready++;
 			} 
 		}
 	}
@@ -220,7 +231,7 @@ int lol_add_record(lol *lo, char *buff)
 	llist *l;
 
 	// Short circuit if event is not of interest
-	if (extract_timestamp(buff, &e) == 0)
+	if (extract_timestamp(buff, &e, lo->all_times) == 0)
 		return 0;
 
 	ptr = strrchr(buff, 0x0a);
@@ -263,30 +274,265 @@ void terminate_all_events(lol *lo)
 		lolnode *cur = &lo->array[i];
 		if (cur->status == L_BUILDING) {
 			cur->status = L_COMPLETE;
-			ready++;
+			lo->ready++;
 		}
 	}
 //printf("maxi = %d\n",lo->maxi);
 }
 
-/* Search the list for any event that is ready to go. The caller
- * takes custody of the memory */
+/* Finds the open event started next after prev, or the first if prev
+ * is NULL */
+static lolnode *next_building(lol *lo, const lolnode *prev)
+{
+	int i;
+	lolnode *next = NULL;
+
+	for (i=0; i<=lo->maxi; i++) {
+		lolnode *cur = &lo->array[i];
+		if (cur->status != L_BUILDING)
+			continue;
+		if (prev && cur->seq <= prev->seq)
+			continue;
+		if (next == NULL || cur->seq < next->seq)
+			next = cur;
+	}
+	return next;
+}
+
+/* This function returns 1 if both lists have the same events open and
+ * nothing ready. Fed the same records from then on, they hand out the
+ * same events. */
+int lol_same(lol *a, lol *b)
+{
+	lolnode *na = NULL, *nb = NULL;
+
+	if (a->ready || b->ready)
+		return 0;
+	while (1) {
+		na = next_building(a, na);
+		nb = next_building(b, nb);
+		if (na == NULL || nb == NULL)
+			return na == nb;
+		if (!events_are_equal(&na->l->e, &nb->l->e) ||
+				na->l->cnt != nb->l->cnt)
+			return 0;
+	}
+}
+
+/* This function finds the earliest and latest second of the events still
+ * open. It returns 0 if there are none. */
+int lol_open_times(lol *lo, time_t *first, time_t *last)
+{
+	int i, found = 0;
+
+	for (i=0; i<=lo->maxi; i++) {
+		lolnode *cur = &lo->array[i];
+		if (cur->status != L_BUILDING)
+			continue;
+		if (!found || cur->l->e.sec < *first)
+			*first = cur->l->e.sec;
+		if (!found || cur->l->e.sec > *last)
+			*last = cur->l->e.sec;
+		found = 1;
+	}
+	return found;
+}
+
+/* Search the list for any event that is ready to go. Of those that are,
+ * the one started first goes first so the output doesn't depend on where
+ * events landed in the array. The caller takes custody of the memory */
 llist* get_ready_event(lol *lo)
 {
 	int i;
+	lolnode *first = NULL;
 
-	if (ready == 0)
+	if (lo->ready == 0)
 		return NULL;
 
 	for (i=0; i<=lo->maxi; i++) {
 		lolnode *cur = &lo->array[i];
-		if (cur->status == L_COMPLETE) {
-			cur->status = L_EMPTY;
-			ready--;
-			return cur->l;
+		if (cur->status == L_COMPLETE &&
+				(first == NULL || cur->seq < first->seq))
+			first = cur;
+	}
+	if (first == NULL)
+		return NULL;
+
+	first->status = L_EMPTY;
+	lo->ready--;
+	return first->l;
+}
+
+
+void rlol_create(rlol *r)
+{
+	r->array = NULL;
+	r->cnt = 0;
+	r->limit = 0;
+	r->sec = 0;
+	lol_create(&r->done);
+	r->done.all_times = 1;	// The times were checked when read
+}
+
+static void rlolnode_clear(rlolnode *n)
+{
+	int i;
+
+	for (i = 0; i < n->cnt; i++)
+		free(n->records[i]);
+	free(n->records);
+	free(n->flags);
+	free((char *)n->e.node);
+}
+
+void rlol_clear(rlol *r)
+{
+	int i;
+
+	for (i = 0; i < r->cnt; i++)
+		rlolnode_clear(&r->array[i]);
+	free(r->array);
+	r->array = NULL;
+	r->cnt = 0;
+	r->limit = 0;
+	lol_clear(&r->done);
+}
+
+#define REC_START	4	// Begins a piece of the event, set when finishing
+
+// This function puts the records of a finished event back in order by
+// adding them to the done lol oldest first. A forward read splits an
+// event where it ended it before all its records were read, so those
+// pieces are found first and go out newest first like the events do.
+static void rlol_finish(rlol *r, int i)
+{
+	rlolnode *n = &r->array[i];
+	int j, k, start, end;
+
+	start = n->cnt - 1;
+	n->flags[start] |= REC_START;
+	for (j = start - 1; j >= 0; j--) {
+		if ((n->flags[j+1] & REC_CUT) ||
+				(n->flags[start] & REC_ALONE)) {
+			start = j;
+			n->flags[start] |= REC_START;
+		}
+	}
+	for (end = 0, j = 0; j < n->cnt; j++) {
+		if ((n->flags[j] & REC_START) == 0)
+			continue;
+		for (k = j; k >= end; k--)
+			lol_add_record(&r->done, n->records[k]);
+		terminate_all_events(&r->done);
+		end = j + 1;
+	}
+	rlolnode_clear(n);
+	r->cnt--;
+	memmove(&r->array[i], &r->array[i+1],
+		(r->cnt - i) * sizeof(rlolnode));
+}
+
+// This function adds a record to the event it belongs to, which is
+// usually the one seen last, or starts a new one
+int rlol_add_record(rlol *r, const char *buff)
+{
+	int i, wanted;
+	event e;
+	char *rec;
+	rlolnode *n;
+
+	if (extract_timestamp(buff, &e, 1) == 0)
+		return 0;
+
+	wanted = !((start_time && e.sec < start_time) ||
+			(end_time && e.sec > end_time));
+	r->sec = e.sec;
+	for (i = 0; i < r->cnt; ) {
+		n = &r->array[i];
+		// A record more than 2 seconds older than an event may have
+		// come late, so the event is done after a run of them
+		if (n->e.sec > e.sec + 2) {
+			if (++n->old > OLD_RECORDS) {
+				rlol_finish(r, i);
+				continue;
+			}
+		} else
+			n->old = 0;
+		// Read forward, this record would end events more than 2
+		// seconds older, so their records before it are apart
+		if (wanted && e.sec > n->e.sec + 2)
+			n->cut = 1;
+		i++;
+	}
+
+	// Short circuit if the record is not of interest
+	if (!wanted) {
+		free((char *)e.node);
+		return 0;
+	}
+
+	rec = strdup(buff);
+	if (rec == NULL) {
+		free((char *)e.node);
+		return 0;
+	}
+	for (i = r->cnt - 1; i >= 0; i--) {
+		if (events_are_equal(&r->array[i].e, &e))
+			break;
+	}
+	if (i >= 0) {
+		free((char *)e.node);
+		n = &r->array[i];
+	} else {
+		if (r->cnt == r->limit) {
+			n = realloc(r->array,
+				(r->limit + ARRAY_LIMIT) * sizeof(rlolnode));
+			if (n == NULL) {
+				free((char *)e.node);
+				free(rec);
+				return 0;
+			}
+			r->array = n;
+			r->limit += ARRAY_LIMIT;
+		}
+		n = &r->array[r->cnt++];
+		memset(n, 0, sizeof(rlolnode));
+		n->e = e;
+	}
+	if (n->cnt == n->limit) {
+		char **tmp = realloc(n->records,
+				(n->limit + 8) * sizeof(char *));
+		unsigned char *ftmp;
+
+		if (tmp == NULL) {
+			free(rec);
+			return 0;
 		}
+		n->records = tmp;
+		ftmp = realloc(n->flags, n->limit + 8);
+		if (ftmp == NULL) {
+			free(rec);
+			return 0;
+		}
+		n->flags = ftmp;
+		n->limit += 8;
 	}
+	n->flags[n->cnt] = stands_alone(e.type) ? REC_ALONE : 0;
+	if (n->cut)
+		n->flags[n->cnt] |= REC_CUT;
+	n->cut = 0;
+	n->records[n->cnt++] = rec;
+	return 1;
+}
 
-	return NULL;
+// This function will mark all events as "done"
+void rlol_terminate_all_events(rlol *r)
+{
+	while (r->cnt)
+		rlol_finish(r, 0);
 }
 
+llist *rlol_get_ready_event(rlol *r)
+{
+	return get_ready_event(&r->done);
+}
@@ -34,6 +34,7 @@ typedef enum { L_EMPTY, L_BUILDING, L_COMPLETE } lol_t;
 typedef struct _lolnode{
   llist *l;			// The linked list
   int status;			// 0 = empty, 1 in use, 2 complete
+  unsigned long seq;		// Order the event was started in
 } lolnode;
 
 /* This is the linked list head. Only data elements that are 1 per
@@ -42,6 +43,9 @@ typedef struct {
   lolnode *array;
   int maxi;		// Largest index used
   int limit;		// Number of nodes in the array
+  int ready;		// Number of complete events
+  int all_times;	// Keep records outside of the -ts/-te times
+  unsigned long seq;	// Number for the next new event
 } lol;
 
 void lol_create(lol *lo);
@@ -49,6 +53,46 @@ void lol_clear(lol *lo);
 int lol_add_record(lol *lo, char *buff);
 void terminate_all_events(lol *lo);
 llist* get_ready_event(lol *lo);
+int lol_same(lol *a, lol *b);
+int lol_open_times(lol *lo, time_t *first, time_t *last);
+
+/* An event whose records are being read from the end of the logs back */
+typedef struct _rlolnode{
+  event e;		// Time stamp, serial, and node of the event
+  char **records;	// Its records, newest first
+  unsigned char *flags;	// REC_ flags of each record
+  int cnt;		// Number of records
+  int limit;		// Size of the records and flags arrays
+  int cut;		// A record that ends it was read since the last one
+  int old;		// Records more than 2 seconds older read in a row
+} rlolnode;
+
+#define REC_ALONE	1	// Its type is an event of its own
+#define REC_CUT		2	// A forward read ends the event after it
+
+/* Records more than 2 seconds older read in a row that show no more of
+ * an event will come, as some of them may have come late */
+#define OLD_RECORDS	8
+
+/* Events assembled from records read in reverse. Finished events go
+ * through a lol to be put back in order. */
+typedef struct {
+  rlolnode *array;	// Events still being read, newest first
+  int cnt;		// Number of events in the array
+  int limit;		// Size of the array
+  time_t sec;		// Time of the last record added
+  lol done;		// Finished events
+} rlol;
+
+void rlol_create(rlol *r);
+void rlol_clear(rlol *r);
+/* Adds the record before the ones added so far. Returns 1 if it was
+ * kept, 0 if it was not of interest. */
+int rlol_add_record(rlol *r, const char *buff);
+void rlol_terminate_all_events(rlol *r);
+/* Returns the finished events, newest first. The caller takes custody
+ * of the memory. */
+llist *rlol_get_ready_event(rlol *r);
 
 #endif
 
@@ -27,6 +27,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <linux/net.h>
+#include <pthread.h>
 #include "ausearch-lookup.h"
 #include "ausearch-options.h"
 #include "ausearch-nvpair.h"
@@ -181,6 +182,7 @@ static const char *aulookup_ipccall(long ic)
 
 static nvlist uid_nvl;
 static int uid_list_created=0;
+static pthread_mutex_t uid_lock = PTHREAD_MUTEX_INITIALIZER;
 const char *aulookup_uid(uid_t uid, char *buf, size_t size)
 {
 	char *name = NULL;
@@ -195,7 +197,8 @@ const char *aulookup_uid(uid_t uid, char *buf, size_t size)
 		return buf;
 	}
 
-	// Check the cache first
+	// Check the cache first, aureport may have several threads in here
+	pthread_mutex_lock(&uid_lock);
 	if (uid_list_created == 0) {
 		nvlist_create(&uid_nvl);
 		nvlist_clear(&uid_nvl);
@@ -220,6 +223,7 @@ const char *aulookup_uid(uid_t uid, char *buf, size_t size)
 		snprintf(buf, size, "%s", name);
 	else
 		snprintf(buf, size, "unknown(%d)", uid);
+	pthread_mutex_unlock(&uid_lock);
 	return buf;
 }
 
@@ -234,6 +238,7 @@ void aulookup_destroy_uid_list(void)
 
 static nvlist gid_nvl;
 static int gid_list_created=0;
+static pthread_mutex_t gid_lock = PTHREAD_MUTEX_INITIALIZER;
 const char *aulookup_gid(gid_t gid, char *buf, size_t size)
 {
 	char *name = NULL;
@@ -249,6 +254,7 @@ const char *aulookup_gid(gid_t gid, char *buf, size_t size)
 	}
 
 	// Check the cache first
+	pthread_mutex_lock(&gid_lock);
 	if (gid_list_created == 0) {
 		nvlist_create(&gid_nvl);
 		nvlist_clear(&gid_nvl);
@@ -273,6 +279,7 @@ const char *aulookup_gid(gid_t gid, char *buf, size_t size)
 		snprintf(buf, size, "%s", name);
 	else
 		snprintf(buf, size, "unknown(%d)", gid);
+	pthread_mutex_unlock(&gid_lock);
 	return buf;
 }
 
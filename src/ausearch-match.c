@@ -28,11 +28,53 @@
 #include "libaudit.h"
 #include "ausearch-options.h"
 #include "ausearch-parse.h"
+#include "ausearch-rules.h"
 
 static int strmatch(const char *needle, const char *haystack);
 static int user_match(llist *l);
 static int group_match(llist *l);
 static int context_match(llist *l);
+int match_header(llist *l);
+int match_items(llist *l);
+
+/*
+ * This function works out which search_items fields the command line
+ * params look at, so that records which can't supply them need not be
+ * parsed at all.
+ */
+unsigned int needed_items(void)
+{
+	unsigned int need = 0;
+
+	if (event_debug)	// Report every malformed record
+		return SI_ALL;
+	if (event_ua || event_ga || event_uid != -1 || event_euid != -1 ||
+			event_loginuid != -2 || event_gid != -1 ||
+			event_egid != -1 || event_ppid != -1 ||
+			event_pid != -1 || event_session_id != -2)
+		need |= SI_IDS;
+	if (event_success != S_UNSET)
+		need |= SI_SUCCESS;
+	if (event_machine != -1 || event_syscall != -1 || event_exit_is_set)
+		need |= SI_SYSCALL;
+	if (event_filename)
+		need |= SI_FILE;
+	if (event_hostname)
+		need |= SI_HOST;
+	if (event_terminal)
+		need |= SI_TERM;
+	if (event_exe)
+		need |= SI_EXE;
+	if (event_comm)
+		need |= SI_COMM;
+	if (event_key)
+		need |= SI_KEY;
+	if (event_subject || event_object)
+		need |= SI_CONTEXT;
+	if (event_vmname || event_uuid)
+		need |= SI_VM;
+	return need;
+}
 
 /*
  * This function performs that matching of search params with the record.
@@ -40,201 +82,227 @@ static int context_match(llist *l);
  * works is that it will try to determine if there is not a match and exit
  * as soon as possible. We can do this since all command line params form
  * an 'and' statement. If anything does not match, no need to evaluate the
- * rest of the params.
+ * rest of the params. The checks that need no parsing come first, then
+ * only the records holding fields that are searched for get parsed.
  */
-#include <stdio.h>
 int match(llist *l)
 {
-	// Are we within time range?
-	if (start_time == 0 || l->e.sec >= start_time) {
-		if (end_time == 0 || l->e.sec <= end_time) {
-			if (event_id == -1 || event_id == l->e.serial) {
-				// OK - do the heavier checking
-				if (extract_search_items(l)) {
-					return 0;
-				}
+	static unsigned int need = 0;
+	static int need_set = 0;
 
-				// perform additional tests for the field
-				if (event_node_list) {
-					const snode *sn;
-					int found=0;
-					slist *sptr = event_node_list;
+	if (match_header(l) == 0)
+		return 0;
 
-					if (l->e.node == NULL)
-				  		return 0;
+	// Events the loaded rules couldn't have keyed need no parsing
+	if (kernel_rules && rules_may_match(l) == 0)
+		return 0;
 
-					slist_first(sptr);
-					sn=slist_get_cur(sptr);
-					while (sn && !found) {
-						if (sn->str &&  (!strcmp(sn->str, l->e.node)))
-							found++;
-						else
-							sn=slist_next(sptr);
-					}
-					if (!found)
-						return 0;
-				}
-				if (user_match(l) == 0)
-					return 0;
-				if (group_match(l) == 0)
-					return 0;
-				if ((event_ppid != -1) && 
-						(event_ppid != l->s.ppid))
-					return 0;
-				if ((event_pid != -1) && 
-						(event_pid != l->s.pid))
-					return 0;
-				if (event_machine != -1 && 
-						(event_machine !=
-					audit_elf_to_machine(l->s.arch)))
-					return 0;
-				if ((event_syscall != -1) && 
-					(event_syscall != l->s.syscall))
-						return 0;
-				if ((event_session_id != -2) &&
-					(event_session_id != l->s.session_id))
-					return 0;
-				if (event_exit_is_set) {
-					if (l->s.exit_is_set == 0)
-						return 0;
-					if (event_exit != l->s.exit)
-						return 0;
-				}
+	// OK - do the heavier checking
+	if (!need_set) {
+		need = needed_items();
+		need_set = 1;
+	}
+	if (extract_needed_items(l, need))
+		return 0;
+	return match_items(l);
+}
 
-				if ((event_success != S_UNSET) &&
-						(event_success != l->s.success))
-					return 0;
-				// event_type requires looking at each item
-				if (event_type != NULL) {
-					int found = 0;
-					const lnode *n;
+/*
+ * The checks that need no parsing: time, event id, node, and message
+ * type. Returns 1 if the event passes them.
+ */
+int match_header(llist *l)
+{
+	// Are we within time range?
+	if (start_time && l->e.sec < start_time)
+		return 0;
+	if (end_time && l->e.sec > end_time)
+		return 0;
+	if (event_id != -1 && event_id != l->e.serial)
+		return 0;
+	if (event_node_list) {
+		const snode *sn;
+		int found=0;
+		slist *sptr = event_node_list;
 
-					list_first(l);
-					n = list_get_cur(l);
-					do {
-						int_node *in;
-						ilist_first(event_type);
-						in = ilist_get_cur(event_type);
-						do {
-							if (in->num == n->type){
-								found = 1;
-								break;
-							}
-						} while((in = 
-						    ilist_next(event_type)));
-						if (found)
-							break;
-					} while ((n = list_next(l)));
-					if (!found)
-						return 0;
+		if (l->e.node == NULL)
+			return 0;
+
+		slist_first(sptr);
+		sn=slist_get_cur(sptr);
+		while (sn && !found) {
+			if (sn->str &&  (!strcmp(sn->str, l->e.node)))
+				found++;
+			else
+				sn=slist_next(sptr);
+		}
+		if (!found)
+			return 0;
+	}
+	// event_type requires looking at each item
+	if (event_type != NULL) {
+		int found = 0;
+		const lnode *n;
+
+		list_first(l);
+		n = list_get_cur(l);
+		do {
+			int_node *in;
+			ilist_first(event_type);
+			in = ilist_get_cur(event_type);
+			do {
+				if (in->num == n->type){
+					found = 1;
+					break;
 				}
+			} while((in = ilist_next(event_type)));
+			if (found)
+				break;
+		} while ((n = list_next(l)));
+		if (!found)
+			return 0;
+	}
+	return 1;
+}
 
-				// Done all the easy compares, now do the 
-				// string searches.
-				if (event_filename) {
-					int found = 0;
-					if (l->s.filename == NULL && l->s.cwd == NULL)
-						return 0;
-					if (l->s.filename) {
-						const snode *sn;
-						slist *sptr = l->s.filename;
+/*
+ * The checks on the fields extract_needed_items() parsed out of the
+ * event. Returns 1 on a match.
+ */
+int match_items(llist *l)
+{
+	if (user_match(l) == 0)
+		return 0;
+	if (group_match(l) == 0)
+		return 0;
+	if ((event_ppid != -1) && 
+			(event_ppid != l->s.ppid))
+		return 0;
+	if ((event_pid != -1) && 
+			(event_pid != l->s.pid))
+		return 0;
+	if (event_machine != -1 && 
+			(event_machine !=
+		audit_elf_to_machine(l->s.arch)))
+		return 0;
+	if ((event_syscall != -1) && 
+		(event_syscall != l->s.syscall))
+			return 0;
+	if ((event_session_id != -2) &&
+		(event_session_id != l->s.session_id))
+		return 0;
+	if (event_exit_is_set) {
+		if (l->s.exit_is_set == 0)
+			return 0;
+		if (event_exit != l->s.exit)
+			return 0;
+	}
 
-						slist_first(sptr);
-						sn=slist_get_cur(sptr);
-						do {
-							if (sn->str == NULL)
-								return 0;
-							if (strmatch(
-								event_filename,
-								sn->str)) {
-								found = 1;
-								break;
-							}
-						} while ((sn=slist_next(sptr)));
+	if ((event_success != S_UNSET) &&
+			(event_success != l->s.success))
+		return 0;
+	// Done all the easy compares, now do the 
+	// string searches.
+	if (event_filename) {
+		int found = 0;
+		if (l->s.filename == NULL && l->s.cwd == NULL)
+			return 0;
+		if (l->s.filename) {
+			const snode *sn;
+			slist *sptr = l->s.filename;
 
-						if (!found && l->s.cwd == NULL)
-							return 0;
-					}
-					if (l->s.cwd && !found) {
-						/* Check cwd, too */
-						if (strmatch(event_filename,
-								l->s.cwd) == 0)
-							return 0;
-					}
-				}
-				if (event_hostname) {
-					if (l->s.hostname == NULL)
-						return 0;
-					if (strmatch(event_hostname, 
-						l->s.hostname) == 0)
-						return 0; 
-				}
-				if (event_terminal) {
-					if (l->s.terminal == NULL)
-						return 0;
-					if (strmatch(event_terminal, 
-						l->s.terminal) == 0)
-						return 0; 
+			slist_first(sptr);
+			sn=slist_get_cur(sptr);
+			do {
+				if (sn->str == NULL)
+					return 0;
+				if (strmatch(
+					event_filename,
+					sn->str)) {
+					found = 1;
+					break;
 				}
-				if (event_exe) {
-					if (l->s.exe == NULL)
-						return 0;
-					if (strmatch(event_exe, 
-						l->s.exe) == 0)
-						return 0; 
-				}				
-				if (event_comm) {
-					if (l->s.comm == NULL)
-						return 0;
-					if (strmatch(event_comm, 
-						l->s.comm) == 0)
-						return 0; 
-				}				
-				if (event_key) {
-					if (l->s.key == NULL)
-						return 0;
-					else {
-						int found = 0;
-						const snode *sn;
-						slist *sptr = l->s.key;
+			} while ((sn=slist_next(sptr)));
 
-						slist_first(sptr);
-						sn=slist_get_cur(sptr);
-						do {
-							if (sn->str == NULL)
-								return 0;
-							if (strmatch(
-								event_key,
-								sn->str)) {
-								found = 1;
-								break;
-							}
-						} while ((sn=slist_next(sptr)));
-						if (!found)
-							return 0;
-					}
-				}				
-				if (event_vmname) {
-					if (l->s.vmname == NULL)
-						return 0;
-					if (strmatch(event_vmname,
-							l->s.vmname) == 0)
-						return 0;
-				}
-				if (event_uuid) {
-					if (l->s.uuid == NULL)
-						return 0;
-					if (strmatch(event_uuid,
-							l->s.uuid) == 0)
-						return 0;
-				}
-				if (context_match(l) == 0)
+			if (!found && l->s.cwd == NULL)
+				return 0;
+		}
+		if (l->s.cwd && !found) {
+			/* Check cwd, too */
+			if (strmatch(event_filename,
+					l->s.cwd) == 0)
+				return 0;
+		}
+	}
+	if (event_hostname) {
+		if (l->s.hostname == NULL)
+			return 0;
+		if (strmatch(event_hostname, 
+			l->s.hostname) == 0)
+			return 0; 
+	}
+	if (event_terminal) {
+		if (l->s.terminal == NULL)
+			return 0;
+		if (strmatch(event_terminal, 
+			l->s.terminal) == 0)
+			return 0; 
+	}
+	if (event_exe) {
+		if (l->s.exe == NULL)
+			return 0;
+		if (strmatch(event_exe, 
+			l->s.exe) == 0)
+			return 0; 
+	}				
+	if (event_comm) {
+		if (l->s.comm == NULL)
+			return 0;
+		if (strmatch(event_comm, 
+			l->s.comm) == 0)
+			return 0; 
+	}				
+	if (event_key) {
+		if (l->s.key == NULL)
+			return 0;
+		else {
+			int found = 0;
+			const snode *sn;
+			slist *sptr = l->s.key;
+
+			slist_first(sptr);
+			sn=slist_get_cur(sptr);
+			do {
+				if (sn->str == NULL)
 					return 0;
-				return 1;
-			}
+				if (strmatch(
+					event_key,
+					sn->str)) {
+					found = 1;
+					break;
+				}
+			} while ((sn=slist_next(sptr)));
+			if (!found)
+				return 0;
 		}
+	}				
+	if (event_vmname) {
+		if (l->s.vmname == NULL)
+			return 0;
+		if (strmatch(event_vmname,
+				l->s.vmname) == 0)
+			return 0;
 	}
-	return 0;
+	if (event_uuid) {
+		if (l->s.uuid == NULL)
+			return 0;
+		if (strmatch(event_uuid,
+				l->s.uuid) == 0)
+			return 0;
+	}
+	if (context_match(l) == 0)
+		return 0;
+	return 1;
 }
 
 /*
@@ -52,11 +52,14 @@ uid_t event_uid = -1, event_euid = -1, event_loginuid = -2;
 int event_syscall = -1, event_machine = -1;
 int event_ua = 0, event_ga = 0, event_se = 0;
 int just_one = 0;
+unsigned long last_events = 0;
 uint32_t event_session_id = -2;
 long long event_exit = 0;
 int event_exit_is_set = 0;
 int line_buffered = 0;
 int event_debug = 0;
+int build_index = 0;
+int kernel_rules = 0;
 int checkpt_timeonly = 0;
 const char *event_key = NULL;
 const char *event_filename = NULL;
@@ -69,6 +72,8 @@ const char *event_object = NULL;
 const char *event_uuid = NULL;
 const char *event_vmname = NULL;
 const char *checkpt_filename = NULL;	/* checkpoint filename if present */
+const char *columnar_filename = NULL;	/* columnar output file if present */
+const char *query_filename = NULL;	/* query file if present */
 report_t report_format = RPT_DEFAULT;
 ilist *event_type;
 
@@ -85,15 +90,18 @@ S_HOSTNAME, S_INTERP, S_INFILE, S_MESSAGE_TYPE, S_PID, S_SYSCALL, S_OSUCCESS,
 S_TIME_END, S_TIME_START, S_TERMINAL, S_ALL_UID, S_EFF_UID, S_UID, S_LOGINID,
 S_VERSION, S_EXACT_MATCH, S_EXECUTABLE, S_CONTEXT, S_SUBJECT, S_OBJECT,
 S_PPID, S_KEY, S_RAW, S_NODE, S_IN_LOGS, S_JUST_ONE, S_SESSION, S_EXIT,
-S_LINEBUFFERED, S_UUID, S_VMNAME, S_DEBUG, S_CHECKPOINT, S_ARCH };
+S_LINEBUFFERED, S_UUID, S_VMNAME, S_DEBUG, S_CHECKPOINT, S_ARCH, S_COLUMNAR,
+S_BUILD_INDEX, S_QUERIES, S_KERNEL_RULES, S_LAST };
 
 static struct nv_pair optiontab[] = {
 	{ S_EVENT, "-a" },
 	{ S_ARCH, "--arch" },
 	{ S_EVENT, "--event" },
+	{ S_BUILD_INDEX, "--build-index" },
 	{ S_COMM, "-c" },
 	{ S_COMM, "--comm" },
 	{ S_CHECKPOINT, "--checkpoint" },
+	{ S_COLUMNAR, "--columnar" },
 	{ S_DEBUG, "--debug" },
 	{ S_EXIT, "-e" },
 	{ S_EXIT, "--exit" },
@@ -115,8 +123,10 @@ static struct nv_pair optiontab[] = {
 	{ S_INFILE, "--input" },
 	{ S_IN_LOGS, "--input-logs" },
 	{ S_JUST_ONE, "--just-one" },
+	{ S_KERNEL_RULES, "--kernel-rules" },
 	{ S_KEY, "-k" },
 	{ S_KEY, "--key" },
+	{ S_LAST, "--last" },
 	{ S_LINEBUFFERED, "-l" },
 	{ S_LINEBUFFERED, "--line-buffered" },
 	{ S_MESSAGE_TYPE, "-m" },
@@ -129,6 +139,7 @@ static struct nv_pair optiontab[] = {
 	{ S_PID, "--pid" },
 	{ S_PPID, "-pp" },
 	{ S_PPID, "--ppid" },
+	{ S_QUERIES, "--queries" },
 	{ S_RAW, "-r" },
 	{ S_RAW, "--raw" },
 	{ S_SYSCALL, "-sc" },
@@ -183,8 +194,10 @@ static void usage(void)
 	printf("usage: ausearch [options]\n"
 	"\t-a,--event <Audit event id>\tsearch based on audit event id\n"
 	"\t--arch <CPU>\t\t\tsearch based on the CPU architecture\n"
+	"\t--build-index\t\t\tindex the rotated logs to speed up searches\n"
 	"\t-c,--comm  <Comm name>\t\tsearch based on command line name\n"
 	"\t--checkpoint <checkpoint file>\tsearch from last complete event\n"
+	"\t--columnar <output file>\twrite matches in the columnar format\n"
 	"\t--debug\t\t\tWrite malformed events that are skipped to stderr\n"
 	"\t-e,--exit  <Exit code or errno>\tsearch based on syscall exit code\n"
 	"\t-f,--file  <File name>\t\tsearch based on file name\n"
@@ -197,13 +210,16 @@ static void usage(void)
 	"\t-if,--input <Input File name>\tuse this file instead of current logs\n"
 	"\t--input-logs\t\t\tUse the logs even if stdin is a pipe\n"
 	"\t--just-one\t\t\tEmit just one event\n"
+	"\t--kernel-rules\t\t\tskip events the loaded rules didn't key\n"
 	"\t-k,--key  <key string>\t\tsearch based on key field\n"
+	"\t--last <number>\t\t\tEmit just the last number of events\n"
 	"\t-l, --line-buffered\t\tFlush output on every line\n"
 	"\t-m,--message  <Message type>\tsearch based on message type\n"
 	"\t-n,--node  <Node name>\t\tsearch based on machine's name\n"
 	"\t-o,--object  <SE Linux Object context> search based on context of object\n"
 	"\t-p,--pid  <Process id>\t\tsearch based on process id\n"
 	"\t-pp,--ppid <Parent Process id>\tsearch based on parent process id\n"
+	"\t--queries <query file>\t\trun each search in the file in one pass\n"
 	"\t-r,--raw\t\t\toutput is completely unformatted\n"
 	"\t-sc,--syscall <SysCall name>\tsearch based on syscall name or number\n"
 	"\t-se,--context <SE Linux context> search based on either subject or\n\t\t\t\t\t object\n"
@@ -1116,9 +1132,40 @@ int check_params(int count, char *vars[])
 		case S_LINEBUFFERED:
 			line_buffered = 1;
 			break;
+		case S_LAST:
+			if (!optarg) {
+				fprintf(stderr, 
+					"Argument is required for %s\n",
+					vars[c]);
+				retval = -1;
+				break;
+			}
+			if (isdigit(optarg[0])) {
+				errno = 0;
+				last_events = strtoul(optarg, NULL, 10);
+				if (errno || last_events == 0) {
+					fprintf(stderr,
+				"Number of events must be at least 1, was %s\n",
+						optarg);
+					retval = -1;
+				}
+				c++;
+			} else {
+				fprintf(stderr, 
+			"Number of events must be a numeric value, was %s\n",
+					optarg);
+				retval = -1;
+			}
+			break;
 		case S_DEBUG:
 			event_debug = 1;
 			break;
+		case S_BUILD_INDEX:
+			build_index = 1;
+			break;
+		case S_KERNEL_RULES:
+			kernel_rules = 1;
+			break;
 		case S_CHECKPOINT:
 			if (!optarg) {
 				fprintf(stderr, 
@@ -1132,6 +1179,39 @@ int check_params(int count, char *vars[])
 				c++;
 			}
 			break;
+		case S_COLUMNAR:
+			if (!optarg) {
+				fprintf(stderr, 
+					"Argument is required for %s\n",
+					vars[c]);
+				retval = -1;
+				break;
+			}
+			if (report_format == RPT_DEFAULT)
+				report_format = RPT_COLUMNAR;
+			else {
+				fprintf(stderr, 
+				    "Conflicting output format --columnar\n");
+				retval = -1;
+			}
+			columnar_filename = strdup(optarg);
+			if (columnar_filename == NULL)
+				retval = -1;
+			c++;
+			break;
+		case S_QUERIES:
+			if (!optarg) {
+				fprintf(stderr, 
+					"Argument is required for %s\n",
+					vars[c]);
+				retval = -1;
+			} else {
+				query_filename = strdup(optarg);
+				if (query_filename == NULL)
+					retval = -1;
+				c++;
+			}
+			break;
 		case S_ARCH:
 			if (!optarg) {
 				fprintf(stderr, 
@@ -36,14 +36,19 @@ extern const char *event_subject;
 extern const char *event_object;
 extern int event_se;
 extern int just_one;
+extern unsigned long last_events;
 extern int line_buffered;
 extern int event_debug;
+extern int build_index;
+extern int kernel_rules;
 extern pid_t event_ppid;
 extern uint32_t event_session_id;
 extern ilist *event_type;
 
 /* Data type to govern output format */
 extern report_t report_format;
+extern const char *columnar_filename;
+extern const char *query_filename;
 
 /* Function to process commandline options */
 extern int check_params(int count, char *vars[]);
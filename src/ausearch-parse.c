@@ -72,19 +72,60 @@ static int audit_avc_init(search_items *s)
 	return 0;
 }
 
+/*
+ * This function returns which groups of search_items fields the parser
+ * for a record type can fill in.
+ */
+static unsigned int record_items(int type)
+{
+	switch (type) {
+		case AUDIT_SYSCALL:
+			return SI_IDS|SI_SUCCESS|SI_SYSCALL|SI_TERM|SI_EXE|
+				SI_COMM|SI_KEY|SI_CONTEXT;
+		case AUDIT_CWD:
+		case AUDIT_AVC_PATH:
+			return SI_FILE;
+		case AUDIT_PATH:
+			return SI_FILE|SI_CONTEXT;
+		case AUDIT_SOCKADDR:
+			return SI_FILE|SI_HOST;
+		case AUDIT_NETFILTER_PKT:
+			return SI_HOST|SI_CONTEXT;
+		case AUDIT_IPC:
+		case AUDIT_OBJ_PID:
+			return SI_CONTEXT;
+		default:
+			return SI_ALL;
+	}
+}
+
 /*
  * This function will take the list and extract the searchable fields from it.
  * It returns 0 on success and 1 on failure.
  */
 int extract_search_items(llist *l)
+{
+	return extract_needed_items(l, SI_ALL);
+}
+
+/*
+ * Same as above, but records that can't supply any of the fields in need
+ * are skipped without being parsed.
+ */
+int extract_needed_items(llist *l, unsigned int need)
 {
 	int ret = 0;
 	lnode *n;
 	search_items *s = &l->s;
+
+	if (need == 0)
+		return 0;
 	list_first(l);
 	n = list_get_cur(l);
 	if (n) {
 		do {
+			if ((record_items(n->type) & need) == 0)
+				continue;
 			switch (n->type) {
 			case AUDIT_SYSCALL:
 				ret = parse_syscall(n, s);
@@ -21,13 +21,29 @@
 *   Steve Grubb <sgrubb@redhat.com>
 */
 
-#ifndef AUPARSE_HEADER
-#define AUPARSE_HEADER
+#ifndef AUSEARCH_PARSE_HEADER
+#define AUSEARCH_PARSE_HEADER
 
 #include "config.h"
 #include "ausearch-llist.h"
 
+/* Groups of search_items fields. A record is only parsed when its type
+ * can fill in one of the groups that were asked for. */
+#define SI_IDS		0x0001	// pid, ppid, uids, gids, session_id
+#define SI_SUCCESS	0x0002	// success
+#define SI_SYSCALL	0x0004	// arch, syscall, exit
+#define SI_FILE		0x0008	// filename, cwd
+#define SI_HOST		0x0010	// hostname
+#define SI_TERM		0x0020	// terminal
+#define SI_EXE		0x0040	// exe
+#define SI_COMM		0x0080	// comm
+#define SI_KEY		0x0100	// key
+#define SI_CONTEXT	0x0200	// avc
+#define SI_VM		0x0400	// uuid, vmname, acct
+#define SI_ALL		0x07FF
+
 int extract_search_items(llist *l);
+int extract_needed_items(llist *l, unsigned int need);
 
 #endif
 
@@ -0,0 +1,467 @@
+/*
+* ausearch-query.c - Run many searches in one pass over the logs
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * Each line of a query file is an output file followed by the search
+ * options that select what goes in it. The options given on the command
+ * line apply to all of the searches. The match code works on the global
+ * search options, so every search keeps its own copy of them and loads it
+ * to be checked. What the parser pulls out of an event depends on which
+ * options are set, so searches that set the same ones share a parse of
+ * each event that passes their cheap checks.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "ausearch-options.h"
+#include "ausearch-parse.h"
+#include "ausearch-index.h"
+#include "ausearch-query.h"
+
+#define MAX_QUERY_ARGS 64
+
+extern int match_header(llist *l);
+extern int match_items(llist *l);
+extern unsigned int needed_items(void);
+extern void output_record(llist *l);
+extern void output_flush(void);
+extern void output_to(FILE *f);
+
+/* The global search options */
+struct criteria {
+	unsigned int id;
+	gid_t gid, egid;
+	ilist *type;
+	pid_t pid, ppid;
+	success_t success;
+	int exact_match;
+	uid_t uid, euid, loginuid;
+	int syscall, machine;
+	int ua, ga, se;
+	uint32_t session_id;
+	long long exit;
+	int exit_is_set;
+	const char *key;
+	const char *filename;
+	const char *exe;
+	const char *comm;
+	const char *hostname;
+	const char *terminal;
+	const char *subject;
+	const char *object;
+	const char *uuid;
+	const char *vmname;
+	slist *node_list;
+	time_t start, end;
+	report_t format;
+};
+
+struct query {
+	struct criteria c;
+	unsigned int need;	// What extract_needed_items() has to get
+	unsigned int parse;	// Which options the parser looks at are set
+	unsigned int group;	// First search that parses the same way
+	char *path;
+	FILE *out;
+	int pass;		// Passed match_header() for this event
+};
+
+static struct query *queries;
+static unsigned int query_cnt;
+static struct criteria idle;	// Loaded between events
+
+static void save_criteria(struct criteria *c)
+{
+	c->id = event_id;
+	c->gid = event_gid;
+	c->egid = event_egid;
+	c->type = event_type;
+	c->pid = event_pid;
+	c->ppid = event_ppid;
+	c->success = event_success;
+	c->exact_match = event_exact_match;
+	c->uid = event_uid;
+	c->euid = event_euid;
+	c->loginuid = event_loginuid;
+	c->syscall = event_syscall;
+	c->machine = event_machine;
+	c->ua = event_ua;
+	c->ga = event_ga;
+	c->se = event_se;
+	c->session_id = event_session_id;
+	c->exit = event_exit;
+	c->exit_is_set = event_exit_is_set;
+	c->key = event_key;
+	c->filename = event_filename;
+	c->exe = event_exe;
+	c->comm = event_comm;
+	c->hostname = event_hostname;
+	c->terminal = event_terminal;
+	c->subject = event_subject;
+	c->object = event_object;
+	c->uuid = event_uuid;
+	c->vmname = event_vmname;
+	c->node_list = event_node_list;
+	c->start = start_time;
+	c->end = end_time;
+	c->format = report_format;
+}
+
+static void load_criteria(const struct criteria *c)
+{
+	event_id = c->id;
+	event_gid = c->gid;
+	event_egid = c->egid;
+	event_type = c->type;
+	event_pid = c->pid;
+	event_ppid = c->ppid;
+	event_success = c->success;
+	event_exact_match = c->exact_match;
+	event_uid = c->uid;
+	event_euid = c->euid;
+	event_loginuid = c->loginuid;
+	event_syscall = c->syscall;
+	event_machine = c->machine;
+	event_ua = c->ua;
+	event_ga = c->ga;
+	event_se = c->se;
+	event_session_id = c->session_id;
+	event_exit = c->exit;
+	event_exit_is_set = c->exit_is_set;
+	event_key = c->key;
+	event_filename = c->filename;
+	event_exe = c->exe;
+	event_comm = c->comm;
+	event_hostname = c->hostname;
+	event_terminal = c->terminal;
+	event_subject = c->subject;
+	event_object = c->object;
+	event_uuid = c->uuid;
+	event_vmname = c->vmname;
+	event_node_list = c->node_list;
+	start_time = c->start;
+	end_time = c->end;
+	report_format = c->format;
+}
+
+/* Notes which of the options the parser looks at are set */
+static unsigned int parse_options(const struct criteria *c)
+{
+	unsigned int bits = 0, bit = 1;
+
+#define OPTION(f, unset) do { if (c->f != unset) bits |= bit; \
+				bit <<= 1; } while (0)
+	OPTION(pid, -1);
+	OPTION(ppid, -1);
+	OPTION(success, S_UNSET);
+	OPTION(uid, (uid_t)-1);
+	OPTION(euid, (uid_t)-1);
+	OPTION(loginuid, (uid_t)-2);
+	OPTION(gid, (gid_t)-1);
+	OPTION(egid, (gid_t)-1);
+	OPTION(machine, -1);
+	OPTION(session_id, (uint32_t)-2);
+	OPTION(exit_is_set, 0);
+	OPTION(key, NULL);
+	OPTION(filename, NULL);
+	OPTION(exe, NULL);
+	OPTION(comm, NULL);
+	OPTION(hostname, NULL);
+	OPTION(terminal, NULL);
+	OPTION(subject, NULL);
+	OPTION(object, NULL);
+	OPTION(uuid, NULL);
+	OPTION(vmname, NULL);
+#undef OPTION
+	if (c->format > RPT_DEFAULT)
+		bits |= bit;
+	return bits;
+}
+
+/*
+ * Groups the searches that parse events the same way and works out what
+ * to leave loaded between events. Only the time range is looked at then,
+ * which is the widest one of the searches.
+ */
+static void combine_criteria(void)
+{
+	const struct criteria *c;
+	unsigned int i, j;
+
+	memset(&idle, 0, sizeof(idle));
+	idle.id = -1;
+	idle.gid = idle.egid = -1;
+	idle.pid = idle.ppid = -1;
+	idle.success = S_UNSET;
+	idle.uid = idle.euid = -1;
+	idle.loginuid = -2;
+	idle.syscall = idle.machine = -1;
+	idle.session_id = -2;
+	idle.format = RPT_DEFAULT;
+	for (i = 0; i < query_cnt; i++) {
+		c = &queries[i].c;
+		if (i == 0 || (idle.start && c->start < idle.start))
+			idle.start = c->start;
+		if (i == 0 || (idle.end && (c->end == 0 ||
+						c->end > idle.end)))
+			idle.end = c->end;
+		queries[i].parse = parse_options(c);
+		for (j = 0; j < i; j++)
+			if (queries[j].parse == queries[i].parse &&
+					queries[j].need == queries[i].need)
+				break;
+		queries[i].group = j;
+	}
+}
+
+/* Splits a line into words, which may be in double quotes */
+static int split_line(char *buf, char *argv[], int max)
+{
+	int argc = 0;
+	char *p = buf, *w;
+
+	while (*p) {
+		while (isspace((unsigned char)*p))
+			p++;
+		if (*p == 0 || *p == '#')
+			break;
+		if (argc == max)
+			return -1;
+		if (*p == '"') {
+			w = ++p;
+			while (*p && *p != '"')
+				p++;
+			if (*p == 0)
+				return -1;
+		} else {
+			w = p;
+			while (*p && !isspace((unsigned char)*p))
+				p++;
+		}
+		if (*p)
+			*p++ = 0;
+		argv[argc++] = w;
+	}
+	return argc;
+}
+
+/* Options that are about the run as a whole rather than a search */
+static const char *not_allowed[] = {
+	"-if", "--input", "--input-logs", "--checkpoint", "--columnar",
+	"--build-index", "--queries", "-h", "--help", "-v", "--version",
+	"--just-one", "--debug", "-l", "--line-buffered", "--kernel-rules",
+	"--last", NULL
+};
+
+/*
+ * A search adds its -m and -n values to the ones on the command line, so
+ * it starts from copies of those lists. Returns 0 on success.
+ */
+static int copy_lists(const struct criteria *base)
+{
+	event_type = NULL;
+	event_node_list = NULL;
+	if (base->type) {
+		int_node *in;
+
+		event_type = malloc(sizeof(ilist));
+		if (event_type == NULL)
+			return -1;
+		ilist_create(event_type);
+		for (in = base->type->head; in; in = in->next)
+			ilist_append(event_type, in->num, in->hits, in->aux1);
+	}
+	if (base->node_list) {
+		snode *sn, tmp;
+
+		event_node_list = malloc(sizeof(slist));
+		if (event_node_list == NULL)
+			return -1;
+		slist_create(event_node_list);
+		for (sn = base->node_list->head; sn; sn = sn->next) {
+			tmp.str = strdup(sn->str);
+			tmp.key = NULL;
+			tmp.hits = 0;
+			if (tmp.str == NULL)
+				return -1;
+			slist_append(event_node_list, &tmp);
+		}
+	}
+	return 0;
+}
+
+static int add_query(const struct criteria *base, int argc, char *argv[],
+		const char *file, int lineno)
+{
+	struct query *tmp, *q;
+	int i, j;
+
+	for (i = 1; i < argc; i++) {
+		for (j = 0; not_allowed[j]; j++) {
+			if (strcmp(argv[i], not_allowed[j]) == 0) {
+				fprintf(stderr,
+					"%s can't be used in a query (%s:%d)\n",
+					argv[i], file, lineno);
+				return -1;
+			}
+		}
+	}
+	tmp = realloc(queries, (query_cnt + 1) * sizeof(struct query));
+	if (tmp == NULL)
+		return -1;
+	queries = tmp;
+	q = &queries[query_cnt];
+	memset(q, 0, sizeof(*q));
+
+	load_criteria(base);
+	if (copy_lists(base))
+		return -1;
+	if (argc > 1) {
+		// check_params() skips argv[0], which is the output here
+		if (check_params(argc, argv)) {
+			fprintf(stderr, "Bad query at %s:%d\n", file, lineno);
+			return -1;
+		}
+	}
+	save_criteria(&q->c);
+	q->need = needed_items();
+	index_add_search();
+
+	q->path = strdup(argv[0]);
+	if (q->path == NULL)
+		return -1;
+	q->out = fopen(q->path, "w");
+	if (q->out == NULL) {
+		fprintf(stderr, "Error creating %s (%s)\n", q->path,
+			strerror(errno));
+		free(q->path);
+		return -1;
+	}
+	query_cnt++;
+	return 0;
+}
+
+int query_load(const char *filename)
+{
+	struct criteria base;
+	char buf[4096], *argv[MAX_QUERY_ARGS];
+	int argc, lineno = 0, rc = 0;
+	FILE *f;
+
+	f = fopen(filename, "rm");
+	if (f == NULL) {
+		fprintf(stderr, "Error opening %s (%s)\n", filename,
+			strerror(errno));
+		return 1;
+	}
+	save_criteria(&base);
+	while (rc == 0 && fgets(buf, sizeof(buf), f)) {
+		lineno++;
+		argc = split_line(buf, argv, MAX_QUERY_ARGS);
+		if (argc < 0) {
+			fprintf(stderr, "Bad query at %s:%d\n", filename,
+				lineno);
+			rc = 1;
+		} else if (argc && add_query(&base, argc, argv, filename,
+				lineno))
+			rc = 1;
+	}
+	fclose(f);
+	if (rc == 0 && query_cnt == 0) {
+		fprintf(stderr, "No queries in %s\n", filename);
+		rc = 1;
+	}
+	combine_criteria();
+	load_criteria(&idle);
+	return rc;
+}
+
+int query_match(llist *l)
+{
+	struct query *q;
+	unsigned int i, g;
+	int hits = 0, parsed = 0;
+
+	for (i = 0; i < query_cnt; i++) {
+		q = &queries[i];
+		load_criteria(&q->c);
+		q->pass = match_header(l);
+	}
+	for (g = 0; g < query_cnt; g++) {
+		if (queries[g].group != g)
+			continue;
+		for (i = g; i < query_cnt; i++)
+			if (queries[i].group == g && queries[i].pass)
+				break;
+		if (i == query_cnt)
+			continue;
+
+		// Parse the event the way this group's searches would
+		if (parsed)
+			list_clear_items(l);
+		parsed = 1;
+		load_criteria(&queries[g].c);
+		if (extract_needed_items(l, queries[g].need))
+			continue;
+		for (; i < query_cnt; i++) {
+			q = &queries[i];
+			if (q->group != g || !q->pass)
+				continue;
+			load_criteria(&q->c);
+			if (match_items(l)) {
+				output_to(q->out);
+				output_record(l);
+				if (line_buffered)
+					output_flush();
+				hits++;
+			}
+		}
+	}
+	output_to(stdout);
+	load_criteria(&idle);
+	return hits;
+}
+
+int query_close(void)
+{
+	unsigned int i;
+	int rc = 0;
+
+	for (i = 0; i < query_cnt; i++) {
+		if (fclose(queries[i].out)) {
+			fprintf(stderr, "Error writing %s (%s)\n",
+				queries[i].path, strerror(errno));
+			rc = 1;
+		}
+		free(queries[i].path);
+	}
+	free(queries);
+	queries = NULL;
+	query_cnt = 0;
+	return rc;
+}
+
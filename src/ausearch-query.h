@@ -0,0 +1,40 @@
+/*
+* ausearch-query.h - Header file for ausearch-query.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUSEARCH_QUERY_HEADER
+#define AUSEARCH_QUERY_HEADER
+
+#include "config.h"
+#include "ausearch-llist.h"
+
+/* Reads the searches of a query file and opens their output files.
+ * Returns 0 on success. */
+int query_load(const char *filename);
+/* Checks an event against every search and writes it to the output of
+ * each one that matches. Returns how many matched. */
+int query_match(llist *l);
+/* Closes the output files. Returns 0 if they were all written. */
+int query_close(void);
+
+#endif
+
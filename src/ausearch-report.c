@@ -26,15 +26,18 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include "libaudit.h"
 #include "ausearch-options.h"
 #include "ausearch-parse.h"
 #include "ausearch-lookup.h"
 #include "auparse-idata.h"
 #include "auparse-defs.h"
+#include "auparse.h"
 
 /* Local functions */
 static void output_raw(llist *l);
+static void output_columnar(llist *l);
 static void output_default(llist *l);
 static void output_interpreted(llist *l);
 static void output_interpreted_node(const lnode *n);
@@ -42,14 +45,162 @@ static void interpret(char *name, char *val, int comma, int rtype);
 
 /* The machine based on elf type */
 static unsigned long machine = -1;
+static int host_machine = -2;	// Only looked up once
 static int cur_syscall = -1;
 
 /* The first syscall argument */
 static unsigned long long a0, a1;
 
+/* Where --columnar output goes */
+static aucol_writer_t *columnar;
+static int columnar_error;
+
+/* Where the text formats go, stdout unless output_to() says otherwise */
+static FILE *out;
+
+/*
+ * The text formats are put together in outbuf and written out when it
+ * fills up, which saves a stdio call for every field.
+ */
+#define OUTBUF_SIZE (128*1024)
+static char outbuf[OUTBUF_SIZE];
+static size_t outlen;
+
+static void out_drain(void)
+{
+	if (outlen) {
+		fwrite_unlocked(outbuf, 1, outlen, out);
+		outlen = 0;
+	}
+}
+
+static void out_write(const char *str, size_t len)
+{
+	if (len > OUTBUF_SIZE - outlen) {
+		out_drain();
+		if (len > OUTBUF_SIZE) {
+			fwrite_unlocked(str, 1, len, out);
+			return;
+		}
+	}
+	memcpy(outbuf + outlen, str, len);
+	outlen += len;
+}
+
+static inline void out_str(const char *str)
+{
+	out_write(str, strlen(str));
+}
+
+static inline void out_char(char c)
+{
+	if (outlen == OUTBUF_SIZE)
+		out_drain();
+	outbuf[outlen++] = c;
+}
+
+static void out_printf(const char *fmt, ...)
+{
+	size_t room = OUTBUF_SIZE - outlen;
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(outbuf + outlen, room, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	if ((size_t)len >= room) {
+		out_drain();
+		va_start(ap, fmt);
+		if (len < OUTBUF_SIZE)
+			vsnprintf(outbuf, OUTBUF_SIZE, fmt, ap);
+		else {
+			vfprintf(out, fmt, ap);
+			len = 0;
+		}
+		va_end(ap);
+	}
+	outlen += len;
+}
+
+/* Formats the interpretation of a field straight into outbuf */
+static void out_interp(int type, const idata *id)
+{
+	size_t room = OUTBUF_SIZE - outlen;
+	int len;
+
+	len = auparse_interp_buf(type, id, outbuf + outlen, room);
+	if ((size_t)len >= room) {
+		out_drain();
+		len = auparse_interp_buf(type, id, outbuf, OUTBUF_SIZE);
+		if (len >= OUTBUF_SIZE) {
+			// Too big to be buffered
+			char *str = (char *)auparse_do_interpretation(type, id);
+
+			if (str)
+				fwrite_unlocked(str, 1, strlen(str), out);
+			free(str);
+			len = 0;
+		}
+	}
+	outlen += len;
+}
+
+/* Writes what has been formatted so far and flushes the stream */
+void output_flush(void)
+{
+	if (out == NULL)
+		return;
+	out_drain();
+	fflush(out);
+}
+
+void output_to(FILE *f)
+{
+	if (out)
+		out_drain();
+	out = f;
+}
+
+/* Opens the output file of formats that need one. Returns 0 on success. */
+int output_open(void)
+{
+	if (report_format != RPT_COLUMNAR)
+		return 0;
+	columnar = auparse_columnar_create(columnar_filename);
+	if (columnar == NULL) {
+		fprintf(stderr, "Error creating %s (%s)\n", columnar_filename,
+			strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/* Finishes the output file, if any. Returns 0 on success. */
+int output_close(void)
+{
+	int rc = columnar_error;
+
+	if (out)
+		out_drain();
+
+	if (columnar) {
+		if (auparse_columnar_close(columnar))
+			rc = 1;
+		columnar = NULL;
+		if (rc)
+			fprintf(stderr, "Error writing %s\n",
+				columnar_filename);
+	}
+	return rc;
+}
+
 /* This function branches to the correct output format */
 void output_record(llist *l)
 {
+	if (out == NULL)
+		out = stdout;
 	switch (report_format) {
 		case RPT_RAW:
 			output_raw(l);
@@ -62,6 +213,9 @@ void output_record(llist *l)
 			break;
 		case RPT_PRETTY:
 			break;
+		case RPT_COLUMNAR:
+			output_columnar(l);
+			break;
 		default:
 			fprintf(stderr, "Report format error");
 			exit(1);
@@ -80,30 +234,56 @@ static void output_raw(llist *l)
 		return;
 	}
 	do {
-		printf("%s\n", n->message);
+		out_str(n->message);
+		out_char('\n');
 	} while ((n=list_next(l)));
 }
 
+/* This function adds the records to the columnar file in log order */
+static void output_columnar(llist *l)
+{
+	const lnode *n;
+
+	list_first(l);
+	n = list_get_cur(l);
+	while (n && !columnar_error) {
+		if (auparse_columnar_write(columnar, n->message))
+			columnar_error = 1;
+		n = list_next(l);
+	}
+}
+
 /*
  * This function will take the linked list and format it for output. No
  * interpretation is performed. The output order is lifo for everything.
  */
 static void output_default(llist *l)
 {
+	static time_t last_sec = -1;
+	static char last_time[32];
 	const lnode *n;
 
 	list_last(l);
 	n = list_get_cur(l);
-	printf("----\ntime->%s", ctime(&l->e.sec));
+	// Events often share a second, so keep the last one formatted
+	if (l->e.sec != last_sec) {
+		snprintf(last_time, sizeof(last_time), "%s",
+			ctime(&l->e.sec));
+		last_sec = l->e.sec;
+	}
+	out_str("----\ntime->");
+	out_str(last_time);
 	if (!n) {
 		fprintf(stderr, "Error - no elements in record.");
 		return;
 	}
-	if (n->type >= AUDIT_DAEMON_START && n->type < AUDIT_SYSCALL) 
-		printf("%s\n", n->message);
-	else {
+	if (n->type >= AUDIT_DAEMON_START && n->type < AUDIT_SYSCALL) {
+		out_str(n->message);
+		out_char('\n');
+	} else {
 		do {
-			printf("%s\n", n->message);
+			out_str(n->message);
+			out_char('\n');
 		} while ((n=list_prev(l)));
 	}
 }
@@ -119,7 +299,7 @@ static void output_interpreted(llist *l)
 
 	list_last(l);
 	n = list_get_cur(l);
-	printf("----\n");
+	out_str("----\n");
 	if (!n) {
 		fprintf(stderr, "Error - no elements in record.");
 		return;
@@ -139,8 +319,23 @@ static void output_interpreted(llist *l)
  */
 static void output_interpreted_node(const lnode *n)
 {
-	char *ptr, *str = n->message, *node = NULL;
+	static time_t last_t = -1;
+	static int last_milli;
+	static unsigned long last_serial;
+	static char last_tm[64];
+	char *ptr, *str, *node = NULL;
+	char buf[MAX_AUDIT_MESSAGE_LENGTH];
 	int found, comma = 0;
+	size_t len;
+
+	// The record is cut up as it goes, so work on a copy of it in
+	// case the event is written again
+	len = strlen(n->message);
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+	memcpy(buf, n->message, len);
+	buf[len] = 0;
+	str = buf;
 
 	// Reset these because each record could be different
 	machine = -1;
@@ -165,8 +360,6 @@ static void output_interpreted_node(const lnode *n)
 		time_t t;
 		int milli,num = n->type;
 		unsigned long serial;
-		struct tm *btm;
-		char tmp[32];
 		const char *bptr;
 
 		*ptr++ = 0;
@@ -192,15 +385,22 @@ static void output_interpreted_node(const lnode *n)
 		if (num >= 0) {
 			bptr = audit_msg_type_to_name(num);
 			if (bptr) {
-				if (node)
-					printf("%s ", node);
-				printf("type=%s msg=audit(", bptr);
+				if (node) {
+					out_str(node);
+					out_char(' ');
+				}
+				out_str("type=");
+				out_str(bptr);
+				out_str(" msg=audit(");
 				goto no_print;
 			}
 		} 
-		if (node)
-			printf("%s ", node);
-		printf("%s(", str);
+		if (node) {
+			out_str(node);
+			out_char(' ');
+		}
+		out_str(str);
+		out_char('(');
 no_print:
 
 		// output formatted time.
@@ -226,10 +426,19 @@ no_print:
 		serial = strtoul(ptr, NULL, 10);
 		if (errno)
 			return;
-		btm = localtime(&t);
-		strftime(tmp, sizeof(tmp), "%x %T", btm);
-		printf("%s", tmp);
-		printf(".%03d:%lu) ", milli, serial);
+		// The records of an event share the time stamp, so keep
+		// the last one formatted
+		if (t != last_t || milli != last_milli ||
+				serial != last_serial) {
+			len = strftime(last_tm, sizeof(last_tm), "%x %T",
+				localtime(&t));
+			snprintf(last_tm + len, sizeof(last_tm) - len,
+				".%03d:%lu) ", milli, serial);
+			last_t = t;
+			last_milli = milli;
+			last_serial = serial;
+		}
+		out_str(last_tm);
 	}
 
 	if (n->type == AUDIT_SYSCALL) { 
@@ -251,7 +460,8 @@ no_print:
 		*ptr++ = 0;
 
 		// print everything up to the '='
-		printf("%s=", str);
+		out_str(str);
+		out_char('=');
 
 		// Some user messages have msg='uid=500   in this case
 		// skip the msg= piece since the real stuff is the uid=
@@ -314,11 +524,11 @@ no_print:
 	}
 	// If nothing found, just print out as is
 	if (!found && ptr == NULL && str)
-		printf("%s", str);
+		out_str(str);
 	// If last field had comma, output the rest
 	else if (comma)
-		printf("%s", str);
-	printf("\n");
+		out_str(str);
+	out_char('\n');
 }
 
 static void interpret(char *name, char *val, int comma, int rtype)
@@ -338,14 +548,17 @@ static void interpret(char *name, char *val, int comma, int rtype)
 	type = auparse_interp_adjust_type(rtype, name, val);
 
 	if (rtype == AUDIT_SYSCALL || rtype == AUDIT_SECCOMP) {
-		if (machine == (unsigned long)-1) 
-			machine = audit_detect_machine();
+		if (machine == (unsigned long)-1) {
+			if (host_machine == -2)
+				host_machine = audit_detect_machine();
+			machine = host_machine;
+		}
 		if (*name == 'a' && strcmp(name, "arch") == 0) {
 			unsigned long ival;
 			errno = 0;
 			ival = strtoul(val, NULL, 16);
 			if (errno) {
-				printf("arch conversion error(%s) ", val);
+				out_printf("arch conversion error(%s) ", val);
 				return;
 			}
 			machine = audit_elf_to_machine(ival);
@@ -356,7 +569,8 @@ static void interpret(char *name, char *val, int comma, int rtype)
 			errno = 0;
 			ival = strtoul(val, NULL, 10);
 			if (errno) {
-				printf("syscall conversion error(%s) ", val);
+				out_printf("syscall conversion error(%s) ",
+					val);
 				return;
 			}
 			cur_syscall = ival;
@@ -370,29 +584,33 @@ static void interpret(char *name, char *val, int comma, int rtype)
 	id.name = name;
 	id.val = val;
 
-	char *out = auparse_do_interpretation(type, &id);
-	if (type == AUPARSE_TYPE_UNCLASSIFIED)
-		printf("%s%c", val, comma ? ',' : ' ');
-	else if (name[0] == 'k' && strcmp(name, "key") == 0) {
-		char *str, *ptr = out;
+	if (type == AUPARSE_TYPE_UNCLASSIFIED) {
+		out_str(val);
+		out_char(comma ? ',' : ' ');
+	} else if (name[0] == 'k' && strcmp(name, "key") == 0) {
+		char buf[MAX_AUDIT_MESSAGE_LENGTH], *str, *ptr = buf;
 		int count = 0;
+
+		auparse_interp_buf(type, &id, buf, sizeof(buf));
 		while ((str = strchr(ptr, AUDIT_KEY_SEPARATOR))) {
 			*str = 0;
 			if (count == 0) {
-				printf("%s", ptr);
+				out_str(ptr);
 				count++;
-			} else
-				printf(" key=%s", ptr);
+			} else {
+				out_str(" key=");
+				out_str(ptr);
+			}
 			ptr = str+1;
 		}
-		if (count == 0)
-			printf("%s ", out);
-		else
-			printf(" key=%s ", ptr);
-	} else if (type == AUPARSE_TYPE_TTY_DATA)
-		printf("%s", out);
-	else
-		printf("%s ", out);
-	free(out);
+		if (count)
+			out_str(" key=");
+		out_str(ptr);
+		out_char(' ');
+	} else {
+		out_interp(type, &id);
+		if (type != AUPARSE_TYPE_TTY_DATA)
+			out_char(' ');
+	}
 }
 
@@ -0,0 +1,155 @@
+/*
+* ausearch-reverse.c - Read logs from the end back
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "ausearch-reverse.h"
+
+/* How much is read at a time */
+#define RFILE_BLOCK (64*1024)
+
+rfile *rfile_open(const char *filename)
+{
+	struct stat sb;
+	rfile *f;
+
+	f = malloc(sizeof(rfile));
+	if (f == NULL)
+		return NULL;
+	f->fd = open(filename, O_RDONLY);
+	if (f->fd < 0) {
+		free(f);
+		return NULL;
+	}
+	if (fstat(f->fd, &sb) < 0)
+		goto err;
+	f->size = 2 * RFILE_BLOCK;
+	f->buf = malloc(f->size);
+	if (f->buf == NULL)
+		goto err;
+	f->pos = sb.st_size;
+	f->start = f->end = f->size;
+	f->error = 0;
+	return f;
+err:
+	close(f->fd);
+	free(f);
+	return NULL;
+}
+
+/*
+ * This function reads the block in front of the data not returned yet.
+ * That data is moved to the end of the buffer first if there is no
+ * room for the block, and the buffer grows when a line is longer than
+ * it. Returns 0 on success and -1 on error.
+ */
+static int read_block(rfile *f)
+{
+	size_t n = f->pos < RFILE_BLOCK ? f->pos : RFILE_BLOCK;
+	size_t len = f->end - f->start;
+	ssize_t rc;
+
+	if (f->start < n) {
+		if (len + n > f->size) {
+			size_t size = f->size * 2;
+			char *buf = malloc(size);
+
+			if (buf == NULL)
+				return -1;
+			memcpy(buf + size - len, f->buf + f->start, len);
+			free(f->buf);
+			f->buf = buf;
+			f->size = size;
+		} else
+			memmove(f->buf + f->size - len, f->buf + f->start,
+				len);
+		f->start = f->size - len;
+		f->end = f->size;
+	}
+	while (n) {
+		do {
+			rc = pread(f->fd, f->buf + f->start - n, n,
+				f->pos - n);
+		} while (rc < 0 && errno == EINTR);
+		if (rc <= 0) {
+			if (rc == 0)
+				errno = EIO;	// The file was truncated
+			return -1;
+		}
+		// A short read gets the end of the block
+		f->start -= rc;
+		f->pos -= rc;
+		n -= rc;
+	}
+	return 0;
+}
+
+char *rfile_gets(char *buff, int size, rfile *f)
+{
+	char *line, *nl;
+	size_t len;
+
+	while (1) {
+		// Look for the end of the line before this one, skipping
+		// the newline that ends this one
+		len = f->end - f->start;
+		nl = NULL;
+		if (len > 1)
+			nl = memrchr(f->buf + f->start, '\n', len - 1);
+		if (nl) {
+			line = nl + 1;
+			break;
+		}
+		if (f->pos == 0) {
+			// The first line of the file
+			if (len == 0)
+				return NULL;
+			line = f->buf + f->start;
+			break;
+		}
+		if (read_block(f)) {
+			f->error = errno;
+			return NULL;
+		}
+	}
+	len = f->buf + f->end - line;
+	f->end = line - f->buf;
+	if (len > (size_t)size - 1)
+		len = size - 1;
+	memcpy(buff, line, len);
+	buff[len] = 0;
+	return buff;
+}
+
+void rfile_close(rfile *f)
+{
+	close(f->fd);
+	free(f->buf);
+	free(f);
+}
+
@@ -0,0 +1,50 @@
+/*
+* ausearch-reverse.h - Header file for ausearch-reverse.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUSEARCH_REVERSE_HEADER
+#define AUSEARCH_REVERSE_HEADER
+
+#include "config.h"
+#include <sys/types.h>
+
+/* A log being read from its end back */
+typedef struct {
+  int fd;
+  off_t pos;		// File offset of buf[start]
+  char *buf;
+  size_t size;		// Size of buf
+  size_t start;		// The data not returned yet is buf[start]
+  size_t end;		// up to buf[end]
+  int error;		// Set when a read failed
+} rfile;
+
+rfile *rfile_open(const char *filename);
+/* Copies the line before the one returned last into buff the way fgets
+ * does. Returns buff, or NULL when the start of the file is reached or
+ * on a read error. */
+char *rfile_gets(char *buff, int size, rfile *f);
+static inline int rfile_error(const rfile *f) { return f->error; }
+void rfile_close(rfile *f);
+
+#endif
+
@@ -0,0 +1,247 @@
+/*
+* ausearch-rules.c - Skip events the kernel rules could not have keyed
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+/*
+ * ausearch --kernel-rules looks up which of the loaded audit rules carry
+ * the key given with -k. A key in a SYSCALL record comes from the rule
+ * that matched the syscall, so only the arch and syscall pairs those
+ * rules list can have it. For each arch, the syscall masks of the rules
+ * are or'ed into one, and events whose SYSCALL record is outside of it
+ * are dropped before any record is parsed. Besides SYSCALL records, the
+ * search parser only takes keys from CONFIG_CHANGE and MAC records, so
+ * events holding one of those are always parsed.
+ *
+ * The filter describes the rules loaded now. Logs written while other
+ * rules were loaded can have keyed events it drops.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "libaudit.h"
+#include "ausearch-options.h"
+#include "ausearch-rules.h"
+
+/* The syscalls the rules with the key audit for one arch */
+struct arch_mask {
+	uint32_t arch;		// 0 if the rules have no arch field
+	uint32_t mask[AUDIT_BITMASK_SIZE];
+};
+
+static struct arch_mask *masks = NULL;
+static unsigned int mask_cnt = 0;
+
+/*
+ * This function returns 1 if one of the keys of a rule, which are
+ * separated by AUDIT_KEY_SEPARATOR, is matched by the -k search.
+ */
+static int key_matches(const char *keys, unsigned int len)
+{
+	const char *ptr = keys, *end = keys + len;
+	char buf[AUDIT_MAX_KEY_LEN+1];
+
+	while (ptr < end) {
+		const char *sep = memchr(ptr, AUDIT_KEY_SEPARATOR, end - ptr);
+		size_t klen = (sep ? sep : end) - ptr;
+
+		if (klen > AUDIT_MAX_KEY_LEN)
+			klen = AUDIT_MAX_KEY_LEN;
+		memcpy(buf, ptr, klen);
+		buf[klen] = 0;
+		if (event_exact_match) {
+			if (strcmp(buf, event_key) == 0)
+				return 1;
+		} else if (strstr(buf, event_key))
+			return 1;
+		if (sep == NULL)
+			break;
+		ptr = sep + 1;
+	}
+	return 0;
+}
+
+static struct arch_mask *get_mask(uint32_t arch)
+{
+	struct arch_mask *m;
+	unsigned int i;
+
+	for (i = 0; i < mask_cnt; i++) {
+		if (masks[i].arch == arch)
+			return &masks[i];
+	}
+	m = realloc(masks, (mask_cnt + 1) * sizeof(struct arch_mask));
+	if (m == NULL)
+		return NULL;
+	masks = m;
+	m = &masks[mask_cnt++];
+	memset(m, 0, sizeof(struct arch_mask));
+	m->arch = arch;
+	return m;
+}
+
+void rules_add(const struct audit_rule_data *r)
+{
+	int i, found = 0;
+	uint32_t arch = 0;
+	size_t boffset = 0;
+	struct arch_mask *m;
+
+	if (event_key == NULL || r->action == AUDIT_NEVER)
+		return;
+	for (i = 0; i < r->field_count; i++) {
+		int field = r->fields[i] & ~AUDIT_OPERATORS;
+		int op = r->fieldflags[i] & AUDIT_OPERATORS;
+
+		if (field == AUDIT_FILTERKEY && found == 0 &&
+				boffset + r->values[i] <= r->buflen)
+			found = key_matches(&r->buf[boffset], r->values[i]);
+		else if (field == AUDIT_ARCH && op == AUDIT_EQUAL)
+			arch = r->values[i];
+		if (((field >= AUDIT_SUBJ_USER && field <= AUDIT_OBJ_LEV_HIGH)
+				&& field != AUDIT_PPID) || field == AUDIT_WATCH ||
+				field == AUDIT_DIR || field == AUDIT_FILTERKEY)
+			boffset += r->values[i];
+	}
+	if (!found)
+		return;
+
+	switch (r->flags & AUDIT_FILTER_MASK) {
+		case AUDIT_FILTER_ENTRY:
+		case AUDIT_FILTER_EXIT:
+			m = get_mask(arch);
+			if (m == NULL)
+				return;
+			for (i = 0; i < AUDIT_BITMASK_SIZE; i++)
+				m->mask[i] |= r->mask[i];
+			break;
+		case AUDIT_FILTER_TASK:
+			// The key goes on every syscall of the task
+			m = get_mask(arch);
+			if (m == NULL)
+				return;
+			memset(m->mask, 0xff, sizeof(m->mask));
+			break;
+		default:
+			// User and exclude rules don't key syscalls
+			break;
+	}
+}
+
+/* Adds each rule listed */
+static int list_reply(struct audit_reply *rep, void *data)
+{
+	if (rep->type == AUDIT_LIST_RULES)
+		rules_add(rep->ruledata);
+	return 0;
+}
+
+int rules_load(void)
+{
+	int fd, seq, rc;
+
+	fd = audit_open();
+	if (fd < 0) {
+		fprintf(stderr, "Can't open the audit netlink socket (%s)\n",
+			strerror(errno));
+		return 1;
+	}
+	seq = audit_request_rules_list_data(fd);
+	if (seq <= 0) {
+		fprintf(stderr, "Can't list the audit rules (%s)\n",
+			strerror(errno));
+		audit_close(fd);
+		return 1;
+	}
+	rc = audit_wait_replies(fd, seq, list_reply, NULL, 40000);
+	if (rc < 0)
+		fprintf(stderr, "Error listing the audit rules (%s)\n",
+			strerror(-rc));
+	audit_close(fd);
+	return rc ? 1 : 0;
+}
+
+/*
+ * This function returns 1 if a rule with the key covers the syscall of a
+ * SYSCALL record. Records that can't be read are left for the parser.
+ */
+static int syscall_may_match(const char *msg)
+{
+	const char *ptr;
+	char *end;
+	unsigned long arch, sc;
+	unsigned int i;
+
+	ptr = strstr(msg, " arch=");
+	if (ptr == NULL)
+		return 1;
+	errno = 0;
+	arch = strtoul(ptr + 6, &end, 16);
+	if (errno || *end != ' ')
+		return 1;
+	ptr = strstr(end, " syscall=");
+	if (ptr == NULL)
+		return 1;
+	sc = strtoul(ptr + 9, &end, 10);
+	if (errno || (*end != ' ' && *end != 0))
+		return 1;
+	if (sc >= AUDIT_BITMASK_SIZE * 32)
+		return 1;
+
+	for (i = 0; i < mask_cnt; i++) {
+		if (masks[i].arch && masks[i].arch != arch)
+			continue;
+		if (masks[i].mask[AUDIT_WORD(sc)] & AUDIT_BIT(sc))
+			return 1;
+	}
+	return 0;
+}
+
+int rules_may_match(const llist *l)
+{
+	const lnode *n;
+
+	for (n = l->head; n; n = n->next) {
+		switch (n->type) {
+			case AUDIT_SYSCALL:
+				if (syscall_may_match(n->message))
+					return 1;
+				break;
+			case AUDIT_CONFIG_CHANGE:
+			case AUDIT_MAC_POLICY_LOAD...AUDIT_MAC_UNLBL_STCDEL:
+				return 1;
+			default:
+				break;
+		}
+	}
+	return 0;
+}
+
+void rules_clear(void)
+{
+	free(masks);
+	masks = NULL;
+	mask_cnt = 0;
+}
+
@@ -0,0 +1,43 @@
+/*
+* ausearch-rules.h - Header file for ausearch-rules.c
+* Copyright (c) 2014 Red Hat Inc., Durham, North Carolina.
+* All Rights Reserved.
+*
+* This software may be freely redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free
+* Software Foundation; either version 2, or (at your option) any
+* later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; see the file COPYING. If not, write to the
+* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+* Authors:
+*   Steve Grubb <sgrubb@redhat.com>
+*/
+
+#ifndef AUSEARCH_RULES_HEADER
+#define AUSEARCH_RULES_HEADER
+
+#include "config.h"
+#include "libaudit.h"
+#include "ausearch-llist.h"
+
+/* Reads the rules loaded in the kernel and keeps the ones that can put
+ * the searched key in a record. Returns 0 on success. */
+int rules_load(void);
+/* Adds one rule to the filter if its key matches the searched one */
+void rules_add(const struct audit_rule_data *r);
+/* Returns 0 if no record of the event can hold the key, going by the
+ * rules, and 1 if it might. Only the type, arch, and syscall of the
+ * records are looked at. */
+int rules_may_match(const llist *l);
+void rules_clear(void);
+
+#endif
+
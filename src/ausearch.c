@@ -43,6 +43,10 @@
 #include "ausearch-lookup.h"
 #include "auparse.h"
 #include "ausearch-checkpt.h"
+#include "ausearch-index.h"
+#include "ausearch-query.h"
+#include "ausearch-rules.h"
+#include "ausearch-reverse.h"
 
 
 static FILE *log_fd = NULL;
@@ -51,10 +55,17 @@ static int found = 0;
 static int input_is_pipe = 0;
 static int timeout_interval = 3;	/* timeout in seconds */
 static int files_to_process = 0;	/* number of log files yet to process when reading multiple */
+static rlol rlo;			/* --last events being read back */
+static llist **last_found = NULL;	/* --last matches, newest first */
+static unsigned long last_cnt = 0, last_size = 0;
+static int last_done = 0;		/* nothing older is wanted */
 static int process_logs(void);
+static int build_indexes(void);
 static int process_log_fd(void);
 static int process_stdin(void);
 static int process_file(char *filename);
+static int process_file_reverse(const char *filename);
+static void output_last(void);
 static int get_record(llist **);
 
 extern const char *checkpt_filename;	/* checkpoint file name */
@@ -64,6 +75,9 @@ extern char *user_file;
 extern int force_logs;
 extern int match(llist *l);
 extern void output_record(llist *l);
+extern void output_flush(void);
+extern int output_open(void);
+extern int output_close(void);
 
 static int userfile_is_dir = 0;
 
@@ -99,6 +113,37 @@ int main(int argc, char *argv[])
 	set_aumessage_mode(MSG_STDERR, DBG_NO);
 	(void) umask( umask( 077 ) | 027 );
 
+	if (build_index) {
+		rc = build_indexes();
+		free(user_file);
+		return rc;
+	}
+
+	if (query_filename && (checkpt_filename || columnar_filename ||
+					just_one || kernel_rules)) {
+		fprintf(stderr, "--queries can't be used with --checkpoint, "
+			"--columnar, --just-one, or --kernel-rules\n");
+		return 1;
+	}
+
+	if (last_events && (checkpt_filename || query_filename || just_one)) {
+		fprintf(stderr, "--last can't be used with --checkpoint, "
+			"--queries, or --just-one\n");
+		return 1;
+	}
+
+	if (kernel_rules) {
+		if (event_key == NULL) {
+			fprintf(stderr, "--kernel-rules needs a key to search "
+				"for\n");
+			return 1;
+		}
+		if (rules_load()) {
+			free(user_file);
+			return 1;
+		}
+	}
+
 	/* Load the checkpoint file if requested */
 	if (checkpt_filename) {
 		rc = load_ChkPt(checkpt_filename);
@@ -124,7 +169,16 @@ int main(int argc, char *argv[])
 		}
 	}
 	
+	if (output_open())
+		return 1;
+	if (query_filename && query_load(query_filename)) {
+		query_close();
+		return 1;
+	}
+
 	lol_create(&lo);
+	if (last_events)
+		rlol_create(&rlo);
 	if (user_file) {
 		if (stat(user_file, &sb) == -1) {
                		perror("stat");
@@ -146,6 +200,8 @@ int main(int argc, char *argv[])
 		rc = process_stdin();
 	else
 		rc = process_logs();
+	if (last_events)
+		output_last();
 
 	/* Generate a checkpoint if required */
 	if (checkpt_filename) {
@@ -166,11 +222,18 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (output_close() && rc == 0)
+		rc = 1;
+	if (query_filename && query_close() && rc == 0)
+		rc = 1;
 	lol_clear(&lo);
 	ilist_clear(event_type);
 	free(event_type);
 	free(user_file);
 	free((char *)event_key);
+	free((char *)columnar_filename);
+	free((char *)query_filename);
+	rules_clear();
 	auparse_destroy(NULL);
 	if (rc)
 		return rc;
@@ -274,6 +337,24 @@ static int process_logs(void)
 
 	num--;
 
+	/* The newest events are wanted, so start with the current log */
+	if (last_events) {
+		int i;
+
+		for (i = 0; i <= num && !last_done; i++) {
+			if (i)
+				snprintf(filename, len, "%s.%d",
+					config.log_file, i);
+			else
+				snprintf(filename, len, "%s", config.log_file);
+			if ((ret = process_file(filename)))
+				break;
+		}
+		free(filename);
+		free_config(&config);
+		return ret;
+	}
+
 	/* We note how many files we need to process */
 	files_to_process = num;
 
@@ -314,6 +395,61 @@ static int process_logs(void)
 	return ret;
 }
 
+/*
+ * Writes the block indexes of the rotated logs, or of the file given
+ * with -if. The log being written to changes all the time, so it gets
+ * no index.
+ */
+static int build_indexes(void)
+{
+	struct daemon_conf config;
+	char *filename;
+	int len, num, rc = 0;
+	struct stat sb;
+
+	if (user_file) {
+		if (stat(user_file, &sb) == -1) {
+			perror("stat");
+			return 1;
+		}
+		if (!S_ISDIR(sb.st_mode))
+			return index_build(user_file);
+		clear_config(&config);
+		free((void *)config.log_file);
+		len = strlen(user_file) + 16;
+		filename = malloc(len);
+		if (filename)
+			snprintf(filename, len, "%s%saudit.log", user_file,
+			    user_file[strlen(user_file)-1] == '/' ? "" : "/");
+		config.log_file = filename;
+	} else if (load_config(&config, TEST_SEARCH))
+		fprintf(stderr, "NOTE - using built-in logs: %s\n",
+			config.log_file);
+	if (config.log_file == NULL) {
+		fprintf(stderr, "No memory\n");
+		return 1;
+	}
+
+	len = strlen(config.log_file) + 16;
+	filename = malloc(len);
+	if (!filename) {
+		fprintf(stderr, "No memory\n");
+		free_config(&config);
+		return 1;
+	}
+	for (num = 1; ; num++) {
+		snprintf(filename, len, "%s.%d", config.log_file, num);
+		if (access(filename, R_OK) != 0)
+			break;
+		if (index_build(filename))
+			rc = 1;
+	}
+	index_prune(config.log_file);
+	free(filename);
+	free_config(&config);
+	return rc;
+}
+
 /*
  * Decide if we should start outputing events given we loaded a checkpoint.
  *
@@ -429,7 +565,11 @@ static int process_log_fd(void)
  		 * completed from the rest of it's records we expect to find
  		 * in the next file we are about to process.
  		 */
-		if (match(entries)) {
+		if (query_filename) {
+			// Each search writes its own matches
+			if (query_match(entries))
+				found = 1;
+		} else if (match(entries)) {
 			/*
 			 * If we are checkpointing, decide if we output
 			 * this event
@@ -470,7 +610,7 @@ static int process_log_fd(void)
 				break;
 			}
 			if (line_buffered)
-				fflush(stdout);
+				output_flush();
 		}
 		list_clear(entries);
 		free(entries);
@@ -487,6 +627,10 @@ static void alarm_handler(int signal)
 
 static int process_stdin(void)
 {
+	if (last_events) {
+		fprintf(stderr, "--last can't read events from a pipe\n");
+		return 1;
+	}
 	log_fd = stdin;
 	input_is_pipe=1;
 
@@ -499,6 +643,10 @@ static int process_stdin(void)
 
 static int process_file(char *filename)
 {
+	int rc;
+
+	if (last_events)
+		return process_file_reverse(filename);
 	log_fd = fopen(filename, "rm");
 	if (log_fd == NULL) {
 		fprintf(stderr, "Error opening %s (%s)\n", filename, 
@@ -507,7 +655,104 @@ static int process_file(char *filename)
 	}
 
 	__fsetlocking(log_fd, FSETLOCKING_BYCALLER);
-	return process_log_fd();
+	// Checkpoints need to see every complete event
+	if (checkpt_filename == NULL)
+		index_open(filename, log_fd);
+	rc = process_log_fd();
+	index_close();
+	return rc;
+}
+
+/*
+ * With --last, the logs are read from the end back and the matching
+ * events are kept until enough are found. This function returns 1 when
+ * no more are needed.
+ */
+static int keep_last(llist *l)
+{
+	if (match(l) == 0) {
+		list_clear(l);
+		free(l);
+		return 0;
+	}
+	if (last_cnt == last_size) {
+		unsigned long size = last_size ? last_size * 2 : 64;
+		llist **tmp;
+
+		if (size > last_events)
+			size = last_events;
+		tmp = realloc(last_found, size * sizeof(llist *));
+		if (tmp == NULL) {
+			list_clear(l);
+			free(l);
+			last_done = 1;
+			return 1;
+		}
+		last_found = tmp;
+		last_size = size;
+	}
+	last_found[last_cnt++] = l;
+	if (last_cnt == last_events)
+		last_done = 1;
+	return last_done;
+}
+
+static int process_file_reverse(const char *filename)
+{
+	char buff[MAX_AUDIT_MESSAGE_LENGTH];
+	rfile *f;
+	llist *l;
+	int rc = 0, old = 0;
+
+	f = rfile_open(filename);
+	if (f == NULL) {
+		fprintf(stderr, "Error opening %s (%s)\n", filename, 
+			strerror(errno));
+		return 1;
+	}
+	while (!last_done && rfile_gets(buff, sizeof(buff), f)) {
+		rlol_add_record(&rlo, buff);
+		while (!last_done && (l = rlol_get_ready_event(&rlo)))
+			keep_last(l);
+		// Older records can't be in an event after the start time,
+		// once enough in a row show they didn't come late
+		if (start_time && rlo.sec && rlo.sec + 2 < start_time) {
+			if (++old > OLD_RECORDS)
+				last_done = 1;
+		} else
+			old = 0;
+	}
+	if (rfile_error(f)) {
+		fprintf(stderr, "Error reading %s (%s)\n", filename,
+			strerror(rfile_error(f)));
+		rc = 1;
+	}
+	rfile_close(f);
+	return rc;
+}
+
+/* Writes the --last events, oldest first */
+static void output_last(void)
+{
+	llist *l;
+
+	rlol_terminate_all_events(&rlo);
+	// Reading may have stopped before these were done, so last_done
+	// can be set already
+	while (last_cnt < last_events && (l = rlol_get_ready_event(&rlo)))
+		keep_last(l);
+	while (last_cnt) {
+		l = last_found[--last_cnt];
+		found = 1;
+		output_record(l);
+		if (line_buffered)
+			output_flush();
+		list_clear(l);
+		free(l);
+	}
+	free(last_found);
+	last_found = NULL;
+	rlol_clear(&rlo);
 }
 
 /*
@@ -554,6 +799,7 @@ static int get_record(llist **l)
 		}
 
 		if (rc) {
+			index_skip(log_fd, buff);
 			if (lol_add_record(&lo, buff)) {
 				*l = get_ready_event(&lo);
 				if (*l)
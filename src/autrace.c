@@ -39,7 +39,6 @@
  */
 static int threat = 0;
 static int count_rules(void);
-static int count_em(int fd);
 extern int delete_all_rules(int fd);
 
 static void usage(void)
@@ -47,6 +46,17 @@ static void usage(void)
 	fprintf(stderr, "usage: autrace [-r] program\n");
 }
 
+/* What -r watches for. The network ones go last, see insert_rule. */
+static const char *const threat_syscalls[] = {
+	"open", "openat", "creat", "truncate", "rename", "renameat",
+	"unlink", "unlinkat", "mknod", "mknodat", "mkdir", "mkdirat",
+	"rmdir", "chdir", "chown", "lchown", "fchownat", "chmod",
+	"fchmodat", "link", "linkat", "symlink", "symlinkat", "readlink",
+	"readlinkat", "execve", "name_to_handle_at", "sendfile",
+	"connect", "bind", "accept", "sendto", "recvfrom", "accept4"
+};
+#define NET_SYSCALLS 6
+
 static int insert_rule(int audit_fd, const char *field)
 {
 	int rc;
@@ -60,46 +70,18 @@ static int insert_rule(int audit_fd, const char *field)
 		goto err;
 	memset(rule, 0, sizeof(struct audit_rule_data));
 	if (threat) {
-		rc = 0;
-		rc |= audit_rule_syscallbyname_data(rule, "open");
-		rc |= audit_rule_syscallbyname_data(rule, "openat");
-		rc |= audit_rule_syscallbyname_data(rule, "creat");
-		rc |= audit_rule_syscallbyname_data(rule, "truncate");
-		rc |= audit_rule_syscallbyname_data(rule, "rename");
-		rc |= audit_rule_syscallbyname_data(rule, "renameat");
-		rc |= audit_rule_syscallbyname_data(rule, "unlink");
-		rc |= audit_rule_syscallbyname_data(rule, "unlinkat");
-		rc |= audit_rule_syscallbyname_data(rule, "mknod");
-		rc |= audit_rule_syscallbyname_data(rule, "mknodat");
-		rc |= audit_rule_syscallbyname_data(rule, "mkdir");
-		rc |= audit_rule_syscallbyname_data(rule, "mkdirat");
-		rc |= audit_rule_syscallbyname_data(rule, "rmdir");
-		rc |= audit_rule_syscallbyname_data(rule, "chdir");
-		rc |= audit_rule_syscallbyname_data(rule, "chown");
-		rc |= audit_rule_syscallbyname_data(rule, "lchown");
-		rc |= audit_rule_syscallbyname_data(rule, "fchownat");
-		rc |= audit_rule_syscallbyname_data(rule, "chmod");
-		rc |= audit_rule_syscallbyname_data(rule, "fchmodat");
-		rc |= audit_rule_syscallbyname_data(rule, "link");
-		rc |= audit_rule_syscallbyname_data(rule, "linkat");
-		rc |= audit_rule_syscallbyname_data(rule, "symlink");
-		rc |= audit_rule_syscallbyname_data(rule, "symlinkat");
-		rc |= audit_rule_syscallbyname_data(rule, "readlink");
-		rc |= audit_rule_syscallbyname_data(rule, "readlinkat");
-		rc |= audit_rule_syscallbyname_data(rule, "execve");
-		rc |= audit_rule_syscallbyname_data(rule, "name_to_handle_at");
+		int nums[sizeof(threat_syscalls)/sizeof(threat_syscalls[0])];
+		int i, n = sizeof(threat_syscalls)/sizeof(threat_syscalls[0]);
 
-		if (machine != MACH_X86 && machine != MACH_S390X && 
-						machine != MACH_S390) {
-			rc |= audit_rule_syscallbyname_data(rule, "connect");
-			rc |= audit_rule_syscallbyname_data(rule, "bind");
-			rc |= audit_rule_syscallbyname_data(rule, "accept");
-			rc |= audit_rule_syscallbyname_data(rule, "sendto");
-			rc |= audit_rule_syscallbyname_data(rule, "recvfrom");
-			rc |= audit_rule_syscallbyname_data(rule, "accept4");
-		}
-
-		rc |= audit_rule_syscallbyname_data(rule, "sendfile");
+		// These reach the network calls through socketcall, below
+		if (machine == MACH_X86 || machine == MACH_S390X ||
+						machine == MACH_S390)
+			n -= NET_SYSCALLS;
+		rc = 0;
+		if (audit_names_to_syscalls(threat_syscalls, n, machine, nums))
+			rc = -1;
+		for (i = 0; i < n && rc == 0; i++)
+			rc = audit_rule_syscall_data(rule, nums[i]);
 	} else
 		rc = audit_rule_syscallbyname_data(rule, "all");
 	if (rc < 0)
@@ -266,9 +248,17 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+/* Counts each rule listed */
+static int count_reply(struct audit_reply *rep, void *data)
+{
+	if (rep->type == AUDIT_LIST_RULES)
+		(*(int *)data)++;
+	return 0;
+}
+
 static int count_rules(void)
 {
-	int fd, total, rc;
+	int fd, total = 0, rc;
 
 	fd = audit_open();
 	if (fd < 0) 
@@ -276,52 +266,13 @@ static int count_rules(void)
 
 	rc = audit_request_rules_list_data(fd);
 	if (rc > 0) 
-		total = count_em(fd);
+		rc = audit_wait_replies(fd, rc, count_reply, &total, 4000);
 	else 
-		total = -1;
+		rc = -1;
 
 	close(fd); 
+	if (rc < 0 && rc != -ETIMEDOUT)
+		return -1;
 	return total;
 }
 
-static int count_em(int fd)
-{
-	int i, retval, count = 0;
-	int timeout = 40; /* loop has delay of .1 - this is 4 seconds */
-	struct audit_reply rep;
-	fd_set read_mask;
-
-	FD_ZERO(&read_mask);
-	FD_SET(fd, &read_mask);
-
-	for (i = 0; i < timeout; i++) {
-		retval = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
-		if (retval > 0) {
-			struct timeval t;
-
-			if (rep.type == NLMSG_ERROR && 
-					rep.error->error == 0)
-				continue;
-			t.tv_sec  = 0;
-			t.tv_usec = 100000; /* .1 second */
-			do {
-				retval=select(fd+1, &read_mask, NULL, NULL, &t);
-			} while (retval < 0 && errno == EINTR);
-			switch (rep.type)
-			{
-				case NLMSG_DONE:
-					return count;
-				case AUDIT_LIST_RULES:
-					i = 0;
-					count++;
-					break;
-				case NLMSG_ERROR:
-					return -1;
-				default:
-					break;
-			}
-		}
-	}
-	return count;
-}
-
@@ -21,6 +21,7 @@
  */
 #include "config.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -31,13 +32,35 @@
 
 extern int key_match(const struct audit_rule_data *r);
 
+/* Keeps the listed rules that match the key */
+static int list_reply(struct audit_reply *rep, void *data)
+{
+	llist *l = data;
+
+	if (rep->type == NLMSG_ERROR && rep->error->error) {
+		fprintf(stderr, 
+			"Error receiving rules list (%s)\n", 
+			strerror(-rep->error->error));
+		return rep->error->error;
+	}
+
+	/* If its not what we are expecting, keep looping */
+	if (rep->type != AUDIT_LIST_RULES)
+		return 0;
+
+	if (key_match(rep->ruledata))
+		list_append(l, rep->ruledata, 
+			sizeof(struct audit_rule_data) +
+			rep->ruledata->buflen);
+	return 0;
+}
+
 /* Returns 0 for success and -1 for failure */
 int delete_all_rules(int fd)
 {
-	int seq, i, rc;
-	int timeout = 40; /* tenths of seconds */
-	struct audit_reply rep;
-	fd_set read_mask;
+	int seq, i, rc = 0;
+	struct audit_rule_data **rules;
+	int *errors;
 	llist l;
 	lnode *n;
 
@@ -46,64 +69,43 @@ int delete_all_rules(int fd)
 	if (seq <= 0) 
 		return -1;
 
-	FD_ZERO(&read_mask);
-	FD_SET(fd, &read_mask);
 	list_create(&l);
-
-	for (i = 0; i < timeout; i++) {
-		struct timeval t;
-
-		t.tv_sec  = 0;
-		t.tv_usec = 100000; /* .1 second */
-		do {
-			rc = select(fd+1, &read_mask, NULL, NULL, &t);
-		} while (rc < 0 && errno == EINTR);
-		// We'll try to read just in case
-		rc = audit_get_reply(fd, &rep, GET_REPLY_NONBLOCKING, 0);
-		if (rc > 0) {
-			/* Reset timeout */
-			i = 0;
-
-			/* Don't make decisions based on wrong packet */
-			if (rep.nlh->nlmsg_seq != seq)
-				continue;
-
-			/* If we get done or error, break out */
-			if (rep.type == NLMSG_DONE)
-				break;
-
-			if (rep.type == NLMSG_ERROR && rep.error->error) {
-				fprintf(stderr, 
-					"Error receiving rules list (%s)\n", 
-					strerror(-rep.error->error));
-				return -1;
-			}
-
-			/* If its not what we are expecting, keep looping */
-			if (rep.type != AUDIT_LIST_RULES)
-				continue;
-
-			if (key_match(rep.ruledata))
-				list_append(&l, rep.ruledata, 
-					sizeof(struct audit_rule_data) +
-					rep.ruledata->buflen);
-
-		}
+	rc = audit_wait_replies(fd, seq, list_reply, &l, 40000);
+	/* If the kernel stops answering, delete what was listed */
+	if (rc < 0 && rc != -ETIMEDOUT) {
+		list_clear(&l);
+		return -1;
+	}
+	rc = 0;
+	if (l.cnt == 0)
+		return 0;
+
+	/* Bounce them right back with delete */
+	rules = malloc(l.cnt * sizeof(struct audit_rule_data *));
+	errors = malloc(l.cnt * sizeof(int));
+	if (rules == NULL || errors == NULL) {
+		fprintf(stderr, "Out of memory deleting rules\n");
+		rc = -1;
+		goto out;
 	}
 	list_first(&l);
-	n = l.cur;
-	while (n) {
-		/* Bounce it right back with delete */
-		rc = audit_send(fd, AUDIT_DEL_RULE, n->r, n->size);
-		if (rc < 0) {
+	for (i = 0, n = l.cur; n; n = list_next(&l))
+		rules[i++] = n->r;
+	if (audit_delete_rules_batch(fd, rules, l.cnt, errors)) {
+		for (i = 0; i < (int)l.cnt; i++) {
+			if (errors[i] == 0)
+				continue;
 			fprintf(stderr, "Error deleting rule (%s)\n",
-				strerror(-rc)); 
-			return -1;
+				strerror(-errors[i])); 
+			rc = -1;
+			break;
 		}
-		n = list_next(&l);
 	}
+out:
+	free(rules);
+	free(errors);
 	list_clear(&l);
 
-	return 0;
+	return rc;
 }
 
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libaudit.h"
+#include "auditd-backlog.h"
+
+/* auditd-backlog.o logs through this */
+void audit_msg(int priority, const char *fmt, ...)
+{
+}
+
+static int status(unsigned int backlog, unsigned int limit,
+	unsigned int lost)
+{
+	struct audit_status s;
+
+	memset(&s, 0, sizeof(s));
+	s.backlog = backlog;
+	s.backlog_limit = limit;
+	s.lost = lost;
+	return backlog_status(&s);
+}
+
+static char *report(void)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f = open_memstream(&buf, &len);
+
+	if (f == NULL)
+		exit(1);
+	backlog_report(f);
+	fclose(f);
+	return buf;
+}
+
+int main(void)
+{
+	char *buf;
+	int rc = 0;
+
+	// Lost before auditd looked doesn't count
+	if (status(100, 1000, 5) || backlog_draining()) {
+		printf("Drained on the first look\n");
+		rc = 1;
+	}
+	if (status(600, 1000, 5) != 1 || !backlog_draining()) {
+		printf("Didn't drain a high backlog\n");
+		rc = 1;
+	}
+	if (status(200, 1000, 5) || !backlog_draining()) {
+		printf("Stopped draining too soon\n");
+		rc = 1;
+	}
+	if (status(100, 1000, 5) != 1 || backlog_draining()) {
+		printf("Didn't stop draining\n");
+		rc = 1;
+	}
+	// Any loss drains, even with a low backlog
+	if (status(10, 1000, 8) != 1 || !backlog_draining()) {
+		printf("Didn't drain after a loss\n");
+		rc = 1;
+	}
+	if (status(0, 1000, 8) != 1 || backlog_draining()) {
+		printf("Didn't stop draining after a loss\n");
+		rc = 1;
+	}
+	buf = report();
+	if (strcmp(buf, "kernel status polls = 6\n"
+			"kernel backlog = 0\n"
+			"kernel backlog limit = 1000\n"
+			"kernel backlog high water = 600\n"
+			"kernel lost before start = 5\n"
+			"kernel lost = 3\n"
+			"drain mode = off\n"
+			"drain episodes = 2\n")) {
+		printf("Report is wrong:\n%s", buf);
+		rc = 1;
+	}
+	free(buf);
+
+	// The kernel's counter wraps
+	backlog_clear();
+	status(0, 0, 0xfffffffe);
+	status(0, 0, 1);
+	buf = report();
+	if (strstr(buf, "kernel lost = 3\n") == NULL) {
+		printf("Wrapped loss counted wrong:\n%s", buf);
+		rc = 1;
+	}
+	free(buf);
+	if (rc)
+		return 1;
+	printf("Backlog tests passed\n");
+	return 0;
+}
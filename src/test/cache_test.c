@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "libaudit.h"
+#include "auditctl-cache.h"
+
+#define KEY 0x1234567890abcdefULL
+
+static struct audit_rule_data *make_rule(const char *key)
+{
+	struct audit_rule_data *r;
+	size_t len = strlen(key);
+
+	r = calloc(1, sizeof(*r) + len);
+	if (r == NULL)
+		exit(1);
+	r->flags = AUDIT_FILTER_EXIT;
+	r->action = AUDIT_ALWAYS;
+	r->fields[0] = AUDIT_FILTERKEY;
+	r->fieldflags[0] = AUDIT_EQUAL;
+	r->values[0] = len;
+	r->field_count = 1;
+	memcpy(r->buf, key, len);
+	r->buflen = len;
+	r->mask[0] = 4;
+	return r;
+}
+
+static int write_cache(const char *path)
+{
+	char *line[] = { "auditctl", "-b", "8192", NULL };
+	struct audit_rule_data *r1 = make_rule("k1"), *r2 = make_rule("key2");
+	int rc;
+
+	cache_add_line(3, line, 1);
+	cache_add_rule(r1, 2);
+	cache_add_rule(r2, 4);
+	rc = cache_save(path, KEY);
+	cache_clear();
+	free(r1);
+	free(r2);
+	return rc;
+}
+
+static int check_cache(const char *path)
+{
+	struct audit_rule_data *r = make_rule("key2");
+	struct cache_item it;
+	int rc = 0;
+
+	if (cache_load(path, KEY)) {
+		printf("Cache didn't load\n");
+		free(r);
+		return 1;
+	}
+	if (!cache_next(&it) || it.type != CACHE_LINE || it.lineno != 1 ||
+			it.count != 3 || strcmp(it.fields[1], "-b") ||
+			strcmp(it.fields[2], "8192") || it.fields[3]) {
+		printf("Line entry is wrong\n");
+		rc = 1;
+	}
+	if (!cache_next(&it) || it.type != CACHE_RULE || it.lineno != 2 ||
+			it.rule->buflen != 2 || memcmp(it.rule->buf, "k1", 2)) {
+		printf("First rule is wrong\n");
+		rc = 1;
+	}
+	if (!cache_next(&it) || it.type != CACHE_RULE || it.lineno != 4 ||
+			it.size != sizeof(*r) + 4 || memcmp(it.rule, r, it.size)) {
+		printf("Second rule is wrong\n");
+		rc = 1;
+	}
+	if (cache_next(&it)) {
+		printf("Extra entry in cache\n");
+		rc = 1;
+	}
+	cache_clear();
+	free(r);
+	return rc;
+}
+
+int main(void)
+{
+	char name[] = "/tmp/cache_test.XXXXXX";
+	int fd, rc = 0;
+
+	// The cache has to be owned by root to be used
+	if (geteuid() != 0)
+		return 77;
+	fd = mkstemp(name);
+	if (fd < 0)
+		return 1;
+	close(fd);
+
+	rc |= write_cache(name) || check_cache(name);
+
+	// Written for other rules
+	if (cache_load(name, KEY + 1) != 1) {
+		printf("Stale cache was used\n");
+		rc = 1;
+	}
+
+	// Damaged on disk
+	fd = open(name, O_WRONLY);
+	if (fd < 0 || pwrite(fd, "x", 1, 100) != 1)
+		rc = 1;
+	close(fd);
+	if (cache_load(name, KEY) != -1) {
+		printf("Damaged cache was used\n");
+		rc = 1;
+	}
+
+	// Cut short
+	rc |= write_cache(name);
+	if (truncate(name, 80) || cache_load(name, KEY) != -1) {
+		printf("Short cache was used\n");
+		rc = 1;
+	}
+	unlink(name);
+
+	if (rc)
+		return 1;
+	printf("Rule cache tests passed\n");
+	return 0;
+}
+
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "ausearch-hash.h"
+#include "ausearch-string.h"
+#include "test_logs.h"
+
+shash s;
+ihash i;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Counts n adds spread over distinct keys with both the list and the
+ * hash table, like aureport --file --summary does on a busy system.
+ */
+static void bench(unsigned int n, unsigned int distinct)
+{
+	slist l;
+	shnode **sorted;
+	char buf[64];
+	unsigned int j, cnt;
+	double t;
+
+	slist_create(&l);
+	t = now();
+	for (j = 0; j < n; j++) {
+		snprintf(buf, sizeof(buf), "/usr/lib/file%u", j % distinct);
+		slist_add_if_uniq(&l, buf);
+	}
+	slist_sort_by_hits(&l);
+	printf("slist: %u adds, %u keys: %.3fs\n", n, l.cnt, now() - t);
+	slist_clear(&l);
+
+	shash_create(&s);
+	t = now();
+	for (j = 0; j < n; j++) {
+		snprintf(buf, sizeof(buf), "/usr/lib/file%u", j % distinct);
+		shash_add(&s, buf);
+	}
+	sorted = shash_sort_by_hits(&s, 0, &cnt);
+	printf("shash: %u adds, %u keys: %.3fs\n", n, cnt, now() - t);
+	free(sorted);
+	shash_clear(&s);
+}
+
+#define REPORT_LIMIT 60	// Seconds a report gets before it is cut off
+
+/*
+ * Writes a log of n syscalls that spread their files, executables and
+ * keys over distinct values each, and times the summaries of them with
+ * aureport, and with another build of it if one is given.
+ */
+static void bench_report(unsigned int n, unsigned int distinct,
+		const char *other)
+{
+	static const char *reports[] = {
+		"-f --summary", "-x --summary", "-k --summary"
+	};
+	const char *progs[] = { "../aureport", other };
+	char name[32], exe[32], key[32], cmd[512];
+	unsigned int j, k, p;
+	struct event e;
+	FILE *f;
+
+	if (setup_logs("aureport", "hash_test"))
+		return;
+	f = open_log(0);
+	if (f == NULL) {
+		printf("Can't make a log in %s\n", log_dir);
+		remove_logs();
+		return;
+	}
+	memset(&e, 0, sizeof(e));
+	e.type = EVENT_SYSCALL;
+	e.syscall = 2;
+	e.success = 1;
+	e.exit = 3;
+	e.name = name;
+	e.exe = exe;
+	e.key = key;
+	for (j = 0; j < n; j++) {
+		snprintf(name, sizeof(name), "/usr/lib/file%u", j % distinct);
+		snprintf(exe, sizeof(exe), "/usr/bin/prog%u",
+			(j * 7) % distinct);
+		snprintf(key, sizeof(key), "key%u", (j * 13) % distinct);
+		e.ms = j % 1000;
+		e.pid = 1000 + j % 30000;
+		e.auid = e.uid = 1000 + j % 50;
+		e.inode = j % distinct;
+		write_event(f, &e, NULL);
+		log_when += j % 8 == 0;
+	}
+	fclose(f);
+
+	for (p = 0; p < 2 && progs[p]; p++) {
+		for (k = 0; k < sizeof(reports)/sizeof(reports[0]); k++) {
+			double t = now();
+			int rc;
+
+			snprintf(cmd, sizeof(cmd), "timeout %u %s -if %s %s "
+				">/dev/null 2>&1", REPORT_LIMIT, progs[p],
+				log_dir, reports[k]);
+			rc = system(cmd);
+			if (WIFEXITED(rc) && WEXITSTATUS(rc) == 124)
+				printf("%s %s: over %us\n", progs[p],
+					reports[k], REPORT_LIMIT);
+			else
+				printf("%s %s: %.3fs\n", progs[p],
+					reports[k], now() - t);
+		}
+	}
+	remove_logs();
+}
+
+int main(int argc, char *argv[])
+{
+	shnode **ss;
+	ihnode **is;
+	char buf[32];
+	unsigned int cnt, j;
+
+	if (argc == 3 || argc == 4) {
+		unsigned int n = strtoul(argv[1], NULL, 10);
+		unsigned int distinct = strtoul(argv[2], NULL, 10);
+
+		bench(n, distinct);
+		bench_report(n, distinct, argc == 4 ? argv[3] : NULL);
+		return 0;
+	}
+
+	shash_create(&s);
+	if (shash_add(&s, "test1") != 1 || shash_add(&s, "test2") != 1 ||
+			shash_add(&s, "test2") != 0) {
+		puts("add returned the wrong value");
+		return 1;
+	}
+	shash_add(&s, "test3");
+	shash_add(&s, "test3");
+	shash_add(&s, "test4");
+	shash_add(&s, "test3");
+	if (s.cnt != 4) {
+		puts("test count is wrong");
+		return 1;
+	}
+
+	puts("should be test3 test2 test1 test4");
+	ss = shash_sort_by_hits(&s, 0, &cnt);
+	for (j = 0; j < cnt; j++)
+		printf("%u  %s\n", ss[j]->hits, ss[j]->str);
+	if (cnt != 4 || strcmp(ss[0]->str, "test3") || ss[0]->hits != 3 ||
+			strcmp(ss[1]->str, "test2") ||
+			strcmp(ss[2]->str, "test1") ||
+			strcmp(ss[3]->str, "test4")) {
+		puts("sort order is wrong");
+		return 1;
+	}
+	free(ss);
+
+	puts("should be test3 test2");
+	ss = shash_sort_by_hits(&s, 2, &cnt);
+	if (cnt != 2 || strcmp(ss[0]->str, "test3") ||
+			strcmp(ss[1]->str, "test2")) {
+		puts("top 2 is wrong");
+		return 1;
+	}
+	free(ss);
+
+	/* Enough to make the table grow a few times */
+	for (j = 0; j < 10000; j++) {
+		snprintf(buf, sizeof(buf), "key%u", j);
+		shash_add(&s, buf);
+		if (j % 7 == 0)
+			shash_add(&s, buf);
+	}
+	if (s.cnt != 10004) {
+		puts("test count is wrong after growing");
+		return 1;
+	}
+	ss = shash_sort_by_hits(&s, 5, &cnt);
+	if (cnt != 5 || strcmp(ss[0]->str, "test3") ||
+			strcmp(ss[1]->str, "test2") ||
+			strcmp(ss[2]->str, "key0") ||
+			strcmp(ss[3]->str, "key7") ||
+			strcmp(ss[4]->str, "key14")) {
+		puts("top 5 is wrong after growing");
+		return 1;
+	}
+	free(ss);
+
+	/* Merging keeps the first seen order of the tables in turn */
+	{
+		shash m;
+
+		shash_create(&m);
+		shash_add(&m, "key1");
+		shash_add(&m, "test1");
+		shash_add(&m, "new");
+		if (shash_merge(&s, &m) || s.cnt != 10005) {
+			puts("merge count is wrong");
+			return 1;
+		}
+		shash_add(&m, "test2");
+		shash_clear(&s);
+		shash_merge(&s, &m);
+		ss = shash_sort_by_hits(&s, 0, &cnt);
+		if (cnt != 4 || strcmp(ss[0]->str, "key1") ||
+				strcmp(ss[3]->str, "test2")) {
+			puts("merge order is wrong");
+			return 1;
+		}
+		free(ss);
+		shash_clear(&m);
+	}
+
+	shash_clear(&s);
+	puts("should be empty");
+	ss = shash_sort_by_hits(&s, 0, &cnt);
+	if (s.cnt != 0 || cnt != 0) {
+		puts("test count is wrong");
+		return 1;
+	}
+	free(ss);
+
+	ihash_create(&i);
+	ihash_add(&i, 5, 1);
+	ihash_add(&i, -1, 2);
+	ihash_add(&i, 5, 3);
+	ihash_add(&i, 3, 4);
+	ihash_add(&i, -1, 5);
+	ihash_add(&i, 7, 6);
+	puts("should be -1 5 3 7");
+	is = ihash_sort_by_hits(&i, 0, &cnt);
+	for (j = 0; j < cnt; j++)
+		printf("%u  %d\n", is[j]->hits, is[j]->num);
+	if (cnt != 4 || is[0]->num != -1 || is[0]->aux1 != 2 ||
+			is[1]->num != 5 || is[1]->aux1 != 1 ||
+			is[2]->num != 3 || is[3]->num != 7) {
+		puts("int sort order is wrong");
+		return 1;
+	}
+	free(is);
+	{
+		ihash m;
+
+		ihash_create(&m);
+		ihash_add(&m, 3, 9);
+		ihash_add(&m, 3, 9);
+		ihash_add(&m, 8, 9);
+		ihash_merge(&i, &m);
+		ihash_clear(&m);
+	}
+	puts("should be 3 -1 5 7 8");
+	is = ihash_sort_by_hits(&i, 0, &cnt);
+	if (cnt != 5 || is[0]->num != 3 || is[0]->hits != 3 ||
+			is[0]->aux1 != 4 || is[4]->num != 8) {
+		puts("int merge is wrong");
+		return 1;
+	}
+	free(is);
+	ihash_clear(&i);
+	if (i.cnt != 0) {
+		puts("int count is wrong");
+		return 1;
+	}
+	return 0;
+}
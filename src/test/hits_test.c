@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libaudit.h"
+#include "auditd-hits.h"
+
+static void feed(int type, const char *msg)
+{
+	struct audit_reply rep;
+
+	memset(&rep, 0, sizeof(rep));
+	rep.type = type;
+	rep.message = msg;
+	rep.len = strlen(msg);
+	hits_count(&rep);
+}
+
+/* Returns the report from the line after the column titles */
+static char *report(void)
+{
+	char *buf = NULL, *ptr;
+	size_t len = 0;
+	FILE *f = open_memstream(&buf, &len);
+
+	if (f == NULL)
+		exit(1);
+	hits_report(f);
+	fclose(f);
+	ptr = strstr(buf, "total  rule\n");
+	if (ptr == NULL) {
+		printf("Report has no titles\n");
+		exit(1);
+	}
+	ptr = strdup(ptr + 12);
+	free(buf);
+	return ptr;
+}
+
+int main(void)
+{
+	const char *expected =
+		"3  key=exec\n"
+		"2  key=net\n"
+		"2  syscall=chdir exe=/bin/bash\n"
+		"1  key=home\n"
+		"1  syscall=open exe=/bin/cat\n"
+		"1  syscall=chdir exe=?\n";
+	char *got;
+	int rc = 0;
+
+	feed(AUDIT_SYSCALL, "audit(1.0:1): arch=c000003e syscall=59 "
+		"success=yes exe=\"/bin/ls\" key=\"exec\"");
+	feed(AUDIT_SYSCALL, "audit(1.0:2): arch=c000003e syscall=59 "
+		"success=yes exe=\"/bin/ls\" key=\"exec\"");
+	// Two keys, hex encoded and split by the separator
+	feed(AUDIT_SYSCALL, "audit(1.0:3): arch=c000003e syscall=59 "
+		"success=yes exe=\"/bin/ls\" key=65786563016E6574");
+	feed(AUDIT_SYSCALL, "audit(1.0:4): arch=c000003e syscall=42 "
+		"success=yes exe=\"/bin/nc\" key=\"net\"");
+	feed(AUDIT_SYSCALL, "audit(1.0:5): arch=c000003e syscall=2 "
+		"success=yes exe=\"/bin/cat\" key=\"home\"");
+	// No key
+	feed(AUDIT_SYSCALL, "audit(1.0:6): arch=c000003e syscall=80 "
+		"success=yes exe=\"/bin/bash\" key=(null)");
+	feed(AUDIT_SYSCALL, "audit(1.0:7): arch=c000003e syscall=80 "
+		"success=yes exe=\"/bin/bash\" key=(null)");
+	feed(AUDIT_SYSCALL, "audit(1.0:8): arch=c000003e syscall=2 "
+		"success=no exe=\"/bin/cat\" key=(null)");
+	feed(AUDIT_SYSCALL, "audit(1.0:9): arch=c000003e syscall=80 "
+		"success=yes key=(null)");
+	// Not counted
+	feed(AUDIT_PATH, "audit(1.0:1): item=0 name=\"/tmp\" key=\"exec\"");
+
+	got = report();
+	if (strcmp(got, expected)) {
+		printf("Report is wrong:\n%s", got);
+		rc = 1;
+	}
+	free(got);
+
+	hits_clear();
+	got = report();
+	if (*got) {
+		printf("Counts weren't cleared:\n%s", got);
+		rc = 1;
+	}
+	free(got);
+	if (rc)
+		return 1;
+	printf("Rule hit tests passed\n");
+	return 0;
+}
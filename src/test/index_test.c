@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "test_logs.h"
+#include "ausearch-index.h"
+
+/*
+ * Runs ausearch over rotated logs of several index blocks each, before
+ * and after --build-index, and checks each search finds the same events.
+ * Near every 1MB of a log the records of events are mixed together, so
+ * the blocks have to be cut past events that span where they would be.
+ * Around 2MB one event with values found nowhere else has its records
+ * far apart, and a block cut between them would lose half of it.
+ */
+
+#define LOGS 4
+#define EVENTS 9000
+#define BLOCK (1024*1024)
+#define MIXED (48*1024)		// Bytes either side of a block size
+#define SPAN (16*1024)		// Bytes either side of 2MB the rare event takes
+
+static const char *keys[] = { "passwd", "mod", "time", "net" };
+static const char *exes[] = { "/bin/cat", "/usr/bin/ls", "/usr/sbin/sshd" };
+static const char *files[] = { "/etc/passwd", "/etc/shadow", "/tmp/x",
+	"/var/log/messages" };
+
+/* The PATH record of the last syscall, when it comes after the next
+ * event's records. At the end of a file it goes to the start of the
+ * next one. */
+static char pending[RECORD_MAX];
+/* The PATH record of the rare event, and whether a log has one yet */
+static char held[RECORD_MAX];
+static int rare_done;
+
+static void add_event(FILE *f, unsigned int n)
+{
+	long pos = ftell(f), off = pos % BLOCK;
+	int mixed = off < MIXED || off > BLOCK - MIXED;
+	int span = pos > 2 * BLOCK - SPAN && pos < 2 * BLOCK + SPAN;
+	int rare = span && !rare_done;
+	char path[RECORD_MAX];
+	struct event e;
+
+	if (held[0] && pos >= 2 * BLOCK + SPAN) {
+		fputs(held, f);
+		held[0] = 0;
+	}
+	// Events are only kept apart now and then near a block size
+	if (!mixed || n % 50 == 0) {
+		fputs(pending, f);
+		pending[0] = 0;
+	}
+	memset(&e, 0, sizeof(e));
+	e.ms = (n * 7) % 1000;
+	if (n % 5 == 4 && !rare) {
+		e.type = EVENT_LOGIN;
+		e.pid = 3000 + n;
+		e.auid = 1000 + n % 3;
+		e.host = n % 5;
+		e.success = n % 3 != 0;
+	} else {
+		e.type = EVENT_SYSCALL;
+		e.syscall = 2;
+		e.success = 1;
+		e.exit = 3;
+		e.pid = 2000 + n;
+		e.auid = rare ? 4321 : 1000 + n % 4;
+		e.uid = rare ? 4321 : n % 4;
+		e.exe = rare ? "/usr/bin/rare" :
+			n % 211 == 0 ? "/usr/bin/vi" : exes[n % 3];
+		e.key = rare ? "rarekey" : n % 193 == 0 ? "ab" : keys[n % 4];
+		e.name = rare ? "/etc/rare" : files[n % 4];
+		e.inode = 100 + n % 4;
+	}
+	write_event(f, &e, path);
+	if (rare) {
+		strcpy(held, path);
+		path[0] = 0;
+		rare_done = 1;
+	}
+	if (mixed) {
+		fputs(pending, f);
+		strcpy(pending, path);
+	} else
+		fputs(path, f);
+	// The clock stands still while the rare event is open
+	if (!span)
+		log_when++;
+}
+
+static int make_logs(void)
+{
+	unsigned int i, n;
+
+	// Oldest first, so the times go up through the files
+	for (i = LOGS; i > 0; i--) {
+		FILE *f = open_log(i - 1);
+
+		if (f == NULL)
+			return 1;
+		fputs(pending, f);
+		pending[0] = 0;
+		rare_done = 0;
+		for (n = 0; n < (i > 1 ? EVENTS : EVENTS / 5); n++)
+			add_event(f, n + i);
+		fclose(f);
+	}
+	return 0;
+}
+
+/* Returns the number of indexes */
+static unsigned int index_files(void)
+{
+	char path[128];
+	unsigned int cnt = 0;
+	DIR *d;
+
+	snprintf(path, sizeof(path), "%s/" INDEX_DIR, log_dir);
+	d = opendir(path);
+	if (d) {
+		struct dirent *ent;
+
+		while ((ent = readdir(d))) {
+			if (ent->d_name[0] != '.')
+				cnt++;
+		}
+		closedir(d);
+	}
+	return cnt;
+}
+
+static const char *searches[] = {
+	"-k rarekey",
+	"-k rarekey -w",
+	"-k ab",
+	"-k ab -w",
+	"-k net",
+	"-f /etc/rare",
+	"-f re",
+	"-x /usr/bin/rare",
+	"-x vi",
+	"-ui 4321",
+	"-ui 1002",
+	"-ua 4321",
+	"-ts 05/13/14 19:30:00 -te 05/13/14 19:45:00",
+	"-ts 05/13/14 19:30:00 -te 05/13/14 22:00:00 -k rarekey",
+	"-ts 05/14/14 00:10:00",
+	"-k nothere",
+};
+#define SEARCHES (sizeof(searches)/sizeof(searches[0]))
+
+int main(void)
+{
+	char *plain[SEARCHES], *out;
+	int status[SEARCHES], st, rc = 0;
+	unsigned int i;
+
+	st = setup_logs("ausearch", "index_test");
+	if (st)
+		return st;
+	if (make_logs()) {
+		printf("Can't make logs in %s\n", log_dir);
+		remove_logs();
+		return 1;
+	}
+
+	for (i = 0; i < SEARCHES; i++) {
+		plain[i] = run_tool("ausearch", searches[i], &status[i]);
+		// All but the last should find something
+		if (plain[i] == NULL || (i < SEARCHES - 1 &&
+				strlen(plain[i]) == 0)) {
+			printf("ausearch %s found nothing\n", searches[i]);
+			rc = 1;
+		}
+	}
+
+	// The current log gets no index
+	out = run_tool("ausearch", "--build-index", &st);
+	free(out);
+	if (st || index_files() != LOGS - 1) {
+		printf("ausearch --build-index failed\n");
+		rc = 1;
+	}
+
+	for (i = 0; i < SEARCHES; i++) {
+		out = run_tool("ausearch", searches[i], &st);
+		if (out == NULL || plain[i] == NULL || st != status[i] ||
+				strcmp(out, plain[i])) {
+			printf("ausearch %s differs with an index:\n%s\n----\n"
+				"%s\n", searches[i], plain[i] ? plain[i] : "",
+				out ? out : "");
+			rc = 1;
+		}
+		free(out);
+		free(plain[i]);
+	}
+
+	remove_logs();
+	if (rc == 0)
+		printf("%u tests passed\n", (unsigned int)SEARCHES + 1);
+	return rc;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "auditd-metrics.h"
+
+static char *report(void)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f = open_memstream(&buf, &len);
+
+	if (f == NULL)
+		exit(1);
+	metrics_report(f);
+	fclose(f);
+	return buf;
+}
+
+/* Returns the p50 reported for the queue depth */
+static unsigned long long depth_p50(void)
+{
+	char *buf = report(), *ptr;
+	unsigned long long p50 = 0;
+
+	ptr = strstr(buf, "queue depth = ");
+	if (ptr)
+		ptr = strstr(ptr, "p50=");
+	if (ptr)
+		p50 = strtoull(ptr + 4, NULL, 10);
+	free(buf);
+	return p50;
+}
+
+int main(void)
+{
+	uint64_t v;
+	char *buf;
+	int i, rc = 0;
+
+	for (i = 1; i <= 1000; i++)
+		metrics_record(H_QUEUE_DEPTH, i);
+	metrics_inc(M_QUEUED);
+	metrics_inc(M_QUEUED);
+	metrics_inc(M_QUEUED);
+	metrics_inc(M_LOGGED);
+	buf = report();
+	if (strstr(buf, "queue depth = count=1000 mean=500 p50=511 p90=959 "
+			"p99=1000 p99.9=1000 max=1000\n") == NULL ||
+			strstr(buf, "queued records = 3\n") == NULL ||
+			strstr(buf, "records waiting = 2\n") == NULL ||
+			strstr(buf, "log latency (us) = count=0\n") == NULL) {
+		printf("Report is wrong:\n%s", buf);
+		rc = 1;
+	}
+	free(buf);
+
+	// Each value is reported no more than an eighth over
+	for (v = 1; v < (1ULL << 40); v = v * 3 + 1) {
+		unsigned long long p50;
+
+		metrics_clear();
+		metrics_record(H_QUEUE_DEPTH, v);
+		metrics_record(H_QUEUE_DEPTH, v);
+		metrics_record(H_QUEUE_DEPTH, v + v / 4 + 2);
+		p50 = depth_p50();
+		if (p50 < v || p50 > v + v / 8) {
+			printf("p50 of %llu is %llu\n", (unsigned long long)v,
+				p50);
+			rc = 1;
+		}
+	}
+
+	// The biggest values have a bucket too
+	metrics_clear();
+	metrics_record(H_QUEUE_DEPTH, UINT64_MAX);
+	if (depth_p50() != UINT64_MAX) {
+		printf("Biggest value is lost\n");
+		rc = 1;
+	}
+	if (rc)
+		return 1;
+	printf("Metrics tests passed\n");
+	return 0;
+}
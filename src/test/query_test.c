@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_logs.h"
+
+/*
+ * Runs a file of searches with ausearch --queries and checks each output
+ * file holds what ausearch prints for that search on its own. The options
+ * on the command line go with every search. Some searches parse events
+ * the same way and share a parse, others don't, and their time ranges
+ * are different so the logs have to be read for the widest of them.
+ */
+
+#define LOGS 3
+#define EVENTS 400
+
+static const char *keys[] = { "none", "mod", "time", "net" };
+static const char *exes[] = { "/bin/cat", "/usr/bin/ls", "/usr/sbin/sshd" };
+
+static void add_event(FILE *f, unsigned int n)
+{
+	char name[16];
+	struct event e;
+
+	memset(&e, 0, sizeof(e));
+	e.ms = (n * 7) % 1000;
+	if (n % 4) {
+		snprintf(name, sizeof(name), "/etc/f%u", n % 6);
+		e.type = EVENT_SYSCALL;
+		e.syscall = n % 3 ? 2 : 59;
+		e.success = n % 5 != 0;
+		e.exit = n % 5 ? 3 : -13;
+		e.pid = 1000 + n % 9;
+		e.auid = e.uid = 1000 + n % 3;
+		e.exe = exes[n % 3];
+		e.key = keys[n % 4];
+		e.name = name;
+		e.inode = 100 + n % 6;
+	} else {
+		e.type = EVENT_LOGIN;
+		e.pid = 3000 + n;
+		e.auid = 1000 + n % 3;
+		e.host = n % 5;
+		e.success = n % 3 != 0;
+	}
+	write_event(f, &e, NULL);
+	log_when += 37;
+}
+
+static int make_logs(void)
+{
+	unsigned int i, n;
+
+	// Oldest first, so the times go up through the files
+	for (i = LOGS; i > 0; i--) {
+		FILE *f = open_log(i - 1);
+
+		if (f == NULL)
+			return 1;
+		for (n = 0; n < EVENTS; n++)
+			add_event(f, n + i);
+		fclose(f);
+	}
+	return 0;
+}
+
+/*
+ * The searches. The first one's time range is the narrowest, and others
+ * have no start or no end. The search with no options and -sc set the
+ * same options the parser looks at, but only -sc needs the syscall
+ * records parsed, so they can't share a parse. -k, -i, -f, and -hn each
+ * parse another way.
+ */
+static const char *searches[] = {
+	"-m USER_LOGIN -ts 05/13/14 18:00:00 -te 05/13/14 19:00:00",
+	"-te 05/13/14 17:30:00 -k net",
+	"-ui 1001 -ts 05/14/14 02:00:00",
+	"-k time",
+	"-k net",
+	"-k mod -i",
+	"-f /etc/f2",
+	"-x /usr/sbin/sshd -sv no",
+	"-hn 10.0.0.3",
+	"-m SYSCALL,USER_LOGIN -ua 1002",
+	"",
+	"-sc 59",
+};
+#define SEARCHES (sizeof(searches)/sizeof(searches[0]))
+
+/* Options given on the command line for all of the searches */
+static const char *globals[] = {
+	"",
+	"-sv yes",
+	"-ts 05/13/14 17:00:00 -te 05/14/14 03:00:00",
+	"-m SYSCALL",
+};
+#define GLOBALS (sizeof(globals)/sizeof(globals[0]))
+
+static void out_name(char *path, size_t size, unsigned int i)
+{
+	snprintf(path, size, "%s/out.%u", log_dir, i);
+}
+
+/* Returns 0 if each output of the queries matches a run of its own */
+static int compare(const char *global)
+{
+	char path[64], opts[256], *alone, *queried;
+	unsigned int i;
+	FILE *f;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), "%s/queries", log_dir);
+	f = fopen(path, "w");
+	if (f == NULL)
+		return 1;
+	fprintf(f, "# One search a line\n\n");
+	for (i = 0; i < SEARCHES; i++) {
+		out_name(opts, sizeof(opts), i);
+		fprintf(f, "%s %s\n", opts, searches[i]);
+	}
+	fclose(f);
+	snprintf(opts, sizeof(opts), "--queries %s %s", path, global);
+	free(run_tool("ausearch", opts, NULL));
+
+	for (i = 0; i < SEARCHES; i++) {
+		snprintf(opts, sizeof(opts), "%s %s", global, searches[i]);
+		alone = run_tool("ausearch", opts, NULL);
+		out_name(path, sizeof(path), i);
+		f = fopen(path, "r");
+		queried = f ? read_all(f) : NULL;
+		if (f)
+			fclose(f);
+		if (alone == NULL || queried == NULL ||
+				strcmp(alone, queried)) {
+			printf("ausearch %s differs in a query:\n%s\n----\n"
+				"%s\n", opts, alone ? alone : "",
+				queried ? queried : "");
+			rc = 1;
+		} else if (*global == 0 && *alone == 0) {
+			// Each search finds something on its own
+			printf("ausearch %s found nothing\n", opts);
+			rc = 1;
+		}
+		free(alone);
+		free(queried);
+	}
+	return rc;
+}
+
+int main(void)
+{
+	unsigned int g;
+	int rc = 0;
+
+	rc = setup_logs("ausearch", "query_test");
+	if (rc)
+		return rc;
+	if (make_logs()) {
+		printf("Can't make logs in %s\n", log_dir);
+		remove_logs();
+		return 1;
+	}
+	for (g = 0; g < GLOBALS; g++)
+		rc |= compare(globals[g]);
+	remove_logs();
+	if (rc == 0)
+		printf("%u tests passed\n", (unsigned int)(GLOBALS * SEARCHES));
+	return rc;
+}
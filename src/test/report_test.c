@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libaudit.h"
+#include "ausearch-options.h"
+#include "ausearch-llist.h"
+
+extern void output_record(llist *l);
+extern void output_to(FILE *f);
+
+/* An event with most of the kinds of fields ausearch -i interprets */
+static const struct {
+	int type;
+	const char *text;
+} records[] = {
+{ AUDIT_SYSCALL,
+"type=SYSCALL msg=audit(1400000001.123:4567): arch=c000003e syscall=2 success=no exit=-2 a0=7fff5c1a2b30 a1=0 a2=1b6 a3=0 items=1 ppid=1 pid=2345 auid=4294967295 uid=0 gid=0 euid=0 suid=0 fsuid=0 egid=0 sgid=0 fsgid=0 tty=pts0 ses=4294967295 comm=\"cat\" exe=\"/bin/cat\" key=6B3101707269766163792D6B6579" },
+{ AUDIT_CWD,
+"type=CWD msg=audit(1400000001.123:4567):  cwd=\"/root\"" },
+{ AUDIT_PATH,
+"type=PATH msg=audit(1400000001.123:4567): item=0 name=\"/etc/shadow\" inode=1234 dev=fd:00 mode=0100640 ouid=0 ogid=0 rdev=00:00 obj=system_u:object_r:shadow_t:s0 nametype=NORMAL" },
+{ AUDIT_EXECVE,
+"type=EXECVE msg=audit(1400000001.123:4567): argc=3 a0=\"cat\" a1=2D6E a2=\"/etc/shadow\"" },
+{ AUDIT_PROCTITLE,
+"type=PROCTITLE msg=audit(1400000001.123:4567): proctitle=636174002D6E" },
+{ AUDIT_USER_LOGIN,
+"node=h0 type=USER_LOGIN msg=audit(1400000001.123:4567): pid=2346 uid=0 auid=0 ses=1 msg='op=login id=0 exe=\"/usr/sbin/sshd\" hostname=10.0.0.1 addr=10.0.0.1 terminal=ssh res=success'" },
+{ AUDIT_AVC,
+"type=AVC msg=audit(1400000001.123:4567): avc:  denied  { read } for  pid=2345 comm=\"cat\" name=\"shadow\" dev=\"dm-0\" ino=1234 scontext=u:r:t:s0-s0:c0,c1 tcontext=system_u:object_r:shadow_t:s0 tclass=file permissive=0" },
+{ AUDIT_CONFIG_CHANGE,
+"type=CONFIG_CHANGE msg=audit(1400000001.123:4567): auid=0 ses=1 op=\"add_rule\" key=\"k2\" list=4 res=1" },
+};
+#define RECORDS (sizeof(records)/sizeof(records[0]))
+
+static const char *expected =
+"----\n"
+"type=CONFIG_CHANGE msg=audit(05/13/14 16:53:21.123:4567) : auid=root ses=1 op=\"add_rule\" key=k2 list=exit res=yes \n"
+"type=AVC msg=audit(05/13/14 16:53:21.123:4567) : avc:  denied  { read } for  pid=2345 comm=cat name=shadow dev=\"dm-0\" ino=1234 scontext=u:r:t:s0-s0:c0,c1 tcontext=system_u:object_r:shadow_t:s0 tclass=file permissive=0 \n"
+"node=h0 type=USER_LOGIN msg=audit(05/13/14 16:53:21.123:4567) : pid=2346 uid=root auid=root ses=1 msg='op=login id=root exe=/usr/sbin/sshd hostname=10.0.0.1 addr=10.0.0.1 terminal=ssh res=success' \n"
+"type=PROCTITLE msg=audit(05/13/14 16:53:21.123:4567) : proctitle=cat \n"
+"type=EXECVE msg=audit(05/13/14 16:53:21.123:4567) : argc=3 a0=cat a1=-n a2=/etc/shadow \n"
+"type=PATH msg=audit(05/13/14 16:53:21.123:4567) : item=0 name=/etc/shadow inode=1234 dev=fd:00 mode=file,640 ouid=root ogid=root rdev=00:00 obj=system_u:object_r:shadow_t:s0 nametype=NORMAL \n"
+"type=CWD msg=audit(05/13/14 16:53:21.123:4567) :  cwd=/root \n"
+"type=SYSCALL msg=audit(05/13/14 16:53:21.123:4567) : arch=x86_64 syscall=open success=no exit=-2(No such file or directory) a0=0x7fff5c1a2b30 a1=O_RDONLY a2=0x1b6 a3=0x0 items=1 ppid=1 pid=2345 auid=unset uid=root gid=root euid=root suid=root fsuid=root egid=root sgid=root fsgid=root tty=pts0 ses=unset comm=cat exe=/bin/cat key=k1 key=privacy-key \n";
+
+static void make_event(llist *l)
+{
+	unsigned int i;
+	lnode n;
+
+	list_create(l);
+	l->e.sec = 1400000001;
+	l->e.milli = 123;
+	l->e.serial = 4567;
+	for (i = 0; i < RECORDS; i++) {
+		memset(&n, 0, sizeof(n));
+		n.message = strdup(records[i].text);
+		n.type = records[i].type;
+		if (i == 0) {
+			n.a0 = 0x7fff5c1a2b30ULL;
+			n.a1 = 0;
+		}
+		list_append(l, &n);
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Times writing n copies of the event with ausearch -i formatting */
+static void bench(llist *l, unsigned int n)
+{
+	unsigned int j;
+	FILE *f;
+	double t;
+
+	f = fopen("/dev/null", "w");
+	if (f == NULL)
+		exit(1);
+	output_to(f);
+	t = now();
+	for (j = 0; j < n; j++)
+		output_record(l);
+	output_to(stdout);
+	t = now() - t;
+	printf("interpreted: %u events, %u records: %.3fs, %.0f records/s\n",
+		n, n * l->cnt, t, n * l->cnt / t);
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	char buf[8192];
+	size_t len;
+	llist l;
+	FILE *f;
+
+	setenv("TZ", "UTC", 1);
+	tzset();
+	report_format = RPT_INTERP;
+	make_event(&l);
+
+	if (argc == 2) {
+		bench(&l, strtoul(argv[1], NULL, 10));
+		list_clear(&l);
+		return 0;
+	}
+
+	// Written twice, the output has to be the same both times
+	f = tmpfile();
+	if (f == NULL)
+		return 1;
+	output_to(f);
+	output_record(&l);
+	output_record(&l);
+	output_to(stdout);
+	rewind(f);
+	len = fread(buf, 1, sizeof(buf) - 1, f);
+	buf[len] = 0;
+	fclose(f);
+	list_clear(&l);
+	if (len != 2 * strlen(expected) ||
+			strncmp(buf, expected, strlen(expected)) ||
+			strcmp(buf + strlen(expected), expected)) {
+		printf("Interpreted output is wrong:\n%s", buf);
+		return 1;
+	}
+	printf("Interpreted output test passed\n");
+	return 0;
+}
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "libaudit.h"
+#include "ausearch-lol.h"
+#include "ausearch-reverse.h"
+
+/* Writes lines of many lengths, with a few longer than a read block */
+static int write_file(const char *name, unsigned int lines, int last_nl)
+{
+	FILE *f;
+	unsigned int i, j, len;
+
+	f = fopen(name, "w");
+	if (f == NULL)
+		return 1;
+	for (i = 0; i < lines; i++) {
+		len = (i * 7919) % 300;
+		if (i % 1000 == 999)
+			len = 100000 + i;
+		fprintf(f, "%u:", i);
+		for (j = 0; j < len; j++)
+			fputc('a' + (i + j) % 26, f);
+		if (i + 1 < lines || last_nl)
+			fputc('\n', f);
+	}
+	return fclose(f);
+}
+
+/* Reads the file forward and back, the lines have to be the same */
+static int check_file(const char *name, unsigned int lines)
+{
+	static char fbuf[256*1024], rbuf[256*1024];
+	char **fwd;
+	unsigned int i = 0, n = 0;
+	FILE *f;
+	rfile *r;
+	int rc = 0;
+
+	fwd = calloc(lines + 1, sizeof(char *));
+	f = fopen(name, "r");
+	if (fwd == NULL || f == NULL)
+		return 1;
+	while (fgets(fbuf, sizeof(fbuf), f) && n <= lines)
+		fwd[n++] = strdup(fbuf);
+	fclose(f);
+
+	r = rfile_open(name);
+	if (r == NULL)
+		return 1;
+	while (rfile_gets(rbuf, sizeof(rbuf), r)) {
+		if (i >= n || strcmp(rbuf, fwd[n - 1 - i])) {
+			printf("%s: line %u from the end is wrong\n", name, i);
+			rc = 1;
+			break;
+		}
+		i++;
+	}
+	if (rc == 0 && (i != n || rfile_error(r))) {
+		printf("%s: read %u lines back, expected %u\n", name, i, n);
+		rc = 1;
+	}
+	rfile_close(r);
+	for (i = 0; i < n; i++)
+		free(fwd[i]);
+	free(fwd);
+	return rc;
+}
+
+#define REC(type, sec, serial, text) \
+	"type=" type " msg=audit(" #sec ".100:" #serial "): " text
+
+/* Records of interleaved events, oldest first */
+static const char *records[] = {
+	REC("SYSCALL", 1400000001, 10, "arch=c000003e syscall=2"),
+	REC("SYSCALL", 1400000001, 11, "arch=c000003e syscall=4"),
+	REC("CWD", 1400000001, 10, "cwd=\"/\""),
+	REC("PATH", 1400000001, 11, "item=0 name=\"/b\""),
+	REC("PATH", 1400000001, 10, "item=0 name=\"/a\""),
+	REC("USER_LOGIN", 1400000002, 12, "pid=1 uid=0"),
+	REC("SYSCALL", 1400000009, 13, "arch=c000003e syscall=59"),
+	REC("EXECVE", 1400000009, 13, "argc=1 a0=\"ls\""),
+};
+#define RECORDS (sizeof(records)/sizeof(records[0]))
+
+/* The events that should come out, newest first */
+static const struct {
+	unsigned long serial;
+	unsigned int cnt;
+	unsigned int first;	// Index of its first record
+} events[] = {
+	{ 13, 2, 6 },
+	{ 12, 1, 5 },
+	{ 10, 3, 0 },
+	{ 11, 2, 1 },
+};
+#define EVENTS (sizeof(events)/sizeof(events[0]))
+
+static int check_events(void)
+{
+	rlol r;
+	llist *l;
+	unsigned int i, e = 0;
+	int rc = 0;
+
+	rlol_create(&r);
+	for (i = RECORDS; i > 0; i--) {
+		rlol_add_record(&r, records[i - 1]);
+		// The older records could have come late
+		if ((l = rlol_get_ready_event(&r))) {
+			printf("Event %lu finished early\n", l->e.serial);
+			list_clear(l);
+			free(l);
+			rc = 1;
+		}
+	}
+	rlol_terminate_all_events(&r);
+	while ((l = rlol_get_ready_event(&r))) {
+		if (e >= EVENTS || l->e.serial != events[e].serial ||
+				l->cnt != events[e].cnt ||
+				strcmp(l->head->message,
+					records[events[e].first])) {
+			printf("Event %u is wrong: serial %lu, %u records\n",
+				e, l->e.serial, l->cnt);
+			rc = 1;
+		}
+		e++;
+		list_clear(l);
+		free(l);
+	}
+	if (e != EVENTS) {
+		printf("Got %u events, expected %u\n", e, (unsigned)EVENTS);
+		rc = 1;
+	}
+	rlol_clear(&r);
+	return rc;
+}
+
+/* An event is done once enough records in a row are more than 2 seconds
+ * older than it */
+static int check_old(void)
+{
+	char buf[256];
+	unsigned int i;
+	llist *l;
+	rlol r;
+	int rc = 0;
+
+	rlol_create(&r);
+	rlol_add_record(&r, records[RECORDS - 1]);
+	rlol_add_record(&r, records[RECORDS - 2]);
+	for (i = 0; i < 9 && rc == 0; i++) {
+		snprintf(buf, sizeof(buf), "type=USER_LOGIN msg=audit("
+			"1400000001.100:%u): pid=1 uid=0", 30 + i);
+		rlol_add_record(&r, buf);
+		l = rlol_get_ready_event(&r);
+		if ((l == NULL) != (i < 8)) {
+			printf("Event %s after %u older records\n",
+				l ? "finished" : "not finished", i + 1);
+			rc = 1;
+		} else if (l && (l->e.serial != 13 || l->cnt != 2)) {
+			printf("Event %lu finished instead of 13\n",
+				l->e.serial);
+			rc = 1;
+		}
+		if (l) {
+			list_clear(l);
+			free(l);
+		}
+	}
+	rlol_clear(&r);
+	return rc;
+}
+
+/* Records of an event that a newer one is logged between, oldest first */
+static const char *spread[] = {
+	REC("SYSCALL", 1400000020, 20, "arch=c000003e syscall=2"),
+	REC("PATH", 1400000020, 20, "item=0 name=\"/a\""),
+	REC("SYSCALL", 1400000024, 21, "arch=c000003e syscall=4"),
+	REC("PATH", 1400000024, 21, "item=0 name=\"/b\""),
+	REC("CWD", 1400000020, 20, "cwd=\"/\""),
+	REC("PATH", 1400000020, 20, "item=1 name=\"/c\""),
+	REC("USER_AUTH", 1400000025, 22, "pid=1 uid=0"),
+	REC("CRED_ACQ", 1400000025, 22, "pid=1 uid=0"),
+};
+#define SPREAD (sizeof(spread)/sizeof(spread[0]))
+
+/*
+ * Reading back has to put the records into the same events as reading
+ * forward does. That splits serial 20 where serial 21 is more than 2
+ * seconds newer, and serial 22 as its records are events on their own.
+ */
+static int check_spread(void)
+{
+	llist *fwd[SPREAD], *l;
+	unsigned int i, n = 0, e = 0;
+	lol lo;
+	rlol r;
+	int rc = 0;
+
+	lol_create(&lo);
+	lo.all_times = 1;
+	for (i = 0; i < SPREAD; i++) {
+		char buf[256];
+
+		strcpy(buf, spread[i]);
+		lol_add_record(&lo, buf);
+	}
+	terminate_all_events(&lo);
+	while (n < SPREAD && (l = get_ready_event(&lo)))
+		fwd[n++] = l;
+	if (n != 5) {
+		printf("Read forward, got %u events, expected 5\n", n);
+		rc = 1;
+	}
+
+	rlol_create(&r);
+	for (i = SPREAD; i > 0; i--)
+		rlol_add_record(&r, spread[i - 1]);
+	rlol_terminate_all_events(&r);
+	while ((l = rlol_get_ready_event(&r))) {
+		for (i = 0; i < n; i++) {
+			if (fwd[i] && fwd[i]->e.serial == l->e.serial &&
+					fwd[i]->cnt == l->cnt &&
+					strcmp(fwd[i]->head->message,
+						l->head->message) == 0)
+				break;
+		}
+		if (i < n) {
+			list_clear(fwd[i]);
+			free(fwd[i]);
+			fwd[i] = NULL;
+		} else {
+			printf("Event %u read back is not one read forward: "
+				"serial %lu, %u records\n", e, l->e.serial,
+				l->cnt);
+			rc = 1;
+		}
+		e++;
+		list_clear(l);
+		free(l);
+	}
+	if (e != n) {
+		printf("Read back, got %u events, expected %u\n", e, n);
+		rc = 1;
+	}
+	for (i = 0; i < n; i++) {
+		if (fwd[i]) {
+			list_clear(fwd[i]);
+			free(fwd[i]);
+		}
+	}
+	rlol_clear(&r);
+	lol_clear(&lo);
+	return rc;
+}
+
+int main(void)
+{
+	char name[] = "/tmp/reverse_test.XXXXXX";
+	int fd, rc = 0;
+
+	fd = mkstemp(name);
+	if (fd < 0)
+		return 1;
+	close(fd);
+
+	rc |= write_file(name, 5000, 1) || check_file(name, 5000);
+	rc |= write_file(name, 5000, 0) || check_file(name, 5000);
+	rc |= write_file(name, 1, 0) || check_file(name, 1);
+	rc |= write_file(name, 0, 1) || check_file(name, 0);
+	unlink(name);
+
+	rc |= check_events();
+	rc |= check_old();
+	rc |= check_spread();
+	if (rc)
+		return 1;
+	printf("Reverse reading tests passed\n");
+	return 0;
+}
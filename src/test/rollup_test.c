@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "test_logs.h"
+#include "aureport-rollup.h"
+
+/*
+ * Runs aureport summaries over rotated logs with and without --rollup and
+ * checks they agree, including for -ts/-te windows that cut through the
+ * hours the rollups are kept in and after a log changes under a rollup.
+ * The last event of each rotated log ends in the log after it.
+ */
+
+#define LOGS 4
+#define EVENTS 400
+
+static const char *keys[] = { "passwd", "mod", "time", "net" };
+static const char *exes[] = { "/bin/cat", "/usr/bin/ls", "/usr/sbin/sshd" };
+
+/* The PATH record of the last event of a log, which goes at the start of
+ * the next one */
+static char pending[RECORD_MAX];
+
+static void add_event(FILE *f, unsigned int n, char *path)
+{
+	char name[16];
+	struct event e;
+
+	memset(&e, 0, sizeof(e));
+	e.ms = (n * 7) % 1000;
+	if (n % 4) {
+		snprintf(name, sizeof(name), "/etc/f%u", n % 6);
+		e.type = EVENT_SYSCALL;
+		e.syscall = n % 3 ? 2 : 59;
+		e.success = n % 5 != 0;
+		e.exit = n % 5 ? 3 : -13;
+		e.pid = 1000 + n % 9;
+		e.auid = 1000 + n % 3;
+		e.exe = exes[n % 3];
+		e.key = keys[n % 4];
+		e.name = name;
+		e.inode = 100 + n % 6;
+	} else {
+		e.type = EVENT_LOGIN;
+		e.pid = 3000 + n;
+		e.auid = 1000 + n % 3;
+		e.host = n % 5;
+		e.success = n % 3 != 0;
+	}
+	write_event(f, &e, path);
+	log_when += 37;
+}
+
+static int make_logs(void)
+{
+	unsigned int i, n;
+
+	// Oldest first, so the times go up through the files
+	for (i = LOGS; i > 0; i--) {
+		FILE *f = open_log(i - 1);
+
+		if (f == NULL)
+			return 1;
+		fputs(pending, f);
+		for (n = 0; n < EVENTS; n++) {
+			add_event(f, n + i, pending);
+			// Only the newest log finishes its last event itself
+			if (n < EVENTS - 1 || i == 1)
+				fputs(pending, f);
+		}
+		fclose(f);
+	}
+	return 0;
+}
+
+/* Runs the report and hands back all it wrote */
+static char *run(const char *opts, const char *rollup)
+{
+	char args[256];
+
+	snprintf(args, sizeof(args), "%s %s", rollup, opts);
+	return run_tool("aureport", args, NULL);
+}
+
+/* Returns 0 if --rollup gives the same report as reading the logs */
+static int compare(const char *what, const char *opts)
+{
+	char *plain = run(opts, ""), *rolled = run(opts, "--rollup");
+	int rc = 0;
+
+	if (plain == NULL || rolled == NULL || strcmp(plain, rolled)) {
+		printf("%s: aureport %s differs with --rollup:\n%s\n----\n%s\n",
+			what, opts, plain ? plain : "", rolled ? rolled : "");
+		rc = 1;
+	}
+	free(plain);
+	free(rolled);
+	return rc;
+}
+
+static const char *reports[] = {
+	"--summary",
+	"-e --summary",
+	"-x --summary",
+	"-k --summary",
+	"-f --summary",
+	"-u --summary --failed",
+	"-h --summary",
+	"-s --summary",
+	"-l --summary",
+};
+#define REPORTS (sizeof(reports)/sizeof(reports[0]))
+
+/* Windows that start and end in the middle of an hour */
+static const char *windows[] = {
+	"",
+	"-ts 05/13/14 18:20:00 -te 05/14/14 02:40:30",
+	"-ts 05/13/14 23:59:59",
+	"-te 05/14/14 05:00:01",
+	"-ts 05/13/14 19:10:00 -te 05/13/14 19:50:00",
+};
+#define WINDOWS (sizeof(windows)/sizeof(windows[0]))
+
+static int compare_all(const char *what)
+{
+	unsigned int i, w;
+	int rc = 0;
+
+	for (i = 0; i < REPORTS; i++) {
+		for (w = 0; w < WINDOWS; w++) {
+			char opts[128];
+
+			snprintf(opts, sizeof(opts), "%s %s", reports[i],
+				windows[w]);
+			rc |= compare(what, opts);
+		}
+	}
+	return rc;
+}
+
+/* Swaps one key for another of the same length in a log */
+static int rewrite_key(const char *path, const char *from, const char *to)
+{
+	char *buf, *ptr;
+	struct stat st;
+	FILE *f;
+
+	if (stat(path, &st) || (buf = malloc(st.st_size + 1)) == NULL)
+		return 1;
+	f = fopen(path, "r+");
+	if (f == NULL || fread(buf, st.st_size, 1, f) != 1) {
+		if (f)
+			fclose(f);
+		free(buf);
+		return 1;
+	}
+	buf[st.st_size] = 0;
+	for (ptr = strstr(buf, from); ptr; ptr = strstr(ptr, from))
+		memcpy(ptr, to, strlen(to));
+	rewind(f);
+	fwrite(buf, st.st_size, 1, f);
+	free(buf);
+	return fclose(f);
+}
+
+static int set_mtime(const char *path, time_t t)
+{
+	struct timeval tv[2];
+
+	tv[0].tv_sec = tv[1].tv_sec = t;
+	tv[0].tv_usec = tv[1].tv_usec = 0;
+	return utimes(path, tv);
+}
+
+int main(void)
+{
+	char path[64], *before, *after;
+	struct stat st;
+	FILE *f;
+	int rc = 0;
+
+	rc = setup_logs("aureport", "rollup_test");
+	if (rc)
+		return rc;
+	if (make_logs()) {
+		printf("Can't make logs in %s\n", log_dir);
+		remove_logs();
+		return 1;
+	}
+
+	// The first run makes the rollups, the second one uses them
+	rc |= compare_all("new rollups");
+	rc |= compare_all("saved rollups");
+
+	// A log that looks the same keeps its rollup, even if it isn't
+	log_name(path, sizeof(path), 2);
+	before = run("-k --summary", "--rollup");
+	if (stat(path, &st) || rewrite_key(path, "\"net\"", "\"nix\"") ||
+			set_mtime(path, st.st_mtime)) {
+		printf("Can't change %s\n", path);
+		rc = 1;
+	}
+	after = run("-k --summary", "--rollup");
+	if (before == NULL || after == NULL || strcmp(before, after)) {
+		printf("Rollup of an unchanged log was not used\n");
+		rc = 1;
+	}
+	free(before);
+	free(after);
+
+	// A new modification time has it made again
+	if (set_mtime(path, st.st_mtime + 100)) {
+		printf("Can't change %s\n", path);
+		rc = 1;
+	}
+	rc |= compare("new mtime", "-k --summary");
+
+	// And so does a new size
+	log_name(path, sizeof(path), 1);
+	f = fopen(path, "a");
+	if (f == NULL || stat(path, &st)) {
+		printf("Can't change %s\n", path);
+		rc = 1;
+	} else {
+		unsigned long now = log_when;
+
+		// Inside the log's last hour
+		log_when -= 37 * (EVENTS + 1);
+		add_event(f, 1, NULL);
+		log_when = now;
+		fclose(f);
+		set_mtime(path, st.st_mtime);
+	}
+	rc |= compare("new size", "-k --summary");
+	rc |= compare("new size", "-x --summary -ts 05/13/14 18:20:00");
+
+	remove_logs();
+	if (rc == 0)
+		printf("%u tests passed\n",
+			(unsigned int)(2 * REPORTS * WINDOWS + 4));
+	return rc;
+}
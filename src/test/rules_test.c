@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libaudit.h"
+#include "ausearch-options.h"
+#include "ausearch-llist.h"
+#include "ausearch-rules.h"
+
+#define ARCH_B64 "c000003e"
+
+/* Makes an exit list rule on one syscall with the given keys */
+static struct audit_rule_data *make_rule(int list, int action,
+	uint32_t arch, int syscall, const char *keys)
+{
+	struct audit_rule_data *r;
+	size_t len = strlen(keys);
+	int i = 0;
+
+	r = calloc(1, sizeof(*r) + len);
+	if (r == NULL)
+		exit(1);
+	r->flags = list;
+	r->action = action;
+	if (arch) {
+		r->fields[i] = AUDIT_ARCH;
+		r->fieldflags[i] = AUDIT_EQUAL;
+		r->values[i++] = arch;
+	}
+	r->fields[i] = AUDIT_FILTERKEY;
+	r->fieldflags[i] = AUDIT_EQUAL;
+	r->values[i++] = len;
+	r->field_count = i;
+	memcpy(r->buf, keys, len);
+	r->buflen = len;
+	r->mask[AUDIT_WORD(syscall)] |= AUDIT_BIT(syscall);
+	return r;
+}
+
+static void add_rule(int list, int action, uint32_t arch, int syscall,
+	const char *keys)
+{
+	struct audit_rule_data *r = make_rule(list, action, arch, syscall,
+					keys);
+
+	rules_add(r);
+	free(r);
+}
+
+/* Checks an event made of the given records against the filter */
+static int check(const char *what, int expect, int type1, const char *msg1,
+	int type2, const char *msg2)
+{
+	llist l;
+	lnode n;
+	int rc;
+
+	list_create(&l);
+	memset(&n, 0, sizeof(n));
+	n.type = type1;
+	n.message = strdup(msg1);
+	list_append(&l, &n);
+	if (msg2) {
+		memset(&n, 0, sizeof(n));
+		n.type = type2;
+		n.message = strdup(msg2);
+		list_append(&l, &n);
+	}
+	rc = rules_may_match(&l);
+	list_clear(&l);
+	if (rc != expect) {
+		printf("%s: got %d expected %d\n", what, rc, expect);
+		return 1;
+	}
+	return 0;
+}
+
+#define SYSCALL(arch, nr) "type=SYSCALL msg=audit(1400000001.123:4567): " \
+	"arch=" arch " syscall=" #nr " success=yes exit=3 a0=1 a1=0 a2=0 " \
+	"a3=0 items=1 ppid=1 pid=2 auid=0 uid=0 key=\"k1\""
+#define PATH "type=PATH msg=audit(1400000001.123:4567): item=0 " \
+	"name=\"/etc/shadow\" inode=1 dev=fd:00 mode=0100640"
+#define CONFIG "type=CONFIG_CHANGE msg=audit(1400000001.123:4567): " \
+	"auid=0 ses=1 op=\"add_rule\" key=\"k1\" list=4 res=1"
+
+int main(void)
+{
+	int rc = 0;
+
+	event_key = "k1";
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_ALWAYS, AUDIT_ARCH_X86_64, 2, "k1");
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_ALWAYS, AUDIT_ARCH_X86_64, 59,
+		"k0");
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_NEVER, AUDIT_ARCH_X86_64, 87, "k1");
+	add_rule(AUDIT_FILTER_USER, AUDIT_ALWAYS, 0, 0, "k1");
+
+	rc |= check("keyed syscall", 1, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 2),
+		AUDIT_PATH, PATH);
+	rc |= check("other syscall", 0, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 4),
+		AUDIT_PATH, PATH);
+	rc |= check("other key", 0, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 59),
+		0, NULL);
+	rc |= check("never rule", 0, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 87),
+		0, NULL);
+	rc |= check("other arch", 0, AUDIT_SYSCALL, SYSCALL("40000003", 2),
+		0, NULL);
+	rc |= check("no syscall", 0, AUDIT_PATH, PATH, 0, NULL);
+	rc |= check("config change", 1, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 4),
+		AUDIT_CONFIG_CHANGE, CONFIG);
+	rc |= check("bad record", 1, AUDIT_SYSCALL,
+		"type=SYSCALL msg=audit(1400000001.123:4567): arch=", 0, NULL);
+
+	// A rule with several keys, and one without an arch
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_ALWAYS, AUDIT_ARCH_X86_64, 4,
+		"k0\001k1");
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_ALWAYS, 0, 5, "k1");
+	rc |= check("second key", 1, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 4),
+		0, NULL);
+	rc |= check("any arch", 1, AUDIT_SYSCALL, SYSCALL("40000003", 5),
+		0, NULL);
+	rules_clear();
+
+	// Keys match substrings unless -w is given
+	event_key = "k";
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_ALWAYS, AUDIT_ARCH_X86_64, 2, "k1");
+	rc |= check("substring", 1, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 2),
+		0, NULL);
+	rules_clear();
+	event_exact_match = 1;
+	add_rule(AUDIT_FILTER_EXIT, AUDIT_ALWAYS, AUDIT_ARCH_X86_64, 2, "k1");
+	rc |= check("whole word", 0, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 2),
+		0, NULL);
+	rules_clear();
+	event_exact_match = 0;
+
+	// Task rules key every syscall
+	event_key = "k1";
+	add_rule(AUDIT_FILTER_TASK, AUDIT_ALWAYS, 0, 0, "k1");
+	rc |= check("task rule", 1, AUDIT_SYSCALL, SYSCALL(ARCH_B64, 200),
+		0, NULL);
+	rules_clear();
+	event_key = NULL;
+
+	if (rc)
+		return 1;
+	printf("Rule filter tests passed\n");
+	return 0;
+}
@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+#include "libaudit.h"
+#include "auditctl-sync.h"
+
+#define MAX_RULES 16
+#define LOAD_RULES 200
+#define LEGACY 20	// This rule is a directory watch old kernels refuse
+
+/* Makes a rule on one syscall with a key, which is what tells them apart */
+static struct audit_rule_data *make_rule(int list, const char *key)
+{
+	struct audit_rule_data *r;
+	size_t len = strlen(key);
+
+	r = calloc(1, sizeof(*r) + len);
+	if (r == NULL)
+		exit(1);
+	r->flags = list;
+	r->action = AUDIT_ALWAYS;
+	r->fields[0] = AUDIT_FILTERKEY;
+	r->fieldflags[0] = AUDIT_EQUAL;
+	r->values[0] = len;
+	r->field_count = 1;
+	memcpy(r->buf, key, len);
+	r->buflen = len;
+	r->mask[0] = 1;
+	return r;
+}
+
+/*
+ * Rules are given as a string of keys, one letter each. Upper case ones
+ * go on the user list, lower case ones on the exit list. The expected
+ * outcome is a string with a letter for each loaded rule, k to keep and
+ * d to delete, and one for each wanted rule, l if it is loaded, a to
+ * append and p to prepend.
+ */
+static int check(const char *what, const char *have_keys,
+	const char *want_keys, const char *keep_expect,
+	const char *loaded_expect)
+{
+	struct audit_rule_data *have[MAX_RULES], *want[MAX_RULES];
+	int keep[MAX_RULES], loaded[MAX_RULES];
+	int i, hn = strlen(have_keys), wn = strlen(want_keys), rc = 0;
+	char key[2] = { 0, 0 };
+
+	for (i = 0; i < hn; i++) {
+		key[0] = have_keys[i];
+		have[i] = make_rule(key[0] < 'a' ? AUDIT_FILTER_USER :
+					AUDIT_FILTER_EXIT, key);
+	}
+	for (i = 0; i < wn; i++) {
+		key[0] = want_keys[i];
+		want[i] = make_rule(key[0] < 'a' ? AUDIT_FILTER_USER :
+					AUDIT_FILTER_EXIT, key);
+	}
+	sync_diff(have, hn, want, wn, keep, loaded);
+	for (i = 0; i < hn; i++) {
+		if (keep_expect[i] != (keep[i] ? 'k' : 'd')) {
+			printf("%s: loaded rule %d is wrong\n", what, i);
+			rc = 1;
+		}
+		free(have[i]);
+	}
+	for (i = 0; i < wn; i++) {
+		char c = loaded[i] == SYNC_LOADED ? 'l' :
+			loaded[i] == SYNC_PREPEND ? 'p' : 'a';
+
+		if (loaded_expect[i] != c) {
+			printf("%s: wanted rule %d is wrong\n", what, i);
+			rc = 1;
+		}
+		free(want[i]);
+	}
+	return rc;
+}
+
+/*
+ * A fake kernel for load_rules. The library's requests are taken out of
+ * sendto and each is acked at once over a socket, as the kernel does.
+ * Replies have to come from an address the size of a netlink one with a
+ * port id of 0, which an abstract unix socket name of 10 bytes looks
+ * like, with its bytes 2 to 5 where the port id goes.
+ */
+static int lib_fd = -1, kern_fd = -1;
+static char table[LOAD_RULES];	// Which rules are loaded
+static int deletes;
+static int refuse;		// Audit is disabled from this rule on
+
+static int open_kernel(void)
+{
+	struct sockaddr_un addr;
+	int sv[2];
+	pid_t pid = getpid();
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv))
+		return 1;
+	lib_fd = sv[0];
+	kern_fd = sv[1];
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(&addr.sun_path[6], &pid, sizeof(pid));
+	return bind(kern_fd, (struct sockaddr *)&addr,
+		offsetof(struct sockaddr_un, sun_path) + 10);
+}
+
+/* The rules are told apart by their key, which is their number */
+static int rule_id(const struct audit_rule_data *r)
+{
+	char key[16];
+	size_t len = r->buflen < sizeof(key) ? r->buflen : sizeof(key) - 1;
+
+	memcpy(key, r->buf, len);
+	key[len] = 0;
+	return atoi(key);
+}
+
+static int kernel_answer(int type, const struct audit_rule_data *r)
+{
+	int id = rule_id(r);
+
+	if (id < 0 || id >= LOAD_RULES || r->fields[0] == AUDIT_DIR)
+		return -EINVAL;
+	if (type == AUDIT_ADD_RULE) {
+		if (table[id])
+			return -EEXIST;
+		table[id] = 1;
+		return 0;
+	}
+	deletes++;
+	if (table[id] == 0)
+		return -ENOENT;
+	table[id] = 0;
+	return 0;
+}
+
+/* The library calls this instead of the one in libc */
+ssize_t sendto(int fd, const void *buf, size_t len, int flags,
+	const struct sockaddr *addr, socklen_t alen)
+{
+	const struct nlmsghdr *nlh = buf;
+	struct {
+		struct nlmsghdr nlh;
+		struct nlmsgerr err;
+	} ack;
+
+	if (fd != lib_fd || addr == NULL || addr->sa_family != AF_NETLINK)
+		return syscall(SYS_sendto, fd, buf, len, flags, addr, alen);
+	if (refuse >= 0 && rule_id(NLMSG_DATA(nlh)) >= refuse) {
+		errno = ECONNREFUSED;
+		return -1;
+	}
+	memset(&ack, 0, sizeof(ack));
+	ack.nlh.nlmsg_len = sizeof(ack);
+	ack.nlh.nlmsg_type = NLMSG_ERROR;
+	ack.nlh.nlmsg_seq = nlh->nlmsg_seq;
+	ack.err.error = kernel_answer(nlh->nlmsg_type, NLMSG_DATA(nlh));
+	if (send(kern_fd, &ack, sizeof(ack), 0) != sizeof(ack))
+		return -1;
+	return len;
+}
+
+/*
+ * Loads the rules into a fake kernel that has rule have already and
+ * refuses rules from refused on. Checks the rule loading stopped at,
+ * that the rules up to last are loaded and no others, and how many
+ * deletes it took to get there.
+ */
+static int check_load(const char *what, int stop, int have, int refused,
+	int stopped, int last, int dels)
+{
+	struct audit_rule_data *rules[LOAD_RULES];
+	int errors[LOAD_RULES];
+	int i, n, rc = 0;
+
+	memset(table, 0, sizeof(table));
+	deletes = 0;
+	refuse = refused;
+	if (have >= 0)
+		table[have] = 1;
+	for (i = 0; i < LOAD_RULES; i++) {
+		char key[16];
+
+		snprintf(key, sizeof(key), "%d", i);
+		rules[i] = make_rule(AUDIT_FILTER_EXIT, key);
+	}
+	rules[LEGACY]->fields[0] = AUDIT_DIR;
+
+	n = load_rules(lib_fd, rules, LOAD_RULES, errors, stop);
+	if (n != stopped) {
+		printf("%s: loading stopped at %d, not %d\n", what, n,
+			stopped);
+		rc = 1;
+	}
+	if (errors[LEGACY] || rules[LEGACY]->fields[0] != AUDIT_WATCH) {
+		printf("%s: the directory watch was not retried\n", what);
+		rc = 1;
+	}
+	if (have >= 0 && errors[have] != -EEXIST) {
+		printf("%s: the loaded rule got %d\n", what, errors[have]);
+		rc = 1;
+	}
+	if (refused >= 0 && errors[refused] != -ECONNREFUSED) {
+		printf("%s: the refused rule got %d\n", what, errors[refused]);
+		rc = 1;
+	}
+	for (i = 0; i < LOAD_RULES; i++) {
+		if (table[i] != (i <= last)) {
+			printf("%s: rule %d is %sloaded\n", what, i,
+				table[i] ? "" : "not ");
+			rc = 1;
+			break;
+		}
+	}
+	if (deletes != dels) {
+		printf("%s: %d rules were deleted, not %d\n", what, deletes,
+			dels);
+		rc = 1;
+	}
+	for (i = 0; i < LOAD_RULES; i++)
+		free(rules[i]);
+	return rc;
+}
+
+int main(void)
+{
+	struct audit_rule_data *a, *b;
+	int rc = 0;
+
+	// The list a rule was added to the head of doesn't matter
+	a = make_rule(AUDIT_FILTER_EXIT, "k");
+	b = make_rule(AUDIT_FILTER_EXIT | AUDIT_FILTER_PREPEND, "k");
+	if (rule_hash(a) != rule_hash(b) || !rule_same(a, b)) {
+		printf("Prepended rule doesn't match\n");
+		rc = 1;
+	}
+	b->flags = AUDIT_FILTER_TASK;
+	if (rule_same(a, b)) {
+		printf("Rules on other lists match\n");
+		rc = 1;
+	}
+	b->flags = AUDIT_FILTER_EXIT;
+	b->mask[1] = 1;
+	if (rule_same(a, b)) {
+		printf("Rules on other syscalls match\n");
+		rc = 1;
+	}
+	free(a);
+	free(b);
+
+	rc |= check("same", "abcd", "abcd", "kkkk", "llll");
+	rc |= check("empty kernel", "", "abc", "", "aaa");
+	rc |= check("empty file", "abc", "", "ddd", "");
+	rc |= check("removed", "abcd", "abd", "kkdk", "lll");
+	rc |= check("appended", "abc", "abcd", "kkk", "llla");
+	rc |= check("prepended", "abc", "xabc", "kkk", "plll");
+	rc |= check("changed early", "abcdefg", "axcdefg", "ddkkkkk",
+		"pplllll");
+	rc |= check("changed late", "abcdefg", "abcdexg", "kkkkkdd",
+		"lllllaa");
+	rc |= check("moved", "abcd", "bcda", "dkkk", "llla");
+	rc |= check("other list", "aBcD", "aBxD", "kkdk", "llal");
+	rc |= check("duplicate", "ab", "aab", "kk", "pll");
+
+	// Loading rules, where the ones after a failed rule are taken back
+	if (open_kernel()) {
+		printf("Can't make a fake kernel (%s)\n", strerror(errno));
+		return 1;
+	}
+	set_aumessage_mode(MSG_QUIET, DBG_NO);
+	rc |= check_load("stop", 1, 50, -1, 50, 50, LOAD_RULES - 51);
+	rc |= check_load("ignore", 0, 50, -1, LOAD_RULES, LOAD_RULES - 1, 0);
+	rc |= check_load("disabled", 1, -1, 120, 120, 119, 0);
+	rc |= check_load("disabled ignored", 0, -1, 120, 120, 119, 0);
+	close(lib_fd);
+	close(kern_fd);
+
+	if (rc)
+		return 1;
+	printf("Rule sync tests passed\n");
+	return 0;
+}
+
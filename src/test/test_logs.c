@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "test_logs.h"
+
+char log_dir[64];
+unsigned long log_serial = 100;
+unsigned long log_when = 1400000000;
+
+int setup_logs(const char *prog, const char *test)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), "../%s", prog);
+	if (access(path, X_OK)) {
+		printf("%s is not built\n", prog);
+		return 77;
+	}
+	// The times are for -ts and -te
+	setenv("TZ", "UTC", 1);
+	setenv("LC_ALL", "C", 1);
+	snprintf(log_dir, sizeof(log_dir), "/tmp/%sXXXXXX", test);
+	if (mkdtemp(log_dir) == NULL) {
+		printf("Can't make a directory for the logs\n");
+		return 1;
+	}
+	return 0;
+}
+
+void log_name(char *path, size_t size, unsigned int i)
+{
+	if (i == 0)
+		snprintf(path, size, "%s/audit.log", log_dir);
+	else
+		snprintf(path, size, "%s/audit.log.%u", log_dir, i);
+}
+
+FILE *open_log(unsigned int i)
+{
+	char path[64];
+
+	log_name(path, sizeof(path), i);
+	return fopen(path, "w");
+}
+
+/* Removes dir and the files in it, and those of its directories if deep */
+static void remove_dir(const char *dir, int deep)
+{
+	struct dirent *ent;
+	DIR *d;
+
+	d = opendir(dir);
+	if (d == NULL)
+		return;
+	while ((ent = readdir(d))) {
+		char path[256];
+		struct stat st;
+
+		if (strcmp(ent->d_name, ".") == 0 ||
+				strcmp(ent->d_name, "..") == 0)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		if (deep && lstat(path, &st) == 0 && S_ISDIR(st.st_mode))
+			remove_dir(path, 0);
+		else
+			unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+void remove_logs(void)
+{
+	if (log_dir[0])
+		remove_dir(log_dir, 1);
+}
+
+void write_event(FILE *f, const struct event *e, char *path)
+{
+	unsigned long s = log_serial++;
+	char record[RECORD_MAX];
+
+	record[0] = 0;
+	switch (e->type) {
+	case EVENT_SYSCALL:
+		fprintf(f, "type=SYSCALL msg=audit(%lu.%03u:%lu): "
+			"arch=c000003e syscall=%u success=%s exit=%d "
+			"a0=0 a1=0 a2=0 a3=0 items=1 ppid=1 pid=%u "
+			"auid=%u uid=%u gid=0 euid=0 suid=0 fsuid=0 egid=0 "
+			"sgid=0 fsgid=0 tty=pts0 ses=1 comm=\"x\" exe=\"%s\" "
+			"key=%s%s%s\n", log_when, e->ms, s, e->syscall,
+			e->success ? "yes" : "no", e->exit, e->pid, e->auid,
+			e->uid, e->exe, e->key ? "\"" : "",
+			e->key ? e->key : "(null)", e->key ? "\"" : "");
+		snprintf(record, sizeof(record), "type=PATH msg=audit("
+			"%lu.%03u:%lu): item=0 name=\"%s\" inode=%u dev=fd:00 "
+			"mode=0100644 ouid=0 ogid=0 rdev=00:00 "
+			"nametype=NORMAL\n", log_when, e->ms, s, e->name,
+			e->inode);
+		break;
+	case EVENT_LOGIN:
+		fprintf(f, "type=USER_LOGIN msg=audit(%lu.%03u:%lu): "
+			"pid=%u uid=0 auid=%u ses=2 msg='op=login id=%u "
+			"exe=\"/usr/sbin/sshd\" hostname=10.0.0.%u "
+			"addr=10.0.0.%u terminal=ssh res=%s'\n", log_when,
+			e->ms, s, e->pid, e->auid, e->auid, e->host, e->host,
+			e->success ? "success" : "failed");
+		break;
+	default:
+		fprintf(f, "type=USER_AUTH msg=audit(%lu.%03u:%lu): "
+			"pid=%u uid=0 auid=%u ses=2 msg='op=PAM:authentication "
+			"acct=\"user%u\" exe=\"/bin/su\" hostname=? addr=? "
+			"terminal=pts/1 res=%s'\n", log_when, e->ms, s, e->pid,
+			e->auid, e->acct, e->success ? "success" : "failed");
+		break;
+	}
+	if (path)
+		strcpy(path, record);
+	else
+		fputs(record, f);
+}
+
+char *read_all(FILE *f)
+{
+	char *out = NULL;
+	size_t len = 0, got;
+
+	do {
+		char *tmp = realloc(out, len + 4096);
+
+		if (tmp == NULL) {
+			free(out);
+			return NULL;
+		}
+		out = tmp;
+		got = fread(out + len, 1, 4095, f);
+		len += got;
+	} while (got);
+	out[len] = 0;
+	return out;
+}
+
+char *run_tool(const char *prog, const char *opts, int *status)
+{
+	char cmd[512], *out;
+	FILE *p;
+	int rc;
+
+	snprintf(cmd, sizeof(cmd), "../%s -if %s %s 2>/dev/null", prog,
+		log_dir, opts);
+	p = popen(cmd, "r");
+	if (p == NULL)
+		return NULL;
+	out = read_all(p);
+	rc = pclose(p);
+	if (status)
+		*status = rc;
+	return out;
+}
@@ -0,0 +1,69 @@
+#ifndef TEST_LOGS_H
+#define TEST_LOGS_H
+
+#include <stdio.h>
+
+/*
+ * Rotated logs for the tests that run ausearch and aureport. Each test
+ * picks its own mix of events, these write them out and run the tools.
+ */
+
+/* The directory the logs are in */
+extern char log_dir[];
+
+/* The serial number of the next event and the time it is logged at. A
+ * test moves the clock on as it likes. */
+extern unsigned long log_serial;
+extern unsigned long log_when;
+
+#define EVENT_SYSCALL	0	// A SYSCALL record and a PATH record
+#define EVENT_LOGIN	1	// A USER_LOGIN record
+#define EVENT_AUTH	2	// A USER_AUTH record
+
+struct event {
+	int type;
+	unsigned int ms;
+	unsigned int syscall;
+	int success;		// Or the result of a user message
+	int exit;
+	unsigned int pid;
+	unsigned int auid;
+	unsigned int uid;
+	const char *exe;
+	const char *key;	// NULL for none
+	const char *name;	// Of the syscall's path
+	unsigned int inode;
+	unsigned int host;	// A login is from 10.0.0.host
+	unsigned int acct;	// An auth is for userN
+};
+
+#define RECORD_MAX 256
+
+/*
+ * Checks ../prog is built, sets the time zone the tests' times are in,
+ * and makes a directory for the logs named for the test. Returns 0, 77
+ * if prog is not built so the test is skipped, or 1 on error.
+ */
+int setup_logs(const char *prog, const char *test);
+
+/* Fills in the name of log i, 0 being audit.log */
+void log_name(char *path, size_t size, unsigned int i);
+/* Opens log i to write it from the start */
+FILE *open_log(unsigned int i);
+/* Removes the directory, its files, and what is in its directories */
+void remove_logs(void);
+
+/*
+ * Writes the event at log_when with the next serial number. If path is
+ * not NULL, the PATH record of a syscall goes there instead of to the
+ * log, so it can be written later on, and it is emptied for other events.
+ */
+void write_event(FILE *f, const struct event *e, char *path);
+
+/* Reads all of a stream */
+char *read_all(FILE *f);
+/* Runs ../prog over the logs and hands back all it wrote. status may
+ * be NULL. */
+char *run_tool(const char *prog, const char *opts, int *status);
+
+#endif
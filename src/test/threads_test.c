@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_logs.h"
+
+/*
+ * Runs aureport over a set of rotated logs with one thread and with
+ * several, and checks every report comes out the same either way.
+ */
+
+#define LOGS 6
+#define EVENTS 300
+
+static const char *exes[] = { "/bin/cat", "/usr/bin/ls", "/usr/sbin/sshd",
+	"/usr/bin/vi" };
+static const char *keys[] = { "passwd", NULL, "mod", "time" };
+static const char *files[] = { "/etc/passwd", "/etc/shadow", "/tmp/x",
+	"/var/log/messages", "/root/.bashrc" };
+
+/* The PATH record of a syscall comes after the next event's records, as
+ * it does when several CPUs log at once. At the end of a file it goes to
+ * the start of the next one. */
+static char pending[RECORD_MAX];
+
+static void add_event(FILE *f, unsigned int n)
+{
+	char path[RECORD_MAX];
+	struct event e;
+
+	memset(&e, 0, sizeof(e));
+	e.ms = (n * 7) % 1000;
+	e.pid = 3000 + n;
+	e.auid = 1000 + n % 4;
+	e.success = n % 2;
+	switch (n % 5) {
+	case 0:
+	case 1:
+	case 2:
+		e.type = EVENT_SYSCALL;
+		e.syscall = (n / 5) % 4 ? 2 : 59;
+		e.success = n % 3 != 0;
+		e.exit = n % 3 ? 3 : -13;
+		e.pid = 1000 + n % 11;
+		e.exe = exes[n % 4];
+		e.key = keys[n % 4];
+		e.name = files[n % 5];
+		e.inode = 100 + n % 5;
+		break;
+	case 3:
+		e.type = EVENT_LOGIN;
+		e.host = n % 7;
+		break;
+	default:
+		e.type = EVENT_AUTH;
+		e.acct = n % 3;
+		e.success = n % 4 != 0;
+		break;
+	}
+	write_event(f, &e, path);
+	fputs(pending, f);
+	strcpy(pending, path);
+	// A few events a second, and now and then a gap to end them
+	log_when += n % 3 == 0;
+	if (n % 50 == 0)
+		log_when += 5;
+}
+
+static int make_logs(void)
+{
+	unsigned int i, n;
+
+	// Oldest first, so the times go up through the files
+	for (i = LOGS; i > 0; i--) {
+		FILE *f = open_log(i - 1);
+
+		if (f == NULL)
+			return 1;
+		fputs(pending, f);
+		pending[0] = 0;
+		for (n = 0; n < EVENTS; n++)
+			add_event(f, n + i);
+		// A clock that jumped ahead leaves an event open for good
+		if (i == 4) {
+			unsigned long now = log_when;
+
+			log_when += 100000;
+			add_event(f, 0);
+			log_when = now;
+		}
+		fclose(f);
+	}
+	return 0;
+}
+
+/* Runs the report and hands back all it wrote */
+static char *run(const char *opts, unsigned int threads, int *status)
+{
+	char args[256];
+
+	snprintf(args, sizeof(args), "--threads %u %s", threads, opts);
+	return run_tool("aureport", args, status);
+}
+
+static const char *reports[] = {
+	"",
+	"-i",
+	"-t",
+	"-x --summary",
+	"-x -i",
+	"-k --summary",
+	"-k",
+	"-f --summary -i",
+	"-f",
+	"-u -i",
+	"-u --summary --failed",
+	"-l",
+	"-au --success",
+	"-s --summary",
+	"-e",
+	"-h --summary",
+	"-ts 05/13/14 16:56:00 -te 05/13/14 17:01:30 -x --summary",
+	"-ts 05/13/14 16:56:00 -te 05/13/14 17:01:30 -e",
+};
+#define REPORTS (sizeof(reports)/sizeof(reports[0]))
+
+int main(void)
+{
+	unsigned int i, t, threads[] = { 2, 4, 8 };
+	int rc = 0;
+
+	rc = setup_logs("aureport", "threads_test");
+	if (rc)
+		return rc;
+	if (make_logs()) {
+		printf("Can't make logs in %s\n", log_dir);
+		remove_logs();
+		return 1;
+	}
+	for (i = 0; i < REPORTS && rc == 0; i++) {
+		int status1, status;
+		char *one = run(reports[i], 1, &status1);
+
+		if (one == NULL || strlen(one) == 0) {
+			printf("aureport %s gave nothing\n", reports[i]);
+			free(one);
+			rc = 1;
+			break;
+		}
+		for (t = 0; t < sizeof(threads)/sizeof(threads[0]); t++) {
+			char *many = run(reports[i], threads[t], &status);
+
+			if (many == NULL || status != status1 ||
+					strcmp(one, many)) {
+				printf("aureport %s --threads %u differs:\n"
+					"%s\n----\n%s\n", reports[i],
+					threads[t], one, many ? many : "");
+				rc = 1;
+			}
+			free(many);
+		}
+		free(one);
+	}
+	remove_logs();
+	if (rc == 0)
+		printf("%u tests passed\n", (unsigned int)REPORTS);
+	return rc;
+}
@@ -28,6 +28,7 @@
 #include "libaudit.h"
 
 #define LAST_SYSCALL 1400	// IA64 is in the 1300's right now
+#define LAST_DUMP 8192
 
 void usage(void)
 {
@@ -35,6 +36,35 @@ void usage(void)
 	exit(1);
 }
 
+/* Names the syscalls of the machine below last all at once */
+static const char **table_names(int machine, int last)
+{
+	static int nums[LAST_DUMP];
+	static const char *names[LAST_DUMP];
+	int i;
+
+	for (i = 0; i < last; i++)
+		nums[i] = i;
+	audit_syscalls_to_names(nums, last, machine, names);
+	return names;
+}
+
+/* Tells which other machines have a syscall of that name */
+static void print_known(const char *name)
+{
+	int nums[AUDIT_MACHINES], i;
+
+	if (audit_name_to_syscall_all(name, nums) == 0)
+		return;
+	fprintf(stderr, "%s is known on:", name);
+	for (i = 0; i < AUDIT_MACHINES; i++) {
+		if (nums[i] >= 0)
+			fprintf(stderr, " %s(%d)", audit_machine_to_name(i),
+				nums[i]);
+	}
+	fputc('\n', stderr);
+}
+
 int main(int argc, char *argv[])
 {
 	int i, rc;
@@ -99,12 +129,13 @@ int main(int argc, char *argv[])
 	}
 
 	if (dump) {
+		const char **names = table_names(machine, LAST_DUMP);
+
 		printf("Using %s syscall table:\n",
 			audit_machine_to_name(machine));
-		for (i=0; i<8192; i++) {
-			name = audit_syscall_to_name(i, machine);
-			if (name) 
-				printf("%d\t%s\n", i, name);
+		for (i=0; i<LAST_DUMP; i++) {
+			if (names[i]) 
+				printf("%d\t%s\n", i, names[i]);
 		}
 		return 0;
 	}
@@ -116,13 +147,16 @@ int main(int argc, char *argv[])
 				fprintf(stderr,
 					"Unknown syscall %s using %s lookup table\n",
 					name, audit_machine_to_name(machine));
+				print_known(name);
 				return 1;
 			} else
 				printf("%d\n", rc);
 		} else {
+			const char **names = table_names(machine,
+							LAST_SYSCALL);
 			int found = 0;
 			for (i=0; i< LAST_SYSCALL; i++) {
-				const char *n = audit_syscall_to_name(i, machine);
+				const char *n = names[i];
 				if (n && strcasestr(n, name)) {
 					found = 1;
 					printf("%-18s %d\n", n, i);